@@ -0,0 +1,117 @@
+#include <string.h>
+
+#include "alarm.h"
+#include "utils.h"
+
+_Static_assert(ALARM_FIELD_COUNT <= 32, "field bitmaps are 32 bits wide");
+_Static_assert(ALARM_RULE_COUNT <= 32, "rule bitmaps are 32 bits wide");
+_Static_assert((ALARM_JOURNAL_SIZE & (ALARM_JOURNAL_SIZE - 1)) == 0, "ALARM_JOURNAL_SIZE must be a power of two");
+
+#define DESCRIBE_RULE(name, field, direction, set, clear) \
+    {#name, ALARM_FIELD_##field, ALARM_##direction, (float)(set), (float)(clear)},
+
+const alarm_rule_t alarm_rules[ALARM_RULE_COUNT] = {ALARM_RULES(DESCRIBE_RULE)};
+
+// Rules depending on each field, filled once by alarm_init
+static uint32_t field_rules[ALARM_FIELD_COUNT];
+
+// Sampling a FLOAT or INT reads the field, a FLAG tests its status bits and
+// a HEX parses the alarm word, so every field compares as a float
+#define SAMPLE_FLOAT(id, field) values[ALARM_FIELD_##id] = state->field;
+#define SAMPLE_INT(id, field) values[ALARM_FIELD_##id] = (float)state->field;
+#define SAMPLE_FLAG(id, byte, mask) values[ALARM_FIELD_##id] = (state->tod_status[byte] & (mask)) ? 1.0f : 0.0f;
+#define SAMPLE_HEX(id, field) values[ALARM_FIELD_##id] = (float)atohex((char *)state->field);
+
+static void alarm_sample(const gpsdo_state_t *state, float *values)
+{
+    ALARM_FIELDS(SAMPLE_FLOAT, SAMPLE_INT, SAMPLE_FLAG, SAMPLE_HEX)
+}
+
+void alarm_init(alarm_engine_t *engine)
+{
+    memset(engine, 0, sizeof(alarm_engine_t));
+    memset(field_rules, 0, sizeof(field_rules));
+    for (int rule = 0; rule < ALARM_RULE_COUNT; rule++)
+    {
+        field_rules[alarm_rules[rule].field] |= 1u << rule;
+    }
+}
+
+// New state of a rule, holding the old one inside the hysteresis band
+static bool alarm_evaluate(const alarm_rule_t *rule, float value, bool active)
+{
+    switch (rule->direction)
+    {
+    case ALARM_BELOW:
+        return active ? !(value > rule->clear) : (value < rule->set);
+    case ALARM_OUTSIDE:
+        value = (value < 0) ? -value : value;
+        // fall through
+    default:
+        return active ? !(value < rule->clear) : (value > rule->set);
+    }
+}
+
+// Samples the fields and re-evaluates the rules of the ones that changed.
+// Returns the number of events added to the journal.
+int alarm_update(alarm_engine_t *engine, const gpsdo_state_t *state)
+{
+    float values[ALARM_FIELD_COUNT];
+    uint32_t dirty = 0;
+    uint32_t pending = 0;
+    int added = 0;
+
+    alarm_sample(state, values);
+    for (int field = 0; field < ALARM_FIELD_COUNT; field++)
+    {
+        if (!engine->sampled || (values[field] != engine->values[field]))
+        {
+            dirty |= 1u << field;
+        }
+    }
+    engine->sampled = true;
+    memcpy(engine->values, values, sizeof(values));
+
+    while (dirty != 0)
+    {
+        int field = __builtin_ctz(dirty);
+        dirty &= dirty - 1;
+        pending |= field_rules[field];
+    }
+
+    while (pending != 0)
+    {
+        int rule = __builtin_ctz(pending);
+        uint32_t bit = 1u << rule;
+        float value = values[alarm_rules[rule].field];
+        bool was_active = (engine->active & bit) != 0;
+        bool active = alarm_evaluate(&alarm_rules[rule], value, was_active);
+
+        pending &= pending - 1;
+        engine->evaluations++;
+        if (active == was_active)
+        {
+            continue;
+        }
+        engine->active ^= bit;
+
+        alarm_event_t *event = &engine->journal[engine->events % ALARM_JOURNAL_SIZE];
+        event->gps_time = state->gps_time;
+        event->value = value;
+        event->rule = rule;
+        event->raised = active;
+        engine->events++;
+        added++;
+    }
+    return added;
+}
+
+// Event number n, NULL once the journal has overwritten it or before it happens
+const alarm_event_t *alarm_event(const alarm_engine_t *engine, uint32_t n)
+{
+    if ((n >= engine->events) || ((engine->events - n) > ALARM_JOURNAL_SIZE))
+    {
+        return NULL;
+    }
+    return &engine->journal[n % ALARM_JOURNAL_SIZE];
+}
@@ -0,0 +1,122 @@
+#ifndef ALARM_H_
+#define ALARM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+// Rule engine over gpsdo_state_t. alarm_update() samples the fields below,
+// marks the ones that changed in a dirty bitmap and re-evaluates only the
+// rules depending on them, so the cost follows the changes and not the size
+// of the rule table. Rule transitions go into a small RAM journal.
+
+// Fields the rules can watch:
+//   FLOAT(id, field)             float field of gpsdo_state_t
+//   INT(id, field)               int field of gpsdo_state_t
+//   FLAG(id, byte, mask)         bits of tod_status (TOD packet bytes 33 to 36), 1 when any is set
+//   HEX(id, field)               hex string field of gpsdo_state_t, as returned by ALAR:HARD? and ALAR:OPER?
+#define ALARM_FIELDS(FLOAT, INT, FLAG, HEX)     \
+    FLOAT(TEMPERATURE, temperature)             \
+    FLOAT(ANTENNA_VOLTAGE, antenna_voltage)     \
+    FLOAT(ANTENNA_CURRENT, antenna_current)     \
+    FLOAT(DAC, dac)                             \
+    FLOAT(PHASE, phase)                         \
+    INT(TFOM, tfom)                             \
+    INT(FFOM, ffom)                             \
+    INT(SATELLITES, satellite_trk)              \
+    /* 33: 0x01 phase settling, 0x10 PPS invalid, 0x02 leap pending */ \
+    FLAG(PHASE_SETTLING, 0, 0x01)               \
+    FLAG(PPS_INVALID, 0, 0x10)                  \
+    FLAG(LEAP_PENDING, 0, 0x02)                 \
+    /* 34: 0x08 antenna open or shorted */      \
+    FLAG(ANTENNA_FAULT, 1, 0x08)                \
+    /* 35: 0x45 when locked, 0x4F while settling or without antenna */ \
+    FLAG(NOT_LOCKED, 2, 0x0a)                   \
+    /* 36: 0x10 date invalid */                 \
+    FLAG(DATE_INVALID, 3, 0x10)                 \
+    HEX(HW_ALARM, alarm_hw)                     \
+    HEX(OP_ALARM, alarm_op)
+
+// Threshold rules with hysteresis, raised past set and cleared past clear:
+//   ABOVE     raised when value > set, cleared when value < clear
+//   BELOW     raised when value < set, cleared when value > clear
+//   OUTSIDE   raised when |value| > set, cleared when |value| < clear
+#define ALARM_RULES(RULE)                                     \
+    RULE(TEMP_HIGH, TEMPERATURE, ABOVE, 60.0, 55.0)           \
+    RULE(ANTENNA_LOW, ANTENNA_VOLTAGE, BELOW, 4.5, 4.7)       \
+    RULE(ANTENNA_OPEN, ANTENNA_CURRENT, BELOW, 5.0, 8.0)      \
+    RULE(ANTENNA_SHORT, ANTENNA_CURRENT, ABOVE, 80.0, 70.0)   \
+    RULE(EFC_RAIL, DAC, OUTSIDE, 90.0, 85.0)                  \
+    RULE(PHASE_ERROR, PHASE, OUTSIDE, 1e-7, 5e-8)             \
+    RULE(TFOM_HIGH, TFOM, ABOVE, 4.5, 2.5)                    \
+    RULE(FEW_SATELLITES, SATELLITES, BELOW, 2.5, 3.5)         \
+    RULE(PPS_INVALID, PPS_INVALID, ABOVE, 0.5, 0.5)           \
+    RULE(ANTENNA_FAULT, ANTENNA_FAULT, ABOVE, 0.5, 0.5)       \
+    RULE(NOT_LOCKED, NOT_LOCKED, ABOVE, 0.5, 0.5)             \
+    RULE(HW_ALARM, HW_ALARM, ABOVE, 0.5, 0.5)                 \
+    RULE(OP_ALARM, OP_ALARM, ABOVE, 0.5, 0.5)
+
+// Transitions kept in the journal, a power of two
+#define ALARM_JOURNAL_SIZE (32)
+
+#define ALARM_FIELD_ID(id, ...) ALARM_FIELD_##id,
+#define ALARM_RULE_ID(name, field, direction, set, clear) ALARM_RULE_##name,
+
+typedef enum
+{
+    ALARM_FIELDS(ALARM_FIELD_ID, ALARM_FIELD_ID, ALARM_FIELD_ID, ALARM_FIELD_ID)
+        ALARM_FIELD_COUNT
+} alarm_field_id_t;
+
+typedef enum
+{
+    ALARM_RULES(ALARM_RULE_ID)
+        ALARM_RULE_COUNT
+} alarm_rule_id_t;
+
+typedef enum
+{
+    ALARM_ABOVE,
+    ALARM_BELOW,
+    ALARM_OUTSIDE,
+} alarm_direction_t;
+
+typedef struct
+{
+    const char *name;
+    uint8_t field;
+    uint8_t direction;
+    float set;
+    float clear;
+} alarm_rule_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t gps_time;
+    float value;
+    uint8_t rule;
+    uint8_t raised;
+} alarm_event_t;
+
+typedef struct
+{
+    // Field values as of the last update
+    float values[ALARM_FIELD_COUNT];
+    bool sampled;
+    // Raised rules, one bit per rule id
+    uint32_t active;
+    // Journal of transitions, event n sits at n % ALARM_JOURNAL_SIZE
+    alarm_event_t journal[ALARM_JOURNAL_SIZE];
+    uint32_t events;
+    // Rule evaluations done, to check the cost stays with the changes
+    uint32_t evaluations;
+} alarm_engine_t;
+
+extern const alarm_rule_t alarm_rules[ALARM_RULE_COUNT];
+
+void alarm_init(alarm_engine_t *engine);
+int alarm_update(alarm_engine_t *engine, const gpsdo_state_t *state);
+const alarm_event_t *alarm_event(const alarm_engine_t *engine, uint32_t n);
+
+#endif
@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc_track.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static portMUX_TYPE alloc_lock = portMUX_INITIALIZER_UNLOCKED;
+#define ALLOC_LOCK() portENTER_CRITICAL(&alloc_lock)
+#define ALLOC_UNLOCK() portEXIT_CRITICAL(&alloc_lock)
+#define ALLOC_LOG(format, ...) ESP_LOGI("alloc_track", format, ##__VA_ARGS__)
+#else
+#include <pthread.h>
+
+static pthread_mutex_t alloc_lock = PTHREAD_MUTEX_INITIALIZER;
+#define ALLOC_LOCK() pthread_mutex_lock(&alloc_lock)
+#define ALLOC_UNLOCK() pthread_mutex_unlock(&alloc_lock)
+#define ALLOC_LOG(format, ...) printf(format "\n", ##__VA_ARGS__)
+#endif
+
+_Static_assert((ALLOC_TRACK_LIVE_SLOTS & (ALLOC_TRACK_LIVE_SLOTS - 1)) == 0, "ALLOC_TRACK_LIVE_SLOTS must be a power of two");
+_Static_assert(ALLOC_TRACK_SITES <= 256 && ALLOC_TRACK_TASKS <= 256, "site and task indexes are 8 bits");
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+typedef struct
+{
+    void *ptr;
+    uint32_t size;
+    uint8_t site;
+    uint8_t task;
+} alloc_live_t;
+
+static alloc_live_t live[ALLOC_TRACK_LIVE_SLOTS];
+static alloc_track_site_t sites[ALLOC_TRACK_SITES];
+static alloc_track_task_t tasks[ALLOC_TRACK_TASKS];
+static alloc_track_totals_t totals;
+
+static uint32_t live_hash(const void *ptr)
+{
+    return ((uint32_t)(uintptr_t)ptr * 2654435761u) >> 8;
+}
+
+// Slot of a call site, the last one counts the sites that found the table full
+static int site_slot(const void *caller)
+{
+    for (int i = 0; i < ALLOC_TRACK_SITES - 1; i++)
+    {
+        if (sites[i].caller == NULL)
+        {
+            sites[i].caller = caller;
+        }
+        if (sites[i].caller == caller)
+        {
+            return i;
+        }
+    }
+    sites[ALLOC_TRACK_SITES - 1].caller = ALLOC_TRACK_OTHER;
+    return ALLOC_TRACK_SITES - 1;
+}
+
+static const void *current_task(void)
+{
+#ifdef ESP_PLATFORM
+    return xTaskGetCurrentTaskHandle();
+#else
+    return (const void *)pthread_self();
+#endif
+}
+
+static void task_name(const void *task, char *name)
+{
+#ifdef ESP_PLATFORM
+    const char *task_name = (task != NULL) ? pcTaskGetTaskName((TaskHandle_t)task) : "startup";
+    strncpy(name, task_name, ALLOC_TRACK_TASK_NAME_SIZE - 1);
+#else
+    snprintf(name, ALLOC_TRACK_TASK_NAME_SIZE, "thread %lx", (unsigned long)(uintptr_t)task & 0xffff);
+#endif
+}
+
+// Slot of a task, allocations made before the scheduler runs count as the
+// startup task and the last slot takes the tasks that found the table full
+static int task_slot(const void *task)
+{
+    const void *key = (task != NULL) ? task : ALLOC_TRACK_STARTUP;
+
+    for (int i = 0; i < ALLOC_TRACK_TASKS - 1; i++)
+    {
+        if (tasks[i].task == NULL)
+        {
+            tasks[i].task = key;
+            task_name(task, tasks[i].name);
+        }
+        if (tasks[i].task == key)
+        {
+            return i;
+        }
+    }
+    if (tasks[ALLOC_TRACK_TASKS - 1].task == NULL)
+    {
+        tasks[ALLOC_TRACK_TASKS - 1].task = ALLOC_TRACK_OTHER;
+        strcpy(tasks[ALLOC_TRACK_TASKS - 1].name, "other");
+    }
+    return ALLOC_TRACK_TASKS - 1;
+}
+
+static void counters_alloc(alloc_track_counters_t *counters, uint32_t size)
+{
+    counters->allocs++;
+    counters->live_bytes += size;
+    counters->peak_bytes = (counters->live_bytes > counters->peak_bytes) ? counters->live_bytes : counters->peak_bytes;
+}
+
+static void counters_free(alloc_track_counters_t *counters, uint32_t size)
+{
+    counters->frees++;
+    counters->live_bytes -= size;
+}
+
+static void track_alloc(void *ptr, size_t size, const void *caller)
+{
+    const void *task = current_task();
+
+    ALLOC_LOCK();
+    uint32_t slot = live_hash(ptr) & (ALLOC_TRACK_LIVE_SLOTS - 1);
+    uint32_t probes;
+    for (probes = 0; (probes < ALLOC_TRACK_LIVE_SLOTS) && (live[slot].ptr != NULL); probes++)
+    {
+        slot = (slot + 1) & (ALLOC_TRACK_LIVE_SLOTS - 1);
+    }
+    if (probes == ALLOC_TRACK_LIVE_SLOTS)
+    {
+        totals.untracked++;
+        ALLOC_UNLOCK();
+        return;
+    }
+
+    live[slot].ptr = ptr;
+    live[slot].size = size;
+    live[slot].site = site_slot(caller);
+    live[slot].task = task_slot(task);
+    counters_alloc(&sites[live[slot].site].counters, size);
+    counters_alloc(&tasks[live[slot].task].counters, size);
+    counters_alloc(&totals.counters, size);
+    ALLOC_UNLOCK();
+}
+
+// Forgets ptr, closing the gap with backward shift deletion so that linear
+// probing never needs tombstones
+static void track_free(void *ptr)
+{
+    ALLOC_LOCK();
+    uint32_t slot = live_hash(ptr) & (ALLOC_TRACK_LIVE_SLOTS - 1);
+    uint32_t probes;
+    for (probes = 0; (probes < ALLOC_TRACK_LIVE_SLOTS) && (live[slot].ptr != ptr); probes++)
+    {
+        if (live[slot].ptr == NULL)
+        {
+            probes = ALLOC_TRACK_LIVE_SLOTS;
+            break;
+        }
+        slot = (slot + 1) & (ALLOC_TRACK_LIVE_SLOTS - 1);
+    }
+    if (probes == ALLOC_TRACK_LIVE_SLOTS)
+    {
+        ALLOC_UNLOCK();
+        return;
+    }
+
+    counters_free(&sites[live[slot].site].counters, live[slot].size);
+    counters_free(&tasks[live[slot].task].counters, live[slot].size);
+    counters_free(&totals.counters, live[slot].size);
+
+    uint32_t hole = slot;
+    // A full table has no empty slot to stop at, one lap is the most to walk
+    for (uint32_t next = (slot + 1) & (ALLOC_TRACK_LIVE_SLOTS - 1); (next != slot) && (live[next].ptr != NULL);
+         next = (next + 1) & (ALLOC_TRACK_LIVE_SLOTS - 1))
+    {
+        uint32_t home = live_hash(live[next].ptr) & (ALLOC_TRACK_LIVE_SLOTS - 1);
+        // Move the entry into the hole unless its home lies cyclically in (hole, next]
+        if (((next - home) & (ALLOC_TRACK_LIVE_SLOTS - 1)) >= ((next - hole) & (ALLOC_TRACK_LIVE_SLOTS - 1)))
+        {
+            live[hole] = live[next];
+            hole = next;
+        }
+    }
+    live[hole].ptr = NULL;
+    ALLOC_UNLOCK();
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    if (ptr != NULL)
+    {
+        track_alloc(ptr, size, __builtin_return_address(0));
+    }
+    return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    if (ptr != NULL)
+    {
+        track_alloc(ptr, count * size, __builtin_return_address(0));
+    }
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    void *moved = __real_realloc(ptr, size);
+    if ((ptr != NULL) && ((moved != NULL) || (size == 0)))
+    {
+        track_free(ptr);
+    }
+    if (moved != NULL)
+    {
+        track_alloc(moved, size, __builtin_return_address(0));
+    }
+    return moved;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr != NULL)
+    {
+        track_free(ptr);
+    }
+    __real_free(ptr);
+}
+
+void alloc_track_get_totals(alloc_track_totals_t *out)
+{
+    ALLOC_LOCK();
+    *out = totals;
+    ALLOC_UNLOCK();
+#ifdef ESP_PLATFORM
+    out->heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    out->heap_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+#endif
+}
+
+// Percentage of the free heap that is not part of the largest free block
+int alloc_track_fragmentation(const alloc_track_totals_t *totals)
+{
+    if (totals->heap_free == 0)
+    {
+        return 0;
+    }
+    return 100 - (int)((uint64_t)totals->heap_largest_block * 100 / totals->heap_free);
+}
+
+// Copies the max used entries with the most live bytes into out, largest
+// first, by insertion while scanning the table
+#define GET_TOP(table, count, field, out, max)                                                  \
+    int found = 0;                                                                              \
+    ALLOC_LOCK();                                                                               \
+    for (int i = 0; i < (count); i++)                                                           \
+    {                                                                                           \
+        if ((table)[i].field == NULL)                                                           \
+        {                                                                                       \
+            continue;                                                                           \
+        }                                                                                       \
+        int j = (found < (max)) ? found++ : (max);                                              \
+        for (; (j > 0) && ((out)[j - 1].counters.live_bytes < (table)[i].counters.live_bytes); j--) \
+        {                                                                                       \
+            if (j < (max))                                                                      \
+            {                                                                                   \
+                (out)[j] = (out)[j - 1];                                                        \
+            }                                                                                   \
+        }                                                                                       \
+        if (j < (max))                                                                          \
+        {                                                                                       \
+            (out)[j] = (table)[i];                                                              \
+        }                                                                                       \
+    }                                                                                           \
+    ALLOC_UNLOCK();                                                                             \
+    return found;
+
+int alloc_track_get_sites(alloc_track_site_t *out, int max)
+{
+    GET_TOP(sites, ALLOC_TRACK_SITES, caller, out, max)
+}
+
+int alloc_track_get_tasks(alloc_track_task_t *out, int max)
+{
+    GET_TOP(tasks, ALLOC_TRACK_TASKS, task, out, max)
+}
+
+static void dump_counters(const char *label, const alloc_track_counters_t *counters)
+{
+    ALLOC_LOG("%-16s %7u %7u %8u %8u", label, counters->allocs, counters->frees, counters->live_bytes, counters->peak_bytes);
+}
+
+// Prints the totals, the heap state and every call site and task
+void alloc_track_dump(void)
+{
+    static alloc_track_site_t site_copy[ALLOC_TRACK_SITES];
+    static alloc_track_task_t task_copy[ALLOC_TRACK_TASKS];
+    alloc_track_totals_t total;
+    char label[16];
+
+    alloc_track_get_totals(&total);
+    int site_count = alloc_track_get_sites(site_copy, ALLOC_TRACK_SITES);
+    int task_count = alloc_track_get_tasks(task_copy, ALLOC_TRACK_TASKS);
+
+    ALLOC_LOG("Heap free %u, largest block %u, fragmentation %d%%, untracked %u",
+              total.heap_free, total.heap_largest_block, alloc_track_fragmentation(&total), total.untracked);
+    ALLOC_LOG("%-16s %7s %7s %8s %8s", "", "allocs", "frees", "live", "peak");
+    dump_counters("total", &total.counters);
+    for (int i = 0; i < site_count; i++)
+    {
+        if (site_copy[i].caller == ALLOC_TRACK_OTHER)
+        {
+            snprintf(label, sizeof(label), "other");
+        }
+        else
+        {
+            snprintf(label, sizeof(label), "%p", site_copy[i].caller);
+        }
+        dump_counters(label, &site_copy[i].counters);
+    }
+    for (int i = 0; i < task_count; i++)
+    {
+        dump_counters(task_copy[i].name, &task_copy[i].counters);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ALLOC_TRACK_H_
+#define ALLOC_TRACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Allocation accounting. malloc, calloc, realloc and free are wrapped at link
+// time (-Wl,--wrap, see src/CMakeLists.txt), so every caller is counted
+// without touching its code. Each live block is remembered with the return
+// address of its caller and the task that allocated it, which gives the
+// live and peak bytes per call site and per task. Pointers that do not fit
+// the live table, or that were allocated before tracking could see them,
+// are passed straight through.
+//
+// The host build links with the same flags (see tools/alloc_track_test.c),
+// a leak check there is
+//
+//     alloc_track_totals_t before, after;
+//     alloc_track_get_totals(&before);
+//     parse_status(...);
+//     alloc_track_get_totals(&after);
+//     assert(after.counters.live_bytes == before.counters.live_bytes);
+
+// Live blocks tracked at once, a power of two
+#define ALLOC_TRACK_LIVE_SLOTS (256)
+// Distinct call sites and tasks counted, the last slot takes the overflow
+#define ALLOC_TRACK_SITES (32)
+#define ALLOC_TRACK_TASKS (16)
+#define ALLOC_TRACK_TASK_NAME_SIZE (16)
+
+// Keys of the overflow entries and of the allocations made before the scheduler starts
+#define ALLOC_TRACK_OTHER ((const void *)1)
+#define ALLOC_TRACK_STARTUP ((const void *)2)
+
+typedef struct
+{
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t live_bytes;
+    uint32_t peak_bytes;
+} alloc_track_counters_t;
+
+typedef struct
+{
+    const void *caller;
+    alloc_track_counters_t counters;
+} alloc_track_site_t;
+
+typedef struct
+{
+    const void *task;
+    char name[ALLOC_TRACK_TASK_NAME_SIZE];
+    alloc_track_counters_t counters;
+} alloc_track_task_t;
+
+typedef struct
+{
+    alloc_track_counters_t counters;
+    // Allocations the live table had no room for
+    uint32_t untracked;
+    // Heap state, zero where the platform cannot tell
+    uint32_t heap_free;
+    uint32_t heap_largest_block;
+} alloc_track_totals_t;
+
+void alloc_track_get_totals(alloc_track_totals_t *totals);
+int alloc_track_get_sites(alloc_track_site_t *sites, int max);
+int alloc_track_get_tasks(alloc_track_task_t *tasks, int max);
+int alloc_track_fragmentation(const alloc_track_totals_t *totals);
+void alloc_track_dump(void);
+
+#endif
@@ -0,0 +1,209 @@
+#include <string.h>
+
+#include "main.h"
+#include "clock_sync.h"
+
+#define NOMINAL_PERIOD_Q16 (1000000LL << 16)
+#define MAX_DEVIATION_Q16 (CLOCK_SYNC_MAX_PPM * (1LL << 16))
+
+void clock_sync_init(clock_sync_t *cs)
+{
+    memset(cs->samples, 0, sizeof(cs->samples));
+    cs->head = 0;
+    cs->count = 0;
+    atomic_init(&cs->sequence, 0);
+    memset(&cs->model, 0, sizeof(cs->model));
+}
+
+static void model_write(clock_sync_t *cs, const clock_sync_model_t *model)
+{
+    atomic_fetch_add(&cs->sequence, 1);
+    atomic_thread_fence(memory_order_release);
+    cs->model = *model;
+    atomic_thread_fence(memory_order_release);
+    atomic_fetch_add(&cs->sequence, 1);
+}
+
+static bool model_read(clock_sync_t *cs, clock_sync_model_t *model)
+{
+    unsigned int before, after;
+
+    do
+    {
+        before = atomic_load(&cs->sequence);
+        atomic_thread_fence(memory_order_acquire);
+        *model = cs->model;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load(&cs->sequence);
+    } while ((before & 1) || (before != after));
+
+    return model->period_q16 != 0;
+}
+
+static int64_t model_boundary(const clock_sync_model_t *model, uint32_t second)
+{
+    return model->boundary_us + (((int64_t)(int32_t)(second - model->second) * model->period_q16) >> 16);
+}
+
+// Least squares slope over the window for the period, then the smallest
+// residual against that slope for the anchor
+static void fit(clock_sync_t *cs, clock_sync_model_t *model)
+{
+    const clock_sync_sample_t *first = &cs->samples[(cs->head + CLOCK_SYNC_WINDOW - cs->count) % CLOCK_SYNC_WINDOW];
+    int64_t n = cs->count, sx = 0, sy = 0, sxx = 0, sxy = 0;
+
+    for (uint32_t i = 0; i < cs->count; i++)
+    {
+        const clock_sync_sample_t *sample = &cs->samples[(cs->head + CLOCK_SYNC_WINDOW - cs->count + i) % CLOCK_SYNC_WINDOW];
+        int64_t x = sample->second - first->second;
+        int64_t y = sample->boundary_us - first->boundary_us;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+
+    int64_t period_q16 = (((n * sxy) - (sx * sy)) << 16) / ((n * sxx) - (sx * sx));
+    period_q16 = MAX(period_q16, NOMINAL_PERIOD_Q16 - MAX_DEVIATION_Q16);
+    period_q16 = MIN(period_q16, NOMINAL_PERIOD_Q16 + MAX_DEVIATION_Q16);
+
+    int64_t offset = INT64_MAX;
+    for (uint32_t i = 0; i < cs->count; i++)
+    {
+        const clock_sync_sample_t *sample = &cs->samples[(cs->head + CLOCK_SYNC_WINDOW - cs->count + i) % CLOCK_SYNC_WINDOW];
+        int64_t x = sample->second - first->second;
+        offset = MIN(offset, sample->boundary_us - first->boundary_us - ((x * period_q16) >> 16));
+    }
+
+    model->second = first->second;
+    model->boundary_us = first->boundary_us + offset;
+    model->period_q16 = period_q16;
+}
+
+// Feeds the end time of the TOD packet for a GPS second. When a boundary
+// was predicted for it, error_us receives how far the packet was off.
+bool clock_sync_tod(clock_sync_t *cs, uint32_t second, int64_t end_us, int32_t *error_us)
+{
+    clock_sync_model_t model;
+    int64_t boundary_us = end_us - CLOCK_SYNC_TOD_LATENCY_US;
+    bool predicted = false;
+
+    if (cs->count > 0)
+    {
+        const clock_sync_sample_t *last = &cs->samples[(cs->head + CLOCK_SYNC_WINDOW - 1) % CLOCK_SYNC_WINDOW];
+        // Time went backwards or skipped past the window, start over
+        if (((int32_t)(second - last->second) <= 0) || ((second - last->second) > CLOCK_SYNC_WINDOW))
+        {
+            cs->count = 0;
+        }
+    }
+
+    if (model_read(cs, &model))
+    {
+        int64_t error = boundary_us - model_boundary(&model, second);
+        if ((cs->count == 0) || (error > CLOCK_SYNC_MAX_ERROR_US) || (error < -CLOCK_SYNC_MAX_ERROR_US))
+        {
+            cs->count = 0;
+            memset(&model, 0, sizeof(model));
+            model_write(cs, &model);
+        }
+        else
+        {
+            *error_us = (int32_t)error;
+            predicted = true;
+        }
+    }
+
+    cs->samples[cs->head].second = second;
+    cs->samples[cs->head].boundary_us = boundary_us;
+    cs->head = (cs->head + 1) % CLOCK_SYNC_WINDOW;
+    cs->count = MIN(cs->count + 1, CLOCK_SYNC_WINDOW);
+
+    if (cs->count >= CLOCK_SYNC_MIN_SAMPLES)
+    {
+        fit(cs, &model);
+        model_write(cs, &model);
+    }
+    return predicted;
+}
+
+static uint32_t model_second(const clock_sync_model_t *model, int64_t now_us)
+{
+    int64_t elapsed_q16 = (now_us - model->boundary_us) * (1LL << 16);
+    int64_t seconds = elapsed_q16 / model->period_q16;
+
+    if ((elapsed_q16 % model->period_q16) < 0)
+    {
+        seconds--;
+    }
+    return model->second + (uint32_t)seconds;
+}
+
+// GPS second in progress at a local time
+bool clock_sync_second_at(clock_sync_t *cs, int64_t now_us, uint32_t *second)
+{
+    clock_sync_model_t model;
+
+    if (!model_read(cs, &model))
+    {
+        return false;
+    }
+    *second = model_second(&model, now_us);
+    return true;
+}
+
+// First second boundary after a local time
+bool clock_sync_next_boundary(clock_sync_t *cs, int64_t now_us, uint32_t *second, int64_t *boundary_us)
+{
+    clock_sync_model_t model;
+
+    if (!model_read(cs, &model))
+    {
+        return false;
+    }
+    *second = model_second(&model, now_us) + 1;
+    *boundary_us = model_boundary(&model, *second);
+    // Rounding of the fixed point period can land on the boundary itself
+    if (*boundary_us <= now_us)
+    {
+        *second += 1;
+        *boundary_us = model_boundary(&model, *second);
+    }
+    return true;
+}
+
+// GPS time at a local time, the fraction of the second in units of 2^-32 s
+// as NTP timestamps have it
+bool clock_sync_time_at(clock_sync_t *cs, int64_t now_us, uint32_t *second, uint32_t *fraction)
+{
+    clock_sync_model_t model;
+
+    if (!model_read(cs, &model))
+    {
+        return false;
+    }
+    *second = model_second(&model, now_us);
+    // Rounding of the fixed point period can put it just outside the second
+    int64_t period_us = (model.period_q16 + (1 << 15)) >> 16;
+    int64_t into_us = MAX(now_us - model_boundary(&model, *second), 0);
+    *fraction = MIN(((uint64_t)into_us << 32) / period_us, UINT32_MAX);
+    return true;
+}
+
+// Returns true once CLOCK_SYNC_REPORT_INTERVAL samples are in
+bool clock_sync_error_add(clock_sync_error_t *error, int32_t error_us)
+{
+    int32_t abs_us = error_us < 0 ? -error_us : error_us;
+
+    error->count++;
+    error->sum_abs_us += abs_us;
+    error->max_abs_us = MAX(error->max_abs_us, abs_us);
+    return error->count >= CLOCK_SYNC_REPORT_INTERVAL;
+}
+
+void clock_sync_error_reset(clock_sync_error_t *error)
+{
+    error->count = 0;
+    error->sum_abs_us = 0;
+    error->max_abs_us = 0;
+}
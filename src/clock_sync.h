@@ -0,0 +1,78 @@
+#ifndef CLOCK_SYNC_H_
+#define CLOCK_SYNC_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+// Predicts the GPS second boundaries on the local esp_timer clock from the
+// arrival times of the TOD packets. A packet ends a fixed latency after the
+// boundary of the second it describes, plus jitter that only ever delays it,
+// so the model fits the local length of a second over a window of arrivals
+// and anchors on the least delayed one.
+
+// Arrivals kept for the fit
+#define CLOCK_SYNC_WINDOW (16)
+// Arrivals needed before boundaries are predicted
+#define CLOCK_SYNC_MIN_SAMPLES (4)
+// Delay from a second boundary to the first byte of its TOD packet. Not
+// measured yet: calibrate by replaying a capture of the PPS output against
+// the TOD line through tools/clock_align_bench.c
+#define CLOCK_SYNC_TOD_DELAY_US (0)
+// Time on the line of a TOD packet, 10 bit times per byte
+#define CLOCK_SYNC_TOD_FRAME_US ((TOD_PACKET_SIZE * 10 * 1000000) / UART_BAUD_RATE)
+// Delay from a second boundary to the end of its TOD packet, which the
+// arrival times stamp
+#define CLOCK_SYNC_TOD_LATENCY_US (CLOCK_SYNC_TOD_DELAY_US + CLOCK_SYNC_TOD_FRAME_US)
+// Largest deviation of the local second from nominal, in ppm
+#define CLOCK_SYNC_MAX_PPM (200)
+// A packet further than this from its predicted boundary restarts the fit
+#define CLOCK_SYNC_MAX_ERROR_US (100000)
+// Samples summarised per alignment error report
+#define CLOCK_SYNC_REPORT_INTERVAL (60)
+
+typedef struct
+{
+    uint32_t second;
+    int64_t boundary_us;
+} clock_sync_sample_t;
+
+typedef struct
+{
+    // GPS second the model is anchored on and its boundary in local time
+    uint32_t second;
+    int64_t boundary_us;
+    // Local microseconds per GPS second, Q16. Zero while not locked.
+    int64_t period_q16;
+} clock_sync_model_t;
+
+typedef struct
+{
+    clock_sync_sample_t samples[CLOCK_SYNC_WINDOW];
+    uint32_t head;
+    uint32_t count;
+    // The model is written by the TOD parser and read by the display, a
+    // reader retries while the sequence is odd or changed under it
+    atomic_uint sequence;
+    clock_sync_model_t model;
+} clock_sync_t;
+
+// Running alignment error, kept by whoever measures it
+typedef struct
+{
+    uint32_t count;
+    int64_t sum_abs_us;
+    int32_t max_abs_us;
+} clock_sync_error_t;
+
+void clock_sync_init(clock_sync_t *cs);
+bool clock_sync_tod(clock_sync_t *cs, uint32_t second, int64_t end_us, int32_t *error_us);
+bool clock_sync_second_at(clock_sync_t *cs, int64_t now_us, uint32_t *second);
+bool clock_sync_next_boundary(clock_sync_t *cs, int64_t now_us, uint32_t *second, int64_t *boundary_us);
+bool clock_sync_time_at(clock_sync_t *cs, int64_t now_us, uint32_t *second, uint32_t *fraction);
+bool clock_sync_error_add(clock_sync_error_t *error, int32_t error_us);
+void clock_sync_error_reset(clock_sync_error_t *error);
+
+#endif
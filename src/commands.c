@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "commands.h"
+#include "utils.h"
+
+#define FIELD_SIZE(field) sizeof(((gpsdo_state_t *)0)->field)
+
+#define DESCRIBE_FLOAT(id, wire, field, period)                                                        \
+    [UCCM_CMD_##id] = {wire, sizeof(wire) - 2, UCCM_PARSE_FLOAT, period, offsetof(gpsdo_state_t, field), \
+                       FIELD_SIZE(field), NULL},
+#define DESCRIBE_STRING(id, wire, field, period)                                                        \
+    [UCCM_CMD_##id] = {wire, sizeof(wire) - 2, UCCM_PARSE_STRING, period, offsetof(gpsdo_state_t, field), \
+                       FIELD_SIZE(field), NULL},
+#define DESCRIBE_CUSTOM(id, wire, parser, period) \
+    [UCCM_CMD_##id] = {wire, sizeof(wire) - 2, UCCM_PARSE_CUSTOM, period, 0, 0, parser},
+#define DESCRIBE_IGNORED(id, wire, period) \
+    [UCCM_CMD_##id] = {wire, sizeof(wire) - 2, UCCM_PARSE_NONE, period, 0, 0, NULL},
+
+const uccm_command_t uccm_commands[UCCM_COMMAND_COUNT] = {
+    UCCM_COMMANDS(DESCRIBE_FLOAT, DESCRIBE_STRING, DESCRIBE_CUSTOM, DESCRIBE_IGNORED)};
+
+// Build time checks: the target fields must have the right type, a polled
+// command must be consumed and the poll periods must fit in the poll slots.
+// _Generic tells a float from an int of the same size, and a char array,
+// which decays to char *, from any other array.
+#define FIELD_IS(field, type) _Generic(((gpsdo_state_t *)0)->field, type: 1, default: 0)
+#define CHECK_FLOAT(id, wire, field, period) \
+    _Static_assert(FIELD_IS(field, float), wire " must target a float field");
+#define CHECK_STRING(id, wire, field, period) \
+    _Static_assert(FIELD_IS(field, char *) && (FIELD_SIZE(field) > 1), wire " must target a char array field");
+#define CHECK_CUSTOM(id, wire, parser, period)
+#define CHECK_IGNORED(id, wire, period) \
+    _Static_assert((period) == 0, "polled command " wire " is not consumed by any parser");
+
+UCCM_COMMANDS(CHECK_FLOAT, CHECK_STRING, CHECK_CUSTOM, CHECK_IGNORED)
+
+// Poll slots per thousand seconds used by each command
+#define LOAD_FIELD(id, wire, field, period) +((period) ? 1000 / (period) : 0)
+#define LOAD_CUSTOM(id, wire, parser, period) +((period) ? 1000 / (period) : 0)
+#define LOAD_IGNORED(id, wire, period)
+
+enum
+{
+    UCCM_POLL_LOAD = 0 UCCM_COMMANDS(LOAD_FIELD, LOAD_FIELD, LOAD_CUSTOM, LOAD_IGNORED)
+};
+
+_Static_assert(UCCM_POLL_LOAD <= 1000 * 1000 / UCCM_POLL_SLOT_MS, "UCCM poll periods exceed the poll slots");
+
+// Maps the echoed command (without the question mark) to its descriptor
+int uccm_command_find(const char *command)
+{
+    size_t length = strlen(command);
+
+    for (int i = 0; i < UCCM_COMMAND_COUNT; i++)
+    {
+        if ((uccm_commands[i].name_length == length) && (memcmp(uccm_commands[i].wire, command, length) == 0))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void uccm_command_apply(gpsdo_state_t *gpsdo_status, int id, char *data)
+{
+    const uccm_command_t *cmd = &uccm_commands[id];
+    uint8_t *field = (uint8_t *)gpsdo_status + cmd->offset;
+
+    switch (cmd->kind)
+    {
+    case UCCM_PARSE_FLOAT:
+        *(float *)field = atof(data);
+        break;
+    case UCCM_PARSE_STRING:
+        strncpy((char *)field, data, cmd->size - 1);
+        field[cmd->size - 1] = '\0';
+        break;
+    case UCCM_PARSE_CUSTOM:
+        cmd->parser(gpsdo_status, data);
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef COMMANDS_H_
+#define COMMANDS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "main.h"
+
+// One poll slot per UCCM_POLL_SLOT_MS, send_cmd_task sends the most overdue command
+#define UCCM_POLL_SLOT_MS (1000)
+
+// Every command the monitor knows about, with how its response is consumed:
+//   FIELD_FLOAT(id, wire, field, period)   number stored into a float field of gpsdo_state_t
+//   FIELD_STRING(id, wire, field, period)  text copied into a char array field of gpsdo_state_t
+//   CUSTOM(id, wire, parser, period)       response handed to a dedicated parser in utils.c
+//   IGNORED(id, wire, period)              response dropped, only allowed when never polled
+// period is the poll period in seconds, 0 means the command is never polled.
+#define UCCM_COMMANDS(FIELD_FLOAT, FIELD_STRING, CUSTOM, IGNORED)  \
+    CUSTOM(IDN, "*IDN?", parse_idn, 600)                           \
+    CUSTOM(SYST_STAT, "SYST:STAT?", parse_status, 5)               \
+    FIELD_STRING(ALAR_HARD, "ALAR:HARD?", alarm_hw, 15)            \
+    FIELD_STRING(ALAR_OPER, "ALAR:OPER?", alarm_op, 15)            \
+    CUSTOM(DIAG_LOOP, "DIAG:LOOP?", parse_loop, 20)                \
+    FIELD_FLOAT(EFC_REL, "DIAG:ROSC:EFC:REL?", dac, 5)             \
+    FIELD_FLOAT(EFC_DATA, "DIAG:ROSC:EFC:DATA?", efc_data, 20)     \
+    CUSTOM(GPS_POS, "GPS:POS?", parse_position, 30)                \
+    FIELD_STRING(LED_GPSL, "LED:GPSL?", status_gps, 15)            \
+    FIELD_STRING(OUTP_STAT, "OUTP:STAT?", status_output, 15)       \
+    CUSTOM(PULLINRANGE, "PULLINRANGE?", parse_pullin_range, 600)   \
+    FIELD_STRING(SYNC_FFOM, "SYNC:FFOM?", ffom_status, 20)         \
+    FIELD_FLOAT(SYNC_TINT, "SYNC:TINT?", tint, 10)                 \
+    IGNORED(SYNC_TFOM, "SYNC:TFOM?", 0)
+
+#define UCCM_COMMAND_ID_FIELD(id, wire, field, period) UCCM_CMD_##id,
+#define UCCM_COMMAND_ID_CUSTOM(id, wire, parser, period) UCCM_CMD_##id,
+#define UCCM_COMMAND_ID_IGNORED(id, wire, period) UCCM_CMD_##id,
+
+typedef enum
+{
+    UCCM_COMMANDS(UCCM_COMMAND_ID_FIELD, UCCM_COMMAND_ID_FIELD, UCCM_COMMAND_ID_CUSTOM, UCCM_COMMAND_ID_IGNORED)
+        UCCM_COMMAND_COUNT
+} uccm_command_id_t;
+
+// Build option: write the due polls of UCCM_BATCH in one go instead of one
+// per slot. The responses come back as one frame of several prompts, which
+// uart_receive_cmd_task splits again. Off unless set.
+#ifndef GPSDO_CMD_BATCH
+#define GPSDO_CMD_BATCH 0
+#endif
+
+// Short queries that may share a write, best with equal poll periods so
+// they stay due together
+#define UCCM_BATCH(CMD) CMD(LED_GPSL) CMD(OUTP_STAT) CMD(ALAR_HARD) CMD(ALAR_OPER)
+#define UCCM_BATCH_BIT(id) | (1u << UCCM_CMD_##id)
+#define UCCM_BATCH_MASK (0 UCCM_BATCH(UCCM_BATCH_BIT))
+
+typedef enum
+{
+    UCCM_PARSE_FLOAT,
+    UCCM_PARSE_STRING,
+    UCCM_PARSE_CUSTOM,
+    UCCM_PARSE_NONE,
+} uccm_parse_kind_t;
+
+typedef struct
+{
+    const char *wire;
+    // Length of the echoed command, without the question mark
+    uint8_t name_length;
+    uint8_t kind;
+    uint16_t period;
+    uint16_t offset;
+    uint16_t size;
+    void (*parser)(gpsdo_state_t *gpsdo_status, char *data);
+} uccm_command_t;
+
+extern const uccm_command_t uccm_commands[UCCM_COMMAND_COUNT];
+
+int uccm_command_find(const char *command);
+void uccm_command_apply(gpsdo_state_t *gpsdo_status, int id, char *data);
+
+#endif
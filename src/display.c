@@ -0,0 +1,117 @@
+#include <string.h>
+#include <esp_timer.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "display.h"
+#include "display_mirror.h"
+
+typedef struct
+{
+    const uint8_t *buffer;
+    uint8_t tile_y;
+    uint8_t tile_h;
+} display_frame_t;
+
+display_stats_t display_stats;
+
+static u8g2_t *display;
+static uint8_t *buffers[2];
+static int drawing;
+static uint16_t buffer_size;
+
+// Frame handed to the flush task, guarded by flush_idle
+static display_frame_t pending;
+static SemaphoreHandle_t flush_idle;
+static StaticSemaphore_t flush_idle_buffer;
+static TaskHandle_t volatile flush_task;
+
+// spare_buffer must hold as much as the buffer u8g2 was set up with
+void display_init(u8g2_t *u8g2, uint8_t *spare_buffer)
+{
+    display = u8g2;
+    buffers[0] = u8g2_GetBufferPtr(u8g2);
+    buffers[1] = spare_buffer;
+    drawing = 0;
+    buffer_size = u8g2_GetBufferTileHeight(u8g2) * u8g2_GetBufferTileWidth(u8g2) * 8;
+    flush_idle = xSemaphoreCreateBinaryStatic(&flush_idle_buffer);
+    xSemaphoreGive(flush_idle);
+#if GPSDO_DISPLAY_MIRROR
+    display_mirror_init(u8g2_GetBufferTileWidth(u8g2), u8g2_GetBufferTileHeight(u8g2));
+#endif
+}
+
+// Same tile writes as u8g2_UpdateDisplayArea, but from the given buffer
+static void display_flush(const display_frame_t *frame)
+{
+    u8x8_t *u8x8 = u8g2_GetU8x8(display);
+    uint8_t width = u8g2_GetBufferTileWidth(display);
+    int64_t start_us = esp_timer_get_time();
+
+    for (uint8_t row = frame->tile_y; row < frame->tile_y + frame->tile_h; row++)
+    {
+        u8x8_DrawTile(u8x8, 0, row, width, (uint8_t *)frame->buffer + (row * width * 8));
+    }
+    if ((frame->tile_y == 0) && (frame->tile_h == u8g2_GetBufferTileHeight(display)))
+    {
+        u8x8_RefreshDisplay(u8x8);
+    }
+
+    unsigned int flush_us = esp_timer_get_time() - start_us;
+    unsigned int flush_us_max = atomic_load(&display_stats.flush_us_max);
+    atomic_fetch_add(&display_stats.frames, 1);
+    atomic_fetch_add(&display_stats.flush_us_total, flush_us);
+    while ((flush_us > flush_us_max) &&
+           !atomic_compare_exchange_weak(&display_stats.flush_us_max, &flush_us_max, flush_us))
+    {
+    }
+#if GPSDO_DISPLAY_MIRROR
+    display_mirror_capture(frame->buffer);
+#endif
+}
+
+// Hands the tile rows of the back buffer to the flush task and swaps. Before
+// the flush task runs, as for the boot screen, the rows are sent right away.
+void display_present_rows(uint8_t tile_y, uint8_t tile_h)
+{
+    int64_t start_us = esp_timer_get_time();
+    uint8_t *frame = buffers[drawing];
+
+    xSemaphoreTake(flush_idle, portMAX_DELAY);
+    atomic_fetch_add(&display_stats.wait_us_total, (unsigned int)(esp_timer_get_time() - start_us));
+
+    pending.buffer = frame;
+    pending.tile_y = tile_y;
+    pending.tile_h = tile_h;
+    if (flush_task != NULL)
+    {
+        xTaskNotifyGive(flush_task);
+    }
+    else
+    {
+        display_flush(&pending);
+        xSemaphoreGive(flush_idle);
+    }
+
+    drawing ^= 1;
+    memcpy(buffers[drawing], frame, buffer_size);
+    display->tile_buf_ptr = buffers[drawing];
+}
+
+void display_present(void)
+{
+    display_present_rows(0, u8g2_GetBufferTileHeight(display));
+}
+
+void display_flush_task(void *pvParameters)
+{
+    flush_task = xTaskGetCurrentTaskHandle();
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        display_flush(&pending);
+        xSemaphoreGive(flush_idle);
+    }
+}
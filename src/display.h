@@ -0,0 +1,33 @@
+#ifndef DISPLAY_H_
+#define DISPLAY_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "u8g2.h"
+
+// Double buffered output for the u8g2 full frame buffer. Screens draw into
+// the back buffer as usual and call display_present(); the buffers are then
+// swapped and display_flush_task pushes the finished frame over SPI while
+// the next one is being composed. The new back buffer starts as a copy of
+// the presented frame, so partial redraws such as the clock keep working.
+
+typedef struct
+{
+    atomic_uint frames;
+    // Time spent pushing frames and time present waited for the previous push
+    atomic_uint flush_us_total;
+    atomic_uint flush_us_max;
+    atomic_uint wait_us_total;
+} display_stats_t;
+
+extern display_stats_t display_stats;
+
+void display_init(u8g2_t *u8g2, uint8_t *spare_buffer);
+void display_present(void);
+// Rows are tile rows of the panel, as the buffer holds them, not of the
+// rotated screen
+void display_present_rows(uint8_t tile_y, uint8_t tile_h);
+void display_flush_task(void *pvParameters);
+
+#endif
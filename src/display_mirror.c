@@ -0,0 +1,268 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "display_mirror.h"
+
+#if GPSDO_DISPLAY_MIRROR
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+
+static portMUX_TYPE capture_lock = portMUX_INITIALIZER_UNLOCKED;
+#define CAPTURE_LOCK() portENTER_CRITICAL(&capture_lock)
+#define CAPTURE_UNLOCK() portEXIT_CRITICAL(&capture_lock)
+#else
+#include <pthread.h>
+
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+#define CAPTURE_LOCK() pthread_mutex_lock(&capture_lock)
+#define CAPTURE_UNLOCK() pthread_mutex_unlock(&capture_lock)
+#endif
+
+#define FRAME_BYTES (DISPLAY_MIRROR_MAX_TILES * 8)
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+// Longest PackBits literal and repeat
+#define RLE_MAX (128)
+// Base64 characters buffered before they go to the console
+#define LINE_CHUNK (96)
+
+// PackBits feeding a streaming base64 encoder, so no encoded copy of the
+// frame is ever held
+typedef struct
+{
+    uint8_t literal[RLE_MAX];
+    int literal_count;
+    uint8_t run_value;
+    int run_count;
+    uint8_t triple[3];
+    int triple_count;
+    char line[LINE_CHUNK];
+    int line_length;
+    int bytes;
+} encoder_t;
+
+static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+display_mirror_stats_t display_mirror_stats;
+
+static uint8_t tile_width;
+static uint8_t tile_height;
+static uint16_t frame_size;
+// Last frame sent to the panel, the tile row emit works on and what the viewer has
+static uint8_t captured[FRAME_BYTES];
+static uint32_t capture_count;
+static uint8_t working[DISPLAY_MIRROR_MAX_TILE_WIDTH * 8];
+static uint8_t streamed[FRAME_BYTES];
+static uint32_t streamed_count;
+static uint8_t sequence;
+static int64_t keyframe_us;
+static bool keyframe_sent;
+
+void display_mirror_init(uint8_t width, uint8_t height)
+{
+    tile_width = MIN(width, DISPLAY_MIRROR_MAX_TILE_WIDTH);
+    tile_height = MIN(height, DISPLAY_MIRROR_MAX_TILES / tile_width);
+    frame_size = tile_width * tile_height * 8;
+}
+
+// Called by the flush task with every frame it pushes to the panel
+void display_mirror_capture(const uint8_t *frame)
+{
+    CAPTURE_LOCK();
+    memcpy(captured, frame, frame_size);
+    capture_count++;
+    CAPTURE_UNLOCK();
+}
+
+static void line_flush(encoder_t *encoder)
+{
+    fwrite(encoder->line, 1, encoder->line_length, stdout);
+    encoder->bytes += encoder->line_length;
+    encoder->line_length = 0;
+}
+
+// Room for the next four characters is made up front, base64_finish may
+// still rewrite the last ones as padding
+static void base64_put(encoder_t *encoder, uint8_t byte)
+{
+    encoder->triple[encoder->triple_count++] = byte;
+    if (encoder->triple_count < 3)
+    {
+        return;
+    }
+    if (encoder->line_length > LINE_CHUNK - 4)
+    {
+        line_flush(encoder);
+    }
+    uint32_t bits = (encoder->triple[0] << 16) | (encoder->triple[1] << 8) | encoder->triple[2];
+    for (int shift = 18; shift >= 0; shift -= 6)
+    {
+        encoder->line[encoder->line_length++] = base64[(bits >> shift) & 0x3f];
+    }
+    encoder->triple_count = 0;
+}
+
+static void base64_finish(encoder_t *encoder)
+{
+    int count = encoder->triple_count;
+    if (count > 0)
+    {
+        while (encoder->triple_count != 0)
+        {
+            base64_put(encoder, 0);
+        }
+        // The zero padding came out as A, replace it by =
+        for (int i = count + 1; i < 4; i++)
+        {
+            encoder->line[encoder->line_length - 4 + i] = '=';
+        }
+    }
+    line_flush(encoder);
+}
+
+static void rle_flush_literal(encoder_t *encoder)
+{
+    if (encoder->literal_count == 0)
+    {
+        return;
+    }
+    base64_put(encoder, encoder->literal_count - 1);
+    for (int i = 0; i < encoder->literal_count; i++)
+    {
+        base64_put(encoder, encoder->literal[i]);
+    }
+    encoder->literal_count = 0;
+}
+
+// Runs of three and more become a repeat, shorter ones join the literal
+static void rle_end_run(encoder_t *encoder)
+{
+    if (encoder->run_count >= 3)
+    {
+        rle_flush_literal(encoder);
+        base64_put(encoder, 257 - encoder->run_count);
+        base64_put(encoder, encoder->run_value);
+    }
+    else
+    {
+        for (int i = 0; i < encoder->run_count; i++)
+        {
+            encoder->literal[encoder->literal_count++] = encoder->run_value;
+            if (encoder->literal_count == RLE_MAX)
+            {
+                rle_flush_literal(encoder);
+            }
+        }
+    }
+    encoder->run_count = 0;
+}
+
+static void rle_put(encoder_t *encoder, uint8_t byte)
+{
+    if ((encoder->run_count > 0) && (byte == encoder->run_value) && (encoder->run_count < RLE_MAX))
+    {
+        encoder->run_count++;
+        return;
+    }
+    rle_end_run(encoder);
+    encoder->run_value = byte;
+    encoder->run_count = 1;
+}
+
+static void rle_finish(encoder_t *encoder)
+{
+    rle_end_run(encoder);
+    rle_flush_literal(encoder);
+}
+
+// Streams the tiles changed since the last update, or a key frame when one
+// is due. Returns the console bytes written, 0 when nothing changed. Tile
+// rows are copied out of the capture one at a time, a row may come from a
+// newer frame than the one before it, the next update catches up.
+int display_mirror_emit(int64_t now_us)
+{
+    static encoder_t encoder;
+    int row_bytes = tile_width * 8;
+    int changed_count = 0;
+    uint8_t flags = 0;
+
+    bool keyframe = !keyframe_sent || ((now_us - keyframe_us) >= DISPLAY_MIRROR_KEYFRAME_MS * 1000LL);
+    CAPTURE_LOCK();
+    bool changed = keyframe || ((capture_count != streamed_count) && (memcmp(captured, streamed, frame_size) != 0));
+    streamed_count = capture_count;
+    CAPTURE_UNLOCK();
+    if (!changed)
+    {
+        return 0;
+    }
+
+    if (keyframe)
+    {
+        // Every tile, against a blank screen
+        memset(streamed, 0, frame_size);
+        flags |= DISPLAY_MIRROR_KEYFRAME;
+        keyframe_us = now_us;
+        keyframe_sent = true;
+    }
+
+    memset(&encoder, 0, sizeof(encoder));
+    flockfile(stdout);
+    fputs(DISPLAY_MIRROR_PREFIX, stdout);
+    rle_put(&encoder, sequence++);
+    rle_put(&encoder, flags);
+    rle_put(&encoder, tile_width);
+    rle_put(&encoder, tile_height);
+    for (int row = 0; row < tile_height; row++)
+    {
+        uint8_t *was = &streamed[row * row_bytes];
+        uint8_t row_changed[DISPLAY_MIRROR_MAX_TILE_WIDTH / 8] = {0};
+
+        CAPTURE_LOCK();
+        memcpy(working, &captured[row * row_bytes], row_bytes);
+        CAPTURE_UNLOCK();
+        for (int column = 0; column < tile_width; column++)
+        {
+            bool tile_changed = keyframe;
+            for (int line = 0; !tile_changed && (line < 8); line++)
+            {
+                tile_changed = (working[(line * tile_width) + column] != was[(line * tile_width) + column]);
+            }
+            if (tile_changed)
+            {
+                row_changed[column / 8] |= 1 << (column % 8);
+                changed_count++;
+            }
+        }
+        for (int i = 0; i < (tile_width + 7) / 8; i++)
+        {
+            rle_put(&encoder, row_changed[i]);
+        }
+        for (int column = 0; column < tile_width; column++)
+        {
+            if ((row_changed[column / 8] & (1 << (column % 8))) == 0)
+            {
+                continue;
+            }
+            for (int line = 0; line < 8; line++)
+            {
+                int offset = (line * tile_width) + column;
+                rle_put(&encoder, working[offset] ^ was[offset]);
+                was[offset] = working[offset];
+            }
+        }
+    }
+    rle_finish(&encoder);
+    base64_finish(&encoder);
+    fputc('\n', stdout);
+    fflush(stdout);
+    funlockfile(stdout);
+
+    int bytes = encoder.bytes + sizeof(DISPLAY_MIRROR_PREFIX) - 1 + 1;
+    atomic_fetch_add(&display_mirror_stats.updates, 1);
+    atomic_fetch_add(&display_mirror_stats.tiles, changed_count);
+    atomic_fetch_add(&display_mirror_stats.bytes, bytes);
+    return bytes;
+}
+
+#endif
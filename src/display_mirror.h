@@ -0,0 +1,56 @@
+#ifndef DISPLAY_MIRROR_H_
+#define DISPLAY_MIRROR_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Live copy of the GLCD over the console, for boards nobody can look at.
+// The flush task captures every frame it sends to the panel, and
+// display_mirror_emit() compares the latest capture with the last one it
+// streamed, tile by tile. Only the changed tiles go out, XORed with their
+// previous content and run length encoded, so the bandwidth follows how much
+// of the screen changes rather than how often it is redrawn. A key frame,
+// every tile against a blank screen, goes out every
+// DISPLAY_MIRROR_KEYFRAME_MS for viewers that attach late or lost a line.
+//
+// Each update is one console line, "GLCD:" followed by the base64 of the
+// PackBits encoded payload
+//
+//     uint8_t sequence
+//     uint8_t flags (DISPLAY_MIRROR_KEYFRAME)
+//     uint8_t tile_width, tile_height
+//     then for each tile row
+//         uint8_t changed[(tile_width + 7) / 8]   bit (column & 7) of byte column / 8
+//         uint8_t delta[8]                          per changed tile, its pixel lines XOR the previous ones
+//
+// Tiles are 8x8 pixels of the ST7920 buffer, which u8g2 keeps as horizontal
+// pixel lines with the leftmost pixel in the top bit. tools/glcd_mirror.c
+// reassembles the screen on a Linux terminal.
+
+// Build option: stream the display on the console. The lines mix with the
+// log and the SCPI bridge, so this is off unless set.
+#ifndef GPSDO_DISPLAY_MIRROR
+#define GPSDO_DISPLAY_MIRROR 0
+#endif
+
+#define DISPLAY_MIRROR_MAX_TILE_WIDTH (16)
+#define DISPLAY_MIRROR_MAX_TILES (DISPLAY_MIRROR_MAX_TILE_WIDTH * 8)
+#define DISPLAY_MIRROR_KEYFRAME_MS (10000)
+#define DISPLAY_MIRROR_KEYFRAME (0x01)
+#define DISPLAY_MIRROR_PREFIX "GLCD:"
+
+typedef struct
+{
+    atomic_uint updates;
+    atomic_uint tiles;
+    // Console bytes, prefix and line end included
+    atomic_uint bytes;
+} display_mirror_stats_t;
+
+extern display_mirror_stats_t display_mirror_stats;
+
+void display_mirror_init(uint8_t tile_width, uint8_t tile_height);
+void display_mirror_capture(const uint8_t *frame);
+int display_mirror_emit(int64_t now_us);
+
+#endif
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "xtensa/hal.h"
+
+#include "main.h"
+#include "dlog.h"
+
+_Static_assert((DLOG_RING_RECORDS & (DLOG_RING_RECORDS - 1)) == 0, "DLOG_RING_RECORDS must be a power of two");
+
+// Bounded multi-producer ring after Dmitry Vyukov. A slot whose sequence
+// equals the enqueue position is free for that position; the writer that
+// wins the position sets it to position + 1 once the record is complete,
+// and the reader frees it again for position + DLOG_RING_RECORDS.
+static dlog_record_t ring[DLOG_RING_RECORDS];
+static atomic_uint enqueue_pos;
+static unsigned int dequeue_pos;
+
+dlog_stats_t dlog_stats;
+
+void dlog_init()
+{
+    for (unsigned int i = 0; i < DLOG_RING_RECORDS; i++)
+    {
+        atomic_init(&ring[i].sequence, i);
+    }
+    atomic_init(&enqueue_pos, 0);
+    dequeue_pos = 0;
+    atomic_init(&dlog_stats.records, 0);
+    atomic_init(&dlog_stats.dropped, 0);
+    atomic_init(&dlog_stats.cycles_total, 0);
+    atomic_init(&dlog_stats.cycles_max, 0);
+}
+
+// Never blocks, the record is dropped when the ring is full
+void dlog_write(esp_log_level_t level, const char *tag, const char *format, int argc, const dlog_arg_t *args)
+{
+    uint32_t start = xthal_get_ccount();
+    unsigned int pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    dlog_record_t *record;
+
+    for (;;)
+    {
+        record = &ring[pos & (DLOG_RING_RECORDS - 1)];
+        int diff = (int)(atomic_load_explicit(&record->sequence, memory_order_acquire) - pos);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            atomic_fetch_add_explicit(&dlog_stats.dropped, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    record->timestamp = esp_log_timestamp();
+    record->format = format;
+    record->tag = tag;
+    record->level = level;
+    record->argc = MIN(argc, DLOG_MAX_ARGS);
+
+    size_t text_used = 0;
+    for (int i = 0; i < record->argc; i++)
+    {
+        record->types[i] = args[i].type;
+        switch (args[i].type)
+        {
+        case DLOG_INT32:
+            record->values[i] = args[i].value.i32;
+            break;
+        case DLOG_INT64:
+            record->values[i] = args[i].value.i64;
+            break;
+        case DLOG_DOUBLE:
+            memcpy(&record->values[i], &args[i].value.d, sizeof(double));
+            break;
+        case DLOG_STRING:
+        {
+            const char *s = (args[i].value.s != NULL) ? args[i].value.s : "(null)";
+            size_t length = strnlen(s, DLOG_STRING_SIZE);
+            length = MIN(length, DLOG_STRING_SIZE - 1 - MIN(text_used, DLOG_STRING_SIZE - 1));
+            memcpy(&record->text[text_used], s, length);
+            record->text[text_used + length] = '\0';
+            record->values[i] = text_used;
+            text_used = MIN(text_used + length + 1, DLOG_STRING_SIZE - 1);
+            break;
+        }
+        case DLOG_POINTER:
+            record->values[i] = (uintptr_t)args[i].value.p;
+            break;
+        }
+    }
+    atomic_store_explicit(&record->sequence, pos + 1, memory_order_release);
+
+    uint32_t cycles = xthal_get_ccount() - start;
+    atomic_fetch_add_explicit(&dlog_stats.records, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&dlog_stats.cycles_total, cycles, memory_order_relaxed);
+    unsigned int max = atomic_load_explicit(&dlog_stats.cycles_max, memory_order_relaxed);
+    while ((cycles > max) &&
+           !atomic_compare_exchange_weak_explicit(&dlog_stats.cycles_max, &max, cycles, memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+}
+
+// Expands the format one conversion at a time, handing snprintf each stored
+// argument with the type it was captured as
+static void format_record(const dlog_record_t *record, char *line, size_t size)
+{
+    const char *f = record->format;
+    size_t used = 0;
+    int arg = 0;
+    char spec[16];
+
+    while ((*f != '\0') && (used < size - 1))
+    {
+        if (*f != '%')
+        {
+            line[used++] = *f++;
+            continue;
+        }
+        if (f[1] == '%')
+        {
+            line[used++] = '%';
+            f += 2;
+            continue;
+        }
+
+        size_t n = 0;
+        spec[n++] = *f++;
+        while ((*f != '\0') && (strchr("diouxXeEfFgGaAcsp", *f) == NULL) && (n < sizeof(spec) - 2))
+        {
+            spec[n++] = *f++;
+        }
+        if (*f != '\0')
+        {
+            spec[n++] = *f++;
+        }
+        spec[n] = '\0';
+        if (arg >= record->argc)
+        {
+            break;
+        }
+
+        int written = 0;
+        uint64_t value = record->values[arg];
+        switch (record->types[arg])
+        {
+        case DLOG_INT32:
+            written = snprintf(&line[used], size - used, spec, (uint32_t)value);
+            break;
+        case DLOG_INT64:
+            written = snprintf(&line[used], size - used, spec, (long long)value);
+            break;
+        case DLOG_DOUBLE:
+        {
+            double d;
+            memcpy(&d, &value, sizeof(double));
+            written = snprintf(&line[used], size - used, spec, d);
+            break;
+        }
+        case DLOG_STRING:
+            written = snprintf(&line[used], size - used, spec, &record->text[value]);
+            break;
+        case DLOG_POINTER:
+            written = snprintf(&line[used], size - used, spec, (void *)(uintptr_t)value);
+            break;
+        }
+        arg++;
+        if (written > 0)
+        {
+            used += MIN((size_t)written, size - 1 - used);
+        }
+    }
+    line[used] = '\0';
+}
+
+// Formats and prints every pending record, returns how many there were
+int dlog_flush()
+{
+    static const char letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+    static char line[160];
+    int count = 0;
+
+    for (;;)
+    {
+        dlog_record_t *record = &ring[dequeue_pos & (DLOG_RING_RECORDS - 1)];
+        if (atomic_load_explicit(&record->sequence, memory_order_acquire) != dequeue_pos + 1)
+        {
+            return count;
+        }
+        format_record(record, line, sizeof(line));
+        esp_log_write(record->level, record->tag, "%c (%u) %s: %s\n",
+                      letters[MIN(record->level, sizeof(letters) - 1)], record->timestamp, record->tag, line);
+        atomic_store_explicit(&record->sequence, dequeue_pos + DLOG_RING_RECORDS, memory_order_release);
+        dequeue_pos++;
+        count++;
+    }
+}
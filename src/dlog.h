@@ -0,0 +1,134 @@
+#ifndef DLOG_H_
+#define DLOG_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "esp_log.h"
+
+// Deferred logging. A call only captures the format string pointer (which
+// doubles as the message id), a timestamp and the raw arguments into a
+// lock-free ring, dlog_flush() formats and prints them later from a low
+// priority task.
+// Takes at most DLOG_MAX_ARGS arguments. String arguments are copied, up to
+// DLOG_STRING_SIZE bytes per record.
+//
+//     DLOGD(TAG, "Response [%d]: %s", length, frame);
+
+// Records held until dlog_flush(), a power of two
+#define DLOG_RING_RECORDS (64)
+#define DLOG_MAX_ARGS (6)
+#define DLOG_STRING_SIZE (32)
+
+typedef enum
+{
+    DLOG_INT32,
+    DLOG_INT64,
+    DLOG_DOUBLE,
+    DLOG_STRING,
+    DLOG_POINTER,
+} dlog_type_t;
+
+typedef struct
+{
+    dlog_type_t type;
+    union
+    {
+        uint32_t i32;
+        uint64_t i64;
+        double d;
+        const char *s;
+        const void *p;
+    } value;
+} dlog_arg_t;
+
+typedef struct
+{
+    // Ring position this slot is ready for, see dlog.c
+    atomic_uint sequence;
+    uint32_t timestamp;
+    const char *format;
+    const char *tag;
+    uint8_t level;
+    uint8_t argc;
+    uint8_t types[DLOG_MAX_ARGS];
+    // Raw argument bits, strings hold their offset into text
+    uint64_t values[DLOG_MAX_ARGS];
+    char text[DLOG_STRING_SIZE];
+} dlog_record_t;
+
+typedef struct
+{
+    atomic_uint records;
+    atomic_uint dropped;
+    atomic_uint cycles_total;
+    atomic_uint cycles_max;
+} dlog_stats_t;
+
+extern dlog_stats_t dlog_stats;
+
+static inline dlog_arg_t dlog_int32(uint32_t value) { return (dlog_arg_t){.type = DLOG_INT32, .value.i32 = value}; }
+static inline dlog_arg_t dlog_int64(uint64_t value) { return (dlog_arg_t){.type = DLOG_INT64, .value.i64 = value}; }
+static inline dlog_arg_t dlog_double(double value) { return (dlog_arg_t){.type = DLOG_DOUBLE, .value.d = value}; }
+static inline dlog_arg_t dlog_string(const char *value) { return (dlog_arg_t){.type = DLOG_STRING, .value.s = value}; }
+static inline dlog_arg_t dlog_pointer(const void *value) { return (dlog_arg_t){.type = DLOG_POINTER, .value.p = value}; }
+
+// Picks the capture for an argument from its type, as printf would see it
+// after the default argument promotions
+#define DLOG_ARG(x) _Generic((x),         \
+    float: dlog_double,                   \
+    double: dlog_double,                  \
+    long long: dlog_int64,                \
+    unsigned long long: dlog_int64,       \
+    char *: dlog_string,                  \
+    const char *: dlog_string,            \
+    void *: dlog_pointer,                 \
+    const void *: dlog_pointer,           \
+    default: dlog_int32)(x)
+
+#define DLOG_CAT_(a, b) a##b
+#define DLOG_CAT(a, b) DLOG_CAT_(a, b)
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_ARGS_0()
+#define DLOG_ARGS_1(a) DLOG_ARG(a),
+#define DLOG_ARGS_2(a, ...) DLOG_ARG(a), DLOG_ARGS_1(__VA_ARGS__)
+#define DLOG_ARGS_3(a, ...) DLOG_ARG(a), DLOG_ARGS_2(__VA_ARGS__)
+#define DLOG_ARGS_4(a, ...) DLOG_ARG(a), DLOG_ARGS_3(__VA_ARGS__)
+#define DLOG_ARGS_5(a, ...) DLOG_ARG(a), DLOG_ARGS_4(__VA_ARGS__)
+#define DLOG_ARGS_6(a, ...) DLOG_ARG(a), DLOG_ARGS_5(__VA_ARGS__)
+
+#define DLOG_WRITE(level, tag, format, ...)                                 \
+    dlog_write((level), (tag), (format), DLOG_NARGS(__VA_ARGS__),           \
+               (const dlog_arg_t[]){DLOG_CAT(DLOG_ARGS_, DLOG_NARGS(__VA_ARGS__))(__VA_ARGS__){0}})
+
+#define DLOGE(tag, format, ...) DLOG_WRITE(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define DLOGW(tag, format, ...) DLOG_WRITE(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define DLOGI(tag, format, ...) DLOG_WRITE(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+
+// Build option: keep the debug logs on the hot paths (UART receive loops,
+// response parsing and the display callbacks). They vanish from the build
+// unless this is set.
+#ifndef GPSDO_HOT_PATH_DEBUG
+#define GPSDO_HOT_PATH_DEBUG 0
+#endif
+
+#if GPSDO_HOT_PATH_DEBUG
+#define DLOGD(tag, format, ...) DLOG_WRITE(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#else
+// Still type checked, but never executed and dropped by the compiler
+#define DLOGD(tag, format, ...)                                              \
+    do                                                                       \
+    {                                                                        \
+        if (0)                                                               \
+        {                                                                    \
+            DLOG_WRITE(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__);           \
+        }                                                                    \
+    } while (0)
+#endif
+
+void dlog_init();
+void dlog_write(esp_log_level_t level, const char *tag, const char *format, int argc, const dlog_arg_t *args);
+int dlog_flush();
+
+#endif
@@ -0,0 +1,572 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fmt.h"
+
+#define FMT_LIMBS (FMT_BITS / 32)
+// Decimal digits of the largest integer part, FMT_BITS * log10(2)
+#define FMT_INTEGER_DIGITS (FMT_BITS * 30103 / 100000 + 1)
+// Sign, integer digits, point, fraction digits and an exponent
+#define FMT_BODY_SIZE (FMT_INTEGER_DIGITS + FMT_MAX_PRECISION + 8)
+
+#define FMT_LEFT (0x01)
+#define FMT_PLUS (0x02)
+#define FMT_SPACE (0x04)
+#define FMT_ZERO (0x08)
+
+typedef struct
+{
+    char *dst;
+    size_t size;
+    size_t length;
+} fmt_out_t;
+
+// Little endian limbs, the first used ones are live
+typedef struct
+{
+    uint32_t limb[FMT_LIMBS];
+    int used;
+} fmt_big_t;
+
+// Exact decimal digits of m * 2^e, the integer part first and then the
+// fraction, one digit at a time
+typedef struct
+{
+    char integer[FMT_INTEGER_DIGITS];
+    int integer_length;
+    int integer_next;
+    fmt_big_t fraction;
+    int fraction_bits;
+} fmt_digits_t;
+
+static void out_char(fmt_out_t *out, char c)
+{
+    if (out->length + 1 < out->size)
+    {
+        out->dst[out->length] = c;
+    }
+    out->length++;
+}
+
+static void out_repeat(fmt_out_t *out, char c, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        out_char(out, c);
+    }
+}
+
+static void out_text(fmt_out_t *out, const char *text, int length)
+{
+    for (int i = 0; i < length; i++)
+    {
+        out_char(out, text[i]);
+    }
+}
+
+// A converted field, padded to width. Zero padding goes between the sign
+// or prefix and the digits.
+static void out_field(fmt_out_t *out, const char *prefix, const char *body, int length, int width, int flags)
+{
+    int prefix_length = strlen(prefix);
+    int padding = width - prefix_length - length;
+
+    if (!(flags & (FMT_LEFT | FMT_ZERO)))
+    {
+        out_repeat(out, ' ', padding);
+    }
+    out_text(out, prefix, prefix_length);
+    if ((flags & (FMT_LEFT | FMT_ZERO)) == FMT_ZERO)
+    {
+        out_repeat(out, '0', padding);
+    }
+    out_text(out, body, length);
+    if (flags & FMT_LEFT)
+    {
+        out_repeat(out, ' ', padding);
+    }
+}
+
+static const char *sign_prefix(bool negative, int flags)
+{
+    return negative ? "-" : (flags & FMT_PLUS) ? "+" : (flags & FMT_SPACE) ? " " : "";
+}
+
+// Digits of value in base, most significant first, returns their count
+static int unsigned_digits(char *body, unsigned long value, unsigned int base, bool upper)
+{
+    const char *symbols = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char reversed[sizeof(unsigned long) * 8];
+    int length = 0;
+
+    do
+    {
+        reversed[length++] = symbols[value % base];
+        value /= base;
+    } while (value != 0);
+    for (int i = 0; i < length; i++)
+    {
+        body[i] = reversed[length - 1 - i];
+    }
+    return length;
+}
+
+// Sets big to value << shift, false when it does not fit
+static bool big_set(fmt_big_t *big, uint64_t value, int shift)
+{
+    memset(big, 0, sizeof(*big));
+    for (int position = shift; value != 0; position += 32, value >>= 32)
+    {
+        uint64_t part = (value & 0xffffffffu) << (position % 32);
+        for (int limb = position / 32; part != 0; limb++, part >>= 32)
+        {
+            if (limb >= FMT_LIMBS)
+            {
+                return false;
+            }
+            big->limb[limb] |= (uint32_t)part;
+            big->used = limb + 1;
+        }
+    }
+    return true;
+}
+
+static bool big_is_zero(const fmt_big_t *big)
+{
+    for (int i = 0; i < big->used; i++)
+    {
+        if (big->limb[i] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// big /= 10, returns the remainder
+static int big_divide_10(fmt_big_t *big)
+{
+    uint64_t remainder = 0;
+
+    for (int i = big->used - 1; i >= 0; i--)
+    {
+        uint64_t current = (remainder << 32) | big->limb[i];
+        big->limb[i] = current / 10;
+        remainder = current % 10;
+    }
+    while ((big->used > 0) && (big->limb[big->used - 1] == 0))
+    {
+        big->used--;
+    }
+    return remainder;
+}
+
+// Splits m * 2^e into integer digits and a binary fraction of -e bits.
+// False when either does not fit FMT_BITS.
+static bool digits_init(fmt_digits_t *digits, uint64_t m, int e)
+{
+    char reversed[FMT_INTEGER_DIGITS];
+    fmt_big_t integer;
+
+    digits->integer_length = 0;
+    digits->integer_next = 0;
+    digits->fraction_bits = (e < 0) ? -e : 0;
+    if (e >= 0)
+    {
+        if (!big_set(&integer, m, e))
+        {
+            return false;
+        }
+        big_set(&digits->fraction, 0, 0);
+    }
+    else
+    {
+        // Room for the next digit above the fraction bits
+        if (digits->fraction_bits + 4 > FMT_BITS)
+        {
+            return false;
+        }
+        uint64_t whole = (digits->fraction_bits < 64) ? m >> digits->fraction_bits : 0;
+        uint64_t part = (digits->fraction_bits < 64) ? m & ((1ull << digits->fraction_bits) - 1) : m;
+        big_set(&integer, whole, 0);
+        big_set(&digits->fraction, part, 0);
+        digits->fraction.used = (digits->fraction_bits + 4 + 31) / 32;
+    }
+    while (!big_is_zero(&integer))
+    {
+        reversed[digits->integer_length++] = '0' + big_divide_10(&integer);
+    }
+    for (int i = 0; i < digits->integer_length; i++)
+    {
+        digits->integer[i] = reversed[digits->integer_length - 1 - i];
+    }
+    return true;
+}
+
+static int digits_next(fmt_digits_t *digits)
+{
+    if (digits->integer_next < digits->integer_length)
+    {
+        return digits->integer[digits->integer_next++] - '0';
+    }
+    if (digits->fraction_bits == 0)
+    {
+        return 0;
+    }
+    // fraction * 10, the digit is what moves past the fraction bits
+    fmt_big_t *fraction = &digits->fraction;
+    uint64_t carry = 0;
+    for (int i = 0; i < fraction->used; i++)
+    {
+        uint64_t product = (uint64_t)fraction->limb[i] * 10 + carry;
+        fraction->limb[i] = (uint32_t)product;
+        carry = product >> 32;
+    }
+    int limb = digits->fraction_bits / 32;
+    int shift = digits->fraction_bits % 32;
+    uint64_t window = fraction->limb[limb] | ((limb + 1 < fraction->used) ? (uint64_t)fraction->limb[limb + 1] << 32 : 0);
+    int digit = (window >> shift) & 0x0f;
+    fraction->limb[limb] &= (shift > 0) ? ((1u << shift) - 1) : 0;
+    if (limb + 1 < fraction->used)
+    {
+        fraction->limb[limb + 1] = 0;
+    }
+    return digit;
+}
+
+// True when a digit other than 0 is still to come
+static bool digits_remain(const fmt_digits_t *digits)
+{
+    for (int i = digits->integer_next; i < digits->integer_length; i++)
+    {
+        if (digits->integer[i] != '0')
+        {
+            return true;
+        }
+    }
+    return !big_is_zero(&digits->fraction);
+}
+
+// Rounds the count digits in body half to even, on the digit that followed
+// them and on whether anything other than zeros came after that. Returns
+// true when the carry ran out of the top, body then holds 1 and zeros.
+static bool round_digits(char *body, int count, int next, bool sticky)
+{
+    bool odd = (count > 0) && ((body[count - 1] - '0') & 1);
+    if ((next < 5) || ((next == 5) && !sticky && !odd))
+    {
+        return false;
+    }
+    for (int i = count - 1; i >= 0; i--)
+    {
+        if (body[i] != '9')
+        {
+            body[i]++;
+            return false;
+        }
+        body[i] = '0';
+    }
+    if (count > 0)
+    {
+        body[0] = '1';
+    }
+    return true;
+}
+
+// Mantissa and binary exponent of a finite value, trailing zero bits dropped
+static void decompose(double value, uint64_t *m, int *e)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    int exponent = (bits >> 52) & 0x7ff;
+    *m = bits & ((1ull << 52) - 1);
+    if (exponent == 0)
+    {
+        *e = -1074;
+    }
+    else
+    {
+        *m |= 1ull << 52;
+        *e = exponent - 1075;
+    }
+    if (*m == 0)
+    {
+        *e = 0;
+    }
+    while ((*m != 0) && !(*m & 1))
+    {
+        *m >>= 1;
+        (*e)++;
+    }
+}
+
+// Digits of a fixed point conversion, returns their count
+static int fixed_body(char *body, uint64_t m, int e, int precision, bool *fits)
+{
+    fmt_digits_t digits;
+    char number[FMT_INTEGER_DIGITS + FMT_MAX_PRECISION + 1];
+    int count = 0;
+
+    // Too small to show in any precision, all zeros
+    if ((e < 0) && (-e + 4 > FMT_BITS))
+    {
+        m = 0;
+        e = 0;
+    }
+    *fits = digits_init(&digits, m, e);
+    if (!*fits)
+    {
+        return 0;
+    }
+    // At least one integer digit
+    if (digits.integer_length == 0)
+    {
+        number[count++] = '0';
+    }
+    int integer_count = count + digits.integer_length;
+    while (count < integer_count + precision)
+    {
+        number[count++] = '0' + digits_next(&digits);
+    }
+    int next = digits_next(&digits);
+    if (round_digits(number, count, next, digits_remain(&digits)))
+    {
+        // 9.99 became 10.00, one more integer digit
+        number[count++] = '0';
+        integer_count++;
+    }
+
+    int length = 0;
+    memcpy(body, number, integer_count);
+    length += integer_count;
+    if (precision > 0)
+    {
+        body[length++] = '.';
+    }
+    memcpy(&body[length], &number[integer_count], precision);
+    return length + precision;
+}
+
+// Digits and exponent of a scientific conversion, returns their count
+static int scientific_body(char *body, uint64_t m, int e, int precision, bool upper, bool *fits)
+{
+    fmt_digits_t digits;
+    char number[FMT_MAX_PRECISION + 1];
+    int exponent = 0;
+    int count = 0;
+
+    *fits = digits_init(&digits, m, e);
+    if (!*fits)
+    {
+        return 0;
+    }
+    if (m != 0)
+    {
+        if (digits.integer_length > 0)
+        {
+            exponent = digits.integer_length - 1;
+        }
+        else
+        {
+            // Leading zeros of the fraction
+            int digit;
+            exponent = -1;
+            while ((digit = digits_next(&digits)) == 0)
+            {
+                exponent--;
+            }
+            number[count++] = '0' + digit;
+        }
+    }
+    while (count < precision + 1)
+    {
+        number[count++] = '0' + digits_next(&digits);
+    }
+    int next = digits_next(&digits);
+    if (round_digits(number, count, next, digits_remain(&digits)))
+    {
+        exponent++;
+    }
+
+    int length = 0;
+    body[length++] = number[0];
+    if (precision > 0)
+    {
+        body[length++] = '.';
+        memcpy(&body[length], &number[1], precision);
+        length += precision;
+    }
+    body[length++] = upper ? 'E' : 'e';
+    body[length++] = (exponent < 0) ? '-' : '+';
+    unsigned int magnitude = (exponent < 0) ? -exponent : exponent;
+    if (magnitude < 10)
+    {
+        body[length++] = '0';
+    }
+    length += unsigned_digits(&body[length], magnitude, 10, false);
+    return length;
+}
+
+static void out_float(fmt_out_t *out, double value, char conversion, int width, int precision, int flags)
+{
+    char body[FMT_BODY_SIZE];
+    bool upper = (conversion == 'E');
+    bool negative = signbit(value);
+    int length;
+
+    if (isnan(value) || isinf(value))
+    {
+        const char *text = isnan(value) ? (upper ? "NAN" : "nan") : (upper ? "INF" : "inf");
+        out_field(out, sign_prefix(negative, flags), text, 3, width, flags & ~FMT_ZERO);
+        return;
+    }
+
+    uint64_t m;
+    int e;
+    bool fits;
+    decompose(value, &m, &e);
+    precision = (precision < 0) ? 6 : (precision > FMT_MAX_PRECISION) ? FMT_MAX_PRECISION : precision;
+    if (conversion == 'f')
+    {
+        length = fixed_body(body, m, e, precision, &fits);
+    }
+    else
+    {
+        length = scientific_body(body, m, e, precision, upper, &fits);
+    }
+    if (!fits)
+    {
+        out_repeat(out, '#', (width > 0) ? width : 1);
+        return;
+    }
+    out_field(out, sign_prefix(negative, flags), body, length, width, flags);
+}
+
+static int fmt_v(char *dst, size_t size, const char *format, va_list args)
+{
+    fmt_out_t out = {dst, size, 0};
+    char body[sizeof(unsigned long) * 8];
+
+    for (const char *p = format; *p != '\0'; p++)
+    {
+        if (*p != '%')
+        {
+            out_char(&out, *p);
+            continue;
+        }
+        p++;
+
+        int flags = 0;
+        for (;; p++)
+        {
+            if (*p == '-')
+                flags |= FMT_LEFT;
+            else if (*p == '+')
+                flags |= FMT_PLUS;
+            else if (*p == ' ')
+                flags |= FMT_SPACE;
+            else if (*p == '0')
+                flags |= FMT_ZERO;
+            else
+                break;
+        }
+        int width = 0;
+        while ((*p >= '0') && (*p <= '9'))
+        {
+            width = (width * 10) + (*p++ - '0');
+        }
+        int precision = -1;
+        if (*p == '.')
+        {
+            precision = 0;
+            p++;
+            while ((*p >= '0') && (*p <= '9'))
+            {
+                precision = (precision * 10) + (*p++ - '0');
+            }
+        }
+        bool is_long = false;
+        if (*p == 'l')
+        {
+            is_long = true;
+            p++;
+        }
+
+        switch (*p)
+        {
+        case 'd':
+        case 'i':
+        {
+            long value = is_long ? va_arg(args, long) : va_arg(args, int);
+            unsigned long magnitude = (value < 0) ? -(unsigned long)value : (unsigned long)value;
+            int length = unsigned_digits(body, magnitude, 10, false);
+            out_field(&out, sign_prefix(value < 0, flags), body, length, width, flags);
+            break;
+        }
+        case 'u':
+        case 'x':
+        case 'X':
+        {
+            unsigned long value = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+            int length = unsigned_digits(body, value, (*p == 'u') ? 10 : 16, *p == 'X');
+            out_field(&out, "", body, length, width, flags);
+            break;
+        }
+        case 'p':
+        {
+            int length = unsigned_digits(body, (uintptr_t)va_arg(args, void *), 16, false);
+            out_field(&out, "0x", body, length, width, flags & ~FMT_ZERO);
+            break;
+        }
+        case 'c':
+            body[0] = (char)va_arg(args, int);
+            out_field(&out, "", body, 1, width, flags & ~FMT_ZERO);
+            break;
+        case 's':
+        {
+            const char *text = va_arg(args, const char *);
+            int length = 0;
+            while (((precision < 0) || (length < precision)) && (text[length] != '\0'))
+            {
+                length++;
+            }
+            out_field(&out, "", text, length, width, flags & ~FMT_ZERO);
+            break;
+        }
+        case 'f':
+        case 'e':
+        case 'E':
+            out_float(&out, va_arg(args, double), *p, width, precision, flags);
+            break;
+        case '%':
+            out_char(&out, '%');
+            break;
+        default:
+            // Unknown conversion, or the format ended in the middle of one
+            if (*p == '\0')
+            {
+                p--;
+            }
+            break;
+        }
+    }
+    if (size > 0)
+    {
+        dst[(out.length < size) ? out.length : size - 1] = '\0';
+    }
+    return out.length;
+}
+
+int fmt(char *dst, size_t size, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    int length = fmt_v(dst, size, format, args);
+    va_end(args);
+    return length;
+}
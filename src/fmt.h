@@ -0,0 +1,25 @@
+#ifndef FMT_H_
+#define FMT_H_
+
+#include <stddef.h>
+
+// snprintf for the screens, without the floating point printf of newlib
+// (its dtoa allocates and runs in double precision software). Floating
+// point values are expanded exactly from their binary mantissa and
+// exponent with integer arithmetic and rounded half to even, so the output
+// is byte for byte what snprintf writes. tools/fmt_bench.c checks that.
+//
+// Conversions: d i u x X c s p f E e %, flags - + space 0, width as a
+// number, the l length modifier and a precision for s, f, e and E, capped at
+// FMT_MAX_PRECISION. All three are exact for |value| < 2^FMT_BITS, e and E
+// down to |value| of 2^(56 - FMT_BITS), which spans every float. Values
+// outside print as # characters. Always terminates dst, returns the
+// length the output would have had like snprintf.
+
+#define FMT_MAX_PRECISION (20)
+// Width of the integer arithmetic behind f, e and E
+#define FMT_BITS (320)
+
+int fmt(char *dst, size_t size, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#endif
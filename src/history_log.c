@@ -0,0 +1,458 @@
+#include <string.h>
+
+#include "history_log.h"
+
+#define HISTORY_MAGIC (0x474c4748) /* "HGLG" */
+#define HISTORY_VERSION (1)
+#define HISTORY_NO_TIME (0xffffffff)
+
+// Occupies the first record slot of every sector
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t first_time;
+    uint16_t version;
+    uint16_t record_size;
+    uint8_t reserved[14];
+    uint16_t crc;
+} history_sector_header_t;
+
+_Static_assert(sizeof(history_record_t) == HISTORY_RECORD_SIZE, "history_record_t must fill one record slot");
+_Static_assert(sizeof(history_sector_header_t) == HISTORY_RECORD_SIZE, "history_sector_header_t must fill one record slot");
+
+// CRC-16/CCITT-FALSE
+static uint16_t crc16(uint16_t crc, const uint8_t *data, size_t len)
+{
+    while (len--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (int i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t record_crc(const history_record_t *record)
+{
+    const uint8_t *bytes = (const uint8_t *)record;
+    uint16_t crc = crc16(0xffff, bytes, offsetof(history_record_t, crc));
+    return crc16(crc, bytes + offsetof(history_record_t, crc) + sizeof(record->crc),
+                 sizeof(history_record_t) - offsetof(history_record_t, crc) - sizeof(record->crc));
+}
+
+static uint16_t header_crc(const history_sector_header_t *header)
+{
+    return crc16(0xffff, (const uint8_t *)header, offsetof(history_sector_header_t, crc));
+}
+
+static bool slot_is_empty(const void *slot)
+{
+    const uint8_t *bytes = slot;
+    for (int i = 0; i < HISTORY_RECORD_SIZE; i++)
+    {
+        if (bytes[i] != 0xff)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t page_offset(const history_log_t *log, uint32_t sector, uint32_t page)
+{
+    return (sector * log->storage->sector_size) + (page * HISTORY_PAGE_SIZE);
+}
+
+static void reset_page(history_log_t *log)
+{
+    memset(log->page, 0xff, sizeof(log->page));
+    // The first page of a sector reserves its first slot for the header
+    log->page_fill = (log->head_page == 0) ? 1 : 0;
+    log->page_flushed = log->page_fill;
+}
+
+// Erases the sector after the head, dropping the oldest records once the log wraps
+static int open_next_sector(history_log_t *log)
+{
+    const history_storage_t *storage = log->storage;
+    uint32_t sector = (log->head_sector + 1) % log->sector_count;
+
+    if (storage->erase(storage->ctx, sector * storage->sector_size, storage->sector_size) != 0)
+    {
+        return -1;
+    }
+    log->stats.sectors_erased++;
+    log->head_sector = sector;
+    log->head_page = 0;
+    log->seq[sector] = log->next_seq++;
+    log->first_time[sector] = HISTORY_NO_TIME;
+    reset_page(log);
+    return 0;
+}
+
+// Reloads the last page of the head sector so appends continue where they
+// stopped. Only the head sector is scanned; a torn page is skipped over.
+static int recover_tail(history_log_t *log)
+{
+    const history_storage_t *storage = log->storage;
+    history_record_t page[HISTORY_RECORDS_PER_PAGE];
+    uint32_t last_page = 0;
+
+    for (uint32_t p = 1; p < log->pages_per_sector; p++)
+    {
+        history_record_t first;
+        if (storage->read(storage->ctx, page_offset(log, log->head_sector, p), &first, sizeof(first)) != 0)
+        {
+            return -1;
+        }
+        if (slot_is_empty(&first))
+        {
+            break;
+        }
+        last_page = p;
+    }
+
+    if (storage->read(storage->ctx, page_offset(log, log->head_sector, last_page), page, sizeof(page)) != 0)
+    {
+        return -1;
+    }
+    log->head_page = last_page;
+    uint32_t fill = (last_page == 0) ? 1 : 0;
+    while ((fill < HISTORY_RECORDS_PER_PAGE) && !slot_is_empty(&page[fill]))
+    {
+        if (record_crc(&page[fill]) != page[fill].crc)
+        {
+            // Torn write, the rest of this page cannot be programmed again
+            fill = HISTORY_RECORDS_PER_PAGE;
+            break;
+        }
+        fill++;
+    }
+
+    if (fill == HISTORY_RECORDS_PER_PAGE)
+    {
+        log->head_page++;
+        if (log->head_page == log->pages_per_sector)
+        {
+            return open_next_sector(log);
+        }
+        reset_page(log);
+        return 0;
+    }
+    memcpy(log->page, page, sizeof(page));
+    log->page_fill = fill;
+    log->page_flushed = fill;
+    return 0;
+}
+
+int history_log_mount(history_log_t *log, const history_storage_t *storage)
+{
+    uint32_t max_seq = 0;
+
+    memset(log, 0, sizeof(*log));
+    log->storage = storage;
+    log->sector_count = MIN(storage->size / storage->sector_size, HISTORY_MAX_SECTORS);
+    log->pages_per_sector = storage->sector_size / HISTORY_PAGE_SIZE;
+    if ((log->sector_count < 2) || (log->pages_per_sector == 0))
+    {
+        return -1;
+    }
+
+    // Only the sector headers are read to rebuild the index
+    for (uint32_t s = 0; s < log->sector_count; s++)
+    {
+        history_sector_header_t header;
+        if (storage->read(storage->ctx, s * storage->sector_size, &header, sizeof(header)) != 0)
+        {
+            return -1;
+        }
+        if ((header.magic != HISTORY_MAGIC) || (header.version != HISTORY_VERSION) ||
+            (header.record_size != HISTORY_RECORD_SIZE) || (header.crc != header_crc(&header)))
+        {
+            continue;
+        }
+        log->seq[s] = header.seq;
+        log->first_time[s] = header.first_time;
+        if (header.seq > max_seq)
+        {
+            max_seq = header.seq;
+            log->head_sector = s;
+        }
+    }
+
+    if (max_seq == 0)
+    {
+        // Empty or foreign partition: start over from the first sector
+        log->head_sector = log->sector_count - 1;
+        log->next_seq = 1;
+        return open_next_sector(log);
+    }
+    log->next_seq = max_seq + 1;
+    return recover_tail(log);
+}
+
+// Programs the RAM page. Partially filled pages may be flushed again later,
+// programming the same bytes a second time is harmless on NOR flash.
+int history_log_flush(history_log_t *log)
+{
+    const history_storage_t *storage = log->storage;
+    // Only the records not programmed yet, with the header ahead of the first
+    // ones of a sector
+    uint32_t first = log->page_flushed;
+
+    if (log->page_fill == log->page_flushed)
+    {
+        return 0;
+    }
+    if ((log->head_page == 0) && (first == 1))
+    {
+        first = 0;
+        history_sector_header_t header;
+        memset(&header, 0, sizeof(header));
+        header.magic = HISTORY_MAGIC;
+        header.seq = log->seq[log->head_sector];
+        header.first_time = log->page[1].gps_time;
+        header.version = HISTORY_VERSION;
+        header.record_size = HISTORY_RECORD_SIZE;
+        header.crc = header_crc(&header);
+        memcpy(&log->page[0], &header, sizeof(header));
+        log->first_time[log->head_sector] = header.first_time;
+    }
+
+    size_t len = (log->page_fill - first) * HISTORY_RECORD_SIZE;
+    if (storage->write(storage->ctx, page_offset(log, log->head_sector, log->head_page) + (first * HISTORY_RECORD_SIZE),
+                       &log->page[first], len) != 0)
+    {
+        return -1;
+    }
+    log->stats.bytes_programmed += len;
+    log->page_flushed = log->page_fill;
+
+    if (log->page_fill == HISTORY_RECORDS_PER_PAGE)
+    {
+        log->head_page++;
+        if (log->head_page == log->pages_per_sector)
+        {
+            return open_next_sector(log);
+        }
+        reset_page(log);
+    }
+    return 0;
+}
+
+int history_log_append(history_log_t *log, history_record_t *record)
+{
+    record->reserved = 0;
+    record->crc = record_crc(record);
+    memcpy(&log->page[log->page_fill++], record, sizeof(*record));
+    log->stats.records_appended++;
+    log->stats.bytes_appended += sizeof(*record);
+
+    if (log->page_fill == HISTORY_RECORDS_PER_PAGE)
+    {
+        return history_log_flush(log);
+    }
+    return 0;
+}
+
+static uint32_t logical_to_sector(const history_log_t *log, uint32_t oldest, uint32_t i)
+{
+    return (oldest + i) % log->sector_count;
+}
+
+// Returns 1 once a record past the end of the range has been seen
+static int scan_sector(history_log_t *log, uint32_t sector, uint32_t from, uint32_t to, history_query_cb_t cb, void *arg)
+{
+    const history_storage_t *storage = log->storage;
+    history_record_t page[HISTORY_RECORDS_PER_PAGE];
+
+    for (uint32_t p = 0; p < log->pages_per_sector; p++)
+    {
+        if (storage->read(storage->ctx, page_offset(log, sector, p), page, sizeof(page)) != 0)
+        {
+            return -1;
+        }
+        for (uint32_t r = (p == 0) ? 1 : 0; r < HISTORY_RECORDS_PER_PAGE; r++)
+        {
+            if (slot_is_empty(&page[r]))
+            {
+                return 0;
+            }
+            if (record_crc(&page[r]) != page[r].crc)
+            {
+                continue;
+            }
+            if (page[r].gps_time > to)
+            {
+                return 1;
+            }
+            if (page[r].gps_time >= from)
+            {
+                cb(&page[r], arg);
+            }
+        }
+    }
+    return 0;
+}
+
+int history_log_query(history_log_t *log, uint32_t from, uint32_t to, history_query_cb_t cb, void *arg)
+{
+    // Written sectors form one run of the ring ending at the head
+    uint32_t oldest = log->head_sector;
+    uint32_t count = 1;
+    for (uint32_t i = 1; i < log->sector_count; i++)
+    {
+        uint32_t sector = (log->head_sector + i) % log->sector_count;
+        if (log->seq[sector] != 0)
+        {
+            oldest = sector;
+            count = log->sector_count - i + 1;
+            break;
+        }
+    }
+
+    // Binary search for the last sector starting at or before the range
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (high - low > 1)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        uint32_t first_time = log->first_time[logical_to_sector(log, oldest, mid)];
+        if ((first_time != HISTORY_NO_TIME) && (first_time <= from))
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    for (uint32_t i = low; i < count; i++)
+    {
+        int rc = scan_sector(log, logical_to_sector(log, oldest, i), from, to, cb, arg);
+        if (rc != 0)
+        {
+            return rc < 0 ? rc : 0;
+        }
+    }
+
+    // Records still batched in RAM
+    for (uint32_t r = log->page_flushed; r < log->page_fill; r++)
+    {
+        if (log->page[r].gps_time > to)
+        {
+            break;
+        }
+        if (log->page[r].gps_time >= from)
+        {
+            cb(&log->page[r], arg);
+        }
+    }
+    return 0;
+}
+
+// Appends the sample record of the window accumulated so far, stamped with
+// the start of the window
+static int append_sample(history_log_t *log, const gpsdo_state_t *state)
+{
+    history_record_t record;
+
+    memset(&record, 0, sizeof(record));
+    record.gps_time = log->sample_start;
+    record.type = HISTORY_RECORD_SAMPLE;
+    record.sample.phase = log->phase_sum / log->sample_count;
+    record.sample.phase_min = log->phase_min;
+    record.sample.phase_max = log->phase_max;
+    record.sample.dac = log->dac_sum / log->sample_count;
+    record.sample.temperature = log->temperature_sum / log->sample_count;
+    record.sample.samples = log->sample_count;
+    record.sample.tfom = state->tfom;
+    record.sample.ffom = state->ffom;
+    log->sample_count = 0;
+    return history_log_append(log, &record);
+}
+
+// Called once per second: averages the analog values into one sample record
+// per HISTORY_SAMPLE_INTERVAL and records alarm and lock state transitions.
+// Records are appended in GPS time order, which the sector index and the
+// early stop of history_log_query() rely on: a transition first closes the
+// open sample window, stamped with its earlier start, and the next window
+// starts with the second of the transition.
+int history_log_update(history_log_t *log, const gpsdo_state_t *state)
+{
+    history_record_t record;
+    uint32_t now = state->gps_time;
+    int rc = 0;
+
+    // Nothing to log until the first TOD packet, and once per GPS second only
+    if ((now == 0) || (now <= log->last_time))
+    {
+        return 0;
+    }
+    log->last_time = now;
+
+    bool alarm_changed = (strncmp(log->alarm_hw, state->alarm_hw, sizeof(log->alarm_hw)) != 0) ||
+                         (strncmp(log->alarm_op, state->alarm_op, sizeof(log->alarm_op)) != 0);
+    bool lock_changed = (strncmp(log->status_gps, state->status_gps, sizeof(log->status_gps)) != 0);
+    if ((alarm_changed || lock_changed) && (log->sample_count > 0))
+    {
+        rc |= append_sample(log, state);
+    }
+
+    if (alarm_changed)
+    {
+        memset(&record, 0, sizeof(record));
+        record.gps_time = now;
+        record.type = HISTORY_RECORD_ALARM;
+        strncpy(record.alarm.hw, state->alarm_hw, sizeof(record.alarm.hw));
+        strncpy(record.alarm.op, state->alarm_op, sizeof(record.alarm.op));
+        strncpy(log->alarm_hw, state->alarm_hw, sizeof(log->alarm_hw));
+        strncpy(log->alarm_op, state->alarm_op, sizeof(log->alarm_op));
+        rc |= history_log_append(log, &record);
+    }
+
+    if (lock_changed)
+    {
+        memset(&record, 0, sizeof(record));
+        record.gps_time = now;
+        record.type = HISTORY_RECORD_LOCK;
+        strncpy(record.lock.status_gps, state->status_gps, sizeof(record.lock.status_gps));
+        strncpy(record.lock.status_output, state->status_output, sizeof(record.lock.status_output));
+        record.lock.tfom = state->tfom;
+        record.lock.ffom = state->ffom;
+        strncpy(log->status_gps, state->status_gps, sizeof(log->status_gps));
+        rc |= history_log_append(log, &record);
+    }
+
+    if (log->sample_count == 0)
+    {
+        log->sample_start = now;
+        log->phase_sum = 0.0;
+        log->dac_sum = 0.0;
+        log->temperature_sum = 0.0;
+        log->phase_min = state->phase;
+        log->phase_max = state->phase;
+    }
+    log->sample_count++;
+    log->phase_sum += state->phase;
+    log->dac_sum += state->dac;
+    log->temperature_sum += state->temperature;
+    if (state->phase < log->phase_min)
+    {
+        log->phase_min = state->phase;
+    }
+    if (state->phase > log->phase_max)
+    {
+        log->phase_max = state->phase;
+    }
+
+    if (now - log->sample_start >= HISTORY_SAMPLE_INTERVAL - 1)
+    {
+        rc |= append_sample(log, state);
+    }
+    return rc;
+}
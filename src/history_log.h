@@ -0,0 +1,117 @@
+#ifndef HISTORY_LOG_H_
+#define HISTORY_LOG_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "main.h"
+#include "history_storage.h"
+
+// Append-only log of downsampled GPSDO history kept in a dedicated flash
+// partition. Sectors are written round robin, so every sector sees the same
+// number of erase cycles. Records are batched in RAM by the page they fill,
+// history_log_flush() programs those not written yet, so a page is written
+// in a few steps and no byte twice.
+// Each sector starts with a header carrying its sequence number and the GPS
+// time of its first record, which is all that is needed to mount the log and
+// to locate a time range without reading the records themselves.
+
+#define HISTORY_PAGE_SIZE (256)
+#define HISTORY_RECORD_SIZE (32)
+#define HISTORY_RECORDS_PER_PAGE (HISTORY_PAGE_SIZE / HISTORY_RECORD_SIZE)
+#define HISTORY_MAX_SECTORS (128)
+
+// Seconds of 1 Hz samples averaged into one HISTORY_RECORD_SAMPLE
+#define HISTORY_SAMPLE_INTERVAL (60)
+
+typedef enum
+{
+    HISTORY_RECORD_SAMPLE = 1,
+    HISTORY_RECORD_ALARM = 2,
+    HISTORY_RECORD_LOCK = 3,
+    HISTORY_RECORD_EMPTY = 0xff,
+} history_record_type_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t gps_time;
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t crc;
+    union
+    {
+        struct __attribute__((packed))
+        {
+            float phase;
+            float phase_min;
+            float phase_max;
+            float dac;
+            float temperature;
+            uint16_t samples;
+            uint8_t tfom;
+            uint8_t ffom;
+        } sample;
+        struct __attribute__((packed))
+        {
+            char hw[12];
+            char op[12];
+        } alarm;
+        struct __attribute__((packed))
+        {
+            char status_gps[11];
+            char status_output[11];
+            uint8_t tfom;
+            uint8_t ffom;
+        } lock;
+    };
+} history_record_t;
+
+typedef struct
+{
+    uint32_t records_appended;
+    uint32_t bytes_appended;
+    uint32_t bytes_programmed;
+    uint32_t sectors_erased;
+} history_log_stats_t;
+
+typedef struct
+{
+    const history_storage_t *storage;
+    uint32_t sector_count;
+    uint32_t pages_per_sector;
+    // Ring position of the sector being filled and the next page in it
+    uint32_t head_sector;
+    uint32_t head_page;
+    uint32_t next_seq;
+    // Per sector index built at mount, 0 in seq marks an erased sector
+    uint32_t seq[HISTORY_MAX_SECTORS];
+    uint32_t first_time[HISTORY_MAX_SECTORS];
+    // Page being batched in RAM
+    history_record_t page[HISTORY_RECORDS_PER_PAGE];
+    uint32_t page_fill;
+    uint32_t page_flushed;
+    history_log_stats_t stats;
+    // Downsampling and transition tracking for history_log_update()
+    uint32_t last_time;
+    uint32_t sample_start;
+    uint32_t sample_count;
+    double phase_sum;
+    float phase_min;
+    float phase_max;
+    double dac_sum;
+    double temperature_sum;
+    char alarm_hw[11];
+    char alarm_op[11];
+    char status_gps[11];
+} history_log_t;
+
+typedef void (*history_query_cb_t)(const history_record_t *record, void *arg);
+
+int history_log_mount(history_log_t *log, const history_storage_t *storage);
+int history_log_append(history_log_t *log, history_record_t *record);
+int history_log_flush(history_log_t *log);
+int history_log_query(history_log_t *log, uint32_t from, uint32_t to, history_query_cb_t cb, void *arg);
+int history_log_update(history_log_t *log, const gpsdo_state_t *state);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef HISTORY_STORAGE_H_
+#define HISTORY_STORAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Storage backend for the history log. It behaves like NOR flash: erase sets a
+// whole sector to 0xFF and writes can only clear bits. All functions return 0
+// on success and a negative value on failure.
+typedef struct
+{
+    size_t size;
+    size_t sector_size;
+    int (*read)(void *ctx, size_t offset, void *dst, size_t len);
+    int (*write)(void *ctx, size_t offset, const void *src, size_t len);
+    int (*erase)(void *ctx, size_t offset, size_t len);
+    void *ctx;
+} history_storage_t;
+
+#ifdef ESP_PLATFORM
+// Binds to the data partition with the given label (see partitions.csv)
+int history_storage_flash_init(history_storage_t *storage, const char *label);
+#else
+// Emulates a flash partition of the given size with a regular file
+int history_storage_file_init(history_storage_t *storage, const char *path, size_t size, size_t sector_size);
+void history_storage_file_close(history_storage_t *storage);
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef ESP_PLATFORM
+
+#include <stdio.h>
+#include <string.h>
+
+#include "history_storage.h"
+
+// Host backend used to exercise the history log on Linux. Writes are ANDed
+// into the existing content so the file keeps the flash programming rules.
+
+static int file_read(void *ctx, size_t offset, void *dst, size_t len)
+{
+    FILE *file = ctx;
+    if (fseek(file, offset, SEEK_SET) != 0)
+    {
+        return -1;
+    }
+    return fread(dst, 1, len, file) == len ? 0 : -1;
+}
+
+static int file_write(void *ctx, size_t offset, const void *src, size_t len)
+{
+    FILE *file = ctx;
+    const uint8_t *bytes = src;
+    uint8_t chunk[256];
+
+    while (len > 0)
+    {
+        size_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+        if (file_read(ctx, offset, chunk, n) != 0)
+        {
+            return -1;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            chunk[i] &= bytes[i];
+        }
+        if ((fseek(file, offset, SEEK_SET) != 0) || (fwrite(chunk, 1, n, file) != n))
+        {
+            return -1;
+        }
+        offset += n;
+        bytes += n;
+        len -= n;
+    }
+    return fflush(file) == 0 ? 0 : -1;
+}
+
+static int file_erase(void *ctx, size_t offset, size_t len)
+{
+    FILE *file = ctx;
+    uint8_t chunk[256];
+
+    memset(chunk, 0xff, sizeof(chunk));
+    if (fseek(file, offset, SEEK_SET) != 0)
+    {
+        return -1;
+    }
+    while (len > 0)
+    {
+        size_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+        if (fwrite(chunk, 1, n, file) != n)
+        {
+            return -1;
+        }
+        len -= n;
+    }
+    return fflush(file) == 0 ? 0 : -1;
+}
+
+int history_storage_file_init(history_storage_t *storage, const char *path, size_t size, size_t sector_size)
+{
+    FILE *file = fopen(path, "r+b");
+    if (file == NULL)
+    {
+        // A new image starts out erased
+        file = fopen(path, "w+b");
+        if ((file == NULL) || (file_erase(file, 0, size) != 0))
+        {
+            return -1;
+        }
+    }
+    storage->size = size;
+    storage->sector_size = sector_size;
+    storage->read = file_read;
+    storage->write = file_write;
+    storage->erase = file_erase;
+    storage->ctx = file;
+    return 0;
+}
+
+void history_storage_file_close(history_storage_t *storage)
+{
+    if (storage->ctx != NULL)
+    {
+        fclose(storage->ctx);
+        storage->ctx = NULL;
+    }
+}
+
+#endif
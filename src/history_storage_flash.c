@@ -0,0 +1,38 @@
+#ifdef ESP_PLATFORM
+
+#include "esp_partition.h"
+
+#include "history_storage.h"
+
+static int flash_read(void *ctx, size_t offset, void *dst, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, offset, dst, len) == ESP_OK ? 0 : -1;
+}
+
+static int flash_write(void *ctx, size_t offset, const void *src, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, offset, src, len) == ESP_OK ? 0 : -1;
+}
+
+static int flash_erase(void *ctx, size_t offset, size_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, len) == ESP_OK ? 0 : -1;
+}
+
+int history_storage_flash_init(history_storage_t *storage, const char *label)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == NULL)
+    {
+        return -1;
+    }
+    storage->size = partition->size;
+    storage->sector_size = SPI_FLASH_SEC_SIZE;
+    storage->read = flash_read;
+    storage->write = flash_write;
+    storage->erase = flash_erase;
+    storage->ctx = (void *)partition;
+    return 0;
+}
+
+#endif
@@ -5,23 +5,81 @@
 #include <stddef.h>
 #include <time.h>
 #include <esp_system.h>
+#include <esp_timer.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "driver/uart.h"
 #include "esp_log.h"
 #include "u8g2.h"
+#include "xtensa/hal.h"
 
 #include "main.h"
 #include "utils.h"
+#include "commands.h"
+#include "spsc_ring.h"
+#include "memory_budget.h"
+#include "history_log.h"
+#include "clock_sync.h"
+#include "dlog.h"
+#include "sky_plot.h"
+#include "trend.h"
+#include "alarm.h"
+#include "sample_store.h"
+#include "display.h"
+#include "display_mirror.h"
+#include "run_stats.h"
+#include "alloc_track.h"
+#include "scpi_bridge.h"
+#include "state_snapshot.h"
+#include "metrics.h"
+#include "metrics_http.h"
+#include "wifi_station.h"
+#include "ntp_server.h"
+#include "uccm_profile.h"
+#include "fmt.h"
+#include "window_stats.h"
+#include "position_survey.h"
+#include "prompt_framer.h"
 #include "u8g2_esp32_hal.h"
 
-#define CMD_BUFFER_SIZE (3072)
-#define TOD_BUFFER_SIZE (256)
-#define TOD_PACKET_SIZE (44)
 #define TOD_PORT_NUM (UART_NUM_1)
 #define CMD_PORT_NUM (UART_NUM_2)
+#define UCCM_PROMPT "UCCM> "
+#define UCCM_PROMPT_TIMEOUT_MS (500)
+// Longest write to the UCCM, a client command or a batch of polls
+#define UCCM_WRITE_SIZE (128)
+_Static_assert(SCPI_BRIDGE_LINE_SIZE + 1 <= UCCM_WRITE_SIZE, "Client commands do not fit a write");
+// Bit times of line idle after the prompt before the pattern detector fires
+#define UART_PATTERN_POST_IDLE (20)
+#define UART_PATTERN_QUEUE_SIZE (20)
+// Time on the wire of one byte (start, 8 data and stop bit), and the line idle
+// the driver waits for before it hands over received bytes (its default)
+#define UART_BYTE_US (10 * 1000000 / UART_BAUD_RATE)
+#define UART_RX_TIMEOUT_BYTES (10)
+#define SCREEN_PERIOD_MS (5000)
+// Trend screens span TREND_WIDTH columns of this many one second samples
+#define TREND_SECONDS_PER_COLUMN (30)
+#define DLOG_FLUSH_INTERVAL_MS (100)
+#define DLOG_REPORT_INTERVAL_MS (60000)
+#define SAMPLE_STORE_REPORT_INTERVAL (3600)
+#define ALLOC_DUMP_INTERVAL_MS (600000)
+// Seconds between snapshots of gpsdo_state, written only when they changed
+#define STATE_SNAPSHOT_INTERVAL (300)
+// SCPI passthrough on the console. A client command goes out in the next poll
+// slot unless it had SCPI_BRIDGE_BURST_SLOTS slots in a row already, then an
+// overdue poll goes first.
+#define SCPI_CONSOLE_PORT (UART_NUM_0)
+#define SCPI_BRIDGE_POLL_MS (20)
+#define SCPI_BRIDGE_BURST_SLOTS (3)
+
+// The UART drivers are installed from app_main on core 0, so their interrupts
+// and the receive and parse pipeline stay there. Drawing, the SPI pushes and
+// the background tasks run on core 1.
+#define PIPELINE_CORE (0)
+#define DISPLAY_CORE (1)
 
 static void uart_receive_tod_task(void *pvParameters);
 static void uart_receive_cmd_task(void *pvParameters);
@@ -29,19 +87,132 @@ static void parse_tod_task(void *pvParameters);
 static void parse_cmd_task(void *pvParameters);
 static void update_display_task(void *pvParameters);
 static void send_cmd_task(void *pvParameters);
+static void history_task(void *pvParameters);
+static void dlog_task(void *pvParameters);
+static void bridge_task(void *pvParameters);
+#if GPSDO_METRICS
+static void metrics_task(void *pvParameters);
+#endif
+#if GPSDO_NTP
+static void ntp_task(void *pvParameters);
+#endif
 static void initialize_uart();
 static void initialize_display();
-
-// The object for the GLCD display
+static bool wait_for_prompt(TickType_t timeout);
+static void check_first_data();
+static void log_first_screen(const char *source);
+static void push_tod(const uint8_t *packet, int64_t end_us);
+static void clock_flush_callback(void *arg);
+static void stage_clock(uint32_t second);
+
+// The object for the GLCD display and the second frame buffer it swaps with
 u8g2_t u8g2;
+static uint8_t display_spare_buffer[DISPLAY_BUFFER_SIZE];
 
 // Message queues
 static QueueHandle_t queue_uart_cmd;
 static QueueHandle_t queue_uart_tod;
-static QueueHandle_t queue_cmd;
-static QueueHandle_t queue_tod;
 static SemaphoreHandle_t can_send_cmd;
 
+// Framed responses and TOD packets from the receive tasks to the parsing
+// tasks. Pushing never blocks, the parsing tasks are woken by notification.
+static spsc_ring_t ring_cmd;
+static spsc_ring_t ring_tod;
+static uint8_t ring_cmd_buffer[CMD_RING_SIZE];
+static uint8_t ring_tod_buffer[TOD_RING_SIZE];
+static TaskHandle_t parse_cmd_handle;
+static TaskHandle_t parse_tod_handle;
+
+// Commands typed on the console and their responses, see scpi_bridge.h
+static scpi_bridge_t scpi_bridge;
+
+// TOD packet as it travels through ring_tod, stamped with the local time its
+// last byte came in
+typedef struct
+{
+    int64_t end_us;
+    uint8_t packet[TOD_PACKET_SIZE];
+} tod_frame_t;
+
+// Second boundaries predicted from the TOD arrivals
+static clock_sync_t clock_sync;
+
+#if GPSDO_NTP
+// Replies on the local clock disciplined by clock_sync, template updated by parse_tod_task
+static ntp_server_t ntp_server;
+#endif
+
+// Where the current screen shows the clock. The display task redraws just
+// these tile rows for the upcoming second and sends them on its boundary.
+typedef struct
+{
+    bool visible;
+    u8g2_uint_t x;
+    u8g2_uint_t y;
+    uint8_t tile_y;
+    uint8_t tile_h;
+} clock_region_t;
+static clock_region_t clock_region;
+
+// Screen on the display, the mirror bandwidth is accounted to it
+static atomic_int current_screen;
+
+// Configuration sent to the UCCM at boot. Each line is acknowledged with a
+// prompt before the next one goes out, the empty lines sync up the prompt.
+static const char *uccm_init_commands[] = {
+    "",
+    "",
+    "SYNC:REF:DISABLE LINK",
+    "SYNC:REF:DISABLE EXT",
+    "SYNC:REF:ENABLE GPS",
+    "REF:TYPE GPS",
+    "OUTP:TP:SEL PP1S",
+    // "GPS:SAT:TRAC:EMAN 20",
+};
+#define UCCM_INIT_COMMANDS (sizeof(uccm_init_commands) / sizeof(uccm_init_commands[0]))
+
+// Boot timing in microseconds since app_main started. The display keeps the
+// boot screen until both a TOD packet and a status dump have been parsed.
+static int64_t boot_start_us;
+static int64_t first_tod_us;
+static int64_t first_status_us;
+static volatile bool first_data_valid = false;
+
+// Last known state restored at boot, shown until live data replaces it
+static state_snapshot_t state_snapshot;
+static bool snapshot_restored;
+
+// Persistent history in the "history" flash partition
+static history_storage_t history_storage;
+static history_log_t history_log;
+
+// Envelopes for the trend screens, sampled by history_task
+static trend_t trend_phase;
+static trend_t trend_efc;
+static trend_t trend_temperature;
+static SemaphoreHandle_t trend_lock;
+
+// Threshold rules over gpsdo_state, run by history_task
+static alarm_engine_t alarm_engine;
+
+// Compressed 1 Hz samples and their means over the last week, appended by
+// history_task and queried by the window statistics under sample_lock
+static sample_block_t sample_blocks[SAMPLE_STORE_BLOCKS];
+static sample_store_t sample_store;
+static sample_block_t sample_week_blocks[SAMPLE_STORE_WEEK_BLOCKS];
+static sample_store_t sample_store_week;
+static SemaphoreHandle_t sample_lock;
+static window_stats_t window_stats;
+
+#if GPSDO_METRICS
+// Prometheus and JSON documents, updated by history_task and served by metrics_task
+static metrics_t metrics;
+#endif
+
+// Average of the GPS:POS? fixes, fed by parse_cmd_task
+static position_survey_t position_survey;
+static SemaphoreHandle_t survey_lock;
+
 // UART message ring buffer
 RingbufHandle_t buf_handle;
 
@@ -52,7 +223,7 @@ gpsdo_state_t gpsdo_state = {
     .temperature = 0.0,
     .dac = 0.0,
     .phase = 0.0,
-    .pps = 0.0,
+    .tint = 0.0,
     .freq_diff = 0.0,
     .tfom = 0,
     .ffom = 0,
@@ -73,102 +244,342 @@ gpsdo_state_t gpsdo_state = {
 };
 
 // Screen functions pointer array
-void (*screen_functions[4])(void) = {&monitorScreen, &uccmDataScreen, &satellitesScreen, &statScreen};
+void (*screen_functions[])(void) = {&monitorScreen, &uccmDataScreen, &satellitesScreen, &skyPlotScreen, &statScreen,
+                                    &surveyScreen, &phaseTrendScreen, &efcTrendScreen, &temperatureTrendScreen,
+                                    &windowStatsScreen, &heapScreen};
+#define SCREEN_COUNT (sizeof(screen_functions) / sizeof(screen_functions[0]))
+
+#if GPSDO_STATIC_ALLOCATION
+#define CREATE_BINARY_SEMAPHORE(handle)                       \
+    do                                                        \
+    {                                                         \
+        static StaticSemaphore_t handle##_buffer;             \
+        handle = xSemaphoreCreateBinaryStatic(&handle##_buffer); \
+    } while (0)
+
+#define CREATE_MUTEX(handle)                                  \
+    do                                                        \
+    {                                                         \
+        static StaticSemaphore_t handle##_buffer;             \
+        handle = xSemaphoreCreateMutexStatic(&handle##_buffer); \
+    } while (0)
+
+#define CREATE_TASK(function, name, stack_size, priority, handle, core)                                         \
+    do                                                                                                          \
+    {                                                                                                           \
+        static StackType_t function##_stack[(stack_size)];                                                      \
+        static StaticTask_t function##_tcb;                                                                     \
+        TaskHandle_t created = xTaskCreateStaticPinnedToCore(function, name, (stack_size), NULL, priority,      \
+                                                             function##_stack, &function##_tcb, core);          \
+        if ((handle) != NULL)                                                                                   \
+        {                                                                                                       \
+            *(TaskHandle_t *)(handle) = created;                                                                \
+        }                                                                                                       \
+    } while (0)
+#else
+#define CREATE_BINARY_SEMAPHORE(handle) handle = xSemaphoreCreateBinary()
+#define CREATE_MUTEX(handle) handle = xSemaphoreCreateMutex()
+#define CREATE_TASK(function, name, stack_size, priority, handle, core) \
+    xTaskCreatePinnedToCore(function, name, (stack_size), NULL, priority, (handle), core)
+#endif
 
 void app_main()
 {
     static const char *TAG = "main";
 
+    boot_start_us = esp_timer_get_time();
+    dlog_init();
+
+    // Restored first, the display comes up with the last known state
+    state_snapshot_init(&state_snapshot);
+    int restored = state_snapshot_load(&state_snapshot, &gpsdo_state);
+    snapshot_restored = (restored > 0);
+
     initialize_display();
+    if (snapshot_restored)
+    {
+        ESP_LOGI(TAG, "Restored %d fields from the state snapshot", restored);
+        // The identification of the last run, until *IDN? answers again
+        uccm_profile_select(&gpsdo_state);
+        monitorScreen();
+        log_first_screen("snapshot");
+    }
+    bootScreen(0, UCCM_INIT_COMMANDS, "UART");
     initialize_uart();
 
     initialize_uccm();
 
-    ESP_LOGI(TAG, "Initialization complete. Waiting before creating tasks.");
+    ESP_LOGI(TAG, "Initialization complete after %lld ms", (esp_timer_get_time() - boot_start_us) / 1000);
+    memory_budget_report();
+#if GPSDO_WINDOW_STATS_BENCH
+    window_stats_benchmark_t bench;
+    if (window_stats_benchmark(WINDOW_STATS_SECONDS, 8, &bench) == 0)
+    {
+        ESP_LOGI(TAG, "Window stats over %u samples: scalar %u ns, vector %u ns, error %u/%u ppb",
+                 bench.samples, bench.scalar_ns, bench.vector_ns, bench.scalar_error_ppb, bench.vector_error_ppb);
+    }
+#endif
 
-    vTaskDelay(5000 / portTICK_PERIOD_MS);
-    uart_flush_input(CMD_PORT_NUM);
+    spsc_ring_init(&ring_tod, ring_tod_buffer, TOD_RING_SIZE, TOD_RING_POLICY);
+    clock_sync_init(&clock_sync);
+#if GPSDO_NTP
+    ntp_server_init(&ntp_server, &clock_sync);
+#endif
+    spsc_ring_init(&ring_cmd, ring_cmd_buffer, CMD_RING_SIZE, CMD_RING_POLICY);
 
-    queue_tod = xQueueCreate(20, sizeof(char *));
-    if (queue_tod == NULL)
+    CREATE_BINARY_SEMAPHORE(can_send_cmd);
+    if (can_send_cmd == NULL)
     {
-        ESP_LOGE(TAG, "Failed to create queue_tod");
+        ESP_LOGE(TAG, "Failed to create can_send_cmd");
     }
 
-    queue_cmd = xQueueCreate(20, sizeof(char *));
-    if (queue_cmd == NULL)
+    trend_init(&trend_phase, TREND_SECONDS_PER_COLUMN);
+    trend_init(&trend_efc, TREND_SECONDS_PER_COLUMN);
+    trend_init(&trend_temperature, TREND_SECONDS_PER_COLUMN);
+    alarm_init(&alarm_engine);
+    sample_store_init(&sample_store, sample_blocks, SAMPLE_STORE_BLOCKS, 1);
+    sample_store_init(&sample_store_week, sample_week_blocks, SAMPLE_STORE_WEEK_BLOCKS, SAMPLE_STORE_WEEK_DECIMATION);
+    CREATE_MUTEX(sample_lock);
+    CREATE_MUTEX(trend_lock);
+    position_survey_init(&position_survey);
+    CREATE_MUTEX(survey_lock);
+#if GPSDO_METRICS
+    if (metrics_init(&metrics) != 0)
     {
-        ESP_LOGE(TAG, "Failed to create queue_cmd");
+        ESP_LOGE(TAG, "Metrics do not fit their documents");
     }
+#endif
 
-    can_send_cmd = xSemaphoreCreateBinary();
-    if (can_send_cmd == NULL)
+    scpi_client_t console;
+    scpi_bridge_init(&scpi_bridge, UCCM_PROMPT);
+    if ((scpi_client_uart_init(&console, SCPI_CONSOLE_PORT) != 0) || (scpi_bridge_add_client(&scpi_bridge, &console) < 0))
     {
-        ESP_LOGE(TAG, "Failed to create can_send_cmd");
+        ESP_LOGW(TAG, "No SCPI bridge on the console");
     }
 
-    xTaskCreate(parse_tod_task, "parse_tod_task", 2048, NULL, 6, NULL);
-    xTaskCreate(parse_cmd_task, "parse_cmd_task", 2048, NULL, 3, NULL);
+    // The parsing tasks go first, the receive tasks notify them by handle
+    CREATE_TASK(parse_tod_task, "parse_tod_task", STACK_PARSE_TOD, 6, &parse_tod_handle, PIPELINE_CORE);
+    CREATE_TASK(parse_cmd_task, "parse_cmd_task", STACK_PARSE_CMD, 3, &parse_cmd_handle, PIPELINE_CORE);
 
-    xTaskCreate(update_display_task, "updateDisplayTask", 2048, NULL, 1, NULL);
+    // The flush task outranks the drawing so a presented frame goes out at once
+    CREATE_TASK(display_flush_task, "display_flush", STACK_DISPLAY_FLUSH, 3, NULL, DISPLAY_CORE);
+    CREATE_TASK(update_display_task, "updateDisplayTask", STACK_UPDATE_DISPLAY, 2, NULL, DISPLAY_CORE);
 
-    xTaskCreate(uart_receive_tod_task, "uart_receive_tod_task", 2048, NULL, 12, NULL);
-    xTaskCreate(uart_receive_cmd_task, "uart_receive_cmd_task", 2048, NULL, 11, NULL);
+    CREATE_TASK(uart_receive_tod_task, "uart_receive_tod_task", STACK_UART_RECEIVE_TOD, 12, NULL, PIPELINE_CORE);
+    CREATE_TASK(uart_receive_cmd_task, "uart_receive_cmd_task", STACK_UART_RECEIVE_CMD, 11, NULL, PIPELINE_CORE);
 
-    xTaskCreate(send_cmd_task, "send_cmd_task", 2048, NULL, 2, NULL);
+    CREATE_TASK(send_cmd_task, "send_cmd_task", STACK_SEND_CMD, 2, NULL, PIPELINE_CORE);
+
+    CREATE_TASK(history_task, "history_task", STACK_HISTORY, 1, NULL, DISPLAY_CORE);
+
+    CREATE_TASK(dlog_task, "dlog_task", STACK_DLOG, 1, NULL, DISPLAY_CORE);
+
+    CREATE_TASK(bridge_task, "scpi_bridge", STACK_SCPI_BRIDGE, 2, NULL, DISPLAY_CORE);
+
+#if GPSDO_METRICS || GPSDO_NTP
+    // NVS is up, the snapshot restore initialized it
+    if (wifi_station_init(GPSDO_WIFI_SSID, GPSDO_WIFI_PASSWORD) == 0)
+    {
+#if GPSDO_METRICS
+        CREATE_TASK(metrics_task, "metrics", STACK_METRICS, 1, NULL, DISPLAY_CORE);
+#endif
+#if GPSDO_NTP
+        // Above the display, the receive timestamp is taken in this task
+        CREATE_TASK(ntp_task, "ntp", STACK_NTP, 5, NULL, DISPLAY_CORE);
+#endif
+    }
+#endif
 }
 
 void initialize_uccm()
 {
-    uart_write_bytes(CMD_PORT_NUM, "\n", sizeof("\n") - 1);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    uart_write_bytes(CMD_PORT_NUM, "\n", sizeof("\n") - 1);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    uart_write_bytes(CMD_PORT_NUM, "SYNC:REF:DISABLE LINK\n", sizeof("SYNC:REF:DISABLE LINK\n") - 1);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    uart_write_bytes(CMD_PORT_NUM, "SYNC:REF:DISABLE EXT\n", sizeof("SYNC:REF:DISABLE EXT\n") - 1);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    uart_write_bytes(CMD_PORT_NUM, "SYNC:REF:ENABLE GPS\n", sizeof("SYNC:REF:ENABLE GPS\n") - 1);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    uart_write_bytes(CMD_PORT_NUM, "REF:TYPE GPS\n", sizeof("REF:TYPE GPS\n") - 1);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    uart_write_bytes(CMD_PORT_NUM, "OUTP:TP:SEL PP1S\n", sizeof("OUTP:TP:SEL PP1S\n") - 1);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    // uart_write_bytes(CMD_PORT_NUM, "GPS:SAT:TRAC:EMAN 20\n", sizeof("GPS:SAT:TRAC:EMAN 20\n") - 1);
-    // vTaskDelay(100 / portTICK_PERIOD_MS);
-    uart_write_bytes(CMD_PORT_NUM, "\n", sizeof("\n") - 1);
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    static const char *TAG = "initialize_uccm";
+
+    uart_flush_input(CMD_PORT_NUM);
+    for (int i = 0; i < UCCM_INIT_COMMANDS; i++)
+    {
+        bootScreen(i, UCCM_INIT_COMMANDS, uccm_init_commands[i][0] ? uccm_init_commands[i] : "Sync prompt");
+        uart_write_bytes(CMD_PORT_NUM, uccm_init_commands[i], strlen(uccm_init_commands[i]));
+        uart_write_bytes(CMD_PORT_NUM, "\n", sizeof("\n") - 1);
+        if (!wait_for_prompt(UCCM_PROMPT_TIMEOUT_MS / portTICK_PERIOD_MS))
+        {
+            ESP_LOGW(TAG, "No prompt after \"%s\"", uccm_init_commands[i]);
+        }
+    }
+    bootScreen(UCCM_INIT_COMMANDS, UCCM_INIT_COMMANDS, "Waiting for data");
+    // Drop the echoes and the UART events they raised before the tasks start
     uart_flush_input(CMD_PORT_NUM);
+    xQueueReset(queue_uart_cmd);
+}
+
+// Reads the command port until the UCCM prompt shows up or the timeout expires.
+// Only used during boot, before uart_receive_cmd_task owns the port.
+static bool wait_for_prompt(TickType_t timeout)
+{
+    static const char prompt[] = UCCM_PROMPT;
+    size_t matched = 0;
+    uint8_t c;
+    TickType_t start = xTaskGetTickCount();
+
+    while ((xTaskGetTickCount() - start) < timeout)
+    {
+        if (uart_read_bytes(CMD_PORT_NUM, &c, 1, 10 / portTICK_PERIOD_MS) != 1)
+        {
+            continue;
+        }
+        if (c == prompt[matched])
+        {
+            matched++;
+        }
+        else
+        {
+            matched = (c == prompt[0]) ? 1 : 0;
+        }
+        if (matched == sizeof(prompt) - 1)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Logs how long the display showed nothing but the boot screen
+static void log_first_screen(const char *source)
+{
+    static const char *TAG = "boot";
+
+    ESP_LOGI(TAG, "Time to first useful screen: %lld ms, from %s", (esp_timer_get_time() - boot_start_us) / 1000, source);
 }
 
+// Logs the time to first valid data once both sources have delivered
+static void check_first_data()
+{
+    static const char *TAG = "boot";
+
+    if (first_data_valid || (first_tod_us == 0) || (first_status_us == 0))
+    {
+        return;
+    }
+    first_data_valid = true;
+    ESP_LOGI(TAG, "Time to first valid data: %lld ms (TOD %lld ms, status %lld ms)",
+             (MAX(first_tod_us, first_status_us) - boot_start_us) / 1000,
+             (first_tod_us - boot_start_us) / 1000,
+             (first_status_us - boot_start_us) / 1000);
+}
+
+// Writes commands to the UCCM in a single write, a line each, noting who the
+// responses go back to. Returns how many fit into the write, the rest stays
+// unsent.
+static int send_commands(int owner, const char *const *commands, int count)
+{
+    char line[UCCM_WRITE_SIZE];
+    int length = 0;
+    int fitting;
+
+    for (fitting = 0; fitting < count; fitting++)
+    {
+        size_t command_length = strlen(commands[fitting]);
+        if (length + command_length + 1 > sizeof(line))
+        {
+            break;
+        }
+        memcpy(&line[length], commands[fitting], command_length);
+        length += command_length;
+        line[length++] = '\n';
+    }
+    int64_t now_us = esp_timer_get_time();
+    for (int i = 0; i < fitting; i++)
+    {
+        scpi_bridge_sent(&scpi_bridge, owner, commands[i], i == fitting - 1, now_us);
+    }
+    uart_write_bytes(CMD_PORT_NUM, line, length);
+    return fitting;
+}
+
+// Polls the UCCM following the periods in the command table, one command per
+// slot. The most overdue command goes first, ties in table order. Commands
+// from the SCPI bridge take the slot ahead of the polls, bar one slot in
+// every SCPI_BRIDGE_BURST_SLOTS + 1 while a poll is overdue. A client waits
+// at most that many slots per command queued ahead of it, and the monitor
+// refreshes slower instead of stopping while a client is busy. With
+// GPSDO_CMD_BATCH the due polls of UCCM_BATCH share the slot of the first.
 static void send_cmd_task(void *pvParameters)
 {
     static const char *TAG = "send_cmd_task";
-    char *commands[13] = {
-        "*IDN?",
-        "ALAR:HARD?",
-        "ALAR:OPER?",
-        "DIAG:LOOP?",
-        "DIAG:ROSC:EFC:REL?",
-        "DIAG:ROSC:EFC:DATA?",
-        "GPS:POS?",
-        "LED:GPSL?",
-        "OUTP:STAT?",
-        "PULLINRANGE?",
-        "SYNC:FFOM?",
-        "SYNC:TINT?",
-        "SYST:STAT?"};
+    TickType_t next_due[UCCM_COMMAND_COUNT];
+    TickType_t last_wake = xTaskGetTickCount();
+    char client_command[SCPI_BRIDGE_LINE_SIZE + 1];
+    int client_owner = SCPI_OWNER_MONITOR;
+    int client_slots = 0;
+
+    for (int i = 0; i < UCCM_COMMAND_COUNT; i++)
+    {
+        next_due[i] = last_wake;
+    }
 
     for (;;)
     {
-        for (int i = 0; i < 13; i++)
+        TickType_t now = xTaskGetTickCount();
+        int next = -1;
+        uint32_t due = 0;
+        for (int i = 0; i < UCCM_COMMAND_COUNT; i++)
         {
+            if ((uccm_commands[i].period == 0) || ((int32_t)(next_due[i] - now) > 0))
+            {
+                continue;
+            }
+            due |= 1u << i;
+            if ((next < 0) || ((int32_t)(next_due[i] - next_due[next]) < 0))
+            {
+                next = i;
+            }
+        }
+
+        // A client command waits here while an overdue poll takes the slot
+        if (client_owner == SCPI_OWNER_MONITOR)
+        {
+            client_owner = scpi_bridge_next_command(&scpi_bridge, client_command, sizeof(client_command));
+        }
+
+        if ((next >= 0) && ((client_owner == SCPI_OWNER_MONITOR) || (client_slots >= SCPI_BRIDGE_BURST_SLOTS)))
+        {
+            const char *batch[UCCM_COMMAND_COUNT];
+            int batch_ids[UCCM_COMMAND_COUNT];
+            int count = 0;
+            uint32_t polls = 1u << next;
+            if (GPSDO_CMD_BATCH && (UCCM_BATCH_MASK & polls))
+            {
+                polls |= UCCM_BATCH_MASK & due;
+            }
+            // The most overdue first, the rest in table order
+            batch_ids[count] = next;
+            batch[count++] = uccm_commands[next].wire;
+            for (int i = 0; i < UCCM_COMMAND_COUNT; i++)
+            {
+                if ((i != next) && (polls & (1u << i)))
+                {
+                    batch_ids[count] = i;
+                    batch[count++] = uccm_commands[i].wire;
+                }
+            }
             // xSemaphoreTake(can_send_cmd, portMAX_DELAY);
-            ESP_LOGD(TAG, "Sending command %s", commands[i]);
-            uart_write_bytes(CMD_PORT_NUM, commands[i], strlen(commands[i]));
-            uart_write_bytes(CMD_PORT_NUM, "\n", sizeof("\n") - 1);
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
+            DLOGD(TAG, "Sending command %s and %d more", batch[0], count - 1);
+            count = send_commands(SCPI_OWNER_MONITOR, batch, count);
+            for (int i = 0; i < count; i++)
+            {
+                next_due[batch_ids[i]] = now + (uccm_commands[batch_ids[i]].period * 1000) / portTICK_PERIOD_MS;
+            }
+            client_slots = 0;
         }
+        else if (client_owner != SCPI_OWNER_MONITOR)
+        {
+            DLOGD(TAG, "Sending client command %s", client_command);
+            const char *command = client_command;
+            send_commands(client_owner, &command, 1);
+            client_owner = SCPI_OWNER_MONITOR;
+            client_slots++;
+        }
+        vTaskDelayUntil(&last_wake, UCCM_POLL_SLOT_MS / portTICK_PERIOD_MS);
     }
     vTaskDelete(NULL);
 }
@@ -177,49 +588,82 @@ static void parse_cmd_task(void *pvParameters)
 {
     static const char *TAG = "parse_cmd_task";
     esp_log_level_set(TAG, ESP_LOG_INFO);
-    char *cmd_data;
+    static char cmd_data[CMD_BUFFER_SIZE];
     char *mark_pos;
     char *complete_pos = NULL;
+    char command[24];
+    unsigned int dropped = 0;
+    uint32_t surveyed_fixes = 0;
+    int length;
     for (;;)
     {
-        if (xQueueReceive(queue_cmd, &cmd_data, (portTickType)portMAX_DELAY))
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while ((length = spsc_ring_pop(&ring_cmd, cmd_data, sizeof(cmd_data) - 1)) != 0)
         {
-            ESP_LOGD(TAG, "cmd data [%d]: %s", strlen(cmd_data), cmd_data);
+            if (length < 0)
+            {
+                continue;
+            }
+            cmd_data[length] = '\0';
+            DLOGD(TAG, "cmd data [%d]: %s", strlen(cmd_data), cmd_data);
             mark_pos = strchr(cmd_data, '?');
             complete_pos = strstr(cmd_data, "\"Command Complete\"");
-            if (mark_pos != NULL)
+            if ((mark_pos != NULL) && (complete_pos != NULL))
             {
                 // The len_cmd is calculated from the original ? position
                 size_t len_cmd = mark_pos - cmd_data;
-                if (len_cmd <= 0)
+                if ((len_cmd <= 0) || (len_cmd >= sizeof(command)))
                 {
                     ESP_LOGW(TAG, "len_cmd is invalid: %d", len_cmd);
+                    continue;
                 }
                 // We increase ? position (mark_pos) and decrease complete_pos
                 // to skip the line feeds and carriage returns
                 mark_pos += 4;
                 complete_pos -= 2;
-                size_t len_data = complete_pos - mark_pos;
-                if (len_data <= 0)
+                if (complete_pos <= mark_pos)
                 {
-                    ESP_LOGW(TAG, "len_data is invalid: %d", len_data);
+                    ESP_LOGW(TAG, "len_data is invalid: %d", complete_pos - mark_pos);
+                    continue;
                 }
-                char *command = calloc(len_cmd + 1, sizeof(char));
-                char *data = calloc(len_data + 1, sizeof(char));
-                ESP_LOGD(TAG, "mark_pos: %p complete_pos: %p len_data: %d", mark_pos, complete_pos, len_data);
+                size_t len_data = complete_pos - mark_pos;
+                DLOGD(TAG, "mark_pos: %p complete_pos: %p len_data: %d", (void *)mark_pos, (void *)complete_pos, len_data);
                 memcpy(command, cmd_data, len_cmd);
-                memcpy(data, mark_pos, len_data);
+                command[len_cmd] = '\0';
+                // The data is parsed in place, terminated where the trailer starts
+                char *data = mark_pos;
+                data[len_data] = '\0';
                 // Parse the received command result
-                parse_command(&gpsdo_state, command, data);
-                ESP_LOGD(TAG, "Received command %s", command);
-                ESP_LOGD(TAG, "Received data %s", data);
-                free(command);
-                free(data);
-                command = NULL;
-                data = NULL;
+                int id = parse_command(&gpsdo_state, command, data);
+                state_snapshot_refresh(&state_snapshot, id);
+                if ((id == UCCM_CMD_IDN) && uccm_profile_select(&gpsdo_state))
+                {
+                    ESP_LOGI(TAG, "UCCM variant: %s", uccm_profile_current()->name);
+                }
+                if ((id == UCCM_CMD_GPS_POS) && (gpsdo_state.position_fixes != surveyed_fixes))
+                {
+                    surveyed_fixes = gpsdo_state.position_fixes;
+                    position_t fix = {gpsdo_state.latitude, gpsdo_state.longitude, gpsdo_state.altitude};
+                    xSemaphoreTake(survey_lock, portMAX_DELAY);
+                    bool converged = position_survey_add(&position_survey, &fix);
+                    xSemaphoreGive(survey_lock);
+                    if (converged)
+                    {
+                        ESP_LOGI(TAG, "Position survey converged after %u fixes", surveyed_fixes);
+                    }
+                }
+                if ((first_status_us == 0) && (id == UCCM_CMD_SYST_STAT))
+                {
+                    first_status_us = esp_timer_get_time();
+                    check_first_data();
+                }
+                DLOGD(TAG, "Received command %s", command);
             }
-            free(cmd_data);
-            cmd_data = NULL;
+        }
+        if (atomic_load(&ring_cmd.stats.frames_dropped) != dropped)
+        {
+            dropped = atomic_load(&ring_cmd.stats.frames_dropped);
+            ESP_LOGW(TAG, "%u responses dropped so far", dropped);
         }
     }
     vTaskDelete(NULL);
@@ -228,39 +672,66 @@ static void parse_cmd_task(void *pvParameters)
 static void parse_tod_task(void *pvParameters)
 {
     static const char *TAG = "parse_tod_task";
-    uint8_t *tod_data;
-    uint32_t gpsepoch, utctime;
-    struct tm ts;
-    time_t timestamp;
+    tod_frame_t frame;
+    uint8_t *tod_data = frame.packet;
+    unsigned int dropped = 0;
+    int length;
+    uint32_t gpsepoch;
+    int32_t error_us;
+    clock_sync_error_t tod_error = {0};
+#if GPSDO_NTP
+    // Largest TOD arrival error of the last report, the NTP root dispersion includes it
+    uint32_t sync_error_us = CLOCK_SYNC_MAX_ERROR_US;
+#endif
 
     esp_log_level_set(TAG, ESP_LOG_INFO);
     for (;;)
     {
-        if (xQueueReceive(queue_tod, &tod_data, (portTickType)portMAX_DELAY))
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (atomic_load(&ring_tod.stats.frames_dropped) != dropped)
         {
+            dropped = atomic_load(&ring_tod.stats.frames_dropped);
+            ESP_LOGW(TAG, "%u TOD packets dropped so far", dropped);
+        }
+        while ((length = spsc_ring_pop(&ring_tod, &frame, sizeof(frame))) != 0)
+        {
+            if (length != sizeof(frame))
+            {
+                continue;
+            }
             // Process the timestamp from the message
             // Fields 27 to 30 contain a 32bit timestamp
             gpsepoch = (uint32_t)((tod_data[27] * (256 * 256 * 256)) + (tod_data[28] * (256 * 256)) + (tod_data[29] * (256)) + tod_data[30]);
 
+            gpsdo_state.gps_time = gpsepoch;
+            // The packets start shortly after the second they describe began,
+            // report how well their arrival matched the prediction
+            if (clock_sync_tod(&clock_sync, gpsepoch, frame.end_us, &error_us) &&
+                clock_sync_error_add(&tod_error, error_us))
+            {
+                ESP_LOGI(TAG, "TOD arrival against predicted boundary: mean %lld us, max %d us",
+                         tod_error.sum_abs_us / tod_error.count, tod_error.max_abs_us);
+#if GPSDO_NTP
+                sync_error_us = tod_error.max_abs_us;
+#endif
+                clock_sync_error_reset(&tod_error);
+            }
+            if (first_tod_us == 0)
+            {
+                first_tod_us = esp_timer_get_time();
+                check_first_data();
+            }
+
             // We need the utc_offset to calculate the UTC time from GPS time
             gpsdo_state.utc_offset = tod_data[32];
 
-            // Difference between GPS and UTC epoch
-            // UTC Offset contains the leap seconds
-            utctime = gpsepoch - gpsdo_state.utc_offset;
-            utctime += 315964800;
-
-            timestamp = utctime;
-            ts = *localtime(&timestamp);
-            strftime(gpsdo_state.date, GPSDO_STATE_DATE_SIZE, "%d %b %G", &ts);
-            strftime(gpsdo_state.time, GPSDO_STATE_TIME_SIZE, "%X U", &ts);
-            ESP_LOGD(TAG, "Parsed date: %s", gpsdo_state.date);
-            ESP_LOGD(TAG, "Parsed time: %s", gpsdo_state.time);
-
-            ESP_LOGD(TAG, "UTC Time: %d", utctime);
+            format_gps_time(gpsepoch, gpsdo_state.utc_offset, gpsdo_state.date, gpsdo_state.time);
+            DLOGD(TAG, "Parsed date: %s", gpsdo_state.date);
+            DLOGD(TAG, "Parsed time: %s", gpsdo_state.time);
 
             gpsdo_state.week = (int)(gpsepoch / (7 * 24 * 60 * 60));
-            ESP_LOGD(TAG, "GPS Week: %d", gpsdo_state.week);
+            DLOGD(TAG, "GPS Week: %d", gpsdo_state.week);
+            state_snapshot_refresh(&state_snapshot, STATE_SNAPSHOT_SOURCE_TOD);
 
             // tod_data[33]: 40=PPS validity?  41:phase settling  50:pps invalid?
             //           60:stable  62:stable, leap pending?
@@ -282,45 +753,438 @@ static void parse_tod_task(void *pvParameters)
             // power up 90 -> 80                   Trimble
             // disconnect antenna: 80 -> 90        Trimble UCCM-P
             // reconnect antenna:  90 -> 80        Trimble UCCM-P
-            ESP_LOGD(TAG, "tod[33-36]: %d %d %d %d", tod_data[33], tod_data[34], tod_data[35], tod_data[36]);
+            DLOGD(TAG, "tod[33-36]: %d %d %d %d", tod_data[33], tod_data[34], tod_data[35], tod_data[36]);
+            // Mapped onto the UCCM-P meaning alarm.h describes, see uccm_profile.c
+            uccm_profile_current()->decode_tod(&tod_data[33], gpsdo_state.tod_status);
+#if GPSDO_NTP
+            ntp_server_update(&ntp_server, &gpsdo_state, gpsepoch, sync_error_us);
+#endif
+        }
+    }
+    vTaskDelete(NULL);
+}
 
-            free(tod_data);
-            tod_data = NULL;
+// Logs the journal entries from event number first onwards
+static void log_alarm_events(uint32_t first)
+{
+    static const char *TAG = "alarm";
+    const alarm_event_t *event;
+
+    for (uint32_t n = first; (event = alarm_event(&alarm_engine, n)) != NULL; n++)
+    {
+        if (event->raised)
+        {
+            ESP_LOGW(TAG, "%s raised at %g", alarm_rules[event->rule].name, event->value);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "%s cleared at %g", alarm_rules[event->rule].name, event->value);
         }
     }
+}
+
+static void log_sample_store(const char *name, const sample_store_t *store)
+{
+    static const char *TAG = "sample_store";
+
+    const sample_store_stats_t *stats = &store->stats;
+    if (stats->retained == 0)
+    {
+        return;
+    }
+    ESP_LOGI(TAG, "%s: %u samples over %u s in %u bytes, %u.%02u:1, %u cycles per sample (max %u)", name,
+             stats->retained, store->last_time - sample_store_first_time(store) + store->decimation,
+             stats->retained_bytes, (stats->retained * sizeof(sample_store_sample_t)) / stats->retained_bytes,
+             ((stats->retained * sizeof(sample_store_sample_t) * 100) / stats->retained_bytes) % 100,
+             stats->cycles_total / stats->samples, stats->cycles_max);
+}
+
+// Moments of every series over the last WINDOW_STATS_SECONDS of the sample
+// store, returns the sample count
+static int compute_window_stats(window_moments_t moments[SAMPLE_SERIES_COUNT])
+{
+    xSemaphoreTake(sample_lock, portMAX_DELAY);
+    uint32_t to = sample_store.last_time;
+    window_stats_begin(&window_stats);
+    int found = sample_store_query(&sample_store, to - WINDOW_STATS_SECONDS + 1, to, window_stats_add, &window_stats);
+    window_stats_end(&window_stats);
+    memcpy(moments, window_stats.series, sizeof(window_stats.series));
+    xSemaphoreGive(sample_lock);
+    return found;
+}
+
+static void log_window_stats()
+{
+    static const char *TAG = "window_stats";
+    window_moments_t moments[SAMPLE_SERIES_COUNT];
+
+    if (compute_window_stats(moments) < 2)
+    {
+        return;
+    }
+    for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+    {
+        const window_moments_t *m = &moments[series];
+        ESP_LOGI(TAG, "Window %us %s: mean %.6g sd %.3g pp %.3g drift %+.3g/h", WINDOW_STATS_SECONDS,
+                 window_stats_series_names[series], m->mean_x, window_stats_stddev(m), m->max - m->min,
+                 window_stats_drift(m) * 3600);
+    }
+}
+
+// Appends to the history log and the sample store, samples the trend screens
+// and runs the alarm rules once a second. Without a history partition only
+// the RAM copies are kept.
+static void history_task(void *pvParameters)
+{
+    static const char *TAG = "history_task";
+    bool history_mounted = false;
+    uint32_t sample_report_at = SAMPLE_STORE_REPORT_INTERVAL;
+    uint32_t snapshot_countdown = STATE_SNAPSHOT_INTERVAL;
+
+    if (history_storage_flash_init(&history_storage, "history") != 0)
+    {
+        ESP_LOGE(TAG, "No history partition found");
+    }
+    else if (history_log_mount(&history_log, &history_storage) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to mount history log");
+    }
+    else
+    {
+        history_mounted = true;
+        ESP_LOGI(TAG, "History log mounted, head sector %d page %d", history_log.head_sector, history_log.head_page);
+    }
+
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;)
+    {
+        vTaskDelayUntil(&last_wake, 1000 / portTICK_PERIOD_MS);
+        // Records go to flash in the second they are appended, a reset loses
+        // no more than the sample being averaged
+        if (history_mounted &&
+            ((history_log_update(&history_log, &gpsdo_state) != 0) || (history_log_flush(&history_log) != 0)))
+        {
+            ESP_LOGW(TAG, "History write failed");
+        }
+        if (first_data_valid)
+        {
+            xSemaphoreTake(trend_lock, portMAX_DELAY);
+            trend_add(&trend_phase, gpsdo_state.phase);
+            trend_add(&trend_efc, gpsdo_state.dac);
+            trend_add(&trend_temperature, gpsdo_state.temperature);
+#if GPSDO_METRICS
+            metrics_trend_t trends[METRICS_TREND_COUNT];
+            trends[METRICS_TREND_phase].valid = trend_range(&trend_phase, &trends[METRICS_TREND_phase].low,
+                                                            &trends[METRICS_TREND_phase].high);
+            trends[METRICS_TREND_efc].valid = trend_range(&trend_efc, &trends[METRICS_TREND_efc].low,
+                                                          &trends[METRICS_TREND_efc].high);
+            trends[METRICS_TREND_temperature].valid = trend_range(&trend_temperature,
+                                                                  &trends[METRICS_TREND_temperature].low,
+                                                                  &trends[METRICS_TREND_temperature].high);
+#endif
+            xSemaphoreGive(trend_lock);
+
+            uint32_t first_event = alarm_engine.events;
+            if (alarm_update(&alarm_engine, &gpsdo_state) > 0)
+            {
+                log_alarm_events(first_event);
+            }
+#if GPSDO_METRICS
+            metrics_update(&metrics, &gpsdo_state, trends, &alarm_engine);
+#endif
+
+            xSemaphoreTake(sample_lock, portMAX_DELAY);
+            sample_store_append(&sample_store, &gpsdo_state);
+            sample_store_append(&sample_store_week, &gpsdo_state);
+            xSemaphoreGive(sample_lock);
+
+            // All the changes of an interval go out as one NVS write
+            if (--snapshot_countdown == 0)
+            {
+                snapshot_countdown = STATE_SNAPSHOT_INTERVAL;
+                if (state_snapshot_save(&state_snapshot, &gpsdo_state) < 0)
+                {
+                    ESP_LOGW(TAG, "State snapshot write failed");
+                }
+            }
+            if (sample_store.stats.samples >= sample_report_at)
+            {
+                sample_report_at += SAMPLE_STORE_REPORT_INTERVAL;
+                log_sample_store("1 Hz", &sample_store);
+                log_sample_store("Week", &sample_store_week);
+                log_window_stats();
+            }
+        }
+    }
+}
+
+// Prints the deferred log records and reports what capturing them costs,
+// together with the core loads, the display frame rate and the heap usage
+static void dlog_task(void *pvParameters)
+{
+    static const char *TAG = "dlog_task";
+    static run_stats_t run_stats;
+    TickType_t last_report = xTaskGetTickCount();
+    TickType_t last_alloc_dump = xTaskGetTickCount();
+#if GPSDO_DISPLAY_MIRROR
+    static uint32_t mirror_bytes[SCREEN_COUNT];
+    static uint32_t mirror_ms[SCREEN_COUNT];
+    int64_t mirror_us = esp_timer_get_time();
+#endif
+
+    run_stats_update(&run_stats);
+
+    for (;;)
+    {
+        dlog_flush();
+#if GPSDO_DISPLAY_MIRROR
+        // Screen changes land on the new screen, as they are its cost too
+        int screen = atomic_load(&current_screen);
+        int64_t now_us = esp_timer_get_time();
+        mirror_bytes[screen] += display_mirror_emit(now_us);
+        mirror_ms[screen] += (now_us - mirror_us) / 1000;
+        mirror_us = now_us;
+#endif
+        if ((xTaskGetTickCount() - last_report) >= (DLOG_REPORT_INTERVAL_MS / portTICK_PERIOD_MS))
+        {
+            last_report = xTaskGetTickCount();
+            unsigned int records = atomic_exchange(&dlog_stats.records, 0);
+            unsigned int dropped = atomic_exchange(&dlog_stats.dropped, 0);
+            unsigned int cycles = atomic_exchange(&dlog_stats.cycles_total, 0);
+            unsigned int cycles_max = atomic_exchange(&dlog_stats.cycles_max, 0);
+            if ((records > 0) || (dropped > 0))
+            {
+                ESP_LOGI(TAG, "%u records, %u dropped, %u cycles per call (max %u)",
+                         records, dropped, cycles / MAX(records, 1), cycles_max);
+            }
+
+            if (run_stats_update(&run_stats))
+            {
+                ESP_LOGI(TAG, "Core load: pipeline %u%%, display %u%%",
+                         run_stats.load[PIPELINE_CORE], run_stats.load[DISPLAY_CORE]);
+            }
+            unsigned int frames = atomic_exchange(&display_stats.frames, 0);
+            unsigned int flush_us = atomic_exchange(&display_stats.flush_us_total, 0);
+            unsigned int flush_us_max = atomic_exchange(&display_stats.flush_us_max, 0);
+            unsigned int wait_us = atomic_exchange(&display_stats.wait_us_total, 0);
+            ESP_LOGI(TAG, "Display: %u.%02u fps, flush %u us (max %u), waited %u us per frame",
+                     frames * 1000 / DLOG_REPORT_INTERVAL_MS, (frames * 100000 / DLOG_REPORT_INTERVAL_MS) % 100,
+                     flush_us / MAX(frames, 1), flush_us_max, wait_us / MAX(frames, 1));
+
+            unsigned int commands = atomic_exchange(&scpi_bridge.stats.commands, 0);
+            unsigned int responses = atomic_exchange(&scpi_bridge.stats.responses, 0);
+            unsigned int rejected = atomic_exchange(&scpi_bridge.stats.rejected, 0);
+            unsigned int resyncs = atomic_exchange(&scpi_bridge.stats.resyncs, 0);
+            unsigned int latency_us = atomic_exchange(&scpi_bridge.stats.latency_us_total, 0);
+            unsigned int latency_us_max = atomic_exchange(&scpi_bridge.stats.latency_us_max, 0);
+            if ((commands > 0) || (rejected > 0) || (resyncs > 0))
+            {
+                ESP_LOGI(TAG, "SCPI bridge: %u commands, %u responses in %u us (max %u), %u rejected, %u resyncs",
+                         commands, responses, latency_us / MAX(responses, 1), latency_us_max, rejected, resyncs);
+            }
+            // Time the UART spends on a command, writes of one against batches
+            unsigned int sent = atomic_exchange(&scpi_bridge.stats.sent, 0);
+            unsigned int writes = atomic_exchange(&scpi_bridge.stats.writes, 0);
+            unsigned int round_trips = atomic_exchange(&scpi_bridge.stats.round_trips, 0);
+            unsigned int round_trip_us = atomic_exchange(&scpi_bridge.stats.round_trip_us_total, 0);
+            unsigned int round_trip_us_max = atomic_exchange(&scpi_bridge.stats.round_trip_us_max, 0);
+            ESP_LOGI(TAG, "UCCM: %u commands in %u writes, round trip %u us (max %u), %u us of UART busy per command",
+                     sent, writes, round_trip_us / MAX(round_trips, 1), round_trip_us_max,
+                     (unsigned int)((uint64_t)round_trip_us * writes / MAX(round_trips, 1) / MAX(sent, 1)));
+#if GPSDO_DISPLAY_MIRROR
+            char mirror_rates[SCREEN_COUNT * 7 + 1];
+            int mirror_length = 0;
+            for (int i = 0; i < SCREEN_COUNT; i++)
+            {
+                mirror_length += snprintf(&mirror_rates[mirror_length], sizeof(mirror_rates) - mirror_length, " %u",
+                                          (unsigned int)((uint64_t)mirror_bytes[i] * 1000 / MAX(mirror_ms[i], 1)));
+            }
+            ESP_LOGI(TAG, "Mirror bytes/s per screen since boot:%s", mirror_rates);
+#endif
+#if GPSDO_METRICS
+            unsigned int requests = atomic_exchange(&metrics_http_stats.requests, 0);
+            unsigned int errors = atomic_exchange(&metrics_http_stats.errors, 0);
+            unsigned int serve_us = atomic_exchange(&metrics_http_stats.serve_us_total, 0);
+            unsigned int serve_us_max = atomic_exchange(&metrics_http_stats.serve_us_max, 0);
+            unsigned int updates = atomic_exchange(&metrics.stats.updates, 0);
+            unsigned int rendered = atomic_exchange(&metrics.stats.rendered, 0);
+            ESP_LOGI(TAG, "Metrics: %u requests in %u us (max %u), %u errors, %u of %u values re-rendered",
+                     requests, serve_us / MAX(requests, 1), serve_us_max, errors, rendered, updates * METRICS_COUNT);
+#endif
+#if GPSDO_NTP
+            unsigned int ntp_requests = atomic_exchange(&ntp_server.stats.requests, 0);
+            unsigned int ntp_dropped = atomic_exchange(&ntp_server.stats.dropped, 0);
+            unsigned int ntp_replies = atomic_exchange(&ntp_server.stats.replies, 0);
+            unsigned int turnaround_us = atomic_exchange(&ntp_server.stats.turnaround_us_total, 0);
+            unsigned int turnaround_us_max = atomic_exchange(&ntp_server.stats.turnaround_us_max, 0);
+            ESP_LOGI(TAG, "NTP: %u requests, %u dropped, turnaround %u us (max %u), stratum %u",
+                     ntp_requests, ntp_dropped, turnaround_us / MAX(ntp_replies, 1), turnaround_us_max,
+                     ntp_server.template[1]);
+#endif
+            unsigned int status_fast = atomic_exchange(&uccm_profile_stats.fast, 0);
+            unsigned int status_fallback = atomic_exchange(&uccm_profile_stats.fallback, 0);
+            ESP_LOGI(TAG, "Status dumps: %u by the %s layout, %u by keyword", status_fast,
+                     uccm_profile_current()->name, status_fallback);
+        }
+        if ((xTaskGetTickCount() - last_alloc_dump) >= (ALLOC_DUMP_INTERVAL_MS / portTICK_PERIOD_MS))
+        {
+            last_alloc_dump = xTaskGetTickCount();
+            alloc_track_dump();
+        }
+        vTaskDelay(DLOG_FLUSH_INTERVAL_MS / portTICK_PERIOD_MS);
+    }
+}
+
+static void bridge_task(void *pvParameters)
+{
+    for (;;)
+    {
+        scpi_bridge_poll(&scpi_bridge, SCPI_BRIDGE_POLL_MS);
+    }
+}
+
+#if GPSDO_METRICS
+// Never returns unless the responder cannot listen
+static void metrics_task(void *pvParameters)
+{
+    static const char *TAG = "metrics_task";
+
+    ESP_LOGI(TAG, "Serving metrics on port %d", METRICS_HTTP_PORT);
+    if (metrics_http_serve(&metrics, METRICS_HTTP_PORT) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to listen on port %d", METRICS_HTTP_PORT);
+    }
     vTaskDelete(NULL);
 }
+#endif
+
+#if GPSDO_NTP
+static void ntp_task(void *pvParameters)
+{
+    static const char *TAG = "ntp_task";
+
+    ESP_LOGI(TAG, "Serving NTP on port %d", NTP_SERVER_PORT);
+    if (ntp_server_serve(&ntp_server, NTP_SERVER_PORT) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to bind port %d", NTP_SERVER_PORT);
+    }
+    vTaskDelete(NULL);
+}
+#endif
 
 static void update_display_task(void *pvParameters)
 {
+    static const char *TAG = "update_display";
+
+    while (!first_data_valid && !snapshot_restored)
+    {
+        bootScreen(UCCM_INIT_COMMANDS, UCCM_INIT_COMMANDS, "Waiting for data");
+        vTaskDelay(250 / portTICK_PERIOD_MS);
+    }
+    if (!snapshot_restored)
+    {
+        log_first_screen("live data");
+    }
+
+    // Wakes this task at the predicted second boundaries, with far finer
+    // resolution than the scheduler tick
+    esp_timer_handle_t flush_timer;
+    esp_timer_create_args_t flush_timer_args = {
+        .callback = clock_flush_callback,
+        .arg = xTaskGetCurrentTaskHandle(),
+        .name = "clock_flush",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&flush_timer_args, &flush_timer));
+
+    clock_sync_error_t flush_error = {0};
+    uint32_t second;
+    int64_t boundary_us, now_us;
+
     for (;;)
     {
-        for (int i = 0; i < 4; i++)
+        for (int i = 0; i < SCREEN_COUNT; i++)
         {
+            int64_t screen_end_us = esp_timer_get_time() + SCREEN_PERIOD_MS * 1000LL;
+            atomic_store(&current_screen, i);
+            clock_region.visible = false;
             screen_functions[i]();
 
-            vTaskDelay(5000 / portTICK_PERIOD_MS);
+            while ((now_us = esp_timer_get_time()) < screen_end_us)
+            {
+                if (!clock_region.visible ||
+                    !clock_sync_next_boundary(&clock_sync, now_us, &second, &boundary_us) ||
+                    (boundary_us >= screen_end_us))
+                {
+                    vTaskDelay(MAX(1, (screen_end_us - now_us) / 1000 / portTICK_PERIOD_MS));
+                    break;
+                }
+                // Render the upcoming second now, send it when it starts
+                stage_clock(second);
+                esp_timer_start_once(flush_timer, MAX(1, boundary_us - esp_timer_get_time()));
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                now_us = esp_timer_get_time();
+                display_present_rows(clock_region.tile_y, clock_region.tile_h);
+
+                if (clock_sync_error_add(&flush_error, (int32_t)(now_us - boundary_us)))
+                {
+                    ESP_LOGI(TAG, "Clock flush against predicted boundary: mean %lld us, max %d us",
+                             flush_error.sum_abs_us / flush_error.count, flush_error.max_abs_us);
+                    clock_sync_error_reset(&flush_error);
+                }
+            }
         }
     }
 }
 
+static void clock_flush_callback(void *arg)
+{
+    xTaskNotifyGive((TaskHandle_t)arg);
+}
+
+// Hands a response, echo first and prompt last, to the SCPI bridge or the
+// parser. Clobbers the prompt.
+static void dispatch_response(char *response, int length, void *arg)
+{
+    static const char *TAG = "uart_receive_cmd";
+
+    // Responses to the SCPI bridge go back to the client, prompt and all
+    if (scpi_bridge_route(&scpi_bridge, response, length, esp_timer_get_time()))
+    {
+        return;
+    }
+    length -= sizeof(UCCM_PROMPT) - 1;
+    response[length] = '\0';
+    DLOGD(TAG, "Response [%d]: %s", length, response);
+    if (strchr(response, '?') == NULL)
+    {
+        // Echo of an empty line or a setting, nothing to parse
+        return;
+    }
+    // Never blocks, a full ring applies CMD_RING_POLICY
+    spsc_ring_push(&ring_cmd, response, length);
+    xTaskNotifyGive(parse_cmd_handle);
+    // xSemaphoreGive(can_send_cmd);
+}
+
+// Frames command responses on the UCCM prompt. The UART pattern detector
+// flags the trailing space of "UCCM> " (a space followed by line idle), so the
+// task only reads once a whole response sits in the driver ring buffer and
+// pulls it into the frame buffer, split by prompt_framer.
+// UART_DATA events are left alone, the bytes stay buffered until the
+// pattern shows up.
 static void uart_receive_cmd_task(void *pvParameters)
 {
     static const char *TAG = "uart_receive_cmd";
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
+    static char frame[CMD_BUFFER_SIZE];
+    static prompt_framer_t framer;
     uart_event_t event;
+    int pattern_pos;
 
-    int cmd_buffer_index = 0;
-
-    char *prompt_pos;
-    char *cmd_pos;
-    bool cmd_detected = false;
-    char *dtmp = malloc(CMD_BUFFER_SIZE);
-    char *cmd_buffer = malloc(CMD_BUFFER_SIZE);
-    bzero(dtmp, CMD_BUFFER_SIZE);
-    bzero(cmd_buffer, CMD_BUFFER_SIZE);
+    prompt_framer_init(&framer, frame, sizeof(frame), UCCM_PROMPT);
 
+    uart_pattern_queue_reset(CMD_PORT_NUM, UART_PATTERN_QUEUE_SIZE);
     uart_flush_input(CMD_PORT_NUM);
     // xSemaphoreGive(can_send_cmd);
 
@@ -328,74 +1192,50 @@ static void uart_receive_cmd_task(void *pvParameters)
     {
         if (xQueueReceive(queue_uart_cmd, (void *)&event, (portTickType)portMAX_DELAY) == pdTRUE)
         {
-            bzero(dtmp, CMD_BUFFER_SIZE);
             switch (event.type)
             {
-            /*We'd better handler data event fast, there would be much more data events than
-                other types of events. If we take too much time on data event, the queue might
-                be full.*/
             case UART_DATA:
-                uart_read_bytes(CMD_PORT_NUM, dtmp, event.size, 10 / portTICK_RATE_MS);
-
-                // If the ? has been detected in the previous call, we just get
-                // the rest of the data and notify the parsing function.
-                if (cmd_detected)
+                break;
+            case UART_PATTERN_DET:
+                pattern_pos = uart_pattern_pop_pos(CMD_PORT_NUM);
+                if (pattern_pos < 0)
                 {
-                    memcpy(&cmd_buffer[cmd_buffer_index], dtmp, event.size);
-                    cmd_buffer_index += event.size;
-
-                    prompt_pos = strstr(cmd_buffer, "UCCM> ");
-                    if (prompt_pos != NULL)
-                    {
-                        int cmd_data_length = prompt_pos - cmd_buffer;
-                        char *cmd_data = calloc(cmd_data_length + 1, sizeof(char));
-                        memcpy(cmd_data, cmd_buffer, cmd_data_length);
-                        ESP_LOGD(TAG, "Complex send [%d]: %s", cmd_data_length, cmd_data);
-                        if (xQueueSendToBack(queue_cmd, &cmd_data, (portTickType)portMAX_DELAY) != pdPASS)
-                        {
-                            ESP_LOGE(TAG, "Error sending data to cmd queue");
-                        }
-                        // xSemaphoreGive(can_send_cmd);
-                        // Zero out the buffer to prevent nastiness
-                        cmd_buffer_index = 0;
-                        bzero(cmd_buffer, TOD_BUFFER_SIZE);
-                        cmd_detected = false;
-                    }
+                    // The pattern queue overflowed, positions are no longer reliable
+                    ESP_LOGW(TAG, "pattern queue overflow");
+                    uart_flush_input(CMD_PORT_NUM);
+                    uart_pattern_queue_reset(CMD_PORT_NUM, UART_PATTERN_QUEUE_SIZE);
+                    prompt_framer_reset(&framer);
                     break;
                 }
-
-                cmd_pos = strchr(dtmp, '?');
-                prompt_pos = strstr(dtmp, "UCCM> ");
-                if (cmd_pos != NULL)
+                // A batch may hold more than the frame buffer, what is read
+                // in one go is bounded by what is left of it. Complete
+                // responses are handed over and make room for the rest
+                for (int left = pattern_pos + 1; left > 0;)
                 {
-                    int cmd_length = cmd_pos - dtmp;
-                    if ((cmd_length < 4) || (cmd_length > 18))
+                    int chunk = MIN(left, prompt_framer_space(&framer));
+                    if (chunk <= 0)
                     {
-                        ESP_LOGW(TAG, "Illegal cmd_length: %d", cmd_length);
-                        // xSemaphoreGive(can_send_cmd);
-                        break;
-                    }
-
-                    if (prompt_pos != NULL)
-                    {
-                        int cmd_data_length = prompt_pos - dtmp;
-                        char *cmd_data = calloc(cmd_data_length + 1, sizeof(char));
-                        memcpy(cmd_data, dtmp, cmd_data_length);
-                        ESP_LOGD(TAG, "Simple send: %s", cmd_data);
-                        if (xQueueSendToBack(queue_cmd, &cmd_data, (portTickType)portMAX_DELAY) != pdPASS)
+                        ESP_LOGW(TAG, "Dropping response of more than %d bytes", framer.length + left);
+                        prompt_framer_overflow(&framer, left);
+                        // Drained a buffer at a time, the driver holds up to twice as much
+                        while (left > 0)
                         {
-                            ESP_LOGE(TAG, "Error sending data to cmd queue");
+                            int drained = uart_read_bytes(CMD_PORT_NUM, frame, MIN(left, sizeof(frame)), 10 / portTICK_RATE_MS);
+                            if (drained <= 0)
+                            {
+                                break;
+                            }
+                            left -= drained;
                         }
-                        // xSemaphoreGive(can_send_cmd);
                         break;
                     }
-                    else
+                    int length = uart_read_bytes(CMD_PORT_NUM, prompt_framer_tail(&framer), chunk, 10 / portTICK_RATE_MS);
+                    if (length <= 0)
                     {
-                        cmd_detected = true;
-                        memcpy(&cmd_buffer[cmd_buffer_index], dtmp, event.size);
-                        cmd_buffer_index = event.size;
                         break;
                     }
+                    prompt_framer_commit(&framer, length, dispatch_response, NULL);
+                    left -= length;
                 }
                 break;
             //Event of HW FIFO overflow detected
@@ -405,7 +1245,9 @@ static void uart_receive_cmd_task(void *pvParameters)
                 // The ISR has already reset the rx FIFO,
                 // As an example, we directly flush the rx buffer here in order to read more data.
                 uart_flush_input(CMD_PORT_NUM);
+                uart_pattern_queue_reset(CMD_PORT_NUM, UART_PATTERN_QUEUE_SIZE);
                 xQueueReset(queue_uart_cmd);
+                prompt_framer_reset(&framer);
                 break;
             //Event of UART ring buffer full
             case UART_BUFFER_FULL:
@@ -413,7 +1255,9 @@ static void uart_receive_cmd_task(void *pvParameters)
                 // If buffer full happened, you should consider increasing your buffer size
                 // As an example, we directly flush the rx buffer here in order to read more data.
                 uart_flush_input(CMD_PORT_NUM);
+                uart_pattern_queue_reset(CMD_PORT_NUM, UART_PATTERN_QUEUE_SIZE);
                 xQueueReset(queue_uart_cmd);
+                prompt_framer_reset(&framer);
                 break;
             //Event of UART RX break detected
             case UART_BREAK:
@@ -434,8 +1278,6 @@ static void uart_receive_cmd_task(void *pvParameters)
             }
         }
     }
-    free(dtmp);
-    free(cmd_buffer);
     vTaskDelete(NULL);
 }
 
@@ -444,14 +1286,15 @@ static void uart_receive_tod_task(void *pvParameters)
     static const char *TAG = "uart_receive_tod";
 
     uart_event_t event;
+    int64_t event_us;
 
     int tod_buffer_index = 0;
     bool c5_detected = false;
 
     uint8_t *c5_pos;
     uint8_t *ca_pos;
-    uint8_t *dtmp = calloc(TOD_BUFFER_SIZE, sizeof(uint8_t));
-    uint8_t *tod_buffer = calloc(TOD_BUFFER_SIZE, sizeof(uint8_t));
+    static uint8_t dtmp[TOD_BUFFER_SIZE];
+    static uint8_t tod_buffer[TOD_BUFFER_SIZE];
 
     uart_flush_input(TOD_PORT_NUM);
 
@@ -459,6 +1302,7 @@ static void uart_receive_tod_task(void *pvParameters)
     {
         if (xQueueReceive(queue_uart_tod, (void *)&event, (portTickType)portMAX_DELAY))
         {
+            event_us = esp_timer_get_time();
             switch (event.type)
             {
             /*We'd better handle data event fast, there would be much more data events than
@@ -489,12 +1333,7 @@ static void uart_receive_tod_task(void *pvParameters)
                     if (tod_buffer_index == TOD_PACKET_SIZE)
                     {
                         // Here notify the parsing task that data is ready
-                        char *tod_data = calloc(TOD_PACKET_SIZE, sizeof(uint8_t));
-                        memcpy(tod_data, tod_buffer, tod_buffer_index);
-                        if (xQueueSendToBack(queue_tod, &tod_data, (portTickType)portMAX_DELAY) != pdPASS)
-                        {
-                            ESP_LOGE(TAG, "Error sending data to TOD queue");
-                        }
+                        push_tod(tod_buffer, event_us);
                     }
                     else
                     {
@@ -509,7 +1348,7 @@ static void uart_receive_tod_task(void *pvParameters)
                         // If ca wasn't received yet, we need to break/leave the function and wait for the next one
                         if (ca_pos == NULL)
                         {
-                            ESP_LOGD(TAG, "ca_pos not found yet. Accumulating.");
+                            DLOGD(TAG, "ca_pos not found yet. Accumulating.");
                             break;
                         }
 
@@ -517,7 +1356,7 @@ static void uart_receive_tod_task(void *pvParameters)
                         memcpy(&tod_buffer[tod_buffer_index], dtmp, ca_pos - dtmp);
                         tod_buffer_index += ca_pos - dtmp;
 
-                        ESP_LOGD(TAG, "Binary TOD [%d]", tod_buffer_index);
+                        DLOGD(TAG, "Binary TOD [%d]", tod_buffer_index);
                         // for (int i = 0; i < tod_buffer_index; i++)
                         // {
                         //     ESP_LOGD(TAG, "Binary TOD [%d]: 0x%X", i, tod_buffer[i]);
@@ -526,12 +1365,7 @@ static void uart_receive_tod_task(void *pvParameters)
                         if (tod_buffer_index == TOD_PACKET_SIZE)
                         {
                             // Here notify the parsing task that data is ready
-                            char *tod_data = calloc(TOD_PACKET_SIZE, sizeof(uint8_t));
-                            memcpy(tod_data, tod_buffer, tod_buffer_index);
-                            if (xQueueSendToBack(queue_tod, &tod_data, (portTickType)portMAX_DELAY) != pdPASS)
-                            {
-                                ESP_LOGE(TAG, "Error sending data to TOD queue");
-                            }
+                            push_tod(tod_buffer, event_us);
                         }
                         else
                         {
@@ -581,17 +1415,28 @@ static void uart_receive_tod_task(void *pvParameters)
             }
         }
     }
-    free(dtmp);
-    free(tod_buffer);
     vTaskDelete(NULL);
 }
 
+// Hands a complete TOD packet to parse_tod_task without blocking
+// event_us is when the driver handed over the last bytes, once the line had
+// been idle for a while after them
+static void push_tod(const uint8_t *packet, int64_t event_us)
+{
+    tod_frame_t frame;
+
+    frame.end_us = event_us - (UART_RX_TIMEOUT_BYTES * UART_BYTE_US);
+    memcpy(frame.packet, packet, TOD_PACKET_SIZE);
+    spsc_ring_push(&ring_tod, &frame, sizeof(frame));
+    xTaskNotifyGive(parse_tod_handle);
+}
+
 static void initialize_uart()
 {
     /* Configure parameters of an UART driver,
      * communication pins and install the driver */
     uart_config_t uart_config = {
-        .baud_rate = 57600,
+        .baud_rate = UART_BAUD_RATE,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
@@ -605,6 +1450,8 @@ static void initialize_uart()
     ESP_ERROR_CHECK(uart_param_config(CMD_PORT_NUM, &uart_config));
     // Set UART pins
     ESP_ERROR_CHECK(uart_set_pin(CMD_PORT_NUM, GPIO_NUM_17, GPIO_NUM_16, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    // Flag a single space followed by idle time, the end of the "UCCM> " prompt
+    ESP_ERROR_CHECK(uart_enable_pattern_det_baud_intr(CMD_PORT_NUM, ' ', 1, 9, UART_PATTERN_POST_IDLE, 0));
 
     // TOD UART Initialization
     ESP_ERROR_CHECK(uart_param_config(TOD_PORT_NUM, &uart_config));
@@ -627,117 +1474,465 @@ static void initialize_display()
 
     u8g2_InitDisplay(&u8g2);
     u8g2_SetPowerSave(&u8g2, 0); // wake up display
+    display_init(&u8g2, display_spare_buffer);
+}
+
+void bootScreen(int step, int steps, const char *label)
+{
+    static const char spinner[] = "|/-\\";
+    static int frame = 0;
+    char holder[24];
+    int elapsed_ms = (esp_timer_get_time() - boot_start_us) / 1000;
+
+    // The last known state stays on the display instead
+    if (snapshot_restored)
+    {
+        return;
+    }
+    u8g2_ClearBuffer(&u8g2);
+    u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
+    u8g2_DrawStr(&u8g2, 0, 7, "DK2IP GPSDO Monitor");
+    fmt(holder, sizeof(holder), "Booting %c %d.%01ds", spinner[frame++ & 3], elapsed_ms / 1000, (elapsed_ms / 100) % 10);
+    u8g2_DrawStr(&u8g2, 0, 23, holder);
+    fmt(holder, sizeof(holder), "%.21s", label);
+    u8g2_DrawStr(&u8g2, 0, 39, holder);
+    u8g2_DrawFrame(&u8g2, 0, 48, 128, 10);
+    u8g2_DrawBox(&u8g2, 2, 50, (124 * MIN(step, steps)) / steps, 6);
+    display_present();
+}
+
+// Clears the clock and draws the given time in its place
+static void draw_clock_text(const char *text)
+{
+    u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
+    int top = MAX(0, clock_region.y + 1 - u8g2_GetAscent(&u8g2));
+    u8g2_SetDrawColor(&u8g2, 0);
+    u8g2_DrawBox(&u8g2, clock_region.x, top, u8g2_GetStrWidth(&u8g2, text), clock_region.y + 1 - top);
+    u8g2_SetDrawColor(&u8g2, 1);
+    u8g2_DrawStr(&u8g2, clock_region.x, clock_region.y, text);
+    // The frame buffer and the tile writes are in panel rows, which U8G2_R2
+    // turns upside down: the bottom of the text is the top panel row
+    int bottom = u8g2_GetDisplayHeight(&u8g2) - 1;
+    clock_region.tile_y = (bottom - clock_region.y) / 8;
+    clock_region.tile_h = ((bottom - top) / 8) - clock_region.tile_y + 1;
+}
+
+// Draws the time of the second in progress and marks the spot, so the
+// display task can keep it ticking at the second boundaries
+void drawClock(int x, int y)
+{
+    char holder[GPSDO_STATE_TIME_SIZE];
+    uint32_t second;
+
+    clock_region.visible = true;
+    clock_region.x = x;
+    clock_region.y = y;
+    if (clock_sync_second_at(&clock_sync, esp_timer_get_time(), &second))
+    {
+        format_gps_time(second, gpsdo_state.utc_offset, NULL, holder);
+    }
+    else
+    {
+        fmt(holder, sizeof(holder), "%s", gpsdo_state.time);
+    }
+    draw_clock_text(holder);
+}
+
+// Appends a * to a value that still holds what the snapshot restored
+static void mark_stale(char *holder, size_t size, state_field_t field)
+{
+    size_t length = strlen(holder);
+
+    if (state_snapshot_stale(&state_snapshot, field) && (length + 1 < size))
+    {
+        holder[length] = '*';
+        holder[length + 1] = '\0';
+    }
+}
+
+// Renders the clock for an upcoming second into the frame buffer, without
+// sending it to the display
+static void stage_clock(uint32_t second)
+{
+    char holder[GPSDO_STATE_TIME_SIZE];
+
+    format_gps_time(second, gpsdo_state.utc_offset, NULL, holder);
+    draw_clock_text(holder);
 }
 
 void uccmDataScreen()
 {
-    char *holder = malloc(24 * sizeof(char));
+    char holder[24];
     u8g2_ClearBuffer(&u8g2);
     u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
     // Drawing of left side
-    sprintf(holder, "UCCM:%.10s %.7s", gpsdo_state.manufacturer, gpsdo_state.model);
+    fmt(holder, sizeof(holder), "UCCM:%.10s %.7s", gpsdo_state.manufacturer, gpsdo_state.model);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_manufacturer);
     u8g2_DrawStr(&u8g2, 0, 7, holder);
-    sprintf(holder, "SN:%.10s,%.9s", gpsdo_state.serial_number, gpsdo_state.version);
+    fmt(holder, sizeof(holder), "SN:%.10s,%.9s", gpsdo_state.serial_number, gpsdo_state.version);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_serial_number);
     u8g2_DrawStr(&u8g2, 0, 15, holder);
-    sprintf(holder, "Temp:%6.3f", gpsdo_state.temperature);
+    fmt(holder, sizeof(holder), "Temp:%6.3f", gpsdo_state.temperature);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_temperature);
     u8g2_DrawStr(&u8g2, 0, 23, holder);
-    sprintf(holder, "DAC: %+7.4f %%", gpsdo_state.dac);
+    fmt(holder, sizeof(holder), "DAC: %+7.4f %%", gpsdo_state.dac);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_dac);
     u8g2_DrawStr(&u8g2, 0, 31, holder);
-    sprintf(holder, "Phase: %+5.2E", gpsdo_state.phase);
+    fmt(holder, sizeof(holder), "Phase: %+5.2E", gpsdo_state.phase);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_phase);
     u8g2_DrawStr(&u8g2, 0, 39, holder);
-    sprintf(holder, "PPS: %+7.4fns", gpsdo_state.pps);
+    fmt(holder, sizeof(holder), "PPS: %+7.4fns", gpsdo_state.tint * 1e9);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_tint);
     u8g2_DrawStr(&u8g2, 0, 47, holder);
-    sprintf(holder, "FREQ DIFF: %5.2f", gpsdo_state.freq_diff);
+    fmt(holder, sizeof(holder), "FREQ DIFF:%+.2E", gpsdo_state.freq_diff);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_freq_diff);
     u8g2_DrawStr(&u8g2, 0, 55, holder);
-    sprintf(holder, "TFOM: %d FFOM: %d", gpsdo_state.tfom, gpsdo_state.ffom);
+    fmt(holder, sizeof(holder), "TFOM: %d FFOM: %d", gpsdo_state.tfom, gpsdo_state.ffom);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_tfom);
     u8g2_DrawStr(&u8g2, 0, 63, holder);
-    u8g2_SendBuffer(&u8g2);
-    free(holder);
-    holder = NULL;
+    display_present();
 }
 
 void monitorScreen()
 {
-    char *holder = malloc(24 * sizeof(char));
+    char holder[24];
     u8g2_ClearBuffer(&u8g2);
     u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
     // Drawing of left side
     u8g2_DrawStr(&u8g2, 0, 7, "DK2IP GPSDO Monitor");
-    u8g2_DrawStr(&u8g2, 0, 15, gpsdo_state.time);
+    drawClock(0, 15);
     u8g2_DrawStr(&u8g2, 0, 23, "Freq: N/A");
     u8g2_DrawStr(&u8g2, 0, 31, "GPSDO Status");
-    sprintf(holder, "OUT: %.8s", gpsdo_state.status_output);
+    fmt(holder, sizeof(holder), "OUT: %.8s", gpsdo_state.status_output);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_status_output);
     u8g2_DrawStr(&u8g2, 0, 39, holder);
-    sprintf(holder, "GPS: %.8s", gpsdo_state.status_gps);
+    fmt(holder, sizeof(holder), "GPS: %.8s", gpsdo_state.status_gps);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_status_gps);
     u8g2_DrawStr(&u8g2, 0, 47, holder);
-    sprintf(holder, "Pos: %.8s", gpsdo_state.status_pos);
+    fmt(holder, sizeof(holder), "Pos: %.8s", gpsdo_state.status_pos);
     u8g2_DrawStr(&u8g2, 0, 55, holder);
-    sprintf(holder, "OPR: %.8s", gpsdo_state.status_opr);
+    fmt(holder, sizeof(holder), "OPR: %.8s", gpsdo_state.status_opr);
     u8g2_DrawStr(&u8g2, 0, 63, holder);
     // Drawing of right side
     u8g2_DrawStr(&u8g2, 63, 15, gpsdo_state.date);
     u8g2_DrawStr(&u8g2, 81, 39, "|Alarm");
     u8g2_DrawStr(&u8g2, 81, 47, "|------");
-    sprintf(holder, "|HW:%.4s", gpsdo_state.alarm_hw);
+    fmt(holder, sizeof(holder), "|HW:%.4s", gpsdo_state.alarm_hw);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_alarm_hw);
     u8g2_DrawStr(&u8g2, 81, 55, holder);
-    sprintf(holder, "|OP:%.4s", gpsdo_state.alarm_op);
+    fmt(holder, sizeof(holder), "|OP:%.4s", gpsdo_state.alarm_op);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_alarm_op);
     u8g2_DrawStr(&u8g2, 81, 63, holder);
-    u8g2_SendBuffer(&u8g2);
-    free(holder);
-    holder = NULL;
+    display_present();
 }
 
 void satellitesScreen()
 {
-    char *holder = malloc(24 * sizeof(char));
+    char holder[24];
     u8g2_ClearBuffer(&u8g2);
     u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
     // Drawing of left side
-    sprintf(holder, "Tracking: %d", gpsdo_state.satellite_trk);
+    fmt(holder, sizeof(holder), "Tracking: %d", gpsdo_state.satellite_trk);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_satellite_trk);
     u8g2_DrawStr(&u8g2, 0, 7, holder);
-    sprintf(holder, "Visible: %d", gpsdo_state.satellite_vis);
+    fmt(holder, sizeof(holder), "Visible: %d", gpsdo_state.satellite_vis);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_satellite_vis);
     u8g2_DrawStr(&u8g2, 0, 15, holder);
     u8g2_DrawStr(&u8g2, 0, 23, " PRN E1  AZ  C/N Sig.");
-    // for (int i = 0; i < MIN(gpsdo_state.satellite_trk, 5); i++)
-    for (int i = 0; i < 5; i++)
+    // Tracked satellites come first in the slots, then the visible ones
+    for (int i = 0, row = 0; (i < GPSDO_MAX_SATELLITES) && (row < 5); i++)
     {
-        u8g2_DrawStr(&u8g2, 0, (31 + i * 8), " 00  00 000  000  00");
+        const gps_satellite_t *sat = &gpsdo_state.satellites[i];
+        if (sat->prn == 0)
+        {
+            continue;
+        }
+        if (sat->cn > 0)
+        {
+            fmt(holder, sizeof(holder), " %3d %3d %3d  %3d %3d", sat->prn, sat->e1, sat->az, sat->cn, sat->cn);
+        }
+        else
+        {
+            fmt(holder, sizeof(holder), " %3d %3d %3d  N/A  --", sat->prn, sat->e1, sat->az);
+        }
+        u8g2_DrawStr(&u8g2, 0, (31 + row++ * 8), holder);
     }
     // u8g2_DrawStr(&u8g2, 0, 31, "  2  57  33   42  42");
     // u8g2_DrawStr(&u8g2, 0, 39, "  5  57 336   50  50");
     // u8g2_DrawStr(&u8g2, 0, 47, " 15  23 206   36  36");
     // u8g2_DrawStr(&u8g2, 0, 55, " 19  22 149  N/A  --");
     // u8g2_DrawStr(&u8g2, 0, 63, " 25  13 274  N/A  --");
-    u8g2_SendBuffer(&u8g2);
+    display_present();
+}
+
+#define SKY_CENTER_X (SKY_PLOT_RADIUS + 1)
+#define SKY_CENTER_Y (32)
+
+// Polar plot with north up. Tracked satellites are discs growing with C/N0,
+// visible but untracked ones are rings.
+void skyPlotScreen()
+{
+    static const char *TAG = "skyPlotScreen";
+    char holder[24];
+    int dx, dy;
+    uint32_t start = xthal_get_ccount();
+
+    u8g2_ClearBuffer(&u8g2);
+    // Horizon, 30 and 60 degree elevation rings and the cardinal axes
+    u8g2_DrawCircle(&u8g2, SKY_CENTER_X, SKY_CENTER_Y, sky_plot_radius(0), U8G2_DRAW_ALL);
+    u8g2_DrawCircle(&u8g2, SKY_CENTER_X, SKY_CENTER_Y, sky_plot_radius(30), U8G2_DRAW_ALL);
+    u8g2_DrawCircle(&u8g2, SKY_CENTER_X, SKY_CENTER_Y, sky_plot_radius(60), U8G2_DRAW_ALL);
+    u8g2_DrawHLine(&u8g2, SKY_CENTER_X - SKY_PLOT_RADIUS, SKY_CENTER_Y, 2 * SKY_PLOT_RADIUS + 1);
+    u8g2_DrawVLine(&u8g2, SKY_CENTER_X, SKY_CENTER_Y - SKY_PLOT_RADIUS, 2 * SKY_PLOT_RADIUS + 1);
+    u8g2_SetFont(&u8g2, u8g2_font_5x7_tf);
+    u8g2_DrawStr(&u8g2, SKY_CENTER_X + 2, SKY_CENTER_Y - SKY_PLOT_RADIUS + 7, "N");
+
+    for (int i = 0; i < GPSDO_MAX_SATELLITES; i++)
+    {
+        const gps_satellite_t *sat = &gpsdo_state.satellites[i];
+        if ((sat->prn == 0) || (sat->e1 < 0) || (sat->az < 0))
+        {
+            continue;
+        }
+        sky_plot_position(sat->az, sat->e1, &dx, &dy);
+        if (sat->cn > 0)
+        {
+            // 1 pixel up to 30 dB-Hz, 3 pixels from 46 dB-Hz
+            u8g2_DrawDisc(&u8g2, SKY_CENTER_X + dx, SKY_CENTER_Y + dy, 1 + MIN(2, MAX(0, sat->cn - 30) / 8), U8G2_DRAW_ALL);
+        }
+        else
+        {
+            u8g2_DrawCircle(&u8g2, SKY_CENTER_X + dx, SKY_CENTER_Y + dy, 1, U8G2_DRAW_ALL);
+        }
+    }
+    DLOGD(TAG, "Sky plot drawn in %u cycles", xthal_get_ccount() - start);
+
+    // Drawing of right side
+    u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
+    u8g2_DrawStr(&u8g2, 70, 7, "SKY PLOT");
+    fmt(holder, sizeof(holder), "Trk: %d", gpsdo_state.satellite_trk);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_satellite_trk);
+    u8g2_DrawStr(&u8g2, 70, 23, holder);
+    fmt(holder, sizeof(holder), "Vis: %d", gpsdo_state.satellite_vis);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_satellite_vis);
+    u8g2_DrawStr(&u8g2, 70, 31, holder);
+    u8g2_DrawStr(&u8g2, 70, 47, "* tracked");
+    u8g2_DrawStr(&u8g2, 70, 55, "o visible");
+    display_present();
+}
+
+#define TREND_TOP (17)
+#define TREND_HEIGHT (64 - TREND_TOP)
+
+// Full width plot of a trend, one vertical line per min/max column scaled
+// to the range of everything on screen
+static void drawTrend(const char *title, const char *format, trend_t *trend)
+{
+    char holder[24];
+    char value[16];
+    trend_column_t column;
+    float low, high;
+
+    u8g2_ClearBuffer(&u8g2);
+    u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
+    xSemaphoreTake(trend_lock, portMAX_DELAY);
+    if (!trend_range(trend, &low, &high))
+    {
+        xSemaphoreGive(trend_lock);
+        fmt(holder, sizeof(holder), "%s: no data", title);
+        u8g2_DrawStr(&u8g2, 0, 7, holder);
+        display_present();
+        return;
+    }
+    fmt(value, sizeof(value), format, trend->last);
+    fmt(holder, sizeof(holder), "%s: %s", title, value);
+    u8g2_DrawStr(&u8g2, 0, 7, holder);
+    fmt(value, sizeof(value), format, high - low);
+    fmt(holder, sizeof(holder), "Span %s %dm", value, TREND_WIDTH * TREND_SECONDS_PER_COLUMN / 60);
+    u8g2_DrawStr(&u8g2, 0, 15, holder);
+
+    float scale = (high > low) ? (TREND_HEIGHT - 1) / (high - low) : 0;
+    int middle = (high > low) ? 0 : (TREND_HEIGHT - 1) / 2;
+    for (int x = 0; x < TREND_WIDTH; x++)
+    {
+        if (!trend_column(trend, x, &column))
+        {
+            continue;
+        }
+        int top = TREND_TOP + TREND_HEIGHT - 1 - middle - (int)((column.max - low) * scale);
+        int bottom = TREND_TOP + TREND_HEIGHT - 1 - middle - (int)((column.min - low) * scale);
+        u8g2_DrawVLine(&u8g2, x, top, bottom - top + 1);
+    }
+    xSemaphoreGive(trend_lock);
+    display_present();
+}
+
+void phaseTrendScreen()
+{
+    drawTrend("Phase", "%+.2E", &trend_phase);
+}
+
+void efcTrendScreen()
+{
+    drawTrend("EFC", "%+.4f%%", &trend_efc);
+}
+
+void temperatureTrendScreen()
+{
+    drawTrend("Temp", "%.3f", &trend_temperature);
+}
+
+// Surveyed position with the spread of the fixes and the error of the mean
+void surveyScreen()
+{
+    char holder[24];
+    position_survey_result_t survey;
+
+    xSemaphoreTake(survey_lock, portMAX_DELAY);
+    bool valid = position_survey_result(&position_survey, &survey);
+    xSemaphoreGive(survey_lock);
+
+    u8g2_ClearBuffer(&u8g2);
+    u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
+    if (!valid)
+    {
+        u8g2_DrawStr(&u8g2, 0, 7, "Survey: no fixes");
+        display_present();
+        return;
+    }
+    fmt(holder, sizeof(holder), "Survey %u fixes%s", survey.fixes, survey.converged_at ? " OK" : "");
+    u8g2_DrawStr(&u8g2, 0, 7, holder);
+    fmt(holder, sizeof(holder), "Lat: %+.8f", survey.position.latitude);
+    u8g2_DrawStr(&u8g2, 0, 15, holder);
+    fmt(holder, sizeof(holder), "Lon: %+.8f", survey.position.longitude);
+    u8g2_DrawStr(&u8g2, 0, 23, holder);
+    fmt(holder, sizeof(holder), "Alt: %+.3f m", survey.position.altitude);
+    u8g2_DrawStr(&u8g2, 0, 31, holder);
+    fmt(holder, sizeof(holder), "sd ENU %.2f %.2f %.2f", survey.sd[SURVEY_EAST], survey.sd[SURVEY_NORTH],
+        survey.sd[SURVEY_UP]);
+    u8g2_DrawStr(&u8g2, 0, 39, holder);
+    fmt(holder, sizeof(holder), "Horiz major %.2f m", survey.horizontal_major);
+    u8g2_DrawStr(&u8g2, 0, 47, holder);
+    fmt(holder, sizeof(holder), "Mean error %.3f m", survey.error);
+    u8g2_DrawStr(&u8g2, 0, 55, holder);
+    fmt(holder, sizeof(holder), "Last step %.1E m", survey.last_step);
+    u8g2_DrawStr(&u8g2, 0, 63, holder);
+    display_present();
+}
+
+// Mean, spread and drift of the sample store series over the last hour
+void windowStatsScreen()
+{
+    char holder[24];
+    window_moments_t moments[SAMPLE_SERIES_COUNT];
+
+    int found = compute_window_stats(moments);
+    u8g2_ClearBuffer(&u8g2);
+    u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
+    if (found < 2)
+    {
+        u8g2_DrawStr(&u8g2, 0, 7, "Stats: no samples");
+        display_present();
+        return;
+    }
+    fmt(holder, sizeof(holder), "Last %dm: %d samples", WINDOW_STATS_SECONDS / 60, found);
+    u8g2_DrawStr(&u8g2, 0, 7, holder);
+    // Phase on the left, EFC on the right, drifts per hour
+    const window_moments_t *phase = &moments[SAMPLE_SERIES_PHASE];
+    const window_moments_t *efc = &moments[SAMPLE_SERIES_DAC];
+    u8g2_DrawStr(&u8g2, 0, 15, "Phase");
+    u8g2_DrawStr(&u8g2, 66, 15, "EFC %");
+    fmt(holder, sizeof(holder), "%+.2E", phase->mean_x);
+    u8g2_DrawStr(&u8g2, 0, 23, holder);
+    fmt(holder, sizeof(holder), "%+.4f", efc->mean_x);
+    u8g2_DrawStr(&u8g2, 66, 23, holder);
+    fmt(holder, sizeof(holder), "sd %.1E", window_stats_stddev(phase));
+    u8g2_DrawStr(&u8g2, 0, 31, holder);
+    fmt(holder, sizeof(holder), "sd %.1E", window_stats_stddev(efc));
+    u8g2_DrawStr(&u8g2, 66, 31, holder);
+    fmt(holder, sizeof(holder), "pp %.1E", phase->max - phase->min);
+    u8g2_DrawStr(&u8g2, 0, 39, holder);
+    fmt(holder, sizeof(holder), "pp %.1E", efc->max - efc->min);
+    u8g2_DrawStr(&u8g2, 66, 39, holder);
+    fmt(holder, sizeof(holder), "/h%+.1E", window_stats_drift(phase) * 3600);
+    u8g2_DrawStr(&u8g2, 0, 47, holder);
+    fmt(holder, sizeof(holder), "/h%+.1E", window_stats_drift(efc) * 3600);
+    u8g2_DrawStr(&u8g2, 66, 47, holder);
+    const window_moments_t *temperature = &moments[SAMPLE_SERIES_TEMPERATURE];
+    fmt(holder, sizeof(holder), "Temp %.2f /h %+.3f", temperature->mean_x, window_stats_drift(temperature) * 3600);
+    u8g2_DrawStr(&u8g2, 0, 63, holder);
+    display_present();
+}
+
+// Heap totals and the tasks and call sites holding the most memory
+void heapScreen()
+{
+    char holder[24];
+    alloc_track_totals_t totals;
+    alloc_track_task_t tasks[2];
+    alloc_track_site_t sites[2];
+
+    alloc_track_get_totals(&totals);
+    int task_count = alloc_track_get_tasks(tasks, 2);
+    int site_count = alloc_track_get_sites(sites, 2);
+
+    u8g2_ClearBuffer(&u8g2);
+    u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
+    fmt(holder, sizeof(holder), "Heap: %u free", totals.heap_free);
+    u8g2_DrawStr(&u8g2, 0, 7, holder);
+    fmt(holder, sizeof(holder), "Block: %u %d%% frag", totals.heap_largest_block, alloc_track_fragmentation(&totals));
+    u8g2_DrawStr(&u8g2, 0, 15, holder);
+    fmt(holder, sizeof(holder), "Live: %u pk %u", totals.counters.live_bytes, totals.counters.peak_bytes);
+    u8g2_DrawStr(&u8g2, 0, 23, holder);
+    fmt(holder, sizeof(holder), "Alloc/free: %u/%u", totals.counters.allocs, totals.counters.frees);
+    u8g2_DrawStr(&u8g2, 0, 31, holder);
+    for (int i = 0; i < task_count; i++)
+    {
+        fmt(holder, sizeof(holder), "%-13.13s %7u", tasks[i].name, tasks[i].counters.live_bytes);
+        u8g2_DrawStr(&u8g2, 0, 39 + (i * 8), holder);
+    }
+    for (int i = 0; i < site_count; i++)
+    {
+        fmt(holder, sizeof(holder), "%-13p %7u", sites[i].caller, sites[i].counters.live_bytes);
+        u8g2_DrawStr(&u8g2, 0, 55 + (i * 8), holder);
+    }
+    display_present();
 }
 
 void statScreen()
 {
-    char *holder = calloc(24, sizeof(char));
+    char holder[24];
     u8g2_ClearBuffer(&u8g2);
     u8g2_SetFont(&u8g2, u8g2_font_6x12_tf);
     // Drawing of left side
-    u8g2_DrawStr(&u8g2, 0, 7, gpsdo_state.time);
+    drawClock(0, 7);
     u8g2_DrawStr(&u8g2, 0, 15, gpsdo_state.date);
-    sprintf(holder, "Week: %5d", gpsdo_state.week);
+    fmt(holder, sizeof(holder), "Week: %5d", gpsdo_state.week);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_week);
     u8g2_DrawStr(&u8g2, 0, 23, holder);
     u8g2_DrawStr(&u8g2, 0, 31, "Tow: 000000");
-    sprintf(holder, "UTF ofs: %3d", gpsdo_state.utc_offset);
+    fmt(holder, sizeof(holder), "UTF ofs: %3d", gpsdo_state.utc_offset);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_utc_offset);
     u8g2_DrawStr(&u8g2, 0, 39, holder);
-    sprintf(holder, "Alt: %+6.3f m", gpsdo_state.altitude);
+    fmt(holder, sizeof(holder), "Alt: %+6.3f m", gpsdo_state.altitude);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_altitude);
     u8g2_DrawStr(&u8g2, 0, 47, holder);
-    sprintf(holder, "Lat: %+2.7f", gpsdo_state.latitude);
+    fmt(holder, sizeof(holder), "Lat: %+2.7f", gpsdo_state.latitude);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_latitude);
     u8g2_DrawStr(&u8g2, 0, 55, holder);
-    sprintf(holder, "Lon: %+2.7f", gpsdo_state.longitude);
+    fmt(holder, sizeof(holder), "Lon: %+2.7f", gpsdo_state.longitude);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_longitude);
     u8g2_DrawStr(&u8g2, 0, 63, holder);
     // Drawing of right side
     u8g2_DrawStr(&u8g2, 81, 7, "GPS STAT");
-    sprintf(holder, "OUT:%.4s", gpsdo_state.status_output);
+    fmt(holder, sizeof(holder), "OUT:%.4s", gpsdo_state.status_output);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_status_output);
     u8g2_DrawStr(&u8g2, 81, 15, holder);
-    sprintf(holder, "GPS:%.4s", gpsdo_state.status_gps);
+    fmt(holder, sizeof(holder), "GPS:%.4s", gpsdo_state.status_gps);
+    mark_stale(holder, sizeof(holder), STATE_FIELD_status_gps);
     u8g2_DrawStr(&u8g2, 81, 23, holder);
-    sprintf(holder, "Pos:%.4s", gpsdo_state.status_pos);
+    fmt(holder, sizeof(holder), "Pos:%.4s", gpsdo_state.status_pos);
     u8g2_DrawStr(&u8g2, 81, 31, holder);
     u8g2_DrawStr(&u8g2, 81, 39, "Stable");
-    u8g2_SendBuffer(&u8g2);
+    display_present();
 }
@@ -1,19 +1,45 @@
 #ifndef MAIN_H_
 #define MAIN_H_
 
+#include <stdint.h>
+
 #define GPSDO_STATE_DATE_SIZE 12
 #define GPSDO_STATE_TIME_SIZE 13
 
+#define CMD_BUFFER_SIZE (3072)
+#define TOD_BUFFER_SIZE (256)
+#define TOD_PACKET_SIZE (44)
+// Both UCCM ports, 8N1
+#define UART_BAUD_RATE (57600)
+// Satellite slots in gpsdo_state_t, tracked ones first
+#define GPSDO_MAX_SATELLITES (24)
+
+// Build option: create tasks, queues and message buffers from static storage
+// instead of the heap. Requires CONFIG_FREERTOS_SUPPORT_STATIC_ALLOCATION.
+#ifndef GPSDO_STATIC_ALLOCATION
+#define GPSDO_STATIC_ALLOCATION 1
+#endif
+
 #define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
 
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
 
 void initialize_uccm();
 void statScreen();
+void surveyScreen();
 void monitorScreen();
 void uccmDataScreen();
 void satellitesScreen();
+void skyPlotScreen();
+void phaseTrendScreen();
+void efcTrendScreen();
+void temperatureTrendScreen();
+void windowStatsScreen();
+void heapScreen();
 void splashPage();
+void bootScreen(int step, int steps, const char *label);
+void drawClock(int x, int y);
 
 // Struct that holds the GPS satellite data
 typedef struct
@@ -33,29 +59,40 @@ typedef struct
     char serial_number[11];
     char version[11];
     float temperature;
+    float antenna_voltage;
+    float antenna_current;
     float dac;
+    float efc_data;
     float phase;
-    float pps;
+    float tint;
     float freq_diff;
     int tfom;
     int ffom;
+    char ffom_status[21];
+    int pullin_range;
     char status_output[11];
     char status_gps[11];
     char status_pos[11];
     char status_opr[11];
     char alarm_hw[11];
     char alarm_op[11];
+    // TOD packet bytes 33 to 36, decoded by alarm.h
+    uint8_t tod_status[4];
+    uint32_t gps_time;
     int week;
     int tow;
     int utc_offset;
     char date[GPSDO_STATE_DATE_SIZE];
     char time[GPSDO_STATE_TIME_SIZE];
-    float altitude;
-    float latitude;
-    float longitude;
+    // Last GPS:POS? fix, in double to keep the millimetres of the answer
+    double altitude;
+    double latitude;
+    double longitude;
+    // Complete GPS:POS? answers parsed
+    uint32_t position_fixes;
     int satellite_trk;
     int satellite_vis;
-    gps_satellite_t satellites[24];
+    gps_satellite_t satellites[GPSDO_MAX_SATELLITES];
 } gpsdo_state_t;
 
 #endif
\ No newline at end of file
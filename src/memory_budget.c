@@ -0,0 +1,42 @@
+#include <stdio.h>
+
+#include "esp_log.h"
+
+#include "memory_budget.h"
+
+_Static_assert(MEMORY_BUDGET_TOTAL <= MEMORY_BUDGET_LIMIT, "Static RAM budget exceeded, see memory_budget.h");
+
+typedef struct
+{
+    const char *subsystem;
+    size_t bytes;
+} memory_budget_entry_t;
+
+#define DESCRIBE_ENTRY(name, bytes) {#name, (bytes)},
+static const memory_budget_entry_t memory_budget[] = {MEMORY_BUDGET_ENTRIES(DESCRIBE_ENTRY)};
+
+// Absolute symbols memory_budget_<name> = bytes in the linked image, which
+// tools/memory_budget.cmake reads back to set the estimates and the limit
+// next to what it measures
+#define EMIT_SYMBOL(name, bytes) \
+    __asm__ volatile(".globl memory_budget_" #name "\n.set memory_budget_" #name ", %c0" : : "i"(bytes));
+
+void memory_budget_report()
+{
+    static const char *TAG = "memory_budget";
+
+    MEMORY_BUDGET_ENTRIES(EMIT_SYMBOL)
+    EMIT_SYMBOL(total, MEMORY_BUDGET_TOTAL)
+    EMIT_SYMBOL(limit, MEMORY_BUDGET_LIMIT)
+
+    for (int i = 0; i < sizeof(memory_budget) / sizeof(memory_budget[0]); i++)
+    {
+        ESP_LOGI(TAG, "%-14s %6d bytes", memory_budget[i].subsystem, memory_budget[i].bytes);
+    }
+    ESP_LOGI(TAG, "%-14s %6d / %d bytes", "total", MEMORY_BUDGET_TOTAL, MEMORY_BUDGET_LIMIT);
+#if GPSDO_STATIC_ALLOCATION
+    ESP_LOGI(TAG, "Static allocation enabled");
+#else
+    ESP_LOGI(TAG, "Static allocation disabled, budget is allocated from the heap");
+#endif
+}
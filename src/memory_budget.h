@@ -0,0 +1,125 @@
+#ifndef MEMORY_BUDGET_H_
+#define MEMORY_BUDGET_H_
+
+#include "freertos/FreeRTOS.h"
+
+#include "main.h"
+#include "history_log.h"
+#include "spsc_ring.h"
+#include "clock_sync.h"
+#include "dlog.h"
+#include "trend.h"
+#include "alarm.h"
+#include "sample_store.h"
+#include "run_stats.h"
+#include "alloc_track.h"
+#include "scpi_bridge.h"
+#include "display_mirror.h"
+#include "state_snapshot.h"
+#include "metrics.h"
+#include "metrics_http.h"
+#include "ntp_server.h"
+#include "window_stats.h"
+#include "position_survey.h"
+
+// Sizing of every long-lived buffer and task stack. The estimates below are
+// checked against MEMORY_BUDGET_LIMIT at compile time (see memory_budget.c)
+// and printed at boot by memory_budget_report(). After every build
+// tools/memory_budget.cmake measures the statics of the linked image per
+// subsystem, prints them next to these estimates and fails the build when
+// their total exceeds the limit.
+
+// Rings between the receive and parsing tasks, sizes must be powers of two.
+// The policy decides which frame goes when a ring is full.
+#define CMD_RING_SIZE (8192)
+#define TOD_RING_SIZE (512)
+#define CMD_RING_POLICY SPSC_DROP_OLDEST
+#define TOD_RING_POLICY SPSC_DROP_OLDEST
+
+// Blocks of the compressed sample stores, SAMPLE_STORE_BLOCK_SIZE bytes each.
+// The 1 Hz store must hold the WINDOW_STATS_SECONDS the window statistics
+// read, the week store the SAMPLE_STORE_WEEK_DECIMATION s means of 7 days,
+// as tools/sample_store_bench.c checks for the smallest build. The metrics
+// documents and their responder take the room of 12 of the 1 Hz blocks, the
+// NTP server that of 3.
+#define SAMPLE_STORE_BLOCKS (41 - (12 * GPSDO_METRICS) - (3 * GPSDO_NTP))
+#define SAMPLE_STORE_WEEK_BLOCKS (19)
+#define SAMPLE_STORE_WEEK_DECIMATION (300)
+
+// Task stack sizes, in bytes
+#define STACK_PARSE_TOD (2048)
+#define STACK_PARSE_CMD (3072)
+#define STACK_UPDATE_DISPLAY (2048)
+#define STACK_UART_RECEIVE_TOD (2048)
+#define STACK_UART_RECEIVE_CMD (2048)
+#define STACK_SEND_CMD (2048)
+#define STACK_HISTORY (3072)
+#define STACK_DLOG (3072)
+#define STACK_DISPLAY_FLUSH (2048)
+#define STACK_SCPI_BRIDGE (2048)
+#define STACK_METRICS (3072)
+#define STACK_NTP (2048)
+#define TASK_COUNT (10 + GPSDO_METRICS + GPSDO_NTP)
+
+// ST7920 128x64 full frame buffer, one held by u8g2 and the one it swaps with
+#define DISPLAY_BUFFER_SIZE (128 * 64 / 8)
+
+#define MEMORY_BUDGET_CMD_PIPELINE ((2 * CMD_BUFFER_SIZE) + CMD_RING_SIZE + sizeof(spsc_ring_t))
+#define MEMORY_BUDGET_TOD_PIPELINE ((2 * TOD_BUFFER_SIZE) + TOD_RING_SIZE + sizeof(spsc_ring_t))
+#define MEMORY_BUDGET_TASKS (STACK_PARSE_TOD + STACK_PARSE_CMD + STACK_UPDATE_DISPLAY +   \
+                             STACK_UART_RECEIVE_TOD + STACK_UART_RECEIVE_CMD + STACK_SEND_CMD + \
+                             STACK_HISTORY + STACK_DLOG + STACK_DISPLAY_FLUSH +                \
+                             STACK_SCPI_BRIDGE + (GPSDO_METRICS * STACK_METRICS) +             \
+                             (GPSDO_NTP * STACK_NTP) + (TASK_COUNT * sizeof(StaticTask_t)))
+// Two frame buffers, plus the captured and streamed copies of the mirror
+#define MEMORY_BUDGET_DISPLAY ((2 + (2 * GPSDO_DISPLAY_MIRROR)) * DISPLAY_BUFFER_SIZE)
+#define MEMORY_BUDGET_STATE (sizeof(gpsdo_state_t) + sizeof(clock_sync_t) + sizeof(state_snapshot_t))
+#define MEMORY_BUDGET_HISTORY (sizeof(history_log_t) + sizeof(history_storage_t))
+#define MEMORY_BUDGET_LOG (DLOG_RING_RECORDS * sizeof(dlog_record_t))
+#define MEMORY_BUDGET_TRENDS (3 * sizeof(trend_t))
+#define MEMORY_BUDGET_ALARMS (sizeof(alarm_engine_t))
+#define MEMORY_BUDGET_SAMPLES (((SAMPLE_STORE_BLOCKS + SAMPLE_STORE_WEEK_BLOCKS) * sizeof(sample_block_t)) + \
+                               (2 * sizeof(sample_store_t)))
+#define MEMORY_BUDGET_RUN_STATS (RUN_STATS_MAX_TASKS * sizeof(TaskStatus_t))
+// Live table (pointer, size, site and task per block) and the counters, twice
+// for the tables plus the copies alloc_track_dump() sorts
+#define MEMORY_BUDGET_ALLOC_TRACK ((ALLOC_TRACK_LIVE_SLOTS * (sizeof(void *) + 8)) +     \
+                                   (2 * ALLOC_TRACK_SITES * sizeof(alloc_track_site_t)) + \
+                                   (2 * ALLOC_TRACK_TASKS * sizeof(alloc_track_task_t)))
+#define MEMORY_BUDGET_SCPI_BRIDGE (sizeof(scpi_bridge_t))
+#define MEMORY_BUDGET_METRICS (GPSDO_METRICS * (sizeof(metrics_t) + METRICS_HTTP_BUFFER_SIZE + METRICS_HTTP_REQUEST_SIZE))
+#define MEMORY_BUDGET_NTP (GPSDO_NTP * sizeof(ntp_server_t))
+#define MEMORY_BUDGET_WINDOW_STATS (sizeof(window_stats_t))
+#define MEMORY_BUDGET_SURVEY (sizeof(position_survey_t))
+
+// Every term of the budget, reported under its name:
+//   ENTRY(name, bytes)
+#define MEMORY_BUDGET_ENTRIES(ENTRY)                   \
+    ENTRY(cmd_pipeline, MEMORY_BUDGET_CMD_PIPELINE)    \
+    ENTRY(tod_pipeline, MEMORY_BUDGET_TOD_PIPELINE)    \
+    ENTRY(tasks, MEMORY_BUDGET_TASKS)                  \
+    ENTRY(display, MEMORY_BUDGET_DISPLAY)              \
+    ENTRY(state, MEMORY_BUDGET_STATE)                  \
+    ENTRY(history, MEMORY_BUDGET_HISTORY)              \
+    ENTRY(log, MEMORY_BUDGET_LOG)                      \
+    ENTRY(trends, MEMORY_BUDGET_TRENDS)                \
+    ENTRY(alarms, MEMORY_BUDGET_ALARMS)                \
+    ENTRY(samples, MEMORY_BUDGET_SAMPLES)              \
+    ENTRY(run_stats, MEMORY_BUDGET_RUN_STATS)          \
+    ENTRY(alloc_track, MEMORY_BUDGET_ALLOC_TRACK)      \
+    ENTRY(scpi_bridge, MEMORY_BUDGET_SCPI_BRIDGE)      \
+    ENTRY(metrics, MEMORY_BUDGET_METRICS)              \
+    ENTRY(ntp, MEMORY_BUDGET_NTP)                      \
+    ENTRY(window_stats, MEMORY_BUDGET_WINDOW_STATS)    \
+    ENTRY(survey, MEMORY_BUDGET_SURVEY)
+
+#define MEMORY_BUDGET_SUM(name, bytes) +(bytes)
+#define MEMORY_BUDGET_TOTAL (0 MEMORY_BUDGET_ENTRIES(MEMORY_BUDGET_SUM))
+
+// Static RAM the application may claim for itself, of the roughly 160 KB the
+// ESP32 leaves for static data once the IDF has taken its share
+#define MEMORY_BUDGET_LIMIT (136 * 1024)
+
+void memory_budget_report();
+
+#endif
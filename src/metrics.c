@@ -0,0 +1,281 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "metrics.h"
+
+#ifdef ESP_PLATFORM
+#define METRICS_LOCK(metrics) xSemaphoreTake((metrics)->lock, portMAX_DELAY)
+#define METRICS_UNLOCK(metrics) xSemaphoreGive((metrics)->lock)
+#else
+#define METRICS_LOCK(metrics) pthread_mutex_lock(&(metrics)->lock)
+#define METRICS_UNLOCK(metrics) pthread_mutex_unlock(&(metrics)->lock)
+#endif
+
+_Static_assert(METRICS_COUNT <= 64, "the dirty bitmap is 64 bits wide");
+_Static_assert(METRICS_PROMETHEUS_SIZE <= UINT16_MAX && METRICS_JSON_SIZE <= UINT16_MAX,
+               "document offsets are 16 bits wide");
+
+typedef struct
+{
+    const char *family;
+    // Label value, NULL for a family of one
+    const char *label;
+    const char *label_name;
+    bool integer;
+    bool counter;
+} metrics_desc_t;
+
+#define DESCRIBE_FLOAT(name, field) {#name, NULL, NULL, false, false},
+#define DESCRIBE_INT(name, field) {#name, NULL, NULL, true, false},
+#define DESCRIBE_TREND_LOW(series) {"trend_low", #series, "series", false, false},
+#define DESCRIBE_TREND_HIGH(series) {"trend_high", #series, "series", false, false},
+#define DESCRIBE_ALARM(name, field, direction, set, clear) {"alarm_active", #name, "rule", true, false},
+
+static const metrics_desc_t metrics_descs[METRICS_COUNT] = {
+    METRICS_STATE(DESCRIBE_FLOAT, DESCRIBE_INT)
+    METRICS_TRENDS(DESCRIBE_TREND_LOW)
+    METRICS_TRENDS(DESCRIBE_TREND_HIGH)
+    ALARM_RULES(DESCRIBE_ALARM)
+    {"alarm_events_total", NULL, NULL, true, true},
+};
+
+// Appends to the skeleton, false when it does not fit
+static bool append(metrics_document_t *document, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(&document->text[document->length], document->size - document->length, format, args);
+    va_end(args);
+    if ((length < 0) || (length >= document->size - document->length))
+    {
+        return false;
+    }
+    document->length += length;
+    return true;
+}
+
+static bool new_family(int id)
+{
+    return (id == 0) || (strcmp(metrics_descs[id].family, metrics_descs[id - 1].family) != 0);
+}
+
+// One "# TYPE" line per family, then a sample line per value
+static bool build_prometheus(metrics_document_t *document)
+{
+    for (int id = 0; id < METRICS_COUNT; id++)
+    {
+        const metrics_desc_t *desc = &metrics_descs[id];
+
+        if (new_family(id) &&
+            !append(document, "# TYPE gpsdo_%s %s\n", desc->family, desc->counter ? "counter" : "gauge"))
+        {
+            return false;
+        }
+        if (!append(document, "gpsdo_%s", desc->family) ||
+            ((desc->label != NULL) && !append(document, "{%s=\"%s\"}", desc->label_name, desc->label)) ||
+            !append(document, " "))
+        {
+            return false;
+        }
+        document->value_offset[id] = document->length;
+        if (!append(document, "\n"))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// One object, a labelled family is a nested object keyed by label
+static bool build_json(metrics_document_t *document)
+{
+    if (!append(document, "{"))
+    {
+        return false;
+    }
+    for (int id = 0; id < METRICS_COUNT; id++)
+    {
+        const metrics_desc_t *desc = &metrics_descs[id];
+
+        if (new_family(id))
+        {
+            if ((id > 0) && (metrics_descs[id - 1].label != NULL) && !append(document, "}"))
+            {
+                return false;
+            }
+            if (((id > 0) && !append(document, ",")) ||
+                ((desc->label != NULL) && !append(document, "\"%s\":{", desc->family)))
+            {
+                return false;
+            }
+        }
+        else if (!append(document, ","))
+        {
+            return false;
+        }
+        if (!append(document, "\"%s\":", (desc->label != NULL) ? desc->label : desc->family))
+        {
+            return false;
+        }
+        document->value_offset[id] = document->length;
+    }
+    return ((metrics_descs[METRICS_COUNT - 1].label == NULL) || append(document, "}")) && append(document, "}\n");
+}
+
+static int format_value(metrics_format_t format, int id, double value, char *text)
+{
+    if (isnan(value))
+    {
+        return sprintf(text, "%s", (format == METRICS_PROMETHEUS) ? "NaN" : "null");
+    }
+    if (isinf(value))
+    {
+        return sprintf(text, "%s", (format == METRICS_PROMETHEUS) ? ((value > 0) ? "+Inf" : "-Inf") : "null");
+    }
+    if (metrics_descs[id].integer)
+    {
+        return snprintf(text, METRICS_VALUE_SIZE, "%lld", (long long)value);
+    }
+    return snprintf(text, METRICS_VALUE_SIZE, "%.7g", value);
+}
+
+// Replaces a value, moving the rest of the document when its length changed
+static void splice(metrics_document_t *document, int id, const char *value, int length)
+{
+    int offset = document->value_offset[id];
+    int old_length = document->value_length[id];
+    int shift = length - old_length;
+
+    if (shift != 0)
+    {
+        memmove(&document->text[offset + length], &document->text[offset + old_length],
+                document->length - offset - old_length);
+        document->length += shift;
+        for (int i = id + 1; i < METRICS_COUNT; i++)
+        {
+            document->value_offset[i] += shift;
+        }
+    }
+    memcpy(&document->text[offset], value, length);
+    document->value_length[id] = length;
+}
+
+static void render(metrics_t *metrics, int id)
+{
+    char text[METRICS_VALUE_SIZE];
+
+    for (int format = 0; format < METRICS_FORMAT_COUNT; format++)
+    {
+        int length = format_value(format, id, metrics->values[id], text);
+        splice(&metrics->documents[format], id, text, MIN(length, METRICS_VALUE_SIZE - 1));
+    }
+}
+
+// Renders both skeletons with every value unknown. Returns -1 when a
+// document could overflow once its values are filled in.
+int metrics_init(metrics_t *metrics)
+{
+    metrics->documents[METRICS_PROMETHEUS] = (metrics_document_t){.text = metrics->prometheus,
+                                                                  .size = sizeof(metrics->prometheus)};
+    metrics->documents[METRICS_JSON] = (metrics_document_t){.text = metrics->json, .size = sizeof(metrics->json)};
+    if (!build_prometheus(&metrics->documents[METRICS_PROMETHEUS]) || !build_json(&metrics->documents[METRICS_JSON]))
+    {
+        return -1;
+    }
+    for (int format = 0; format < METRICS_FORMAT_COUNT; format++)
+    {
+        const metrics_document_t *document = &metrics->documents[format];
+        if (document->length + (METRICS_COUNT * (METRICS_VALUE_SIZE - 1)) > document->size)
+        {
+            return -1;
+        }
+    }
+
+    for (int id = 0; id < METRICS_COUNT; id++)
+    {
+        metrics->values[id] = NAN;
+        render(metrics, id);
+    }
+    atomic_init(&metrics->stats.updates, 0);
+    atomic_init(&metrics->stats.rendered, 0);
+#ifdef ESP_PLATFORM
+    metrics->lock = xSemaphoreCreateMutexStatic(&metrics->lock_buffer);
+#else
+    pthread_mutex_init(&metrics->lock, NULL);
+#endif
+    return 0;
+}
+
+// Samples the sources and re-renders the values that changed, returns how many
+int metrics_update(metrics_t *metrics, const gpsdo_state_t *state, const metrics_trend_t trends[METRICS_TREND_COUNT],
+                   const alarm_engine_t *alarms)
+{
+    double values[METRICS_COUNT];
+    uint64_t dirty = 0;
+    int rendered = 0;
+
+#define SAMPLE_STATE(name, field) values[METRICS_##name] = state->field;
+#define SAMPLE_TREND(series)                                                                \
+    values[METRICS_trend_low_##series] = trends[METRICS_TREND_##series].valid ? trends[METRICS_TREND_##series].low : NAN; \
+    values[METRICS_trend_high_##series] = trends[METRICS_TREND_##series].valid ? trends[METRICS_TREND_##series].high : NAN;
+#define SAMPLE_ALARM(name, field, direction, set, clear) \
+    values[METRICS_alarm_##name] = (alarms->active >> ALARM_RULE_##name) & 1;
+
+    METRICS_STATE(SAMPLE_STATE, SAMPLE_STATE)
+    METRICS_TRENDS(SAMPLE_TREND)
+    ALARM_RULES(SAMPLE_ALARM)
+    values[METRICS_alarm_events_total] = alarms->events;
+
+    // Bitwise, so an unknown value stays rendered as it is
+    for (int id = 0; id < METRICS_COUNT; id++)
+    {
+        if (memcmp(&values[id], &metrics->values[id], sizeof(double)) != 0)
+        {
+            dirty |= 1ull << id;
+        }
+    }
+    if (dirty == 0)
+    {
+        atomic_fetch_add(&metrics->stats.updates, 1);
+        return 0;
+    }
+
+    METRICS_LOCK(metrics);
+    for (int id = 0; id < METRICS_COUNT; id++)
+    {
+        if (dirty & (1ull << id))
+        {
+            metrics->values[id] = values[id];
+            render(metrics, id);
+            rendered++;
+        }
+    }
+    METRICS_UNLOCK(metrics);
+
+    atomic_fetch_add(&metrics->stats.updates, 1);
+    atomic_fetch_add(&metrics->stats.rendered, rendered);
+    return rendered;
+}
+
+// Copies the current document, returns its length or 0 when it does not fit
+size_t metrics_copy(metrics_t *metrics, metrics_format_t format, char *dst, size_t size)
+{
+    const metrics_document_t *document = &metrics->documents[format];
+    size_t length;
+
+    METRICS_LOCK(metrics);
+    length = document->length;
+    if (length <= size)
+    {
+        memcpy(dst, document->text, length);
+    }
+    else
+    {
+        length = 0;
+    }
+    METRICS_UNLOCK(metrics);
+    return length;
+}
@@ -0,0 +1,143 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#else
+#include <pthread.h>
+#endif
+
+#include "main.h"
+#include "alarm.h"
+
+// gpsdo_state_t, the trend envelopes and the alarms in the Prometheus text
+// format and as JSON, for scraping. Both documents are rendered once at
+// init with a hole for every value, and metrics_update() only reformats the
+// values that changed since the last update, splicing them into place. A
+// scrape is then a copy of the current document, see metrics_copy().
+
+// Build option: render the metrics and serve them over HTTP on WiFi, see
+// metrics_http.h and wifi_station.h. Off unless set, it needs WiFi
+// credentials and takes RAM from the sample store.
+#ifndef GPSDO_METRICS
+#define GPSDO_METRICS 0
+#endif
+
+#define METRICS_PROMETHEUS_SIZE (3072)
+#define METRICS_JSON_SIZE (1536)
+// Longest formatted value, "%.7g" of a float or an int, terminator included
+#define METRICS_VALUE_SIZE (16)
+
+// Exported fields of gpsdo_state_t, name without the gpsdo_ prefix:
+//   FLOAT(name, field)
+//   INT(name, field)
+#define METRICS_STATE(FLOAT, INT)                     \
+    FLOAT(temperature_celsius, temperature)           \
+    FLOAT(antenna_voltage_volts, antenna_voltage)     \
+    FLOAT(antenna_current, antenna_current)           \
+    FLOAT(efc_percent, dac)                           \
+    FLOAT(efc_data, efc_data)                         \
+    FLOAT(phase, phase)                               \
+    FLOAT(pps_offset_seconds, tint)                   \
+    FLOAT(freq_diff, freq_diff)                       \
+    INT(tfom, tfom)                                   \
+    INT(ffom, ffom)                                   \
+    INT(pullin_range, pullin_range)                   \
+    INT(satellites_tracked, satellite_trk)            \
+    INT(satellites_visible, satellite_vis)            \
+    INT(gps_week, week)                               \
+    INT(gps_time_seconds, gps_time)                   \
+    INT(utc_offset_seconds, utc_offset)               \
+    FLOAT(altitude_meters, altitude)                  \
+    FLOAT(latitude_degrees, latitude)                 \
+    FLOAT(longitude_degrees, longitude)
+
+// Trend envelopes exported as trend_low and trend_high, labelled by series
+#define METRICS_TRENDS(SERIES) \
+    SERIES(phase)              \
+    SERIES(efc)                \
+    SERIES(temperature)
+
+#define METRICS_STATE_ID(name, field) METRICS_##name,
+#define METRICS_TREND_LOW_ID(series) METRICS_trend_low_##series,
+#define METRICS_TREND_HIGH_ID(series) METRICS_trend_high_##series,
+#define METRICS_ALARM_ID(name, field, direction, set, clear) METRICS_alarm_##name,
+#define METRICS_TREND_ID(series) METRICS_TREND_##series,
+
+// Every value in document order, a family is always contiguous
+typedef enum
+{
+    METRICS_STATE(METRICS_STATE_ID, METRICS_STATE_ID)
+    METRICS_TRENDS(METRICS_TREND_LOW_ID)
+    METRICS_TRENDS(METRICS_TREND_HIGH_ID)
+    ALARM_RULES(METRICS_ALARM_ID)
+    METRICS_alarm_events_total,
+    METRICS_COUNT
+} metrics_id_t;
+
+typedef enum
+{
+    METRICS_TRENDS(METRICS_TREND_ID)
+        METRICS_TREND_COUNT
+} metrics_trend_id_t;
+
+typedef enum
+{
+    METRICS_PROMETHEUS,
+    METRICS_JSON,
+    METRICS_FORMAT_COUNT
+} metrics_format_t;
+
+// Envelope of one trend window, as returned by trend_range()
+typedef struct
+{
+    bool valid;
+    float low;
+    float high;
+} metrics_trend_t;
+
+// A rendered document and where its values sit in it
+typedef struct
+{
+    char *text;
+    uint16_t size;
+    uint16_t length;
+    uint16_t value_offset[METRICS_COUNT];
+    uint8_t value_length[METRICS_COUNT];
+} metrics_document_t;
+
+typedef struct
+{
+    atomic_uint updates;
+    // Values reformatted, the rest of the documents is left alone
+    atomic_uint rendered;
+} metrics_stats_t;
+
+typedef struct
+{
+    char prometheus[METRICS_PROMETHEUS_SIZE];
+    char json[METRICS_JSON_SIZE];
+    metrics_document_t documents[METRICS_FORMAT_COUNT];
+    // Values as last rendered
+    double values[METRICS_COUNT];
+    metrics_stats_t stats;
+#ifdef ESP_PLATFORM
+    SemaphoreHandle_t lock;
+    StaticSemaphore_t lock_buffer;
+#else
+    pthread_mutex_t lock;
+#endif
+} metrics_t;
+
+int metrics_init(metrics_t *metrics);
+int metrics_update(metrics_t *metrics, const gpsdo_state_t *state, const metrics_trend_t trends[METRICS_TREND_COUNT],
+                   const alarm_engine_t *alarms);
+size_t metrics_copy(metrics_t *metrics, metrics_format_t format, char *dst, size_t size);
+
+#endif
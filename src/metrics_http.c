@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "metrics_http.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL (0)
+#endif
+
+#define METRICS_HTTP_BACKLOG (4)
+
+metrics_http_stats_t metrics_http_stats;
+
+// Only ever touched by the serving task
+static char request[METRICS_HTTP_REQUEST_SIZE];
+static char response[METRICS_HTTP_BUFFER_SIZE];
+
+static int64_t now_us()
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+#endif
+}
+
+static bool send_all(int client, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        int sent = send(client, data, length, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+// Reads up to the blank line ending the headers, so closing the connection
+// does not reset it under the response. Returns false on timeout, a closed
+// connection or headers too long.
+static bool receive_request(int client)
+{
+    size_t length = 0;
+
+    while (length < sizeof(request) - 1)
+    {
+        int received = recv(client, &request[length], sizeof(request) - 1 - length, 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        length += received;
+        request[length] = '\0';
+        if ((strstr(request, "\r\n\r\n") != NULL) || (strstr(request, "\n\n") != NULL))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writes the header right in front of the body at body, returns its start
+static char *prepend_header(char *body, const char *status, const char *content_type, size_t length)
+{
+    char header[METRICS_HTTP_HEADER_SIZE];
+
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+                                 status, content_type, (unsigned int)length);
+    header_length = MIN(header_length, (int)sizeof(header) - 1);
+    memcpy(body - header_length, header, header_length);
+    return body - header_length;
+}
+
+static bool respond_error(int client, const char *status)
+{
+    char *body = &response[METRICS_HTTP_HEADER_SIZE];
+    size_t length = sprintf(body, "%s\n", status);
+    char *start = prepend_header(body, status, "text/plain", length);
+
+    send_all(client, start, (body + length) - start);
+    return false;
+}
+
+// Returns false when the request got an error status
+static bool serve(metrics_t *metrics, int client)
+{
+    static const char *content_types[METRICS_FORMAT_COUNT] = {
+        [METRICS_PROMETHEUS] = "text/plain; version=0.0.4; charset=utf-8",
+        [METRICS_JSON] = "application/json",
+    };
+    char *body = &response[METRICS_HTTP_HEADER_SIZE];
+    metrics_format_t format;
+
+    if (!receive_request(client))
+    {
+        return respond_error(client, "400 Bad Request");
+    }
+    bool head = (strncmp(request, "HEAD ", 5) == 0);
+    if (!head && (strncmp(request, "GET ", 4) != 0))
+    {
+        return respond_error(client, "405 Method Not Allowed");
+    }
+    char *path = strchr(request, ' ') + 1;
+    size_t path_length = strcspn(path, " ?\r\n");
+    if ((path_length == 8) && (strncmp(path, "/metrics", 8) == 0))
+    {
+        format = METRICS_PROMETHEUS;
+    }
+    else if ((path_length == 13) && (strncmp(path, "/metrics.json", 13) == 0))
+    {
+        format = METRICS_JSON;
+    }
+    else
+    {
+        return respond_error(client, "404 Not Found");
+    }
+
+    size_t length = metrics_copy(metrics, format, body, sizeof(response) - METRICS_HTTP_HEADER_SIZE);
+    char *start = prepend_header(body, "200 OK", content_types[format], length);
+    send_all(client, start, (head ? body : body + length) - start);
+    return true;
+}
+
+// Serves the metrics on port forever, returns -1 when it cannot listen
+int metrics_http_serve(metrics_t *metrics, uint16_t port)
+{
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct timeval timeout = {
+        .tv_sec = METRICS_HTTP_TIMEOUT_MS / 1000,
+        .tv_usec = (METRICS_HTTP_TIMEOUT_MS % 1000) * 1000,
+    };
+    int reuse = 1;
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        return -1;
+    }
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if ((bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+        (listen(listener, METRICS_HTTP_BACKLOG) != 0))
+    {
+        close(listener);
+        return -1;
+    }
+
+    for (;;)
+    {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0)
+        {
+            atomic_fetch_add(&metrics_http_stats.errors, 1);
+            continue;
+        }
+        int64_t start_us = now_us();
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (!serve(metrics, client))
+        {
+            atomic_fetch_add(&metrics_http_stats.errors, 1);
+        }
+        close(client);
+
+        uint32_t serve_us = now_us() - start_us;
+        atomic_fetch_add(&metrics_http_stats.requests, 1);
+        atomic_fetch_add(&metrics_http_stats.serve_us_total, serve_us);
+        if (serve_us > atomic_load(&metrics_http_stats.serve_us_max))
+        {
+            atomic_store(&metrics_http_stats.serve_us_max, serve_us);
+        }
+    }
+    return -1;
+}
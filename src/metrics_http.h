@@ -0,0 +1,39 @@
+#ifndef METRICS_HTTP_H_
+#define METRICS_HTTP_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "metrics.h"
+
+// Minimal HTTP/1.0 responder for the metrics, one connection at a time and
+// closed after the response:
+//
+//     GET /metrics        Prometheus text format
+//     GET /metrics.json   JSON
+//
+// Builds against lwIP on the ESP32 and against BSD sockets on Linux, where
+// tools/metrics_bench.c serves it on localhost for load tests.
+
+#define METRICS_HTTP_PORT (9100)
+#define METRICS_HTTP_REQUEST_SIZE (512)
+#define METRICS_HTTP_HEADER_SIZE (128)
+// Response as sent, the header right in front of the copied document
+#define METRICS_HTTP_BUFFER_SIZE (METRICS_HTTP_HEADER_SIZE + METRICS_PROMETHEUS_SIZE)
+#define METRICS_HTTP_TIMEOUT_MS (2000)
+
+typedef struct
+{
+    atomic_uint requests;
+    // Malformed requests, unknown paths and connections that failed
+    atomic_uint errors;
+    // From accept to the response handed to the stack
+    atomic_uint serve_us_total;
+    atomic_uint serve_us_max;
+} metrics_http_stats_t;
+
+extern metrics_http_stats_t metrics_http_stats;
+
+int metrics_http_serve(metrics_t *metrics, uint16_t port);
+
+#endif
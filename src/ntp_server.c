@@ -0,0 +1,195 @@
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "ntp_server.h"
+#include "alarm.h"
+
+#define NTP_MODE_CLIENT (3)
+#define NTP_MODE_SERVER (4)
+#define NTP_LEAP_INSERT (1)
+#define NTP_LEAP_UNSYNCHRONIZED (3)
+#define NTP_STRATUM_UNSYNCHRONIZED (16)
+// Requests may carry extension fields and a MAC, they are read and ignored
+#define NTP_REQUEST_SIZE (128)
+
+// TOD status flags as alarm.h describes them, (byte << 8) | mask
+#define TOD_FLAG(id, byte, mask) NTP_TOD_##id = ((byte) << 8) | (mask),
+#define TOD_OTHER(...)
+enum
+{
+    ALARM_FIELDS(TOD_OTHER, TOD_OTHER, TOD_FLAG, TOD_OTHER)
+};
+
+// Time error per TFOM, read as the decade of the error in nanoseconds
+static const uint32_t tfom_error_us[] = {0, 0, 0, 1, 10, 100, 1000, 10000, 100000, 1000000};
+
+static int64_t now_us()
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+#endif
+}
+
+static bool tod_flag(const gpsdo_state_t *state, int flag)
+{
+    return (state->tod_status[flag >> 8] & (flag & 0xff)) != 0;
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+// NTP timestamp of a GPS time
+static void put_timestamp(uint8_t *p, uint32_t second, uint32_t fraction, int32_t utc_offset)
+{
+    put32(p, second - utc_offset + NTP_GPS_EPOCH);
+    put32(p + 4, fraction);
+}
+
+void ntp_server_init(ntp_server_t *server, clock_sync_t *clock)
+{
+    server->clock = clock;
+    atomic_init(&server->sequence, 0);
+    memset(server->template, 0, sizeof(server->template));
+    server->template[0] = (NTP_LEAP_UNSYNCHRONIZED << 6) | (4 << 3) | NTP_MODE_SERVER;
+    server->template[1] = NTP_STRATUM_UNSYNCHRONIZED;
+    server->template[3] = (uint8_t)NTP_SERVER_PRECISION;
+    server->utc_offset = 0;
+    memset(&server->stats, 0, sizeof(server->stats));
+}
+
+// Rebuilds the template from the state after the TOD packet for second.
+// error_us bounds how far the local clock strays from the TOD boundaries.
+void ntp_server_update(ntp_server_t *server, const gpsdo_state_t *state, uint32_t second, uint32_t error_us)
+{
+    uint8_t template[NTP_PACKET_SIZE] = {0};
+    int tfom = MIN(MAX(state->tfom, 0), (int)(sizeof(tfom_error_us) / sizeof(tfom_error_us[0])) - 1);
+    bool synchronized = (state->utc_offset != 0) && (state->tfom <= NTP_SERVER_MAX_TFOM) &&
+                        !tod_flag(state, NTP_TOD_PPS_INVALID) && !tod_flag(state, NTP_TOD_NOT_LOCKED) &&
+                        !tod_flag(state, NTP_TOD_DATE_INVALID);
+    int leap = !synchronized                               ? NTP_LEAP_UNSYNCHRONIZED
+               : tod_flag(state, NTP_TOD_LEAP_PENDING) ? NTP_LEAP_INSERT
+                                                          : 0;
+    // Root dispersion in NTP short format, seconds in 16.16
+    uint64_t dispersion_us = tfom_error_us[tfom] + error_us;
+
+    template[0] = (leap << 6) | (4 << 3) | NTP_MODE_SERVER;
+    template[1] = synchronized ? 1 : NTP_STRATUM_UNSYNCHRONIZED;
+    template[3] = (uint8_t)NTP_SERVER_PRECISION;
+    put32(&template[8], MIN((dispersion_us << 16) / 1000000, UINT32_MAX));
+    memcpy(&template[12], synchronized ? "GPS" : "INIT", 4);
+    put_timestamp(&template[16], second, 0, state->utc_offset);
+
+    atomic_fetch_add(&server->sequence, 1);
+    atomic_thread_fence(memory_order_release);
+    memcpy(server->template, template, sizeof(template));
+    server->utc_offset = state->utc_offset;
+    atomic_thread_fence(memory_order_release);
+    atomic_fetch_add(&server->sequence, 1);
+}
+
+// Builds the reply to a request received at receive_us. Returns its length,
+// 0 when the request is dropped.
+int ntp_server_respond(ntp_server_t *server, const uint8_t *request, size_t length, int64_t receive_us,
+                       uint8_t *response)
+{
+    unsigned int before, after;
+    int32_t utc_offset;
+    uint32_t second, fraction;
+
+    atomic_fetch_add(&server->stats.requests, 1);
+    int version = (request[0] >> 3) & 0x07;
+    if ((length < NTP_PACKET_SIZE) || ((request[0] & 0x07) != NTP_MODE_CLIENT) || (version < 1) || (version > 4) ||
+        !clock_sync_time_at(server->clock, receive_us, &second, &fraction))
+    {
+        atomic_fetch_add(&server->stats.dropped, 1);
+        return 0;
+    }
+
+    do
+    {
+        before = atomic_load(&server->sequence);
+        atomic_thread_fence(memory_order_acquire);
+        memcpy(response, server->template, NTP_PACKET_SIZE);
+        utc_offset = server->utc_offset;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load(&server->sequence);
+    } while ((before & 1) || (before != after));
+
+    // Same version as the client, its poll, and its transmit time as origin
+    response[0] = (response[0] & 0xc0) | (version << 3) | NTP_MODE_SERVER;
+    response[2] = request[2];
+    memcpy(&response[24], &request[40], 8);
+    put_timestamp(&response[32], second, fraction, utc_offset);
+
+    int64_t transmit_us = now_us();
+    clock_sync_time_at(server->clock, transmit_us, &second, &fraction);
+    put_timestamp(&response[40], second, fraction, utc_offset);
+
+    uint32_t turnaround_us = transmit_us - receive_us;
+    atomic_fetch_add(&server->stats.replies, 1);
+    atomic_fetch_add(&server->stats.turnaround_us_total, turnaround_us);
+    if (turnaround_us > atomic_load(&server->stats.turnaround_us_max))
+    {
+        atomic_store(&server->stats.turnaround_us_max, turnaround_us);
+    }
+    return NTP_PACKET_SIZE;
+}
+
+// Serves requests on port forever, returns -1 when it cannot bind
+int ntp_server_serve(ntp_server_t *server, uint16_t port)
+{
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    uint8_t request[NTP_REQUEST_SIZE];
+    uint8_t response[NTP_PACKET_SIZE];
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    for (;;)
+    {
+        struct sockaddr_in client;
+        socklen_t client_length = sizeof(client);
+        int length = recvfrom(fd, request, sizeof(request), 0, (struct sockaddr *)&client, &client_length);
+        // Stamped first, the time spent from here on shows in the transmit timestamp
+        int64_t receive_us = now_us();
+        if (length <= 0)
+        {
+            continue;
+        }
+        if (ntp_server_respond(server, request, length, receive_us, response) != 0)
+        {
+            sendto(fd, response, NTP_PACKET_SIZE, 0, (struct sockaddr *)&client, client_length);
+        }
+    }
+    return -1;
+}
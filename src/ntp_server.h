@@ -0,0 +1,68 @@
+#ifndef NTP_SERVER_H_
+#define NTP_SERVER_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "main.h"
+#include "clock_sync.h"
+
+// Stratum 1 NTP server on the UCCM time. Requests are timestamped on the
+// local clock and converted to UTC through the clock_sync model of the TOD
+// second boundaries. The reply is a template, rebuilt by ntp_server_update()
+// on every TOD packet, into which only the version, poll and the three
+// timestamps are patched, so a request costs the same whatever the state.
+//
+// The server is synchronized while the model is locked, the UCCM reports a
+// UTC offset, TFOM is at most NTP_SERVER_MAX_TFOM and the TOD status shows
+// neither an invalid PPS, nor an unlocked loop, nor an invalid date. The
+// leap indicator follows the leap pending flag of the TOD status.
+//
+// Builds against lwIP on the ESP32 and against BSD sockets on Linux, where
+// tools/ntp_bench.c runs it on localhost for load tests.
+
+// Build option: serve NTP over WiFi, see wifi_station.h. Off unless set.
+#ifndef GPSDO_NTP
+#define GPSDO_NTP 0
+#endif
+
+#define NTP_SERVER_PORT (123)
+#define NTP_PACKET_SIZE (48)
+// Largest TFOM served as synchronized
+#define NTP_SERVER_MAX_TFOM (4)
+// Seconds from the NTP epoch (1900) to the GPS epoch (6 Jan 1980)
+#define NTP_GPS_EPOCH (2524953600u)
+// log2 of the local clock resolution, esp_timer counts microseconds
+#define NTP_SERVER_PRECISION (-20)
+
+typedef struct
+{
+    atomic_uint requests;
+    atomic_uint replies;
+    // Malformed requests and requests that came in while the model was not locked
+    atomic_uint dropped;
+    // From the receive to the transmit timestamp
+    atomic_uint turnaround_us_total;
+    atomic_uint turnaround_us_max;
+} ntp_server_stats_t;
+
+typedef struct
+{
+    clock_sync_t *clock;
+    // The template is written by the TOD parser and read by the serving
+    // task, a reader retries while the sequence is odd or changed under it
+    atomic_uint sequence;
+    uint8_t template[NTP_PACKET_SIZE];
+    int32_t utc_offset;
+    ntp_server_stats_t stats;
+} ntp_server_t;
+
+void ntp_server_init(ntp_server_t *server, clock_sync_t *clock);
+void ntp_server_update(ntp_server_t *server, const gpsdo_state_t *state, uint32_t second, uint32_t error_us);
+int ntp_server_respond(ntp_server_t *server, const uint8_t *request, size_t length, int64_t receive_us,
+                       uint8_t *response);
+int ntp_server_serve(ntp_server_t *server, uint16_t port);
+
+#endif
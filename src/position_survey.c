@@ -0,0 +1,162 @@
+#include <math.h>
+#include <string.h>
+
+#include "position_survey.h"
+
+// WGS84 semi-major axis and first eccentricity squared
+#define WGS84_A (6378137.0)
+#define WGS84_F (1.0 / 298.257223563)
+#define WGS84_E2 (WGS84_F * (2.0 - WGS84_F))
+#define DEGREES (M_PI / 180.0)
+
+// Indices into m2
+enum
+{
+    M2_EE,
+    M2_NN,
+    M2_UU,
+    M2_EN,
+    M2_EU,
+    M2_NU,
+};
+
+static void geodetic_to_ecef(const position_t *position, double ecef[3])
+{
+    double lat = position->latitude * DEGREES;
+    double lon = position->longitude * DEGREES;
+    double sin_lat = sin(lat);
+    double n = WGS84_A / sqrt(1.0 - (WGS84_E2 * sin_lat * sin_lat));
+
+    ecef[0] = (n + position->altitude) * cos(lat) * cos(lon);
+    ecef[1] = (n + position->altitude) * cos(lat) * sin(lon);
+    ecef[2] = ((n * (1.0 - WGS84_E2)) + position->altitude) * sin_lat;
+}
+
+// Fixed point iteration on the latitude, sub-millimetre after four rounds
+// anywhere near the surface
+static void ecef_to_geodetic(const double ecef[3], position_t *position)
+{
+    double p = hypot(ecef[0], ecef[1]);
+    double lat = atan2(ecef[2], p * (1.0 - WGS84_E2));
+    double sin_lat, n = WGS84_A;
+
+    for (int i = 0; i < 5; i++)
+    {
+        sin_lat = sin(lat);
+        n = WGS84_A / sqrt(1.0 - (WGS84_E2 * sin_lat * sin_lat));
+        lat = atan2(ecef[2] + (n * WGS84_E2 * sin_lat), p);
+    }
+    sin_lat = sin(lat);
+    position->latitude = lat / DEGREES;
+    position->longitude = atan2(ecef[1], ecef[0]) / DEGREES;
+    // Stable at every latitude, unlike p / cos(lat) - n
+    position->altitude = (p * cos(lat)) + (ecef[2] * sin_lat) - (WGS84_A * sqrt(1.0 - (WGS84_E2 * sin_lat * sin_lat)));
+}
+
+static void ecef_to_enu(const position_survey_t *survey, const double ecef[3], double enu[SURVEY_AXES])
+{
+    double dx = ecef[0] - survey->origin_ecef[0];
+    double dy = ecef[1] - survey->origin_ecef[1];
+    double dz = ecef[2] - survey->origin_ecef[2];
+
+    enu[SURVEY_EAST] = (-survey->sin_lon * dx) + (survey->cos_lon * dy);
+    enu[SURVEY_NORTH] = (-survey->sin_lat * survey->cos_lon * dx) - (survey->sin_lat * survey->sin_lon * dy) +
+                        (survey->cos_lat * dz);
+    enu[SURVEY_UP] = (survey->cos_lat * survey->cos_lon * dx) + (survey->cos_lat * survey->sin_lon * dy) +
+                     (survey->sin_lat * dz);
+}
+
+static void enu_to_ecef(const position_survey_t *survey, const double enu[SURVEY_AXES], double ecef[3])
+{
+    double e = enu[SURVEY_EAST], n = enu[SURVEY_NORTH], u = enu[SURVEY_UP];
+
+    ecef[0] = survey->origin_ecef[0] - (survey->sin_lon * e) - (survey->sin_lat * survey->cos_lon * n) +
+              (survey->cos_lat * survey->cos_lon * u);
+    ecef[1] = survey->origin_ecef[1] + (survey->cos_lon * e) - (survey->sin_lat * survey->sin_lon * n) +
+              (survey->cos_lat * survey->sin_lon * u);
+    ecef[2] = survey->origin_ecef[2] + (survey->cos_lat * n) + (survey->sin_lat * u);
+}
+
+void position_survey_init(position_survey_t *survey)
+{
+    memset(survey, 0, sizeof(*survey));
+}
+
+bool position_survey_add(position_survey_t *survey, const position_t *fix)
+{
+    double ecef[3], enu[SURVEY_AXES], delta[SURVEY_AXES], after[SURVEY_AXES];
+
+    geodetic_to_ecef(fix, ecef);
+    if (survey->fixes == 0)
+    {
+        survey->origin = *fix;
+        memcpy(survey->origin_ecef, ecef, sizeof(ecef));
+        survey->sin_lat = sin(fix->latitude * DEGREES);
+        survey->cos_lat = cos(fix->latitude * DEGREES);
+        survey->sin_lon = sin(fix->longitude * DEGREES);
+        survey->cos_lon = cos(fix->longitude * DEGREES);
+    }
+    ecef_to_enu(survey, ecef, enu);
+
+    survey->fixes++;
+    for (int axis = 0; axis < SURVEY_AXES; axis++)
+    {
+        delta[axis] = enu[axis] - survey->mean[axis];
+        survey->mean[axis] += delta[axis] / survey->fixes;
+        after[axis] = enu[axis] - survey->mean[axis];
+    }
+    survey->m2[M2_EE] += delta[SURVEY_EAST] * after[SURVEY_EAST];
+    survey->m2[M2_NN] += delta[SURVEY_NORTH] * after[SURVEY_NORTH];
+    survey->m2[M2_UU] += delta[SURVEY_UP] * after[SURVEY_UP];
+    survey->m2[M2_EN] += delta[SURVEY_EAST] * after[SURVEY_NORTH];
+    survey->m2[M2_EU] += delta[SURVEY_EAST] * after[SURVEY_UP];
+    survey->m2[M2_NU] += delta[SURVEY_NORTH] * after[SURVEY_UP];
+    survey->last_step = sqrt((delta[SURVEY_EAST] * delta[SURVEY_EAST]) + (delta[SURVEY_NORTH] * delta[SURVEY_NORTH]) +
+                             (delta[SURVEY_UP] * delta[SURVEY_UP])) /
+                        survey->fixes;
+
+    if ((survey->converged_at == 0) && (survey->fixes >= POSITION_SURVEY_MIN_FIXES))
+    {
+        double variance = (survey->m2[M2_EE] + survey->m2[M2_NN] + survey->m2[M2_UU]) / (survey->fixes - 1);
+        if (sqrt(variance / survey->fixes) < POSITION_SURVEY_TARGET_M)
+        {
+            survey->converged_at = survey->fixes;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool position_survey_result(const position_survey_t *survey, position_survey_result_t *result)
+{
+    double ecef[3];
+
+    memset(result, 0, sizeof(*result));
+    if (survey->fixes == 0)
+    {
+        return false;
+    }
+    result->fixes = survey->fixes;
+    result->last_step = survey->last_step;
+    result->converged_at = survey->converged_at;
+    enu_to_ecef(survey, survey->mean, ecef);
+    ecef_to_geodetic(ecef, &result->position);
+    if (survey->fixes < 2)
+    {
+        return true;
+    }
+
+    double count = survey->fixes - 1;
+    double var_e = survey->m2[M2_EE] / count;
+    double var_n = survey->m2[M2_NN] / count;
+    double var_u = survey->m2[M2_UU] / count;
+    double cov_en = survey->m2[M2_EN] / count;
+    result->sd[SURVEY_EAST] = sqrt(var_e);
+    result->sd[SURVEY_NORTH] = sqrt(var_n);
+    result->sd[SURVEY_UP] = sqrt(var_u);
+    // Larger eigenvalue of the horizontal covariance
+    double half_diff = (var_e - var_n) / 2;
+    result->horizontal_major = sqrt(((var_e + var_n) / 2) + sqrt((half_diff * half_diff) + (cov_en * cov_en)));
+    result->error = sqrt((var_e + var_n + var_u) / survey->fixes);
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef POSITION_SURVEY_H_
+#define POSITION_SURVEY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Running average of the GPS:POS? fixes in double precision. The first fix
+// is the origin of a local east, north, up frame. Every fix goes to ECEF on
+// the WGS84 ellipsoid and is rotated into that frame, so the averaging
+// works on offsets of a few metres instead of on degrees. Mean and
+// covariance are updated with Welford's algorithm in constant memory.
+//
+// The altitude is taken as the height above the ellipsoid. A geoid offset
+// only scales the horizontal offsets by its ratio to the Earth radius.
+// Fixes of a receiver are correlated over minutes. The standard error below
+// treats them as independent, so it is optimistic until the survey has run
+// for hours.
+
+// Converged once the standard error of the mean is below the target, in
+// metres, after at least the minimum number of fixes (an hour at the 30 s poll)
+#define POSITION_SURVEY_TARGET_M (0.1)
+#define POSITION_SURVEY_MIN_FIXES (120)
+
+typedef enum
+{
+    SURVEY_EAST,
+    SURVEY_NORTH,
+    SURVEY_UP,
+    SURVEY_AXES
+} position_survey_axis_t;
+
+typedef struct
+{
+    // Degrees and metres
+    double latitude;
+    double longitude;
+    double altitude;
+} position_t;
+
+typedef struct
+{
+    uint32_t fixes;
+    position_t origin;
+    double origin_ecef[3];
+    // Rotation from ECEF to the local frame at the origin
+    double sin_lat;
+    double cos_lat;
+    double sin_lon;
+    double cos_lon;
+    // Mean offset from the origin, and the sums of the products of the
+    // deviations: EE, NN, UU, EN, EU, NU
+    double mean[SURVEY_AXES];
+    double m2[6];
+    // Metres the mean moved with the last fix
+    double last_step;
+    // Fix count at which the survey converged, 0 before
+    uint32_t converged_at;
+} position_survey_t;
+
+typedef struct
+{
+    uint32_t fixes;
+    position_t position;
+    // Spread of the fixes along each axis, metres
+    double sd[SURVEY_AXES];
+    // Semi-major axis of the horizontal 1 sigma ellipse, metres
+    double horizontal_major;
+    // 3D standard error of the mean, metres
+    double error;
+    double last_step;
+    uint32_t converged_at;
+} position_survey_result_t;
+
+void position_survey_init(position_survey_t *survey);
+// Adds a fix, returns true when it converged the survey
+bool position_survey_add(position_survey_t *survey, const position_t *fix);
+// Surveyed position and precision, false without a fix
+bool position_survey_result(const position_survey_t *survey, position_survey_result_t *result);
+
+#endif
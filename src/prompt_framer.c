@@ -0,0 +1,74 @@
+#include <string.h>
+
+#include "prompt_framer.h"
+
+void prompt_framer_init(prompt_framer_t *framer, char *buffer, int size, const char *prompt)
+{
+    memset(framer, 0, sizeof(*framer));
+    framer->buffer = buffer;
+    framer->size = size;
+    framer->prompt = prompt;
+    framer->prompt_length = strlen(prompt);
+}
+
+void prompt_framer_reset(prompt_framer_t *framer)
+{
+    framer->length = 0;
+}
+
+char *prompt_framer_tail(prompt_framer_t *framer)
+{
+    return &framer->buffer[framer->length];
+}
+
+int prompt_framer_space(const prompt_framer_t *framer)
+{
+    return framer->size - framer->length - 1;
+}
+
+void prompt_framer_overflow(prompt_framer_t *framer, int count)
+{
+    framer->stats.overflows++;
+    framer->stats.dropped_bytes += framer->length + count;
+    framer->length = 0;
+}
+
+int prompt_framer_commit(prompt_framer_t *framer, int count, prompt_framer_cb_t cb, void *arg)
+{
+    char *frame = framer->buffer;
+    int responses = 0;
+
+    if (count <= 0)
+    {
+        return 0;
+    }
+    framer->length += count;
+    frame[framer->length] = '\0';
+
+    // Cut after every prompt the frame holds, the commands of a batch come
+    // back without a pause between their responses. What follows the last
+    // prompt is the start of the next response, a space followed by a pause
+    // inside it is not a prompt
+    char *response = frame;
+    char *prompt;
+    while ((prompt = strstr(response, framer->prompt)) != NULL)
+    {
+        char *end = prompt + framer->prompt_length;
+        // The terminator goes in place of the first byte of the next
+        // response, which is restored once cb returns
+        char next = *end;
+        *end = '\0';
+        cb(response, end - response, arg);
+        *end = next;
+        response = end;
+        responses++;
+    }
+    if (responses > 0)
+    {
+        framer->length -= response - frame;
+        memmove(frame, response, framer->length + 1);
+        framer->stats.frames++;
+        framer->stats.responses += responses;
+    }
+    return responses;
+}
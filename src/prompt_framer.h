@@ -0,0 +1,51 @@
+#ifndef PROMPT_FRAMER_H_
+#define PROMPT_FRAMER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Splits the command UART stream into responses, each ending in the UCCM
+// prompt. The receive task reads straight into the frame buffer, at
+// prompt_framer_tail(), whenever the UART pattern detector flags a space
+// followed by line idle, and hands the count to prompt_framer_commit().
+// Every complete response is cut after its prompt, since the commands of a
+// batch come back in one frame without a pause between their responses. The
+// rest, after a space and a pause inside a response, keeps accumulating.
+// Platform independent, see tools/prompt_framer_test.c.
+
+typedef void (*prompt_framer_cb_t)(char *response, int length, void *arg);
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t responses;
+    // Frames that outgrew the buffer, and their bytes
+    uint32_t overflows;
+    uint32_t dropped_bytes;
+} prompt_framer_stats_t;
+
+typedef struct
+{
+    char *buffer;
+    int size;
+    int length;
+    const char *prompt;
+    int prompt_length;
+    prompt_framer_stats_t stats;
+} prompt_framer_t;
+
+void prompt_framer_init(prompt_framer_t *framer, char *buffer, int size, const char *prompt);
+// Drops the partial frame, after the driver flushed its input
+void prompt_framer_reset(prompt_framer_t *framer);
+// Where the next read goes and how much it may take, one byte is kept for
+// the terminator
+char *prompt_framer_tail(prompt_framer_t *framer);
+int prompt_framer_space(const prompt_framer_t *framer);
+// Accounts for count bytes read at the tail. cb gets every complete
+// response, prompt included and NUL terminated past the end, and the partial
+// one left over moves to the front. Returns the number of responses.
+int prompt_framer_commit(prompt_framer_t *framer, int count, prompt_framer_cb_t cb, void *arg);
+// Records bytes discarded because they did not fit, and drops the frame
+void prompt_framer_overflow(prompt_framer_t *framer, int count);
+
+#endif
@@ -0,0 +1,48 @@
+#include "run_stats.h"
+
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+static TaskStatus_t task_status[RUN_STATS_MAX_TASKS];
+
+// Updates load[] from the time since the previous call, false when there is
+// no previous call yet or the task table did not fit
+bool run_stats_update(run_stats_t *stats)
+{
+    uint32_t total;
+    uint32_t idle[portNUM_PROCESSORS] = {0};
+    UBaseType_t count = uxTaskGetSystemState(task_status, RUN_STATS_MAX_TASKS, &total);
+
+    if (count == 0)
+    {
+        return false;
+    }
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        for (int core = 0; core < portNUM_PROCESSORS; core++)
+        {
+            if (task_status[i].xHandle == xTaskGetIdleTaskHandleForCPU(core))
+            {
+                idle[core] = task_status[i].ulRunTimeCounter;
+            }
+        }
+    }
+
+    bool valid = (stats->last_total != 0) && (total != stats->last_total);
+    for (int core = 0; valid && (core < portNUM_PROCESSORS); core++)
+    {
+        uint32_t idle_time = idle[core] - stats->last_idle[core];
+        uint32_t elapsed = total - stats->last_total;
+        stats->load[core] = (idle_time >= elapsed) ? 0 : (uint8_t)(100 - ((uint64_t)idle_time * 100 / elapsed));
+    }
+    stats->last_total = total;
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        stats->last_idle[core] = idle[core];
+    }
+    return valid;
+}
+#else
+bool run_stats_update(run_stats_t *stats)
+{
+    return false;
+}
+#endif
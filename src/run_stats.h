@@ -0,0 +1,28 @@
+#ifndef RUN_STATS_H_
+#define RUN_STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Per core utilisation from the FreeRTOS run time counters: whatever time
+// the idle task of a core did not get between two updates was spent on
+// real work. Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, without them nothing is measured.
+
+// Tasks run_stats_update() can take a snapshot of
+#define RUN_STATS_MAX_TASKS (24)
+
+typedef struct
+{
+    uint32_t last_total;
+    uint32_t last_idle[portNUM_PROCESSORS];
+    // Busy percentage of each core over the last interval
+    uint8_t load[portNUM_PROCESSORS];
+} run_stats_t;
+
+bool run_stats_update(run_stats_t *stats);
+
+#endif
@@ -0,0 +1,413 @@
+#include <stddef.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "xtensa/hal.h"
+#else
+#include <time.h>
+#endif
+
+#include "sample_store.h"
+
+_Static_assert(sizeof(sample_block_t) == SAMPLE_STORE_BLOCK_SIZE, "sample_block_t must fill one block");
+_Static_assert((SAMPLE_STORE_BLOCK_SIZE - 12) * 8 <= UINT16_MAX, "block bit count must fit in 16 bits");
+
+// Largest encoding of one sample: '1111' and a raw delta-of-delta, then '11',
+// 5 bits of leading zeros, 5 bits of length and 32 meaningful bits per series
+#define SAMPLE_MAX_BITS (4 + 32 + (SAMPLE_SERIES_COUNT * (2 + 5 + 5 + 32)))
+#define BLOCK_DATA_BITS ((int)sizeof(((sample_block_t *)0)->data) * 8)
+
+#define SERIES_IS_FLOAT(id, field, bits) \
+    _Static_assert(_Generic(((gpsdo_state_t *)0)->field, float: 1, default: 0), #field " must be a float");
+SAMPLE_STORE_SERIES(SERIES_IS_FLOAT)
+
+#define SERIES_OFFSET(id, field, bits) offsetof(gpsdo_state_t, field),
+#define SERIES_MANTISSA_BITS(id, field, bits) bits,
+static const uint16_t series_offset[SAMPLE_SERIES_COUNT] = {SAMPLE_STORE_SERIES(SERIES_OFFSET)};
+static const uint8_t mantissa_bits[SAMPLE_SERIES_COUNT] = {SAMPLE_STORE_SERIES(SERIES_MANTISSA_BITS)};
+
+#ifndef ESP_PLATFORM
+// Nanoseconds stand in for the CPU cycles on the host
+static uint32_t xthal_get_ccount()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec * 1000000000ULL) + now.tv_nsec);
+}
+#endif
+
+typedef struct
+{
+    const sample_block_t *block;
+    uint32_t bit;
+    uint32_t time;
+    int32_t delta;
+    uint32_t values[SAMPLE_SERIES_COUNT];
+    uint8_t leading[SAMPLE_SERIES_COUNT];
+    uint8_t meaningful[SAMPLE_SERIES_COUNT];
+} sample_reader_t;
+
+static void put_bits(sample_block_t *block, uint32_t value, int count)
+{
+    while (count > 0)
+    {
+        int room = 8 - (block->bits & 7);
+        int take = (count < room) ? count : room;
+        uint8_t chunk = (value >> (count - take)) & ((1u << take) - 1);
+
+        block->data[block->bits >> 3] |= chunk << (room - take);
+        block->bits += take;
+        count -= take;
+    }
+}
+
+static uint32_t get_bits(sample_reader_t *reader, int count)
+{
+    uint32_t value = 0;
+
+    while (count > 0)
+    {
+        int room = 8 - (reader->bit & 7);
+        int take = (count < room) ? count : room;
+        uint8_t byte = reader->block->data[reader->bit >> 3];
+
+        value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+        reader->bit += take;
+        count -= take;
+    }
+    return value;
+}
+
+// Rounds away the mantissa bits the series does not keep
+static uint32_t quantize(float value, int bits)
+{
+    uint32_t raw;
+    uint32_t drop = 23 - bits;
+
+    memcpy(&raw, &value, sizeof(raw));
+    if ((drop == 0) || ((raw & 0x7f800000) == 0x7f800000))
+    {
+        return raw;
+    }
+    raw += 1u << (drop - 1);
+    return raw & ~((1u << drop) - 1);
+}
+
+// Delta-of-delta in the shortest of the Gorilla buckets
+static void put_dod(sample_block_t *block, int32_t dod)
+{
+    if (dod == 0)
+    {
+        put_bits(block, 0x0, 1);
+    }
+    else if ((dod >= -64) && (dod < 64))
+    {
+        put_bits(block, 0x2, 2);
+        put_bits(block, (uint32_t)dod & 0x7f, 7);
+    }
+    else if ((dod >= -256) && (dod < 256))
+    {
+        put_bits(block, 0x6, 3);
+        put_bits(block, (uint32_t)dod & 0x1ff, 9);
+    }
+    else if ((dod >= -2048) && (dod < 2048))
+    {
+        put_bits(block, 0xe, 4);
+        put_bits(block, (uint32_t)dod & 0xfff, 12);
+    }
+    else
+    {
+        put_bits(block, 0xf, 4);
+        put_bits(block, (uint32_t)dod, 32);
+    }
+}
+
+static int32_t get_dod(sample_reader_t *reader)
+{
+    int width;
+
+    if (get_bits(reader, 1) == 0)
+    {
+        return 0;
+    }
+    if (get_bits(reader, 1) == 0)
+    {
+        width = 7;
+    }
+    else if (get_bits(reader, 1) == 0)
+    {
+        width = 9;
+    }
+    else if (get_bits(reader, 1) == 0)
+    {
+        width = 12;
+    }
+    else
+    {
+        return (int32_t)get_bits(reader, 32);
+    }
+
+    uint32_t value = get_bits(reader, width);
+    return (int32_t)(value << (32 - width)) >> (32 - width);
+}
+
+// XOR with the previous value: '0' when equal, '10' and the meaningful bits
+// when they fit the previous window, '11' and a new window otherwise
+static void put_value(sample_store_t *store, sample_block_t *block, int series, uint32_t value)
+{
+    uint32_t xor = value ^ store->last_values[series];
+
+    store->last_values[series] = value;
+    if (xor == 0)
+    {
+        put_bits(block, 0x0, 1);
+        return;
+    }
+
+    int leading = __builtin_clz(xor);
+    int trailing = __builtin_ctz(xor);
+    int window_trailing = 32 - store->leading[series] - store->meaningful[series];
+
+    if ((store->meaningful[series] != 0) && (leading >= store->leading[series]) && (trailing >= window_trailing))
+    {
+        put_bits(block, 0x2, 2);
+        put_bits(block, xor >> window_trailing, store->meaningful[series]);
+        return;
+    }
+
+    int meaningful = 32 - leading - trailing;
+
+    put_bits(block, 0x3, 2);
+    put_bits(block, leading, 5);
+    put_bits(block, meaningful - 1, 5);
+    put_bits(block, xor >> trailing, meaningful);
+    store->leading[series] = leading;
+    store->meaningful[series] = meaningful;
+}
+
+static uint32_t get_value(sample_reader_t *reader, int series)
+{
+    if (get_bits(reader, 1) == 0)
+    {
+        return reader->values[series];
+    }
+    if (get_bits(reader, 1) == 1)
+    {
+        reader->leading[series] = get_bits(reader, 5);
+        reader->meaningful[series] = get_bits(reader, 5) + 1;
+    }
+
+    int trailing = 32 - reader->leading[series] - reader->meaningful[series];
+
+    reader->values[series] ^= get_bits(reader, reader->meaningful[series]) << trailing;
+    return reader->values[series];
+}
+
+static uint32_t block_bytes(const sample_block_t *block)
+{
+    return offsetof(sample_block_t, data) + ((block->bits + 7) / 8);
+}
+
+void sample_store_init(sample_store_t *store, sample_block_t *blocks, uint32_t block_count, uint32_t decimation)
+{
+    memset(store, 0, sizeof(sample_store_t));
+    store->blocks = blocks;
+    store->block_count = block_count;
+    store->decimation = (decimation > 1) ? decimation : 1;
+}
+
+// Moves to the next block of the pool, recycling the oldest when it is full
+static sample_block_t *open_block(sample_store_t *store)
+{
+    if (store->used > 0)
+    {
+        store->head = (store->head + 1) % store->block_count;
+    }
+    if (store->used == store->block_count)
+    {
+        sample_block_t *oldest = &store->blocks[store->head];
+        store->stats.retained -= oldest->count;
+        store->stats.retained_bytes -= block_bytes(oldest);
+        store->stats.blocks_recycled++;
+    }
+    else
+    {
+        store->used++;
+    }
+
+    sample_block_t *block = &store->blocks[store->head];
+    memset(block, 0, sizeof(sample_block_t));
+    store->stats.retained_bytes += block_bytes(block);
+    return block;
+}
+
+// Encodes the series of one stored sample
+static void encode_sample(sample_store_t *store, uint32_t gps_time, const float *sample)
+{
+    sample_block_t *block = (store->used > 0) ? &store->blocks[store->head] : NULL;
+    uint32_t values[SAMPLE_SERIES_COUNT];
+    int series;
+
+    for (series = 0; series < SAMPLE_SERIES_COUNT; series++)
+    {
+        values[series] = quantize(sample[series], mantissa_bits[series]);
+    }
+
+    if ((block == NULL) || ((block->bits + SAMPLE_MAX_BITS) > BLOCK_DATA_BITS))
+    {
+        block = open_block(store);
+    }
+
+    uint32_t bytes = block_bytes(block);
+
+    if (block->count == 0)
+    {
+        // Every block starts from a raw sample
+        put_bits(block, gps_time, 32);
+        for (series = 0; series < SAMPLE_SERIES_COUNT; series++)
+        {
+            put_bits(block, values[series], 32);
+            store->last_values[series] = values[series];
+            store->meaningful[series] = 0;
+        }
+        store->last_delta = 0;
+        block->first_time = gps_time;
+    }
+    else
+    {
+        int32_t delta = (int32_t)(gps_time - store->last_time);
+
+        put_dod(block, delta - store->last_delta);
+        store->last_delta = delta;
+        for (series = 0; series < SAMPLE_SERIES_COUNT; series++)
+        {
+            put_value(store, block, series, values[series]);
+        }
+    }
+    block->last_time = gps_time;
+    block->count++;
+    store->last_time = gps_time;
+    store->stats.retained++;
+    store->stats.retained_bytes += block_bytes(block) - bytes;
+}
+
+// Stores a sample, or adds it to the mean of its period when the store
+// decimates. Samples not newer than the last one are dropped, which keeps
+// every block in time order for the queries.
+void sample_store_append(sample_store_t *store, const gpsdo_state_t *state)
+{
+    uint32_t start = xthal_get_ccount();
+    float sample[SAMPLE_SERIES_COUNT];
+    int series;
+
+    if ((store->stats.samples > 0) && (state->gps_time <= store->last_sample))
+    {
+        return;
+    }
+    for (series = 0; series < SAMPLE_SERIES_COUNT; series++)
+    {
+        sample[series] = *(const float *)((const uint8_t *)state + series_offset[series]);
+    }
+
+    if (store->decimation == 1)
+    {
+        encode_sample(store, state->gps_time, sample);
+    }
+    else
+    {
+        uint32_t period_start = state->gps_time - (state->gps_time % store->decimation);
+
+        // The first sample of a period completes the one before
+        if ((store->period_count > 0) && (period_start != store->period_start))
+        {
+            float mean[SAMPLE_SERIES_COUNT];
+            for (series = 0; series < SAMPLE_SERIES_COUNT; series++)
+            {
+                mean[series] = store->period_sums[series] / store->period_count;
+                store->period_sums[series] = 0.0f;
+            }
+            encode_sample(store, store->period_start, mean);
+            store->period_count = 0;
+        }
+        store->period_start = period_start;
+        store->period_count++;
+        for (series = 0; series < SAMPLE_SERIES_COUNT; series++)
+        {
+            store->period_sums[series] += sample[series];
+        }
+    }
+    store->last_sample = state->gps_time;
+
+    uint32_t cycles = xthal_get_ccount() - start;
+
+    store->stats.samples++;
+    store->stats.cycles_total += cycles;
+    store->stats.cycles_max = (cycles > store->stats.cycles_max) ? cycles : store->stats.cycles_max;
+}
+
+// GPS time of the oldest sample held, 0 when there is none
+uint32_t sample_store_first_time(const sample_store_t *store)
+{
+    if (store->used == 0)
+    {
+        return 0;
+    }
+    return store->blocks[(store->head + store->block_count - store->used + 1) % store->block_count].first_time;
+}
+
+// Streams the samples between from and to, both inclusive, through cb. Only
+// the blocks overlapping the range are decoded. Returns the sample count.
+int sample_store_query(const sample_store_t *store, uint32_t from, uint32_t to, sample_query_cb_t cb, void *arg)
+{
+    int found = 0;
+
+    for (uint32_t i = 0; i < store->used; i++)
+    {
+        const sample_block_t *block = &store->blocks[(store->head + store->block_count - store->used + 1 + i) % store->block_count];
+
+        if ((block->count == 0) || (block->last_time < from))
+        {
+            continue;
+        }
+        if (block->first_time > to)
+        {
+            break;
+        }
+
+        sample_reader_t reader = {.block = block};
+        sample_store_sample_t sample;
+
+        for (uint32_t n = 0; n < block->count; n++)
+        {
+            if (n == 0)
+            {
+                reader.time = get_bits(&reader, 32);
+                for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+                {
+                    reader.values[series] = get_bits(&reader, 32);
+                }
+            }
+            else
+            {
+                reader.delta += get_dod(&reader);
+                reader.time += reader.delta;
+                for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+                {
+                    get_value(&reader, series);
+                }
+            }
+            if (reader.time > to)
+            {
+                return found;
+            }
+            if (reader.time >= from)
+            {
+                sample.gps_time = reader.time;
+                memcpy(sample.values, reader.values, sizeof(sample.values));
+                cb(&sample, arg);
+                found++;
+            }
+        }
+    }
+    return found;
+}
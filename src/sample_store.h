@@ -0,0 +1,100 @@
+#ifndef SAMPLE_STORE_H_
+#define SAMPLE_STORE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+// Compressed in-RAM store of the 1 Hz samples, encoded the way Gorilla does
+// it: timestamps as delta-of-delta, values as the XOR with the previous
+// value of the same series. Samples are packed into fixed size blocks that
+// each start from a raw sample, so any block decodes on its own and the
+// oldest one is recycled once the pool is full.
+// A store can keep means instead of every sample: with a decimation of n
+// seconds it stores the mean of each n second period of GPS time, stamped
+// with the start of the period, once the first sample of the next period
+// comes in. See tools/sample_store_bench.c for the sizes and speeds.
+
+// Series kept per sample:
+//   SERIES(id, field, bits)      float field of gpsdo_state_t rounded to bits
+//                                of mantissa, which bounds the relative error
+//                                to 2^-(bits+1) and keeps the XORs short
+// The bits keep every digit the UCCM prints: 4 significant ones for the
+// phase and TINT, 4 decimals of an EFC below 128 % and 3 of a temperature
+// below 128 degrees, within half a unit of the last one.
+#define SAMPLE_STORE_SERIES(SERIES)      \
+    SERIES(PHASE, phase, 14)             \
+    SERIES(DAC, dac, 20)                 \
+    SERIES(TEMPERATURE, temperature, 16) \
+    SERIES(TINT, tint, 14)
+
+// Block size in bytes, the pool of blocks is handed to sample_store_init()
+#define SAMPLE_STORE_BLOCK_SIZE (1024)
+
+#define SAMPLE_STORE_SERIES_ID(id, field, bits) SAMPLE_SERIES_##id,
+
+typedef enum
+{
+    SAMPLE_STORE_SERIES(SAMPLE_STORE_SERIES_ID)
+        SAMPLE_SERIES_COUNT
+} sample_series_id_t;
+
+typedef struct
+{
+    uint32_t gps_time;
+    float values[SAMPLE_SERIES_COUNT];
+} sample_store_sample_t;
+
+typedef struct
+{
+    uint32_t first_time;
+    uint32_t last_time;
+    uint16_t count;
+    uint16_t bits;
+    uint8_t data[SAMPLE_STORE_BLOCK_SIZE - 12];
+} sample_block_t;
+
+typedef struct
+{
+    // Samples appended, and those stored in the live blocks and the bytes
+    // they take, one per period when decimating
+    uint32_t samples;
+    uint32_t retained;
+    uint32_t retained_bytes;
+    uint32_t blocks_recycled;
+    uint32_t cycles_total;
+    uint32_t cycles_max;
+} sample_store_stats_t;
+
+typedef struct
+{
+    sample_block_t *blocks;
+    uint32_t block_count;
+    // Block being filled and number of live blocks, the oldest is used - 1 blocks back
+    uint32_t head;
+    uint32_t used;
+    // Encoder state of the head block
+    uint32_t last_time;
+    int32_t last_delta;
+    uint32_t last_values[SAMPLE_SERIES_COUNT];
+    uint8_t leading[SAMPLE_SERIES_COUNT];
+    uint8_t meaningful[SAMPLE_SERIES_COUNT];
+    // Seconds per stored sample, the period being averaged and the last sample appended
+    uint32_t decimation;
+    uint32_t period_start;
+    uint32_t period_count;
+    float period_sums[SAMPLE_SERIES_COUNT];
+    uint32_t last_sample;
+    sample_store_stats_t stats;
+} sample_store_t;
+
+typedef void (*sample_query_cb_t)(const sample_store_sample_t *sample, void *arg);
+
+// Not thread safe, appends and queries must come from one task or be locked by the caller
+void sample_store_init(sample_store_t *store, sample_block_t *blocks, uint32_t block_count, uint32_t decimation);
+void sample_store_append(sample_store_t *store, const gpsdo_state_t *state);
+int sample_store_query(const sample_store_t *store, uint32_t from, uint32_t to, sample_query_cb_t cb, void *arg);
+uint32_t sample_store_first_time(const sample_store_t *store);
+
+#endif
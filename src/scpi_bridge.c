@@ -0,0 +1,276 @@
+#include <string.h>
+
+#include "scpi_bridge.h"
+
+// SCPI error sent to a client whose command found the request ring full
+#define SCPI_QUEUE_OVERFLOW "-350,\"Queue overflow\"\r\n"
+
+// FNV-1a over a line that is not terminated
+static uint32_t line_hash(const char *line, size_t length)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)line[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t trimmed_length(const char *line, size_t length)
+{
+    while ((length > 0) && ((line[length - 1] == ' ') || (line[length - 1] == '\r') || (line[length - 1] == '\n')))
+    {
+        length--;
+    }
+    return length;
+}
+
+void scpi_bridge_init(scpi_bridge_t *bridge, const char *prompt)
+{
+    memset(bridge, 0, sizeof(*bridge));
+    bridge->prompt = prompt;
+    // A full request ring turns new commands away with an error, a full
+    // in-flight ring forgets the oldest entries, whose responses never came
+    spsc_ring_init(&bridge->requests, bridge->request_buffer, SCPI_BRIDGE_REQUEST_RING_SIZE, SPSC_DROP_NEWEST);
+    spsc_ring_init(&bridge->in_flight, bridge->in_flight_buffer, SCPI_BRIDGE_IN_FLIGHT_RING_SIZE, SPSC_DROP_OLDEST);
+    spsc_ring_init(&bridge->responses, bridge->response_buffer, SCPI_BRIDGE_RESPONSE_RING_SIZE, SPSC_DROP_NEWEST);
+}
+
+// Returns the client id, or -1 when all client slots are taken
+int scpi_bridge_add_client(scpi_bridge_t *bridge, const scpi_client_t *client)
+{
+    if (bridge->client_count >= SCPI_BRIDGE_CLIENTS)
+    {
+        return -1;
+    }
+    bridge->clients[bridge->client_count] = *client;
+    return bridge->client_count++;
+}
+
+static void client_write(scpi_bridge_t *bridge, int id, const char *text, size_t length)
+{
+    const scpi_client_t *client = &bridge->clients[id];
+    client->write(client->ctx, text, length);
+}
+
+static void client_prompt(scpi_bridge_t *bridge, int id)
+{
+    client_write(bridge, id, bridge->prompt, strlen(bridge->prompt));
+}
+
+// Queues a completed line for send_cmd_task. Empty lines are answered with
+// the prompt right away, there is nothing to ask the UCCM.
+static void submit_line(scpi_bridge_t *bridge, int id)
+{
+    char frame[1 + SCPI_BRIDGE_LINE_SIZE];
+    size_t length = trimmed_length(bridge->line[id], bridge->line_length[id]);
+
+    bridge->line_length[id] = 0;
+    client_write(bridge, id, "\r\n", 2);
+    if (length == 0)
+    {
+        client_prompt(bridge, id);
+        return;
+    }
+    frame[0] = id;
+    memcpy(&frame[1], bridge->line[id], length);
+    if (!spsc_ring_push(&bridge->requests, frame, 1 + length))
+    {
+        atomic_fetch_add(&bridge->stats.rejected, 1);
+        client_write(bridge, id, SCPI_QUEUE_OVERFLOW, sizeof(SCPI_QUEUE_OVERFLOW) - 1);
+        client_prompt(bridge, id);
+        return;
+    }
+    atomic_fetch_add(&bridge->stats.commands, 1);
+}
+
+// Line editing for terminals in raw mode: typed characters are echoed here,
+// the echo of the UCCM is stripped from the responses instead
+static void client_input(scpi_bridge_t *bridge, int id, const char *input, int length)
+{
+    for (int i = 0; i < length; i++)
+    {
+        char c = input[i];
+        // The \n of a \r\n pair, the line was submitted on the \r
+        bool crlf = (c == '\n') && (bridge->last_input[id] == '\r');
+
+        bridge->last_input[id] = c;
+        if ((c == '\r') || (c == '\n'))
+        {
+            if (!crlf)
+            {
+                submit_line(bridge, id);
+            }
+        }
+        else if ((c == '\b') || (c == 0x7f))
+        {
+            if (bridge->line_length[id] > 0)
+            {
+                bridge->line_length[id]--;
+                client_write(bridge, id, "\b \b", 3);
+            }
+        }
+        else if ((c >= ' ') && (bridge->line_length[id] < SCPI_BRIDGE_LINE_SIZE))
+        {
+            bridge->line[id][bridge->line_length[id]++] = c;
+            client_write(bridge, id, &c, 1);
+        }
+    }
+}
+
+// One round of the bridge task: hands the routed responses to their clients,
+// then waits up to timeout_ms for input, shared between the clients
+void scpi_bridge_poll(scpi_bridge_t *bridge, uint32_t timeout_ms)
+{
+    char input[32];
+    int length;
+
+    while ((length = spsc_ring_pop(&bridge->responses, bridge->response, sizeof(bridge->response))) != 0)
+    {
+        int id = (uint8_t)bridge->response[0];
+        if ((length < 1) || (id >= bridge->client_count))
+        {
+            continue;
+        }
+        // A response without a line of its own lost its prompt with the echo
+        if (length == 1)
+        {
+            client_prompt(bridge, id);
+            continue;
+        }
+        client_write(bridge, id, &bridge->response[1], length - 1);
+    }
+
+    for (int id = 0; id < bridge->client_count; id++)
+    {
+        const scpi_client_t *client = &bridge->clients[id];
+        while ((length = client->read(client->ctx, input, sizeof(input), timeout_ms / bridge->client_count)) > 0)
+        {
+            client_input(bridge, id, input, length);
+        }
+    }
+}
+
+// Pops the next queued client command into command, returns its owner for
+// scpi_bridge_sent() or SCPI_OWNER_MONITOR when nothing is queued
+int scpi_bridge_next_command(scpi_bridge_t *bridge, char *command, size_t size)
+{
+    char frame[1 + SCPI_BRIDGE_LINE_SIZE];
+    int length;
+
+    while ((length = spsc_ring_pop(&bridge->requests, frame, sizeof(frame))) != 0)
+    {
+        if ((length < 2) || (size < 2))
+        {
+            continue;
+        }
+        size_t command_length = ((size_t)(length - 1) < size - 1) ? (size_t)(length - 1) : size - 1;
+        memcpy(command, &frame[1], command_length);
+        command[command_length] = '\0';
+        return 1 + (uint8_t)frame[0];
+    }
+    return SCPI_OWNER_MONITOR;
+}
+
+// Notes a command about to be written to the UCCM, before it goes out so the
+// response can never overtake its entry. ends_write marks the last command of
+// the write, the only one unless several go out together.
+void scpi_bridge_sent(scpi_bridge_t *bridge, int owner, const char *command, bool ends_write, int64_t now_us)
+{
+    scpi_in_flight_t entry = {
+        .echo_hash = line_hash(command, trimmed_length(command, strlen(command))),
+        .sent_us = now_us,
+        .owner = owner,
+        .ends_write = ends_write,
+    };
+    spsc_ring_push(&bridge->in_flight, &entry, sizeof(entry));
+    atomic_fetch_add(&bridge->stats.sent, 1);
+    if (ends_write)
+    {
+        atomic_fetch_add(&bridge->stats.writes, 1);
+    }
+}
+
+// Drops the first count pending entries
+static void pending_drop(scpi_bridge_t *bridge, int count)
+{
+    bridge->pending_count -= count;
+    memmove(&bridge->pending[0], &bridge->pending[count], bridge->pending_count * sizeof(bridge->pending[0]));
+}
+
+// Matches a prompt terminated frame with the oldest in-flight command that
+// it echoes. Older entries lost their response and are dropped, a frame that
+// echoes none of them leaves them all in place. Returns true when the frame
+// belonged to a client and was queued for it, false when it is the monitor's
+// to parse.
+bool scpi_bridge_route(scpi_bridge_t *bridge, char *frame, int length, int64_t now_us)
+{
+    char *end = memchr(frame, '\n', length);
+    size_t echo_length = (end != NULL) ? (size_t)(end - frame) : (size_t)length;
+    uint32_t echo_hash = line_hash(frame, trimmed_length(frame, echo_length));
+
+    while ((bridge->pending_count < SCPI_BRIDGE_IN_FLIGHT_PENDING) &&
+           (spsc_ring_pop(&bridge->in_flight, &bridge->pending[bridge->pending_count], sizeof(scpi_in_flight_t)) ==
+            sizeof(scpi_in_flight_t)))
+    {
+        bridge->pending_count++;
+    }
+    int match;
+    for (match = 0; (match < bridge->pending_count) && (bridge->pending[match].echo_hash != echo_hash); match++)
+    {
+    }
+    if (match == bridge->pending_count)
+    {
+        // Keep looking ahead once the oldest entry cannot have an answer coming
+        if (bridge->pending_count == SCPI_BRIDGE_IN_FLIGHT_PENDING)
+        {
+            atomic_fetch_add(&bridge->stats.resyncs, 1);
+            pending_drop(bridge, 1);
+        }
+        return false;
+    }
+    scpi_in_flight_t entry = bridge->pending[match];
+    atomic_fetch_add(&bridge->stats.resyncs, match);
+    pending_drop(bridge, match + 1);
+    if (entry.ends_write)
+    {
+        uint32_t round_trip_us = now_us - entry.sent_us;
+        atomic_fetch_add(&bridge->stats.round_trips, 1);
+        atomic_fetch_add(&bridge->stats.round_trip_us_total, round_trip_us);
+        if (round_trip_us > atomic_load(&bridge->stats.round_trip_us_max))
+        {
+            atomic_store(&bridge->stats.round_trip_us_max, round_trip_us);
+        }
+    }
+    if (entry.owner == SCPI_OWNER_MONITOR)
+    {
+        return false;
+    }
+
+    // The client already saw its line, it gets the response and the prompt.
+    // The client id takes the place of the \n ending the echo.
+    uint8_t id = entry.owner - 1;
+    bool queued;
+    if (end == NULL)
+    {
+        queued = spsc_ring_push(&bridge->responses, &id, 1);
+    }
+    else
+    {
+        *end = id;
+        queued = ((frame + length - end) <= SCPI_BRIDGE_RESPONSE_SIZE) &&
+                 spsc_ring_push(&bridge->responses, end, frame + length - end);
+    }
+    if (queued)
+    {
+        uint32_t latency_us = now_us - entry.sent_us;
+        atomic_fetch_add(&bridge->stats.responses, 1);
+        atomic_fetch_add(&bridge->stats.latency_us_total, latency_us);
+        if (latency_us > atomic_load(&bridge->stats.latency_us_max))
+        {
+            atomic_store(&bridge->stats.latency_us_max, latency_us);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+#ifndef SCPI_BRIDGE_H_
+#define SCPI_BRIDGE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "spsc_ring.h"
+
+// Passthrough of hand typed SCPI commands to the UCCM while the monitor keeps
+// polling it. Client lines queue up for send_cmd_task, which interleaves them
+// with the polls (see scpi_bridge_next_command). Every command sent, polled or
+// not, is noted in an in-flight FIFO together with its owner. Responses come
+// back in order, each framed by the prompt, so uart_receive_cmd_task matches
+// them against that FIFO by their echo and hands the ones owned by a client
+// back to the bridge. Three SPSC rings connect the tasks:
+//
+//     bridge task -> requests -> send_cmd_task -> in_flight -> uart_receive_cmd_task
+//     uart_receive_cmd_task -> responses -> bridge task
+
+// Client transport. read returns the number of bytes read, 0 on timeout and
+// a negative value on failure, write returns a negative value on failure.
+typedef struct
+{
+    int (*read)(void *ctx, char *dst, size_t len, uint32_t timeout_ms);
+    int (*write)(void *ctx, const char *src, size_t len);
+    void *ctx;
+} scpi_client_t;
+
+#define SCPI_BRIDGE_CLIENTS (2)
+#define SCPI_BRIDGE_LINE_SIZE (96)
+// Ring sizes, powers of two. A response can be as long as a SYST:STAT? dump.
+#define SCPI_BRIDGE_REQUEST_RING_SIZE (512)
+#define SCPI_BRIDGE_RESPONSE_RING_SIZE (4096)
+#define SCPI_BRIDGE_IN_FLIGHT_RING_SIZE (256)
+// Longest response handed to a client, client id included
+#define SCPI_BRIDGE_RESPONSE_SIZE (3072)
+// Owner of the commands send_cmd_task polls on its own
+#define SCPI_OWNER_MONITOR (0)
+
+// In-flight entry, one per command written to the UCCM
+typedef struct
+{
+    uint32_t echo_hash;
+    int64_t sent_us;
+    uint8_t owner;
+    // Last command of a write, its response completes the round trip
+    uint8_t ends_write;
+} scpi_in_flight_t;
+
+// Entries the receive side looks ahead over to match a response
+#define SCPI_BRIDGE_IN_FLIGHT_PENDING (SCPI_BRIDGE_IN_FLIGHT_RING_SIZE / (SPSC_FRAME_HEADER + sizeof(scpi_in_flight_t)) + 1)
+
+typedef struct
+{
+    atomic_uint commands;
+    atomic_uint rejected;
+    atomic_uint responses;
+    // In-flight entries dropped because no response echoed them
+    atomic_uint resyncs;
+    atomic_uint latency_us_total;
+    atomic_uint latency_us_max;
+    // Every command written to the UCCM, polled or not, and the writes
+    // carrying them, a batch writes several commands at once. A round trip
+    // runs from a write to the response of its last command.
+    atomic_uint sent;
+    atomic_uint writes;
+    atomic_uint round_trips;
+    atomic_uint round_trip_us_total;
+    atomic_uint round_trip_us_max;
+} scpi_bridge_stats_t;
+
+typedef struct
+{
+    scpi_client_t clients[SCPI_BRIDGE_CLIENTS];
+    int client_count;
+    char line[SCPI_BRIDGE_CLIENTS][SCPI_BRIDGE_LINE_SIZE];
+    int line_length[SCPI_BRIDGE_CLIENTS];
+    char last_input[SCPI_BRIDGE_CLIENTS];
+    const char *prompt;
+    spsc_ring_t requests;
+    spsc_ring_t in_flight;
+    spsc_ring_t responses;
+    // Owned by the receive side, entries popped from in_flight but not yet matched
+    scpi_in_flight_t pending[SCPI_BRIDGE_IN_FLIGHT_PENDING];
+    int pending_count;
+    uint8_t request_buffer[SCPI_BRIDGE_REQUEST_RING_SIZE];
+    uint8_t in_flight_buffer[SCPI_BRIDGE_IN_FLIGHT_RING_SIZE];
+    uint8_t response_buffer[SCPI_BRIDGE_RESPONSE_RING_SIZE];
+    char response[SCPI_BRIDGE_RESPONSE_SIZE];
+    scpi_bridge_stats_t stats;
+} scpi_bridge_t;
+
+void scpi_bridge_init(scpi_bridge_t *bridge, const char *prompt);
+int scpi_bridge_add_client(scpi_bridge_t *bridge, const scpi_client_t *client);
+void scpi_bridge_poll(scpi_bridge_t *bridge, uint32_t timeout_ms);
+
+// For send_cmd_task
+int scpi_bridge_next_command(scpi_bridge_t *bridge, char *command, size_t size);
+void scpi_bridge_sent(scpi_bridge_t *bridge, int owner, const char *command, bool ends_write, int64_t now_us);
+
+// For uart_receive_cmd_task, frame includes the echo and the trailing prompt.
+// The end of the echo line is overwritten when the frame goes to a client.
+bool scpi_bridge_route(scpi_bridge_t *bridge, char *frame, int length, int64_t now_us);
+
+#ifdef ESP_PLATFORM
+// Bridges the given UART, the console one unless the port is taken
+int scpi_client_uart_init(scpi_client_t *client, int port);
+#else
+// Opens a pseudo terminal and returns the name of its slave side in path
+int scpi_client_pty_init(scpi_client_t *client, char *path, size_t path_size);
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef ESP_PLATFORM
+
+#define _XOPEN_SOURCE 600
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "scpi_bridge.h"
+
+// Host side of the bridge, a terminal program attaches to the slave side of
+// the pseudo terminal, e.g. picocom or screen on the path returned
+
+static int pty_read(void *ctx, char *dst, size_t len, uint32_t timeout_ms)
+{
+    struct pollfd fd = {.fd = (int)(intptr_t)ctx, .events = POLLIN};
+
+    if (poll(&fd, 1, timeout_ms) <= 0)
+    {
+        return 0;
+    }
+    // Hang up until a terminal attaches, wait as if nothing came in
+    if ((fd.revents & POLLIN) == 0)
+    {
+        usleep(timeout_ms * 1000);
+        return 0;
+    }
+    int n = read(fd.fd, dst, len);
+    return (n < 0) ? 0 : n;
+}
+
+// Never blocks, output nobody reads is dropped once the pty buffer is full
+static int pty_write(void *ctx, const char *src, size_t len)
+{
+    return write((int)(intptr_t)ctx, src, len);
+}
+
+int scpi_client_pty_init(scpi_client_t *client, char *path, size_t path_size)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if ((fd < 0) || (grantpt(fd) != 0) || (unlockpt(fd) != 0) || (ptsname(fd) == NULL) ||
+        (fcntl(fd, F_SETFL, O_NONBLOCK) != 0))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    strncpy(path, ptsname(fd), path_size - 1);
+    path[path_size - 1] = '\0';
+    client->read = pty_read;
+    client->write = pty_write;
+    client->ctx = (void *)(intptr_t)fd;
+    return 0;
+}
+
+#endif
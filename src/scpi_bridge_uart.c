@@ -0,0 +1,36 @@
+#ifdef ESP_PLATFORM
+
+#include "freertos/FreeRTOS.h"
+#include "driver/uart.h"
+
+#include "scpi_bridge.h"
+
+// Console side of the bridge. Log output shares the UART, so a line can get
+// interleaved with log messages, the UCCM only ever sees what was typed.
+
+#define SCPI_UART_RX_BUFFER_SIZE (256)
+
+static int uart_client_read(void *ctx, char *dst, size_t len, uint32_t timeout_ms)
+{
+    return uart_read_bytes((uart_port_t)(intptr_t)ctx, (uint8_t *)dst, len, timeout_ms / portTICK_PERIOD_MS);
+}
+
+static int uart_client_write(void *ctx, const char *src, size_t len)
+{
+    return uart_write_bytes((uart_port_t)(intptr_t)ctx, src, len);
+}
+
+int scpi_client_uart_init(scpi_client_t *client, int port)
+{
+    if (!uart_is_driver_installed(port) &&
+        (uart_driver_install(port, SCPI_UART_RX_BUFFER_SIZE, 0, 0, NULL, 0) != ESP_OK))
+    {
+        return -1;
+    }
+    client->read = uart_client_read;
+    client->write = uart_client_write;
+    client->ctx = (void *)(intptr_t)port;
+    return 0;
+}
+
+#endif
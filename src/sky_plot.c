@@ -0,0 +1,75 @@
+#include "sky_plot.h"
+
+// Taylor series of sin(x) to the x^11 term in Horner form. Over the first
+// quadrant it stays within 6e-8 of the real thing, far below one Q14 step,
+// and as a constant expression it is evaluated entirely at compile time.
+#define SKY_RAD(d) ((d) * 3.14159265358979323846 / 180.0)
+#define SKY_SIN_POLY(x) \
+    ((x) * (1 - (x) * (x) / 6 * (1 - (x) * (x) / 20 * (1 - (x) * (x) / 42 * (1 - (x) * (x) / 72 * (1 - (x) * (x) / 110))))))
+#define SKY_SIN(d) SKY_SIN_POLY(SKY_RAD(d))
+
+#define SKY_LUT_10(entry, n) \
+    entry(n##0), entry(n##1), entry(n##2), entry(n##3), entry(n##4), entry(n##5), entry(n##6), entry(n##7), entry(n##8), entry(n##9)
+#define SKY_LUT_0_90(entry)                                                                                         \
+    entry(0), entry(1), entry(2), entry(3), entry(4), entry(5), entry(6), entry(7), entry(8), entry(9),             \
+        SKY_LUT_10(entry, 1), SKY_LUT_10(entry, 2), SKY_LUT_10(entry, 3), SKY_LUT_10(entry, 4), SKY_LUT_10(entry, 5), \
+        SKY_LUT_10(entry, 6), SKY_LUT_10(entry, 7), SKY_LUT_10(entry, 8), entry(90)
+
+// Quarter wave of sin in Q14, the other quadrants follow by symmetry
+#define SKY_SIN_ENTRY(d) ((int16_t)(SKY_SIN(d) * (1 << SKY_PLOT_SIN_SHIFT) + 0.5))
+static const int16_t sin_table[91] = {SKY_LUT_0_90(SKY_SIN_ENTRY)};
+
+// Elevation to radius with the azimuthal equal-area projection, which gives
+// the crowded low elevations more room than a linear scale:
+// r = R * sin((90 - el) / 2) / sin(45)
+#define SKY_RADIUS_ENTRY(el) ((uint8_t)(SKY_PLOT_RADIUS * SKY_SIN((90 - (el)) / 2.0) / SKY_SIN(45) + 0.5))
+static const uint8_t radius_table[91] = {SKY_LUT_0_90(SKY_RADIUS_ENTRY)};
+
+int16_t sky_plot_sin(int degrees)
+{
+    degrees %= 360;
+    if (degrees < 0)
+    {
+        degrees += 360;
+    }
+    if (degrees <= 90)
+    {
+        return sin_table[degrees];
+    }
+    if (degrees <= 180)
+    {
+        return sin_table[180 - degrees];
+    }
+    if (degrees <= 270)
+    {
+        return -sin_table[degrees - 180];
+    }
+    return -sin_table[360 - degrees];
+}
+
+int16_t sky_plot_cos(int degrees)
+{
+    return sky_plot_sin(degrees + 90);
+}
+
+uint8_t sky_plot_radius(int elevation)
+{
+    if (elevation < 0)
+    {
+        elevation = 0;
+    }
+    if (elevation > 90)
+    {
+        elevation = 90;
+    }
+    return radius_table[elevation];
+}
+
+// Offset from the plot centre in screen coordinates, north up and east right
+void sky_plot_position(int azimuth, int elevation, int *dx, int *dy)
+{
+    int radius = sky_plot_radius(elevation);
+
+    *dx = (radius * sky_plot_sin(azimuth)) >> SKY_PLOT_SIN_SHIFT;
+    *dy = -((radius * sky_plot_cos(azimuth)) >> SKY_PLOT_SIN_SHIFT);
+}
@@ -0,0 +1,20 @@
+#ifndef SKY_PLOT_H_
+#define SKY_PLOT_H_
+
+#include <stdint.h>
+
+// Polar sky plot geometry. Azimuth and elevation come in whole degrees from
+// SYST:STAT?, so both map through tables built by the compiler instead of
+// doing trigonometry per frame.
+
+// Horizon circle radius in pixels
+#define SKY_PLOT_RADIUS (30)
+// Fixed point scale of the sine table, Q14
+#define SKY_PLOT_SIN_SHIFT (14)
+
+int16_t sky_plot_sin(int degrees);
+int16_t sky_plot_cos(int degrees);
+uint8_t sky_plot_radius(int elevation);
+void sky_plot_position(int azimuth, int elevation, int *dx, int *dy);
+
+#endif
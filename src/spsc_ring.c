@@ -0,0 +1,131 @@
+#include <string.h>
+
+#include "spsc_ring.h"
+
+void spsc_ring_init(spsc_ring_t *ring, uint8_t *buffer, uint32_t capacity, spsc_policy_t policy)
+{
+    ring->buffer = buffer;
+    ring->capacity = capacity;
+    ring->policy = policy;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->stats.frames_pushed, 0);
+    atomic_init(&ring->stats.frames_popped, 0);
+    atomic_init(&ring->stats.frames_dropped, 0);
+    atomic_init(&ring->stats.bytes_high_water, 0);
+}
+
+static void ring_write(spsc_ring_t *ring, uint32_t pos, const void *src, uint32_t length)
+{
+    uint32_t offset = pos & (ring->capacity - 1);
+    uint32_t first = ring->capacity - offset;
+
+    if (first >= length)
+    {
+        memcpy(&ring->buffer[offset], src, length);
+        return;
+    }
+    memcpy(&ring->buffer[offset], src, first);
+    memcpy(ring->buffer, (const uint8_t *)src + first, length - first);
+}
+
+static void ring_read(const spsc_ring_t *ring, uint32_t pos, void *dst, uint32_t length)
+{
+    uint32_t offset = pos & (ring->capacity - 1);
+    uint32_t first = ring->capacity - offset;
+
+    if (first >= length)
+    {
+        memcpy(dst, &ring->buffer[offset], length);
+        return;
+    }
+    memcpy(dst, &ring->buffer[offset], first);
+    memcpy((uint8_t *)dst + first, ring->buffer, length - first);
+}
+
+static uint32_t frame_length_at(const spsc_ring_t *ring, uint32_t pos)
+{
+    uint16_t length;
+    ring_read(ring, pos, &length, sizeof(length));
+    return SPSC_FRAME_HEADER + length;
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, const void *data, uint16_t length)
+{
+    uint32_t needed = SPSC_FRAME_HEADER + length;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (needed > ring->capacity)
+    {
+        atomic_fetch_add_explicit(&ring->stats.frames_dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    while (ring->capacity - (head - tail) < needed)
+    {
+        if (ring->policy == SPSC_DROP_NEWEST)
+        {
+            atomic_fetch_add_explicit(&ring->stats.frames_dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        // Only the producer writes frame data, so the length at tail is stable.
+        // Losing the race means the consumer just freed that frame itself.
+        uint32_t next = tail + frame_length_at(ring, tail);
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, next, memory_order_acq_rel, memory_order_acquire))
+        {
+            atomic_fetch_add_explicit(&ring->stats.frames_dropped, 1, memory_order_relaxed);
+            tail = next;
+        }
+    }
+
+    ring_write(ring, head, &length, sizeof(length));
+    ring_write(ring, head + SPSC_FRAME_HEADER, data, length);
+    atomic_store_explicit(&ring->head, head + needed, memory_order_release);
+    atomic_fetch_add_explicit(&ring->stats.frames_pushed, 1, memory_order_relaxed);
+
+    uint32_t used = head + needed - tail;
+    if (used > atomic_load_explicit(&ring->stats.bytes_high_water, memory_order_relaxed))
+    {
+        atomic_store_explicit(&ring->stats.bytes_high_water, used, memory_order_relaxed);
+    }
+    return true;
+}
+
+// Copies the oldest frame into dst and returns its length, 0 when the ring is
+// empty. Frames larger than dst_size are dropped and return -1.
+int spsc_ring_pop(spsc_ring_t *ring, void *dst, size_t dst_size)
+{
+    for (;;)
+    {
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (head == tail)
+        {
+            return 0;
+        }
+
+        uint16_t length;
+        ring_read(ring, tail, &length, sizeof(length));
+        bool fits = (length <= dst_size) && (SPSC_FRAME_HEADER + length <= head - tail);
+        if (fits)
+        {
+            ring_read(ring, tail + SPSC_FRAME_HEADER, dst, length);
+        }
+
+        // If the producer dropped this frame while it was being copied the
+        // bytes may be torn, the failed exchange sends us round again
+        uint32_t next = tail + SPSC_FRAME_HEADER + length;
+        if (!atomic_compare_exchange_strong_explicit(&ring->tail, &tail, next, memory_order_acq_rel, memory_order_acquire))
+        {
+            continue;
+        }
+        if (!fits)
+        {
+            atomic_fetch_add_explicit(&ring->stats.frames_dropped, 1, memory_order_relaxed);
+            return -1;
+        }
+        atomic_fetch_add_explicit(&ring->stats.frames_popped, 1, memory_order_relaxed);
+        return length;
+    }
+}
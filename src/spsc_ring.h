@@ -0,0 +1,46 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free single producer / single consumer ring of variable length frames.
+// Pushing never blocks: when a frame does not fit, the ring either drops the
+// new frame or discards the oldest ones to make room, as set by the policy.
+// Capacity must be a power of two. Frames carry a 16 bit length header.
+
+typedef enum
+{
+    SPSC_DROP_NEWEST,
+    SPSC_DROP_OLDEST,
+} spsc_policy_t;
+
+typedef struct
+{
+    atomic_uint frames_pushed;
+    atomic_uint frames_popped;
+    atomic_uint frames_dropped;
+    atomic_uint bytes_high_water;
+} spsc_ring_stats_t;
+
+typedef struct
+{
+    uint8_t *buffer;
+    uint32_t capacity;
+    spsc_policy_t policy;
+    // Free running byte counters, written by the producer and consumer only
+    // (the producer may also advance tail when dropping the oldest frames)
+    atomic_uint head;
+    atomic_uint tail;
+    spsc_ring_stats_t stats;
+} spsc_ring_t;
+
+#define SPSC_FRAME_HEADER (sizeof(uint16_t))
+
+void spsc_ring_init(spsc_ring_t *ring, uint8_t *buffer, uint32_t capacity, spsc_policy_t policy);
+bool spsc_ring_push(spsc_ring_t *ring, const void *data, uint16_t length);
+int spsc_ring_pop(spsc_ring_t *ring, void *dst, size_t dst_size);
+
+#endif
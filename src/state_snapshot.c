@@ -0,0 +1,272 @@
+#include <string.h>
+
+#include "state_snapshot.h"
+
+#define FIELD_SIZE(field) sizeof(((gpsdo_state_t *)0)->field)
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t crc;
+} snapshot_header_t;
+
+typedef struct
+{
+    uint8_t tag;
+    bool string;
+    uint8_t source;
+    uint16_t offset;
+    uint16_t size;
+} snapshot_field_t;
+
+#define DESCRIBE_VALUE(tag, field, source) \
+    [STATE_FIELD_##field] = {tag, false, source, offsetof(gpsdo_state_t, field), FIELD_SIZE(field)},
+#define DESCRIBE_STRING(tag, field, source) \
+    [STATE_FIELD_##field] = {tag, true, source, offsetof(gpsdo_state_t, field), FIELD_SIZE(field)},
+
+static const snapshot_field_t snapshot_fields[STATE_FIELD_COUNT] = {
+    STATE_SNAPSHOT_FIELDS(DESCRIBE_VALUE, DESCRIBE_STRING)};
+
+// Build time checks: a duplicate tag fails as a duplicate enumerator, and
+// every record must fit the one byte length and the blob
+#define CHECK_TAG(tag, field, source) STATE_SNAPSHOT_TAG_##tag = (tag),
+enum
+{
+    STATE_SNAPSHOT_FIELDS(CHECK_TAG, CHECK_TAG)
+};
+#define SIZE_VALUE(tag, field, source) +2 + FIELD_SIZE(field)
+_Static_assert(STATE_FIELD_COUNT <= 32, "the stale bitmap holds 32 fields");
+_Static_assert(sizeof(snapshot_header_t) STATE_SNAPSHOT_FIELDS(SIZE_VALUE, SIZE_VALUE) <= STATE_SNAPSHOT_MAX_SIZE,
+               "STATE_SNAPSHOT_MAX_SIZE is too small for the fields");
+
+// Fields refreshed by each command and by the TOD packets
+static uint32_t source_fields[STATE_SNAPSHOT_SOURCE_TOD + 1];
+
+// CRC-32 as used by zlib
+static uint32_t crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+
+    while (len--)
+    {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+void state_snapshot_init(state_snapshot_t *snapshot)
+{
+    atomic_init(&snapshot->stale, 0);
+    snapshot->saved_crc = 0;
+    snapshot->saves = 0;
+    snapshot->skipped = 0;
+    memset(source_fields, 0, sizeof(source_fields));
+    for (int i = 0; i < STATE_FIELD_COUNT; i++)
+    {
+        source_fields[snapshot_fields[i].source] |= 1u << i;
+    }
+}
+
+// Returns the blob length, or -1 when it does not fit in size
+int state_snapshot_encode(const gpsdo_state_t *state, uint8_t *buffer, size_t size)
+{
+    const uint8_t *base = (const uint8_t *)state;
+    size_t length = sizeof(snapshot_header_t);
+
+    for (int i = 0; i < STATE_FIELD_COUNT; i++)
+    {
+        const snapshot_field_t *field = &snapshot_fields[i];
+        const uint8_t *value = base + field->offset;
+        size_t value_length = field->string ? strnlen((const char *)value, field->size) : field->size;
+
+        if (length + 2 + value_length > size)
+        {
+            return -1;
+        }
+        buffer[length++] = field->tag;
+        buffer[length++] = value_length;
+        memcpy(&buffer[length], value, value_length);
+        length += value_length;
+    }
+
+    snapshot_header_t header = {
+        .magic = STATE_SNAPSHOT_MAGIC,
+        .version = STATE_SNAPSHOT_VERSION,
+        .length = length - sizeof(snapshot_header_t),
+        .crc = crc32(&buffer[sizeof(snapshot_header_t)], length - sizeof(snapshot_header_t)),
+    };
+    memcpy(buffer, &header, sizeof(header));
+    return length;
+}
+
+static const snapshot_field_t *field_by_tag(uint8_t tag, int *index)
+{
+    for (int i = 0; i < STATE_FIELD_COUNT; i++)
+    {
+        if (snapshot_fields[i].tag == tag)
+        {
+            *index = i;
+            return &snapshot_fields[i];
+        }
+    }
+    return NULL;
+}
+
+// Restores the fields found in the blob and sets their bits in restored.
+// Returns -1, leaving state alone, when the blob is damaged or newer.
+int state_snapshot_decode(gpsdo_state_t *state, const uint8_t *buffer, size_t length, uint32_t *restored)
+{
+    snapshot_header_t header;
+    uint8_t *base = (uint8_t *)state;
+
+    *restored = 0;
+    if (length < sizeof(header))
+    {
+        return -1;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    if ((header.magic != STATE_SNAPSHOT_MAGIC) || (header.version > STATE_SNAPSHOT_VERSION) ||
+        (sizeof(header) + header.length > length) ||
+        (crc32(&buffer[sizeof(header)], header.length) != header.crc))
+    {
+        return -1;
+    }
+
+    const uint8_t *record = &buffer[sizeof(header)];
+    const uint8_t *end = record + header.length;
+    while (record + 2 <= end)
+    {
+        uint8_t tag = record[0];
+        uint8_t value_length = record[1];
+        const uint8_t *value = &record[2];
+        int index;
+
+        record += 2 + value_length;
+        if (record > end)
+        {
+            break;
+        }
+        const snapshot_field_t *field = field_by_tag(tag, &index);
+        if (field == NULL)
+        {
+            continue;
+        }
+        if (field->string)
+        {
+            size_t copied = (value_length < field->size) ? value_length : field->size - 1;
+            memcpy(base + field->offset, value, copied);
+            base[field->offset + copied] = '\0';
+        }
+        else if (value_length == field->size)
+        {
+            memcpy(base + field->offset, value, value_length);
+        }
+        else
+        {
+            continue;
+        }
+        *restored |= 1u << index;
+    }
+    return 0;
+}
+
+// Clears the stale marks of the fields a command response or a TOD packet
+// has just refreshed
+void state_snapshot_refresh(state_snapshot_t *snapshot, int source)
+{
+    if ((source >= 0) && (source <= STATE_SNAPSHOT_SOURCE_TOD) &&
+        (atomic_load_explicit(&snapshot->stale, memory_order_relaxed) & source_fields[source]))
+    {
+        atomic_fetch_and(&snapshot->stale, ~source_fields[source]);
+    }
+}
+
+bool state_snapshot_stale(state_snapshot_t *snapshot, state_field_t field)
+{
+    return (atomic_load_explicit(&snapshot->stale, memory_order_relaxed) >> field) & 1;
+}
+
+#ifdef ESP_PLATFORM
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#define STATE_SNAPSHOT_NAMESPACE "gpsdo"
+#define STATE_SNAPSHOT_KEY "snapshot"
+
+// Initializes NVS and restores the snapshot into state. Returns the number
+// of fields restored, or -1 when there is no usable snapshot.
+int state_snapshot_load(state_snapshot_t *snapshot, gpsdo_state_t *state)
+{
+    uint8_t buffer[STATE_SNAPSHOT_MAX_SIZE];
+    size_t length = sizeof(buffer);
+    nvs_handle_t handle;
+    uint32_t restored;
+
+    esp_err_t err = nvs_flash_init();
+    if ((err == ESP_ERR_NVS_NO_FREE_PAGES) || (err == ESP_ERR_NVS_NEW_VERSION_FOUND))
+    {
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    if ((err != ESP_OK) || (nvs_open(STATE_SNAPSHOT_NAMESPACE, NVS_READONLY, &handle) != ESP_OK))
+    {
+        return -1;
+    }
+    err = nvs_get_blob(handle, STATE_SNAPSHOT_KEY, buffer, &length);
+    nvs_close(handle);
+    if ((err != ESP_OK) || (state_snapshot_decode(state, buffer, length, &restored) != 0))
+    {
+        return -1;
+    }
+
+    snapshot_header_t header;
+    memcpy(&header, buffer, sizeof(header));
+    snapshot->saved_crc = header.crc;
+    atomic_store(&snapshot->stale, restored);
+    return __builtin_popcount(restored);
+}
+
+// Writes the snapshot unless it matches the one already stored. Returns 1
+// when written, 0 when unchanged and -1 on failure.
+int state_snapshot_save(state_snapshot_t *snapshot, const gpsdo_state_t *state)
+{
+    uint8_t buffer[STATE_SNAPSHOT_MAX_SIZE];
+    snapshot_header_t header;
+    nvs_handle_t handle;
+
+    int length = state_snapshot_encode(state, buffer, sizeof(buffer));
+    if (length < 0)
+    {
+        return -1;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    if (header.crc == snapshot->saved_crc)
+    {
+        snapshot->skipped++;
+        return 0;
+    }
+    if (nvs_open(STATE_SNAPSHOT_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        return -1;
+    }
+    esp_err_t err = nvs_set_blob(handle, STATE_SNAPSHOT_KEY, buffer, length);
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK)
+    {
+        return -1;
+    }
+    snapshot->saved_crc = header.crc;
+    snapshot->saves++;
+    return 1;
+}
+#endif
@@ -0,0 +1,95 @@
+#ifndef STATE_SNAPSHOT_H_
+#define STATE_SNAPSHOT_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "main.h"
+#include "commands.h"
+
+// Last known gpsdo_state_t kept across resets, so the screens have something
+// to show before the UCCM has answered every poll. The snapshot is a small
+// binary blob in NVS: a header with a magic, the format version, the payload
+// length and a CRC-32, then one tag, length, value record per field.
+//
+// Fields are looked up by tag when restoring, so the layout of gpsdo_state_t
+// may change freely. Records with unknown tags are skipped, fields without a
+// record keep their defaults, strings are cut to the size of the field and
+// numbers whose size changed are dropped. A field that changes meaning gets
+// a new tag, tags are never reused. A newer format version is not read.
+//
+// Every restored field is marked stale until the source it comes from (a
+// polled command, or the TOD packets) delivers it again.
+
+#define STATE_SNAPSHOT_VERSION (1)
+#define STATE_SNAPSHOT_MAGIC (0x53535047) // "GPSS"
+#define STATE_SNAPSHOT_MAX_SIZE (320)
+// Fields refreshed by the TOD packets rather than a polled command
+#define STATE_SNAPSHOT_SOURCE_TOD (UCCM_COMMAND_COUNT)
+
+// Every persisted field, with its tag and its source:
+//   VALUE(tag, field, source)   number, restored only when its size matches
+//   STRING(tag, field, source)  char array, cut to fit when its size changed
+#define STATE_SNAPSHOT_FIELDS(VALUE, STRING)                      \
+    STRING(1, manufacturer, UCCM_CMD_IDN)                         \
+    STRING(2, model, UCCM_CMD_IDN)                                \
+    STRING(3, serial_number, UCCM_CMD_IDN)                        \
+    STRING(4, version, UCCM_CMD_IDN)                              \
+    VALUE(5, temperature, UCCM_CMD_SYST_STAT)                     \
+    VALUE(6, antenna_voltage, UCCM_CMD_SYST_STAT)                 \
+    VALUE(7, antenna_current, UCCM_CMD_SYST_STAT)                 \
+    VALUE(8, dac, UCCM_CMD_EFC_REL)                               \
+    VALUE(9, efc_data, UCCM_CMD_EFC_DATA)                         \
+    VALUE(10, phase, UCCM_CMD_SYST_STAT)                          \
+    VALUE(11, tint, UCCM_CMD_SYNC_TINT)                           \
+    VALUE(12, freq_diff, UCCM_CMD_DIAG_LOOP)                      \
+    VALUE(13, tfom, UCCM_CMD_SYST_STAT)                           \
+    VALUE(14, ffom, UCCM_CMD_SYST_STAT)                           \
+    STRING(15, ffom_status, UCCM_CMD_SYNC_FFOM)                   \
+    VALUE(16, pullin_range, UCCM_CMD_PULLINRANGE)                 \
+    STRING(17, status_output, UCCM_CMD_OUTP_STAT)                 \
+    STRING(18, status_gps, UCCM_CMD_LED_GPSL)                     \
+    STRING(19, alarm_hw, UCCM_CMD_ALAR_HARD)                      \
+    STRING(20, alarm_op, UCCM_CMD_ALAR_OPER)                      \
+    VALUE(21, week, STATE_SNAPSHOT_SOURCE_TOD)                    \
+    VALUE(22, utc_offset, STATE_SNAPSHOT_SOURCE_TOD)              \
+    STRING(23, date, STATE_SNAPSHOT_SOURCE_TOD)                   \
+    STRING(24, time, STATE_SNAPSHOT_SOURCE_TOD)                   \
+    VALUE(25, altitude, UCCM_CMD_GPS_POS)                         \
+    VALUE(26, latitude, UCCM_CMD_GPS_POS)                         \
+    VALUE(27, longitude, UCCM_CMD_GPS_POS)                        \
+    VALUE(28, satellite_trk, UCCM_CMD_SYST_STAT)                  \
+    VALUE(29, satellite_vis, UCCM_CMD_SYST_STAT)
+
+#define STATE_FIELD_ID(tag, field, source) STATE_FIELD_##field,
+
+typedef enum
+{
+    STATE_SNAPSHOT_FIELDS(STATE_FIELD_ID, STATE_FIELD_ID)
+        STATE_FIELD_COUNT
+} state_field_t;
+
+typedef struct
+{
+    // Bit per state_field_t, set while the field holds a restored value
+    atomic_uint stale;
+    // CRC of the last blob written, an unchanged state is not written again
+    uint32_t saved_crc;
+    uint32_t saves;
+    uint32_t skipped;
+} state_snapshot_t;
+
+void state_snapshot_init(state_snapshot_t *snapshot);
+int state_snapshot_encode(const gpsdo_state_t *state, uint8_t *buffer, size_t size);
+int state_snapshot_decode(gpsdo_state_t *state, const uint8_t *buffer, size_t length, uint32_t *restored);
+void state_snapshot_refresh(state_snapshot_t *snapshot, int source);
+bool state_snapshot_stale(state_snapshot_t *snapshot, state_field_t field);
+
+#ifdef ESP_PLATFORM
+int state_snapshot_load(state_snapshot_t *snapshot, gpsdo_state_t *state);
+int state_snapshot_save(state_snapshot_t *snapshot, const gpsdo_state_t *state);
+#endif
+
+#endif
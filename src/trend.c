@@ -0,0 +1,103 @@
+#include <string.h>
+
+#include "trend.h"
+
+void trend_init(trend_t *trend, uint16_t samples_per_column)
+{
+    memset(trend, 0, sizeof(trend_t));
+    trend->per_column = samples_per_column;
+}
+
+// Drops candidates that left the window, then the ones the new column
+// dominates, then appends it. minimum picks which deque this is.
+static void deque_push(trend_t *trend, trend_deque_t *deque, uint32_t column, bool minimum)
+{
+    float value = minimum ? trend->columns[column % TREND_WIDTH].min : trend->columns[column % TREND_WIDTH].max;
+
+    while ((deque->head != deque->tail) && ((column - deque->index[deque->head % TREND_WIDTH]) >= TREND_WIDTH))
+    {
+        deque->head++;
+    }
+    while (deque->head != deque->tail)
+    {
+        const trend_column_t *back = &trend->columns[deque->index[(deque->tail - 1) % TREND_WIDTH] % TREND_WIDTH];
+        if (minimum ? (back->min < value) : (back->max > value))
+        {
+            break;
+        }
+        deque->tail--;
+    }
+    deque->index[deque->tail % TREND_WIDTH] = column;
+    deque->tail++;
+}
+
+void trend_add(trend_t *trend, float value)
+{
+    trend->last = value;
+    if (trend->in_column == 0)
+    {
+        trend->current.min = value;
+        trend->current.max = value;
+    }
+    else
+    {
+        trend->current.min = (value < trend->current.min) ? value : trend->current.min;
+        trend->current.max = (value > trend->current.max) ? value : trend->current.max;
+    }
+
+    if (++trend->in_column < trend->per_column)
+    {
+        return;
+    }
+
+    uint32_t column = trend->next++;
+    trend->columns[column % TREND_WIDTH] = trend->current;
+    trend->in_column = 0;
+    deque_push(trend, &trend->low, column, true);
+    deque_push(trend, &trend->high, column, false);
+}
+
+// Range over everything trend_column can return, false without samples
+bool trend_range(const trend_t *trend, float *low, float *high)
+{
+    bool have_columns = trend->low.head != trend->low.tail;
+
+    if (!have_columns && (trend->in_column == 0))
+    {
+        return false;
+    }
+    if (have_columns)
+    {
+        *low = trend->columns[trend->low.index[trend->low.head % TREND_WIDTH] % TREND_WIDTH].min;
+        *high = trend->columns[trend->high.index[trend->high.head % TREND_WIDTH] % TREND_WIDTH].max;
+    }
+    if (trend->in_column > 0)
+    {
+        *low = (!have_columns || (trend->current.min < *low)) ? trend->current.min : *low;
+        *high = (!have_columns || (trend->current.max > *high)) ? trend->current.max : *high;
+    }
+    return true;
+}
+
+// Envelope shown at screen column x, the newest data on the right. The
+// partly filled column is shown as soon as it has a sample.
+bool trend_column(const trend_t *trend, int x, trend_column_t *column)
+{
+    uint32_t age = TREND_WIDTH - 1 - x;
+
+    if (trend->in_column > 0)
+    {
+        if (age == 0)
+        {
+            *column = trend->current;
+            return true;
+        }
+        age--;
+    }
+    if (age >= trend->next)
+    {
+        return false;
+    }
+    *column = trend->columns[(trend->next - 1 - age) % TREND_WIDTH];
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef TREND_H_
+#define TREND_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Min/max decimated history for the trend screens. Samples are folded into
+// the envelope of the column being filled as they arrive, so drawing walks
+// TREND_WIDTH columns and never the raw samples. The autoscale range comes
+// from monotonic deques over the completed columns, amortized O(1) per
+// column.
+
+// One column per display pixel
+#define TREND_WIDTH (128)
+
+typedef struct
+{
+    float min;
+    float max;
+} trend_column_t;
+
+// Column numbers of the window candidates, their values sit in columns[]
+typedef struct
+{
+    uint32_t index[TREND_WIDTH];
+    uint32_t head;
+    uint32_t tail;
+} trend_deque_t;
+
+typedef struct
+{
+    // Completed columns, column n lives at n % TREND_WIDTH
+    trend_column_t columns[TREND_WIDTH];
+    // Number of the column being filled
+    uint32_t next;
+    uint16_t per_column;
+    uint16_t in_column;
+    trend_column_t current;
+    float last;
+    // Ascending minimums and descending maximums of the window
+    trend_deque_t low;
+    trend_deque_t high;
+} trend_t;
+
+void trend_init(trend_t *trend, uint16_t samples_per_column);
+void trend_add(trend_t *trend, float value);
+bool trend_range(const trend_t *trend, float *low, float *high);
+bool trend_column(const trend_t *trend, int x, trend_column_t *column);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "main.h"
+#include "uccm_profile.h"
+#include "uccm_status.h"
+
+#define TOD_PHASE_SETTLING (0x01)
+#define TOD_LEAP_PENDING (0x02)
+#define TOD_POWER_UP (0x41)
+#define TOD_NOT_LOCKED (0x4f)
+
+uccm_profile_stats_t uccm_profile_stats;
+
+// Bytes as the UCCM sends them
+static void tod_raw(const uint8_t *packet, uint8_t *status)
+{
+    memcpy(status, packet, 4);
+}
+
+// Both variants go through 0x43 on power up, the UCCM also through 0x63, the
+// leap pending bit means nothing until the phase has settled. The UCCM
+// starts byte 35 at 0x41 before the 0x4F the UCCM-P starts with, none of the
+// bits of the not locked flag are set in it.
+static void tod_trimble_uccm(const uint8_t *packet, uint8_t *status)
+{
+    memcpy(status, packet, 4);
+    if (status[0] & TOD_PHASE_SETTLING)
+    {
+        status[0] &= ~TOD_LEAP_PENDING;
+    }
+    if (status[2] == TOD_POWER_UP)
+    {
+        status[2] = TOD_NOT_LOCKED;
+    }
+}
+
+// Most specific first, the last one matches anything. The models match by
+// prefix, so the UCCM-P comes before the UCCM. Both dump the same layout, the
+// UCCM-P sends its TOD status bytes as alarm.h describes them.
+static const uccm_profile_t uccm_profiles[] = {
+    {"Trimble UCCM-P", "Trimble", "UCCM-P", NULL, uccm_status_trimble, tod_raw},
+    {"Trimble UCCM", "Trimble", "UCCM", NULL, uccm_status_trimble, tod_trimble_uccm},
+    {"generic", NULL, NULL, NULL, NULL, tod_raw},
+};
+
+#define UCCM_PROFILE_COUNT (sizeof(uccm_profiles) / sizeof(uccm_profiles[0]))
+#define UCCM_PROFILE_GENERIC (&uccm_profiles[UCCM_PROFILE_COUNT - 1])
+
+static _Atomic(const uccm_profile_t *) current = UCCM_PROFILE_GENERIC;
+
+// Compares an *IDN? field without its surrounding blanks, prefix allows it
+// to go on past the expected text
+static bool idn_matches(const char *field, const char *expected, bool prefix)
+{
+    if (expected == NULL)
+    {
+        return true;
+    }
+    size_t length = strlen(expected);
+    while (*field == ' ')
+    {
+        field++;
+    }
+    if (strncmp(field, expected, length) != 0)
+    {
+        return false;
+    }
+    field += length;
+    while ((*field == ' ') || (*field == '\r') || (*field == '\n'))
+    {
+        field++;
+    }
+    return prefix || (*field == '\0');
+}
+
+// Picks the profile of the identification in the state, true when it changed
+bool uccm_profile_select(const gpsdo_state_t *gpsdo_status)
+{
+    const uccm_profile_t *profile = UCCM_PROFILE_GENERIC;
+
+    for (int i = 0; i < UCCM_PROFILE_COUNT; i++)
+    {
+        if (idn_matches(gpsdo_status->manufacturer, uccm_profiles[i].manufacturer, false) &&
+            idn_matches(gpsdo_status->model, uccm_profiles[i].model, true) &&
+            idn_matches(gpsdo_status->version, uccm_profiles[i].version, true))
+        {
+            profile = &uccm_profiles[i];
+            break;
+        }
+    }
+    return atomic_exchange(&current, profile) != profile;
+}
+
+const uccm_profile_t *uccm_profile_current()
+{
+    return atomic_load(&current);
+}
@@ -0,0 +1,81 @@
+#ifndef UCCM_PROFILE_H_
+#define UCCM_PROFILE_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+// Variants of the UCCM, told apart by the *IDN? manufacturer, model and
+// version. A profile carries what differs between them:
+//   - where the values sit in the SYST:STAT? dump, parsed straight from
+//     those positions by a parser generated from the layout below
+//   - how the TOD status bytes map onto the UCCM-P ones alarm.h describes
+// Every variant known so far answers all the commands of commands.h, they
+// are polled at the periods given there.
+// Until *IDN? has answered, and for variants without a profile, the generic
+// profile finds the values of the dump by their keywords.
+
+// Positions in the SYST:STAT? dump, lines numbered as parse_status() splits
+// the response, as the position parser it replaced numbered them:
+//   KEY(line, column, text)            text that must be at the position
+//   VALUE(kind, line, column, field)   number at the position, INT, FLOAT or
+//                                      UNTRACKED (added to satellite_trk)
+// The satellite rows follow the table header line. Every position is checked
+// before any field is written, a dump that does not match is handed to the
+// keyword parser. tools/uccm_status_test.c checks the layout against a dump.
+#define UCCM_TRIMBLE_STATUS_TABLE (11)
+#define UCCM_TRIMBLE_STATUS(KEY, VALUE)                      \
+    /* TFOM     0            FFOM      0 */                  \
+    KEY(5, 0, "TFOM")                                        \
+    KEY(5, 22, "FFOM")                                       \
+    VALUE(INT, 5, 4, tfom)                                   \
+    VALUE(INT, 5, 26, ffom)                                  \
+    /* >>GPS :     [phase : -4.714E-10] */                   \
+    KEY(8, 13, "phase :")                                    \
+    VALUE(FLOAT, 8, 20, phase)                               \
+    /* Tracking:  7 ___   Not Tracking:  5 _______ */        \
+    KEY(10, 0, "Tracking:")                                  \
+    KEY(10, 19, "Not Tracking:")                             \
+    VALUE(INT, 10, 9, satellite_trk)                         \
+    VALUE(UNTRACKED, 10, 32, satellite_vis)                  \
+    /* PRN  El  AZ  CNO   PRN  El  Az ... */                 \
+    KEY(UCCM_TRIMBLE_STATUS_TABLE, 0, "PRN  El")             \
+    /* ELEV MASK  5 deg ...  ANT V=5.112V, I=24.400mA */     \
+    KEY(24, 46, "ANT V=")                                    \
+    KEY(24, 60, "I=")                                        \
+    VALUE(FLOAT, 24, 52, antenna_voltage)                    \
+    VALUE(FLOAT, 24, 62, antenna_current)                    \
+    /* Temp = 37.000 / NONE */                               \
+    KEY(26, 0, "Temp =")                                     \
+    VALUE(FLOAT, 26, 6, temperature)
+
+typedef struct
+{
+    const char *name;
+    // Matched against the *IDN? fields, NULL matches anything. The model and
+    // the version match by prefix.
+    const char *manufacturer;
+    const char *model;
+    const char *version;
+    // Straight-line SYST:STAT? parser, false when the dump does not match
+    bool (*parse_status)(gpsdo_state_t *gpsdo_status, char *const *lines, const uint16_t *lengths, int count);
+    // TOD packet bytes 33 to 36 into gpsdo_state_t.tod_status
+    void (*decode_tod)(const uint8_t *packet, uint8_t *status);
+} uccm_profile_t;
+
+typedef struct
+{
+    // SYST:STAT? dumps parsed by the profile, and those it had to hand to
+    // the keyword parser
+    atomic_uint fast;
+    atomic_uint fallback;
+} uccm_profile_stats_t;
+
+extern uccm_profile_stats_t uccm_profile_stats;
+
+bool uccm_profile_select(const gpsdo_state_t *gpsdo_status);
+const uccm_profile_t *uccm_profile_current();
+
+#endif
@@ -0,0 +1,355 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "uccm_profile.h"
+#include "uccm_status.h"
+
+/* TFOM     0            FFOM      0 */
+static void status_fom(gpsdo_state_t *gpsdo_status, const char *line, const char *anchor)
+{
+    const char *ffom = strstr(anchor, "FFOM");
+
+    gpsdo_status->tfom = atoi(anchor + 4);
+    if (ffom != NULL)
+    {
+        gpsdo_status->ffom = atoi(ffom + 4);
+    }
+}
+
+/* >>GPS :     [phase : -4.714E-10] */
+static void status_phase(gpsdo_state_t *gpsdo_status, const char *line, const char *anchor)
+{
+    gpsdo_status->phase = atof(anchor + 7);
+}
+
+/* Tracking:  7 ___   Not Tracking:  5 _______   Time ____________________________ */
+static void status_tracking(gpsdo_state_t *gpsdo_status, const char *line, const char *anchor)
+{
+    const char *not_tracking = strstr(anchor + 9, "Tracking:");
+
+    gpsdo_status->satellite_trk = atoi(anchor + 9);
+    gpsdo_status->satellite_vis = gpsdo_status->satellite_trk;
+    if (not_tracking != NULL)
+    {
+        gpsdo_status->satellite_vis += atoi(not_tracking + 9);
+    }
+}
+
+#define STATUS_SATELLITE_ROWS (GPSDO_MAX_SATELLITES / 2)
+
+/* PRN  El  AZ  CNO   PRN  El  Az                GPS      09:23:09     13 OCT 2021 */
+static void status_satellite_header(gpsdo_state_t *gpsdo_status, const char *line, const char *anchor)
+{
+    // Only marks the start of the satellite rows, see uccm_status_keywords
+}
+
+// Reads a right aligned number from the columns [start, end), -1 if blank
+static int status_column(const char *line, size_t length, size_t start, size_t end)
+{
+    if (start >= length)
+    {
+        return -1;
+    }
+    end = MIN(end, length);
+    for (size_t i = start; i < end; i++)
+    {
+        if (((line[i] >= '0') && (line[i] <= '9')) || (line[i] == '-'))
+        {
+            return atoi(&line[i]);
+        }
+    }
+    return -1;
+}
+
+/*   1  63 139  50      6   6 304                GPS      Synchronized to UTC
+ * Tracked satellites on the left with their C/N0, satellites that are
+ * visible but not tracked on the right. Row n fills satellites[n] and
+ * satellites[STATUS_SATELLITE_ROWS + n], a PRN of 0 marks an empty slot. */
+static void status_satellite_row(gpsdo_state_t *gpsdo_status, const char *line, int row)
+{
+    static const uint8_t tracked[] = {0, 3, 7, 11, 16};
+    static const uint8_t visible[] = {16, 22, 26, 30};
+    size_t length = strlen(line);
+    gps_satellite_t *sat;
+
+    sat = &gpsdo_status->satellites[row];
+    sat->prn = MAX(0, status_column(line, length, tracked[0], tracked[1]));
+    sat->e1 = status_column(line, length, tracked[1], tracked[2]);
+    sat->az = status_column(line, length, tracked[2], tracked[3]);
+    sat->cn = MAX(0, status_column(line, length, tracked[3], tracked[4]));
+
+    sat = &gpsdo_status->satellites[STATUS_SATELLITE_ROWS + row];
+    sat->prn = MAX(0, status_column(line, length, visible[0], visible[1]));
+    sat->e1 = status_column(line, length, visible[1], visible[2]);
+    sat->az = status_column(line, length, visible[2], visible[3]);
+    sat->cn = 0;
+}
+
+// Empties the slots of the rows the last dump no longer had
+static void status_clear_satellites(gpsdo_state_t *gpsdo_status, int first_row)
+{
+    for (int row = first_row; row < STATUS_SATELLITE_ROWS; row++)
+    {
+        gpsdo_status->satellites[row].prn = 0;
+        gpsdo_status->satellites[STATUS_SATELLITE_ROWS + row].prn = 0;
+    }
+}
+
+static bool status_is_satellite_row(const char *line)
+{
+    while (*line == ' ')
+    {
+        line++;
+    }
+    return (*line >= '0') && (*line <= '9');
+}
+
+/* ELEV MASK  5 deg                              ANT V=5.112V, I=24.400mA */
+static void status_antenna(gpsdo_state_t *gpsdo_status, const char *line, const char *anchor)
+{
+    const char *current = strstr(anchor, "I=");
+
+    gpsdo_status->antenna_voltage = atof(anchor + 6);
+    if (current != NULL)
+    {
+        gpsdo_status->antenna_current = atof(current + 2);
+    }
+}
+
+/* Temp = 37.000 / NONE */
+static void status_temperature(gpsdo_state_t *gpsdo_status, const char *line, const char *anchor)
+{
+    gpsdo_status->temperature = atof(anchor + 6);
+}
+
+// Lines of the SYST:STAT? dump are recognized by a keyword anywhere on the
+// line rather than by their position, so firmware variants that add, drop or
+// reorder lines still parse.
+typedef struct
+{
+    const char *keyword;
+    void (*parse)(gpsdo_state_t *gpsdo_status, const char *line, const char *anchor);
+} status_anchor_t;
+
+static const status_anchor_t status_anchors[] = {
+    {"TFOM", status_fom},
+    {"phase :", status_phase},
+    {"Tracking:", status_tracking},
+    {"PRN  El", status_satellite_header},
+    {"ANT V=", status_antenna},
+    {"Temp =", status_temperature},
+};
+
+#define STATUS_ANCHOR_COUNT (sizeof(status_anchors) / sizeof(status_anchors[0]))
+#define STATUS_ANCHOR_NONE (-1)
+
+// Fingerprint of each line of the previous dumps. A line whose hash is
+// unchanged at the same position is skipped, by either parser, since the
+// fields it holds were written from that same text.
+typedef struct
+{
+    unsigned long hash;
+    int8_t anchor;
+} status_line_t;
+
+typedef enum
+{
+    STATUS_OWNER_NONE,
+    STATUS_OWNER_KEYWORDS,
+    STATUS_OWNER_LAYOUT,
+} status_owner_t;
+
+static status_line_t status_lines[UCCM_STATUS_MAX_LINES];
+// Parser the fingerprints belong to. The two may read a field from different
+// lines of a dump, so the fingerprints only hold while the same one parses.
+static status_owner_t status_lines_owner;
+
+static unsigned long status_hash(const char *str)
+{
+    unsigned long hash = 5381;
+    int c;
+
+    while ((c = *str++))
+        hash = ((hash << 5) + hash) + c;
+    return hash;
+}
+
+void uccm_status_invalidate()
+{
+    status_lines_owner = STATUS_OWNER_NONE;
+}
+
+static void status_lines_claim(status_owner_t owner)
+{
+    if (status_lines_owner != owner)
+    {
+        memset(status_lines, 0, sizeof(status_lines));
+        status_lines_owner = owner;
+    }
+}
+
+int uccm_status_keywords(gpsdo_state_t *gpsdo_status, char *const *lines, int count)
+{
+    int reparsed = 0;
+    // Row within the satellite table, -1 outside of it
+    int satellite_row = -1;
+
+    status_lines_claim(STATUS_OWNER_KEYWORDS);
+    for (int line_number = 0; line_number < MIN(count, UCCM_STATUS_MAX_LINES); line_number++)
+    {
+        const char *found = lines[line_number];
+        unsigned long line_hash = status_hash(found);
+        status_line_t *cached = &status_lines[line_number];
+        bool unchanged = (cached->hash == line_hash);
+
+        // The satellite rows carry no keyword, they are whatever follows the
+        // table header up to the first line that does not start with a PRN
+        if (satellite_row >= 0)
+        {
+            if ((satellite_row < STATUS_SATELLITE_ROWS) && status_is_satellite_row(found))
+            {
+                if (!unchanged)
+                {
+                    reparsed++;
+                    status_satellite_row(gpsdo_status, found, satellite_row);
+                }
+                cached->hash = line_hash;
+                cached->anchor = STATUS_ANCHOR_NONE;
+                satellite_row++;
+                continue;
+            }
+            status_clear_satellites(gpsdo_status, satellite_row);
+            satellite_row = -1;
+        }
+
+        if (unchanged)
+        {
+            if ((cached->anchor != STATUS_ANCHOR_NONE) && (status_anchors[cached->anchor].parse == status_satellite_header))
+            {
+                satellite_row = 0;
+            }
+            continue;
+        }
+
+        reparsed++;
+        // A changed line most likely still carries the keyword it had before
+        int8_t hint = cached->anchor;
+        int8_t anchor_id = STATUS_ANCHOR_NONE;
+        for (int n = 0; n < STATUS_ANCHOR_COUNT; n++)
+        {
+            int i = (hint == STATUS_ANCHOR_NONE) ? n : (hint + n) % STATUS_ANCHOR_COUNT;
+            const char *anchor = strstr(found, status_anchors[i].keyword);
+            if (anchor != NULL)
+            {
+                status_anchors[i].parse(gpsdo_status, found, anchor);
+                anchor_id = i;
+                if (status_anchors[i].parse == status_satellite_header)
+                {
+                    satellite_row = 0;
+                }
+                break;
+            }
+        }
+
+        cached->hash = line_hash;
+        cached->anchor = anchor_id;
+    }
+    if (satellite_row >= 0)
+    {
+        status_clear_satellites(gpsdo_status, satellite_row);
+    }
+    return reparsed;
+}
+
+// Lines of one dump compared with their fingerprints so far, and those of
+// them that changed, a bit per line
+typedef struct
+{
+    uint64_t checked;
+    uint64_t changed;
+} status_scan_t;
+
+_Static_assert(UCCM_STATUS_MAX_LINES <= 64, "status_scan_t has a bit per line");
+
+// Compares a line with its fingerprint once per dump and takes the new one
+static bool status_line_changed(status_scan_t *scan, char *const *lines, int line)
+{
+    uint64_t bit = 1ull << line;
+
+    if (!(scan->checked & bit))
+    {
+        unsigned long line_hash = status_hash(lines[line]);
+        scan->checked |= bit;
+        if (status_lines[line].hash != line_hash)
+        {
+            status_lines[line].hash = line_hash;
+            scan->changed |= bit;
+        }
+    }
+    return (scan->changed & bit) != 0;
+}
+
+// Straight-line parsers of the fixed layouts in uccm_profile.h. The keys and
+// the bounds of every value are checked first, the fields are only written
+// once the whole dump is known to match, and only from the lines that
+// changed since the previous dump.
+#define STATUS_INT(text) atoi(text)
+#define STATUS_FLOAT(text) atof(text)
+#define STATUS_UNTRACKED(text) (gpsdo_status->satellite_trk + atoi(text))
+
+#define STATUS_CHECK_KEY(line, column, text) &&status_text_at(lines, lengths, count, line, column, text)
+#define STATUS_CHECK_VALUE(kind, line, column, field) &&((line) < count) && (lengths[line] > (column))
+#define STATUS_SKIP_KEY(line, column, text)
+#define STATUS_STORE_VALUE(kind, line, column, field)              \
+    if (status_line_changed(&scan, lines, line))                   \
+    {                                                              \
+        gpsdo_status->field = STATUS_##kind(&lines[line][column]); \
+    }
+
+// The satellite rows follow the table header line up to the first line that
+// does not start with a PRN, the fixed lines after them are in the layout.
+// The lines past the rows forget their fingerprints, as the slots they would
+// fill are cleared.
+#define STATUS_LAYOUT_PARSER(name, LAYOUT, table)                                                          \
+    bool name(gpsdo_state_t *gpsdo_status, char *const *lines, const uint16_t *lengths, int count)         \
+    {                                                                                                      \
+        int rows = 0;                                                                                      \
+        while (((table) + 1 + rows < count) && (rows < STATUS_SATELLITE_ROWS) &&                           \
+               status_is_satellite_row(lines[(table) + 1 + rows]))                                         \
+        {                                                                                                  \
+            rows++;                                                                                        \
+        }                                                                                                  \
+        if (!(true LAYOUT(STATUS_CHECK_KEY, STATUS_CHECK_VALUE)))                                          \
+        {                                                                                                  \
+            return false;                                                                                  \
+        }                                                                                                  \
+        status_scan_t scan = {0};                                                                          \
+        status_lines_claim(STATUS_OWNER_LAYOUT);                                                           \
+        LAYOUT(STATUS_SKIP_KEY, STATUS_STORE_VALUE)                                                        \
+        for (int row = 0; row < rows; row++)                                                               \
+        {                                                                                                  \
+            if (status_line_changed(&scan, lines, (table) + 1 + row))                                      \
+            {                                                                                              \
+                status_satellite_row(gpsdo_status, lines[(table) + 1 + row], row);                         \
+            }                                                                                              \
+        }                                                                                                  \
+        for (int row = rows; (row < STATUS_SATELLITE_ROWS) && ((table) + 1 + row < UCCM_STATUS_MAX_LINES); \
+             row++)                                                                                        \
+        {                                                                                                  \
+            status_lines[(table) + 1 + row].hash = 0;                                                      \
+        }                                                                                                  \
+        status_clear_satellites(gpsdo_status, rows);                                                       \
+        return true;                                                                                       \
+    }
+
+static bool status_text_at(char *const *lines, const uint16_t *lengths, int count, int line, size_t column,
+                           const char *text)
+{
+    size_t length = strlen(text);
+    return (line < count) && (lengths[line] >= column + length) && (memcmp(&lines[line][column], text, length) == 0);
+}
+
+STATUS_LAYOUT_PARSER(uccm_status_trimble, UCCM_TRIMBLE_STATUS, UCCM_TRIMBLE_STATUS_TABLE)
@@ -0,0 +1,27 @@
+#ifndef UCCM_STATUS_H_
+#define UCCM_STATUS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+// Parsers of the SYST:STAT? dump once parse_status() has split the response
+// into lines at the line feeds. Platform independent, see
+// tools/uccm_status_test.c.
+
+// Lines past these are ignored, a dump has 27
+#define UCCM_STATUS_MAX_LINES (64)
+
+// Finds the values by their keywords anywhere on a line, so firmware
+// variants that add, drop or reorder lines still parse. Lines unchanged
+// since the previous dump are skipped, returns how many were parsed again.
+int uccm_status_keywords(gpsdo_state_t *gpsdo_status, char *const *lines, int count);
+// Forgets the lines of the previous dumps, so the next one is parsed in full
+void uccm_status_invalidate();
+
+// Fixed layout parsers of uccm_profile.h, false when the dump does not match.
+// Like the keyword parser, only the lines that changed are parsed again.
+bool uccm_status_trimble(gpsdo_state_t *gpsdo_status, char *const *lines, const uint16_t *lengths, int count);
+
+#endif
@@ -1,9 +1,16 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 uint32_t atohex(char *s);
-unsigned long hash(const char *str);
-void parse_command(gpsdo_state_t *gpsdo_status, char *command, char *data);
+int parse_command(gpsdo_state_t *gpsdo_status, char *command, char *data);
+void parse_idn(gpsdo_state_t *gpsdo_status, char *data);
+void parse_loop(gpsdo_state_t *gpsdo_status, char *data);
+void parse_position(gpsdo_state_t *gpsdo_status, char *data);
+void parse_pullin_range(gpsdo_state_t *gpsdo_status, char *data);
 void parse_status(gpsdo_state_t *gpsdo_status, char *data);
+void format_gps_time(uint32_t gps_time, uint32_t utc_offset, char *date, char *time);
 
 #endif
@@ -0,0 +1,62 @@
+#ifdef ESP_PLATFORM
+
+#include <string.h>
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+
+#include "wifi_station.h"
+
+static const char *TAG = "wifi_station";
+
+static void wifi_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    if ((base == WIFI_EVENT) && (id == WIFI_EVENT_STA_START))
+    {
+        esp_wifi_connect();
+    }
+    else if ((base == WIFI_EVENT) && (id == WIFI_EVENT_STA_DISCONNECTED))
+    {
+        ESP_LOGW(TAG, "Disconnected, reason %d", ((wifi_event_sta_disconnected_t *)data)->reason);
+        esp_wifi_connect();
+    }
+    else if ((base == IP_EVENT) && (id == IP_EVENT_STA_GOT_IP))
+    {
+        ESP_LOGI(TAG, "Got address " IPSTR, IP2STR(&((ip_event_got_ip_t *)data)->ip_info.ip));
+    }
+}
+
+int wifi_station_init(const char *ssid, const char *password)
+{
+    wifi_init_config_t init_config = WIFI_INIT_CONFIG_DEFAULT();
+    wifi_config_t config = {0};
+
+    if (strlen(ssid) == 0)
+    {
+        ESP_LOGW(TAG, "No SSID configured, set GPSDO_WIFI_SSID");
+        return -1;
+    }
+    strncpy((char *)config.sta.ssid, ssid, sizeof(config.sta.ssid));
+    strncpy((char *)config.sta.password, password, sizeof(config.sta.password));
+
+    if ((esp_netif_init() != ESP_OK) || (esp_event_loop_create_default() != ESP_OK) ||
+        (esp_netif_create_default_wifi_sta() == NULL) || (esp_wifi_init(&init_config) != ESP_OK))
+    {
+        ESP_LOGE(TAG, "Failed to initialize WiFi");
+        return -1;
+    }
+    esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL);
+    esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL);
+    if ((esp_wifi_set_mode(WIFI_MODE_STA) != ESP_OK) || (esp_wifi_set_config(WIFI_IF_STA, &config) != ESP_OK) ||
+        (esp_wifi_start() != ESP_OK))
+    {
+        ESP_LOGE(TAG, "Failed to start WiFi");
+        return -1;
+    }
+    ESP_LOGI(TAG, "Connecting to %s", ssid);
+    return 0;
+}
+
+#endif
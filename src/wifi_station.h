@@ -0,0 +1,19 @@
+#ifndef WIFI_STATION_H_
+#define WIFI_STATION_H_
+
+// WiFi station for the metrics responder and the NTP server. The credentials
+// are build options, the station reconnects whenever the link drops.
+
+#ifndef GPSDO_WIFI_SSID
+#define GPSDO_WIFI_SSID ""
+#endif
+#ifndef GPSDO_WIFI_PASSWORD
+#define GPSDO_WIFI_PASSWORD ""
+#endif
+
+#ifdef ESP_PLATFORM
+// Needs NVS initialized, returns -1 without an SSID or when WiFi fails to start
+int wifi_station_init(const char *ssid, const char *password);
+#endif
+
+#endif
@@ -0,0 +1,451 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <time.h>
+#endif
+
+#include "window_stats.h"
+
+#ifdef ESP_PLATFORM
+// No vector unit, four accumulators the FPU can pipeline
+typedef struct
+{
+    float lane[WINDOW_STATS_LANES];
+} lanes_t;
+
+#define LANES_OP(name, expression)                  \
+    static inline lanes_t name(lanes_t a, lanes_t b) \
+    {                                               \
+        lanes_t r;                                  \
+        for (int i = 0; i < WINDOW_STATS_LANES; i++) \
+        {                                           \
+            r.lane[i] = (expression);               \
+        }                                           \
+        return r;                                   \
+    }
+
+LANES_OP(lanes_add, a.lane[i] + b.lane[i])
+LANES_OP(lanes_sub, a.lane[i] - b.lane[i])
+LANES_OP(lanes_mul, a.lane[i] * b.lane[i])
+LANES_OP(lanes_min, (a.lane[i] < b.lane[i]) ? a.lane[i] : b.lane[i])
+LANES_OP(lanes_max, (a.lane[i] > b.lane[i]) ? a.lane[i] : b.lane[i])
+
+static inline lanes_t lanes_load(const float *p)
+{
+    lanes_t r;
+    memcpy(r.lane, p, sizeof(r.lane));
+    return r;
+}
+
+static inline lanes_t lanes_set(float value)
+{
+    lanes_t r;
+    for (int i = 0; i < WINDOW_STATS_LANES; i++)
+    {
+        r.lane[i] = value;
+    }
+    return r;
+}
+
+static inline float lanes_get(lanes_t a, int i)
+{
+    return a.lane[i];
+}
+#else
+typedef float lanes_t __attribute__((vector_size(WINDOW_STATS_LANES * sizeof(float))));
+typedef int32_t lanes_mask_t __attribute__((vector_size(WINDOW_STATS_LANES * sizeof(float))));
+
+static inline lanes_t lanes_add(lanes_t a, lanes_t b)
+{
+    return a + b;
+}
+
+static inline lanes_t lanes_sub(lanes_t a, lanes_t b)
+{
+    return a - b;
+}
+
+static inline lanes_t lanes_mul(lanes_t a, lanes_t b)
+{
+    return a * b;
+}
+
+static inline lanes_t lanes_min(lanes_t a, lanes_t b)
+{
+    lanes_mask_t less = a < b;
+    return (lanes_t)(((lanes_mask_t)a & less) | ((lanes_mask_t)b & ~less));
+}
+
+static inline lanes_t lanes_max(lanes_t a, lanes_t b)
+{
+    lanes_mask_t greater = a > b;
+    return (lanes_t)(((lanes_mask_t)a & greater) | ((lanes_mask_t)b & ~greater));
+}
+
+static inline lanes_t lanes_load(const float *p)
+{
+    lanes_t r;
+    memcpy(&r, p, sizeof(r));
+    return r;
+}
+
+static inline lanes_t lanes_set(float value)
+{
+    return (lanes_t){value, value, value, value};
+}
+
+static inline float lanes_get(lanes_t a, int i)
+{
+    return a[i];
+}
+#endif
+
+#define SERIES_NAME(id, field, bits) [SAMPLE_SERIES_##id] = #field,
+const char *const window_stats_series_names[SAMPLE_SERIES_COUNT] = {SAMPLE_STORE_SERIES(SERIES_NAME)};
+
+static int64_t now_us()
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+#endif
+}
+
+static void moments_empty(window_moments_t *moments)
+{
+    memset(moments, 0, sizeof(*moments));
+    moments->min = INFINITY;
+    moments->max = -INFINITY;
+}
+
+// The float means of a chunk are off by up to half an ulp of the sum, which
+// the merge would carry into the drift. The residuals, the sums of the
+// deviations from those means, correct the means and the moments around
+// them (the corrected two pass algorithm).
+static void moments_set(window_moments_t *moments, int count, float mean_t, float mean_x, float residual_t,
+                        float residual_x, float m2_t, float m2_x, float c_tx, float min, float max)
+{
+    moments->count = count;
+    moments->mean_t = mean_t + ((double)residual_t / count);
+    moments->mean_x = mean_x + ((double)residual_x / count);
+    moments->m2_t = m2_t - ((double)residual_t * residual_t / count);
+    moments->m2_x = m2_x - ((double)residual_x * residual_x / count);
+    moments->c_tx = c_tx - ((double)residual_t * residual_x / count);
+    moments->min = min;
+    moments->max = max;
+}
+
+// Reference kernel, the same two passes one sample at a time
+void window_kernel_scalar(const float *time, const float *values, int count, window_moments_t *moments)
+{
+    float sum_t = 0, sum_x = 0, min = INFINITY, max = -INFINITY;
+    float m2_t = 0, m2_x = 0, c_tx = 0, residual_t = 0, residual_x = 0;
+
+    moments_empty(moments);
+    if (count == 0)
+    {
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        sum_t += time[i];
+        sum_x += values[i];
+        min = (values[i] < min) ? values[i] : min;
+        max = (values[i] > max) ? values[i] : max;
+    }
+    float mean_t = sum_t / count;
+    float mean_x = sum_x / count;
+    for (int i = 0; i < count; i++)
+    {
+        float dt = time[i] - mean_t;
+        float dx = values[i] - mean_x;
+        residual_t += dt;
+        residual_x += dx;
+        m2_t += dt * dt;
+        m2_x += dx * dx;
+        c_tx += dt * dx;
+    }
+    moments_set(moments, count, mean_t, mean_x, residual_t, residual_x, m2_t, m2_x, c_tx, min, max);
+}
+
+// WINDOW_STATS_LANES samples per step, the remainder one at a time
+void window_kernel_vector(const float *time, const float *values, int count, window_moments_t *moments)
+{
+    int whole = count - (count % WINDOW_STATS_LANES);
+    lanes_t sum_t = lanes_set(0), sum_x = lanes_set(0);
+    lanes_t min = lanes_set(INFINITY), max = lanes_set(-INFINITY);
+
+    moments_empty(moments);
+    if (count == 0)
+    {
+        return;
+    }
+    for (int i = 0; i < whole; i += WINDOW_STATS_LANES)
+    {
+        lanes_t t = lanes_load(&time[i]);
+        lanes_t x = lanes_load(&values[i]);
+        sum_t = lanes_add(sum_t, t);
+        sum_x = lanes_add(sum_x, x);
+        min = lanes_min(min, x);
+        max = lanes_max(max, x);
+    }
+    float total_t = 0, total_x = 0, low = INFINITY, high = -INFINITY;
+    for (int lane = 0; lane < WINDOW_STATS_LANES; lane++)
+    {
+        total_t += lanes_get(sum_t, lane);
+        total_x += lanes_get(sum_x, lane);
+        low = (lanes_get(min, lane) < low) ? lanes_get(min, lane) : low;
+        high = (lanes_get(max, lane) > high) ? lanes_get(max, lane) : high;
+    }
+    for (int i = whole; i < count; i++)
+    {
+        total_t += time[i];
+        total_x += values[i];
+        low = (values[i] < low) ? values[i] : low;
+        high = (values[i] > high) ? values[i] : high;
+    }
+    float mean_t = total_t / count;
+    float mean_x = total_x / count;
+
+    lanes_t center_t = lanes_set(mean_t), center_x = lanes_set(mean_x);
+    lanes_t m2_t = lanes_set(0), m2_x = lanes_set(0), c_tx = lanes_set(0);
+    lanes_t residual_t = lanes_set(0), residual_x = lanes_set(0);
+    for (int i = 0; i < whole; i += WINDOW_STATS_LANES)
+    {
+        lanes_t dt = lanes_sub(lanes_load(&time[i]), center_t);
+        lanes_t dx = lanes_sub(lanes_load(&values[i]), center_x);
+        residual_t = lanes_add(residual_t, dt);
+        residual_x = lanes_add(residual_x, dx);
+        m2_t = lanes_add(m2_t, lanes_mul(dt, dt));
+        m2_x = lanes_add(m2_x, lanes_mul(dx, dx));
+        c_tx = lanes_add(c_tx, lanes_mul(dt, dx));
+    }
+    float total_m2_t = 0, total_m2_x = 0, total_c_tx = 0, total_residual_t = 0, total_residual_x = 0;
+    for (int lane = 0; lane < WINDOW_STATS_LANES; lane++)
+    {
+        total_residual_t += lanes_get(residual_t, lane);
+        total_residual_x += lanes_get(residual_x, lane);
+        total_m2_t += lanes_get(m2_t, lane);
+        total_m2_x += lanes_get(m2_x, lane);
+        total_c_tx += lanes_get(c_tx, lane);
+    }
+    for (int i = whole; i < count; i++)
+    {
+        float dt = time[i] - mean_t;
+        float dx = values[i] - mean_x;
+        total_residual_t += dt;
+        total_residual_x += dx;
+        total_m2_t += dt * dt;
+        total_m2_x += dx * dx;
+        total_c_tx += dt * dx;
+    }
+    moments_set(moments, count, mean_t, mean_x, total_residual_t, total_residual_x, total_m2_t, total_m2_x,
+                total_c_tx, low, high);
+}
+
+// Pairwise update of Chan et al., the moments of both parts around the
+// combined means
+void window_moments_merge(window_moments_t *into, const window_moments_t *part)
+{
+    if (part->count == 0)
+    {
+        return;
+    }
+    if (into->count == 0)
+    {
+        *into = *part;
+        return;
+    }
+    double count = (double)into->count + part->count;
+    double delta_t = part->mean_t - into->mean_t;
+    double delta_x = part->mean_x - into->mean_x;
+    double weight = (double)into->count * part->count / count;
+
+    into->m2_t += part->m2_t + (delta_t * delta_t * weight);
+    into->m2_x += part->m2_x + (delta_x * delta_x * weight);
+    into->c_tx += part->c_tx + (delta_t * delta_x * weight);
+    into->mean_t += delta_t * part->count / count;
+    into->mean_x += delta_x * part->count / count;
+    into->min = (part->min < into->min) ? part->min : into->min;
+    into->max = (part->max > into->max) ? part->max : into->max;
+    into->count += part->count;
+}
+
+static void flush_chunk(window_stats_t *stats, window_kernel_t kernel)
+{
+    window_moments_t part;
+
+    for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+    {
+        kernel(stats->time, stats->values[series], stats->chunk_count, &part);
+        window_moments_merge(&stats->series[series], &part);
+    }
+    stats->chunk_count = 0;
+}
+
+void window_stats_begin(window_stats_t *stats)
+{
+    stats->first_time = 0;
+    stats->last_time = 0;
+    stats->chunk_count = 0;
+    for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+    {
+        moments_empty(&stats->series[series]);
+    }
+}
+
+// Transposes a sample into the chunk, the kernel runs once it is full
+void window_stats_add(const sample_store_sample_t *sample, void *arg)
+{
+    window_stats_t *stats = arg;
+
+    if ((stats->chunk_count == 0) && (stats->series[0].count == 0))
+    {
+        stats->first_time = sample->gps_time;
+    }
+    stats->last_time = sample->gps_time;
+    stats->time[stats->chunk_count] = sample->gps_time - stats->first_time;
+    for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+    {
+        stats->values[series][stats->chunk_count] = sample->values[series];
+    }
+    if (++stats->chunk_count == WINDOW_STATS_CHUNK)
+    {
+        flush_chunk(stats, window_kernel_vector);
+    }
+}
+
+void window_stats_end(window_stats_t *stats)
+{
+    if (stats->chunk_count > 0)
+    {
+        flush_chunk(stats, window_kernel_vector);
+    }
+}
+
+double window_stats_stddev(const window_moments_t *moments)
+{
+    return (moments->count > 1) ? sqrt(moments->m2_x / (moments->count - 1)) : 0;
+}
+
+double window_stats_drift(const window_moments_t *moments)
+{
+    return (moments->m2_t > 0) ? moments->c_tx / moments->m2_t : 0;
+}
+
+// Phase like samples, a drift under white noise and a slow wander, with an
+// offset large against the spread as EFC and temperature have
+static void benchmark_series(float *time, float *values, uint32_t samples)
+{
+    uint32_t seed = 12345;
+
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        seed = (seed * 1664525u) + 1013904223u;
+        float noise = ((int32_t)(seed >> 8) - (1 << 23)) / (float)(1 << 23);
+        time[i] = i;
+        values[i] = 41.5f + (2e-5f * i) + (0.01f * noise) + (0.05f * sinf(i * 1e-3f));
+    }
+}
+
+static double relative_error(double value, double reference)
+{
+    return fabs(value - reference) / ((fabs(reference) > 0) ? fabs(reference) : 1);
+}
+
+// The series a chunk at a time, as window_stats_add() feeds them
+static void benchmark_pass(const float *time, const float *values, uint32_t samples, window_kernel_t kernel,
+                           window_moments_t *total)
+{
+    window_moments_t part;
+
+    moments_empty(total);
+    for (uint32_t i = 0; i < samples; i += WINDOW_STATS_CHUNK)
+    {
+        int count = ((samples - i) < WINDOW_STATS_CHUNK) ? (samples - i) : WINDOW_STATS_CHUNK;
+        kernel(&time[i], &values[i], count, &part);
+        window_moments_merge(total, &part);
+    }
+}
+
+// Worst error of a pass with kernel against reference
+static double benchmark_error(const float *time, const float *values, uint32_t samples, window_kernel_t kernel,
+                              const window_moments_t *reference)
+{
+    window_moments_t total;
+
+    benchmark_pass(time, values, samples, kernel, &total);
+    double error = relative_error(total.mean_x, reference->mean_x);
+    error = fmax(error, relative_error(window_stats_stddev(&total), window_stats_stddev(reference)));
+    error = fmax(error, relative_error(window_stats_drift(&total), window_stats_drift(reference)));
+    return error;
+}
+
+static uint32_t benchmark_ns(const float *time, const float *values, uint32_t samples, int rounds,
+                             window_kernel_t kernel)
+{
+    window_moments_t total;
+    volatile double sink = 0;
+
+    // One untimed pass brings the series into the cache
+    benchmark_pass(time, values, samples, kernel, &total);
+    int64_t start_us = now_us();
+    for (int round = 0; round < rounds; round++)
+    {
+        benchmark_pass(time, values, samples, kernel, &total);
+        sink += total.c_tx;
+    }
+    return (now_us() - start_us) * 1000 / rounds;
+}
+
+// Times both kernels on a synthetic series and checks them against the
+// same statistics in double precision. Returns -1 when out of memory.
+int window_stats_benchmark(uint32_t samples, int rounds, window_stats_benchmark_t *result)
+{
+    float *time = malloc(samples * sizeof(float));
+    float *values = malloc(samples * sizeof(float));
+    if ((time == NULL) || (values == NULL))
+    {
+        free(time);
+        free(values);
+        return -1;
+    }
+    benchmark_series(time, values, samples);
+
+    // Two passes in double over the whole series
+    window_moments_t reference;
+    double sum_t = 0, sum_x = 0;
+    moments_empty(&reference);
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        sum_t += time[i];
+        sum_x += values[i];
+    }
+    reference.count = samples;
+    reference.mean_t = sum_t / samples;
+    reference.mean_x = sum_x / samples;
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        double dt = time[i] - reference.mean_t;
+        double dx = values[i] - reference.mean_x;
+        reference.m2_t += dt * dt;
+        reference.m2_x += dx * dx;
+        reference.c_tx += dt * dx;
+    }
+
+    result->samples = samples;
+    result->scalar_ns = benchmark_ns(time, values, samples, rounds, window_kernel_scalar);
+    result->vector_ns = benchmark_ns(time, values, samples, rounds, window_kernel_vector);
+    result->scalar_error_ppb = benchmark_error(time, values, samples, window_kernel_scalar, &reference) * 1e9;
+    result->vector_error_ppb = benchmark_error(time, values, samples, window_kernel_vector, &reference) * 1e9;
+    free(time);
+    free(values);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef WINDOW_STATS_H_
+#define WINDOW_STATS_H_
+
+#include <stdint.h>
+
+#include "sample_store.h"
+
+// Mean, standard deviation, min/max and linear drift of the sample store
+// series over a time window, computed on demand. The decoded samples are
+// transposed into a struct of arrays chunk of WINDOW_STATS_CHUNK samples,
+// each series contiguous, and every full chunk goes through a batch kernel
+// that works WINDOW_STATS_LANES samples at a time. The kernel makes two
+// passes over the chunk, sums and extremes first and then the moments
+// around the chunk means, in float. Chunks are merged in double with the
+// pairwise update of Chan et al., so long windows keep their precision.
+//
+// The lanes are GCC vector types on the host, SSE or NEON depending on the
+// machine, and four independent accumulators on the ESP32 whose FPU has no
+// vector unit but pipelines them, as the esp-dsp ae32 kernels do.
+// window_stats_benchmark() times the vector kernel against the scalar one
+// and checks both against a double precision reference, on either target.
+
+#define WINDOW_STATS_CHUNK (32)
+#define WINDOW_STATS_LANES (4)
+// Window of the statistics screen and of the hourly log line
+#define WINDOW_STATS_SECONDS (3600)
+
+// Build option: run window_stats_benchmark() at boot and log it. Off unless set.
+#ifndef GPSDO_WINDOW_STATS_BENCH
+#define GPSDO_WINDOW_STATS_BENCH 0
+#endif
+
+_Static_assert(WINDOW_STATS_CHUNK % WINDOW_STATS_LANES == 0, "Chunks must hold whole lanes");
+
+// Moments of a series against time, t in seconds from the window start
+typedef struct
+{
+    uint32_t count;
+    double mean_t;
+    double mean_x;
+    double m2_t;
+    double m2_x;
+    double c_tx;
+    float min;
+    float max;
+} window_moments_t;
+
+typedef struct
+{
+    uint32_t first_time;
+    uint32_t last_time;
+    int chunk_count;
+    float time[WINDOW_STATS_CHUNK];
+    float values[SAMPLE_SERIES_COUNT][WINDOW_STATS_CHUNK];
+    window_moments_t series[SAMPLE_SERIES_COUNT];
+} window_stats_t;
+
+typedef struct
+{
+    uint32_t samples;
+    // Nanoseconds per pass over the window through the chunks, scalar and
+    // vector kernel
+    uint32_t scalar_ns;
+    uint32_t vector_ns;
+    // Largest relative error of mean, standard deviation and drift against
+    // the double precision reference, in parts per billion
+    uint32_t scalar_error_ppb;
+    uint32_t vector_error_ppb;
+} window_stats_benchmark_t;
+
+typedef void (*window_kernel_t)(const float *time, const float *values, int count, window_moments_t *moments);
+
+// Field names of the series, by sample_series_id_t
+extern const char *const window_stats_series_names[SAMPLE_SERIES_COUNT];
+
+void window_stats_begin(window_stats_t *stats);
+// sample_query_cb_t, arg is the window_stats_t
+void window_stats_add(const sample_store_sample_t *sample, void *arg);
+void window_stats_end(window_stats_t *stats);
+
+double window_stats_stddev(const window_moments_t *moments);
+// Slope of the least squares line, per second
+double window_stats_drift(const window_moments_t *moments);
+
+void window_kernel_scalar(const float *time, const float *values, int count, window_moments_t *moments);
+void window_kernel_vector(const float *time, const float *values, int count, window_moments_t *moments);
+void window_moments_merge(window_moments_t *into, const window_moments_t *part);
+
+int window_stats_benchmark(uint32_t samples, int rounds, window_stats_benchmark_t *result);
+
+#endif
@@ -0,0 +1,202 @@
+// Host leak regression test of src/alloc_track.c, linked with the same
+// --wrap flags as the firmware and running on its pthread backend. Checks:
+//  - the leak check of alloc_track.h around window_stats_benchmark(), which
+//    allocates and frees its sample buffers;
+//  - that a deliberate leak shows up in the totals and at its call site;
+//  - random malloc, calloc, realloc and free against a shadow count;
+//  - per thread counters with several threads allocating at once;
+//  - blocks past the live table are counted as untracked and pass through.
+//
+//     cc -O2 -pthread -Isrc -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free -o alloc_track_test tools/alloc_track_test.c src/alloc_track.c src/window_stats.c -lm
+//     ./alloc_track_test
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc_track.h"
+#include "window_stats.h"
+
+#define THREADS (4)
+#define THREAD_BLOCKS (32)
+#define SHADOW_BLOCKS (200)
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+static uint32_t live_bytes()
+{
+    alloc_track_totals_t totals;
+    alloc_track_get_totals(&totals);
+    return totals.counters.live_bytes;
+}
+
+// Kept out of line so it is a call site of its own
+__attribute__((noinline)) static void *leak(size_t size)
+{
+    return malloc(size);
+}
+
+static void test_leak_check()
+{
+    window_stats_benchmark_t result;
+    alloc_track_totals_t before, after;
+
+    // The example of alloc_track.h
+    alloc_track_get_totals(&before);
+    window_stats_benchmark(WINDOW_STATS_SECONDS, 2, &result);
+    alloc_track_get_totals(&after);
+    check(after.counters.live_bytes == before.counters.live_bytes, "window_stats_benchmark frees what it allocates");
+    check(after.counters.allocs - before.counters.allocs == after.counters.frees - before.counters.frees,
+          "window_stats_benchmark allocs match frees");
+
+    void *leaked = leak(123);
+    alloc_track_get_totals(&after);
+    check(after.counters.live_bytes - before.counters.live_bytes == 123, "a leak of 123 bytes shows in the totals");
+
+    alloc_track_site_t sites[ALLOC_TRACK_SITES];
+    int count = alloc_track_get_sites(sites, ALLOC_TRACK_SITES);
+    int found = 0;
+    for (int i = 0; i < count; i++)
+    {
+        found |= (sites[i].counters.live_bytes == 123) && (sites[i].counters.allocs == 1);
+    }
+    check(found, "and at its call site");
+    free(leaked);
+    check(live_bytes() == before.counters.live_bytes, "freeing it brings the totals back");
+}
+
+static void test_shadow()
+{
+    static void *blocks[SHADOW_BLOCKS];
+    static size_t sizes[SHADOW_BLOCKS];
+    uint32_t start = live_bytes();
+    size_t expected = 0;
+    int mismatches = 0;
+
+    srand(3);
+    for (int i = 0; i < 200000; i++)
+    {
+        int slot = rand() % SHADOW_BLOCKS;
+        size_t size = 1 + (rand() % 200);
+        switch (rand() % 4)
+        {
+        case 0:
+            expected -= sizes[slot];
+            free(blocks[slot]);
+            blocks[slot] = malloc(size);
+            break;
+        case 1:
+            expected -= sizes[slot];
+            free(blocks[slot]);
+            blocks[slot] = calloc(1, size);
+            break;
+        case 2:
+            // realloc of NULL allocates, of a block moves or resizes it
+            expected -= sizes[slot];
+            blocks[slot] = realloc(blocks[slot], size);
+            break;
+        default:
+            expected -= sizes[slot];
+            free(blocks[slot]);
+            blocks[slot] = NULL;
+            size = 0;
+            break;
+        }
+        sizes[slot] = size;
+        expected += size;
+        mismatches += (live_bytes() - start != expected);
+    }
+    for (int i = 0; i < SHADOW_BLOCKS; i++)
+    {
+        free(blocks[i]);
+    }
+    check(mismatches == 0, "random malloc, calloc, realloc and free add up");
+    check(live_bytes() == start, "and leave nothing behind");
+}
+
+static void *thread_allocations(void *arg)
+{
+    void *blocks[THREAD_BLOCKS];
+    size_t size = (size_t)(uintptr_t)arg;
+
+    for (int i = 0; i < THREAD_BLOCKS; i++)
+    {
+        blocks[i] = malloc(size);
+    }
+    // Holds on to them until every thread got its counters checked
+    alloc_track_task_t tasks[ALLOC_TRACK_TASKS];
+    int count = alloc_track_get_tasks(tasks, ALLOC_TRACK_TASKS);
+    int found = 0;
+    for (int i = 0; i < count; i++)
+    {
+        found |= (tasks[i].counters.live_bytes == size * THREAD_BLOCKS);
+    }
+    for (int i = 0; i < THREAD_BLOCKS; i++)
+    {
+        free(blocks[i]);
+    }
+    return (void *)(uintptr_t)found;
+}
+
+static void test_threads()
+{
+    pthread_t threads[THREADS];
+    uint32_t start = live_bytes();
+    int found = 1;
+
+    // Sizes apart enough that each thread recognises its own counters
+    for (int i = 0; i < THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, thread_allocations, (void *)(uintptr_t)(1000 + (i * 7)));
+    }
+    for (int i = 0; i < THREADS; i++)
+    {
+        void *result;
+        pthread_join(threads[i], &result);
+        found &= (int)(uintptr_t)result;
+    }
+    check(found, "every thread sees its own live bytes");
+    check(live_bytes() == start, "threads leave nothing behind");
+}
+
+static void test_overflow()
+{
+    static void *blocks[ALLOC_TRACK_LIVE_SLOTS * 2];
+    alloc_track_totals_t before, after;
+
+    alloc_track_get_totals(&before);
+    for (int i = 0; i < ALLOC_TRACK_LIVE_SLOTS * 2; i++)
+    {
+        blocks[i] = malloc(16);
+    }
+    alloc_track_get_totals(&after);
+    uint32_t untracked = after.untracked - before.untracked;
+    check((untracked > 0) && (after.counters.live_bytes - before.counters.live_bytes ==
+                              (ALLOC_TRACK_LIVE_SLOTS * 2 - untracked) * 16),
+          "blocks past the live table count as untracked");
+    for (int i = 0; i < ALLOC_TRACK_LIVE_SLOTS * 2; i++)
+    {
+        free(blocks[i]);
+    }
+    check(live_bytes() == before.counters.live_bytes, "and free through without upsetting the totals");
+}
+
+int main()
+{
+    test_leak_check();
+    test_shadow();
+    test_threads();
+    test_overflow();
+    if (failures != 0)
+    {
+        alloc_track_dump();
+    }
+    return failures != 0;
+}
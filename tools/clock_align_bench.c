@@ -0,0 +1,212 @@
+// Measures how well the second boundaries predicted by src/clock_sync.c line
+// up with the true ones, the way the display task uses them for the clock.
+//
+// Live, a thread drives clock_sync like tools/ntp_bench.c does, one TOD
+// arrival per host second, here delayed by a fixed latency to the first
+// byte, the time the packet takes on the line and one sided jitter as the
+// UCCM packets are. The latency defaults to CLOCK_SYNC_TOD_DELAY_US, pass
+// another to see the bias an uncalibrated one leaves. The main thread sleeps
+// to each predicted boundary like the flush timer and checks the host clock
+// on waking.
+//
+// Replayed, a capture of the PPS output against the start of the TOD packets
+// (e.g. a logic analyser export, one "pps_seconds tod_seconds" pair per line)
+// is fed through clock_sync and every predicted boundary is compared with the
+// next PPS edge. The median prediction error is what CLOCK_SYNC_TOD_DELAY_US
+// is off by.
+//
+//     cc -O2 -Isrc -o clock_align_bench tools/clock_align_bench.c src/clock_sync.c -lpthread
+//     ./clock_align_bench [seconds] [latency us] [jitter us]
+//     ./clock_align_bench -r capture.txt
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clock_sync.h"
+
+#define UNIX_GPS_EPOCH (315964800)
+#define BENCH_UTC_OFFSET (18)
+#define MAX_SECONDS (100000)
+
+typedef struct
+{
+    int64_t values[MAX_SECONDS];
+    int count;
+} series_t;
+
+static clock_sync_t clock_sync;
+static int latency_us = CLOCK_SYNC_TOD_DELAY_US;
+static int jitter_us = 3000;
+
+static int64_t clock_us(clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+}
+
+static void sleep_until_us(clockid_t clock, int64_t when_us)
+{
+    struct timespec when = {.tv_sec = when_us / 1000000, .tv_nsec = (when_us % 1000000) * 1000};
+    while (clock_nanosleep(clock, TIMER_ABSTIME, &when, NULL) != 0)
+    {
+    }
+}
+
+static void add(series_t *series, int64_t value)
+{
+    if (series->count < MAX_SECONDS)
+    {
+        series->values[series->count++] = value;
+    }
+}
+
+static int compare(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Signed mean, percentiles of the signed value and the largest magnitude;
+// returns the median
+static int64_t report(const char *name, series_t *series)
+{
+    int64_t sum = 0, worst = 0;
+
+    if (series->count == 0)
+    {
+        printf("%-22s no samples\n", name);
+        return 0;
+    }
+    qsort(series->values, series->count, sizeof(int64_t), compare);
+    for (int i = 0; i < series->count; i++)
+    {
+        int64_t value = series->values[i];
+        sum += value;
+        worst = (llabs(value) > llabs(worst)) ? value : worst;
+    }
+    int64_t median = series->values[series->count / 2];
+    printf("%-22s mean %+7lld us, p1 %+7lld, median %+7lld, p99 %+7lld, worst %+7lld over %d\n", name,
+           (long long)(sum / series->count), (long long)series->values[series->count / 100], (long long)median,
+           (long long)series->values[(series->count * 99) / 100], (long long)worst, series->count);
+    return median;
+}
+
+// One TOD arrival per host second, stamped when the packet ends: latency,
+// the packet and jitter after the second began
+static void *tod_thread(void *arg)
+{
+    int32_t error_us;
+
+    for (;;)
+    {
+        int64_t boundary_real_us = ((clock_us(CLOCK_REALTIME) / 1000000) + 1) * 1000000;
+        sleep_until_us(CLOCK_REALTIME, boundary_real_us + latency_us + CLOCK_SYNC_TOD_FRAME_US +
+                                           (jitter_us ? rand() % jitter_us : 0));
+        uint32_t second = (boundary_real_us / 1000000) - UNIX_GPS_EPOCH + BENCH_UTC_OFFSET;
+        clock_sync_tod(&clock_sync, second, clock_us(CLOCK_MONOTONIC), &error_us);
+    }
+    return NULL;
+}
+
+static int live(int seconds)
+{
+    static series_t prediction, wake, alignment;
+    int wrong_second = 0;
+    pthread_t tod;
+
+    printf("Live for %d s, TOD latency %d us, jitter up to %d us, CLOCK_SYNC_TOD_LATENCY_US %d\n", seconds,
+           latency_us + CLOCK_SYNC_TOD_FRAME_US, jitter_us, CLOCK_SYNC_TOD_LATENCY_US);
+    clock_sync_init(&clock_sync);
+    pthread_create(&tod, NULL, tod_thread, NULL);
+
+    int64_t end_us = clock_us(CLOCK_MONOTONIC) + (seconds * 1000000LL);
+    int64_t now_us;
+    while ((now_us = clock_us(CLOCK_MONOTONIC)) < end_us)
+    {
+        uint32_t second;
+        int64_t boundary_us;
+        if (!clock_sync_next_boundary(&clock_sync, now_us, &second, &boundary_us))
+        {
+            sleep_until_us(CLOCK_MONOTONIC, now_us + 100000);
+            continue;
+        }
+        sleep_until_us(CLOCK_MONOTONIC, boundary_us);
+        int64_t woke_us = clock_us(CLOCK_MONOTONIC);
+        int64_t real_us = clock_us(CLOCK_REALTIME);
+
+        // Where the second began on the monotonic clock, from the host clock
+        int64_t into_us = real_us % 1000000;
+        into_us -= (into_us >= 500000) ? 1000000 : 0;
+        uint32_t real_second = ((real_us - into_us) / 1000000) - UNIX_GPS_EPOCH + BENCH_UTC_OFFSET;
+        wrong_second += (real_second != second);
+        add(&prediction, boundary_us - (woke_us - into_us));
+        add(&wake, woke_us - boundary_us);
+        add(&alignment, into_us);
+    }
+
+    report("Predicted boundary", &prediction);
+    report("Timer wake up", &wake);
+    report("Clock alignment", &alignment);
+    printf("%d of %d seconds shown with the wrong value\n", wrong_second, alignment.count);
+    return wrong_second != 0;
+}
+
+static int replay(const char *path)
+{
+    static series_t latency, prediction;
+    double pps_s, tod_s;
+    int64_t origin_us = 0, next_boundary_us = 0;
+    uint32_t second = 0, next_second = 0;
+    bool predicted = false;
+    int32_t error_us;
+
+    FILE *capture = fopen(path, "r");
+    if (capture == NULL)
+    {
+        printf("Cannot open %s\n", path);
+        return 1;
+    }
+    clock_sync_init(&clock_sync);
+    while (fscanf(capture, "%lf %lf", &pps_s, &tod_s) == 2)
+    {
+        if (origin_us == 0)
+        {
+            origin_us = (int64_t)(pps_s * 1e6) - 1000000;
+        }
+        int64_t pps_us = (int64_t)(pps_s * 1e6) - origin_us;
+        int64_t tod_us = (int64_t)(tod_s * 1e6) - origin_us;
+        // Seconds are counted on the PPS edges, a missing edge skips one
+        second += (int)((pps_us - (second * 1000000LL) + 500000) / 1000000);
+
+        if (predicted && (next_second == second))
+        {
+            add(&prediction, next_boundary_us - pps_us);
+        }
+        add(&latency, tod_us - pps_us);
+        clock_sync_tod(&clock_sync, second, tod_us + CLOCK_SYNC_TOD_FRAME_US, &error_us);
+        predicted = clock_sync_next_boundary(&clock_sync, tod_us, &next_second, &next_boundary_us);
+    }
+    fclose(capture);
+
+    printf("Replayed %d seconds of %s, CLOCK_SYNC_TOD_DELAY_US %d\n", latency.count, path, CLOCK_SYNC_TOD_DELAY_US);
+    report("TOD latency", &latency);
+    int64_t median = report("Predicted boundary", &prediction);
+    printf("CLOCK_SYNC_TOD_DELAY_US %lld centres the predictions\n", (long long)(CLOCK_SYNC_TOD_DELAY_US + median));
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc > 2) && (strcmp(argv[1], "-r") == 0))
+    {
+        return replay(argv[2]);
+    }
+    int seconds = (argc > 1) ? atoi(argv[1]) : 30;
+    latency_us = (argc > 2) ? atoi(argv[2]) : latency_us;
+    jitter_us = (argc > 3) ? atoi(argv[3]) : jitter_us;
+    return live(seconds);
+}
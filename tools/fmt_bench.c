@@ -0,0 +1,181 @@
+// Host check and benchmark of src/fmt.c against snprintf. Formats random
+// values with the conversions the screens use and a sweep of generated
+// ones, reports every output that differs from snprintf, then times
+// both on the screen formats.
+//
+//     cc -O2 -Isrc -o fmt_bench tools/fmt_bench.c src/fmt.c -lm
+//     ./fmt_bench [random values per format] [seed]
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fmt.h"
+
+#define LINE_SIZE (24)
+
+// The float conversions on the screens, see main.c
+static const char *screen_formats[] = {
+    "Temp:%6.3f", "DAC: %+7.4f %%", "Phase: %+5.2E", "PPS: %+7.4fns", "FREQ DIFF:%+.2E",
+    "Alt: %+6.3f m", "Lat: %+2.7f", "Lon: %+2.7f", "%+.2E", "%+.4f%%", "%.3f",
+};
+
+static uint64_t state = 88172645463325252ull;
+
+static uint64_t next_random()
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Floats of every magnitude, the values the state holds, and ties
+static double random_value(int kind)
+{
+    uint32_t bits = next_random();
+    float f;
+    switch (kind % 6)
+    {
+    case 0:
+        memcpy(&f, &bits, sizeof(f));
+        return isfinite(f) ? f : 0.0f;
+    case 1:
+        return (float)((int64_t)(next_random() % 2000000001) - 1000000000) * 1e-7f;
+    case 2:
+        return (float)(((int64_t)(next_random() % 2000001) - 1000000) * 1e-15);
+    case 3:
+        // Halfway cases of the fixed formats
+        return ((int64_t)(next_random() % 200001) - 100000) / 16.0 + 0.5 / 10000;
+    case 4:
+        return (float)(((int64_t)(next_random() % 2001) - 1000) * 1e-10) * 1e9;
+    default:
+    {
+        double d;
+        uint64_t wide = next_random();
+        memcpy(&d, &wide, sizeof(d));
+        return (isfinite(d) && (fabs(d) < 1e90) && ((d == 0) || (fabs(d) > 1e-75))) ? d : 1.0;
+    }
+    }
+}
+
+static int64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+static int check(const char *format, double value)
+{
+    char expected[256], actual[256];
+    int expected_length = snprintf(expected, sizeof(expected), format, value);
+    int actual_length = fmt(actual, sizeof(actual), format, value);
+    if ((expected_length != actual_length) || (strcmp(expected, actual) != 0))
+    {
+        printf("MISMATCH %-12s %.17g: snprintf \"%s\" fmt \"%s\"\n", format, value, expected, actual);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int count = (argc > 1) ? atoi(argv[1]) : 200000;
+    char format[32];
+    long checked = 0;
+    int failed = 0;
+
+    if (argc > 2)
+    {
+        state = strtoull(argv[2], NULL, 0);
+    }
+
+    // Screen formats, then every flag, width and precision combination
+    for (int i = 0; i < sizeof(screen_formats) / sizeof(screen_formats[0]); i++)
+    {
+        for (int n = 0; n < count; n++, checked++)
+        {
+            failed += check(screen_formats[i], random_value(n));
+        }
+    }
+    static const char *flag_sets[] = {"", "+", "-", "0", " ", "+0", "-+"};
+    static const char conversions[] = {'f', 'e', 'E'};
+    for (int f = 0; f < sizeof(flag_sets) / sizeof(flag_sets[0]); f++)
+    {
+        for (int c = 0; c < sizeof(conversions); c++)
+        {
+            for (int precision = 0; precision <= FMT_MAX_PRECISION; precision += 3)
+            {
+                snprintf(format, sizeof(format), "%%%s%d.%d%c", flag_sets[f], precision + 4, precision, conversions[c]);
+                for (int n = 0; n < count / 50; n++, checked++)
+                {
+                    failed += check(format, random_value(n));
+                }
+            }
+        }
+    }
+    double specials[] = {0.0, -0.0, 0.5, 1.5, 2.5, -2.5, 9.9999, 99.9995, 1e-45, 3.4e38, INFINITY, -INFINITY, NAN};
+    for (int i = 0; i < sizeof(specials) / sizeof(specials[0]); i++)
+    {
+        for (int j = 0; j < sizeof(screen_formats) / sizeof(screen_formats[0]); j++, checked++)
+        {
+            failed += check(screen_formats[j], specials[i]);
+        }
+    }
+
+    // Integer and string conversions of the other screens
+    char expected[64], actual[64];
+    for (int n = 0; n < count; n++, checked++)
+    {
+        int value = (int)next_random() >> (next_random() % 32);
+        unsigned int u = next_random();
+        snprintf(expected, sizeof(expected), "%d|%5d|%-4d|%+03d|%u|%7u|%X|%c|%-13.13s|%.4s|%%", value, value, value,
+                 value, u, u, u, 'A' + (u % 26), "parse_cmd_task_long", "LOCKED");
+        fmt(actual, sizeof(actual), "%d|%5d|%-4d|%+03d|%u|%7u|%X|%c|%-13.13s|%.4s|%%", value, value, value, value,
+            u, u, u, 'A' + (u % 26), "parse_cmd_task_long", "LOCKED");
+        if (strcmp(expected, actual) != 0)
+        {
+            printf("MISMATCH \"%s\" against \"%s\"\n", actual, expected);
+            failed++;
+        }
+    }
+    // Truncation to the line buffer
+    char small[8];
+    int length = fmt(small, sizeof(small), "Lat: %+2.7f", 123.4567891);
+    if ((length != snprintf(expected, sizeof(expected), "Lat: %+2.7f", 123.4567891)) || (strcmp(small, "Lat: +1") != 0))
+    {
+        printf("MISMATCH truncation \"%s\" %d\n", small, length);
+        failed++;
+    }
+    printf("%ld conversions checked, %d differ from snprintf\n", checked, failed);
+
+    // Timing on values the screens see
+    double values[1024];
+    for (int i = 0; i < 1024; i++)
+    {
+        values[i] = random_value(1 + (i % 4));
+    }
+    char line[LINE_SIZE];
+    volatile int sink = 0;
+    for (int i = 0; i < sizeof(screen_formats) / sizeof(screen_formats[0]) - 3; i++)
+    {
+        int64_t start = now_ns();
+        for (int n = 0; n < 200000; n++)
+        {
+            sink += snprintf(line, sizeof(line), screen_formats[i], values[n & 1023]);
+        }
+        int64_t middle = now_ns();
+        for (int n = 0; n < 200000; n++)
+        {
+            sink += fmt(line, sizeof(line), screen_formats[i], values[n & 1023]);
+        }
+        int64_t end = now_ns();
+        printf("%-16s snprintf %4lld ns  fmt %4lld ns\n", screen_formats[i], (long long)(middle - start) / 200000,
+               (long long)(end - middle) / 200000);
+    }
+    return failed != 0;
+}
@@ -0,0 +1,245 @@
+// Live view of the GLCD streamed with GPSDO_DISPLAY_MIRROR, see
+// src/display_mirror.h for the line format. Reads the console from a serial
+// device (set to 115200 8N1 raw) or from stdin, and draws the screen on the
+// terminal with half block characters, two pixel lines per text line.
+//
+//     cc -O2 -o glcd_mirror tools/glcd_mirror.c
+//     ./glcd_mirror /dev/ttyUSB0
+//     idf.py monitor | ./glcd_mirror
+//
+// Updates that do not follow the previous sequence number are skipped until
+// the next key frame.
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PREFIX "GLCD:"
+#define KEYFRAME (0x01)
+#define MAX_TILES (16 * 8)
+#define LINE_SIZE (4096)
+
+static uint8_t frame[MAX_TILES * 8];
+static int tile_width;
+static int tile_height;
+
+static int base64_value(char c)
+{
+    if ((c >= 'A') && (c <= 'Z'))
+    {
+        return c - 'A';
+    }
+    if ((c >= 'a') && (c <= 'z'))
+    {
+        return c - 'a' + 26;
+    }
+    if ((c >= '0') && (c <= '9'))
+    {
+        return c - '0' + 52;
+    }
+    return (c == '+') ? 62 : (c == '/') ? 63 : -1;
+}
+
+// Decodes up to the first character that is not base64, returns the length
+static int base64_decode(const char *text, uint8_t *out, int size)
+{
+    uint32_t bits = 0;
+    int count = 0;
+    int length = 0;
+
+    for (; base64_value(*text) >= 0; text++)
+    {
+        bits = (bits << 6) | base64_value(*text);
+        count += 6;
+        if (count >= 8)
+        {
+            count -= 8;
+            if (length == size)
+            {
+                return -1;
+            }
+            out[length++] = bits >> count;
+        }
+    }
+    return length;
+}
+
+static int packbits_decode(const uint8_t *in, int length, uint8_t *out, int size)
+{
+    int n = 0;
+
+    for (int i = 0; i < length;)
+    {
+        int code = in[i++];
+        if (code < 128)
+        {
+            if ((i + code + 1 > length) || (n + code + 1 > size))
+            {
+                return -1;
+            }
+            memcpy(&out[n], &in[i], code + 1);
+            i += code + 1;
+            n += code + 1;
+        }
+        else if (code > 128)
+        {
+            if ((i >= length) || (n + 257 - code > size))
+            {
+                return -1;
+            }
+            memset(&out[n], in[i++], 257 - code);
+            n += 257 - code;
+        }
+    }
+    return n;
+}
+
+static bool pixel(int x, int y)
+{
+    return (frame[(y * tile_width) + (x / 8)] >> (7 - (x % 8))) & 1;
+}
+
+static void draw(unsigned int updates, unsigned long bytes, double seconds)
+{
+    static const char *blocks[] = {" ", "▀", "▄", "█"};
+
+    printf("\033[H");
+    for (int y = 0; y < tile_height * 8; y += 2)
+    {
+        for (int x = 0; x < tile_width * 8; x++)
+        {
+            fputs(blocks[pixel(x, y) | (pixel(x, y + 1) << 1)], stdout);
+        }
+        putchar('\n');
+    }
+    printf("%u updates, %.0f bytes/s\033[K\n", updates, (seconds > 0) ? bytes / seconds : 0.0);
+    fflush(stdout);
+}
+
+// Applies one update, false when it was malformed or out of sequence
+static bool apply(const uint8_t *payload, int length)
+{
+    static bool synced;
+    static uint8_t expected;
+
+    if (length < 4)
+    {
+        return false;
+    }
+    uint8_t sequence = payload[0];
+    bool keyframe = payload[1] & KEYFRAME;
+    int width = payload[2];
+    int height = payload[3];
+    int tiles = width * height;
+    if ((tiles == 0) || (tiles > MAX_TILES))
+    {
+        return false;
+    }
+    if (!keyframe && (!synced || (sequence != expected)))
+    {
+        synced = false;
+        return false;
+    }
+    synced = true;
+    expected = sequence + 1;
+    if (keyframe)
+    {
+        memset(frame, 0, sizeof(frame));
+        tile_width = width;
+        tile_height = height;
+    }
+
+    const uint8_t *next = &payload[4];
+    const uint8_t *end = payload + length;
+    for (int row = 0; row < height; row++)
+    {
+        const uint8_t *changed = next;
+        next += (width + 7) / 8;
+        for (int column = 0; column < width; column++)
+        {
+            if ((next > end) || ((changed[column / 8] & (1 << (column % 8))) == 0))
+            {
+                continue;
+            }
+            if (next + 8 > end)
+            {
+                synced = false;
+                return false;
+            }
+            for (int line = 0; line < 8; line++)
+            {
+                frame[(row * width * 8) + (line * width) + column] ^= *next++;
+            }
+        }
+    }
+    if (next > end)
+    {
+        synced = false;
+        return false;
+    }
+    return true;
+}
+
+static void set_raw(int fd)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        return;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+int main(int argc, char **argv)
+{
+    static char line[LINE_SIZE];
+    static uint8_t encoded[LINE_SIZE];
+    static uint8_t payload[4 + MAX_TILES / 8 + MAX_TILES * 8];
+    FILE *input = stdin;
+    unsigned int updates = 0;
+    unsigned long bytes = 0;
+    struct timespec start, now;
+
+    if (argc > 1)
+    {
+        int fd = open(argv[1], O_RDONLY | O_NOCTTY);
+        if (fd < 0)
+        {
+            perror(argv[1]);
+            return 1;
+        }
+        set_raw(fd);
+        input = fdopen(fd, "r");
+    }
+
+    printf("\033[2J");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (fgets(line, sizeof(line), input) != NULL)
+    {
+        char *text = strstr(line, PREFIX);
+        if (text == NULL)
+        {
+            continue;
+        }
+        bytes += strlen(text);
+        int encoded_length = base64_decode(text + strlen(PREFIX), encoded, sizeof(encoded));
+        int length = (encoded_length < 0) ? -1 : packbits_decode(encoded, encoded_length, payload, sizeof(payload));
+        if ((length < 0) || !apply(payload, length))
+        {
+            continue;
+        }
+        updates++;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        draw(updates, bytes, (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9);
+    }
+    return 0;
+}
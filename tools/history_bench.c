@@ -0,0 +1,256 @@
+// Host benchmark and check of the history log on the file backend. Feeds
+// history_log_update() a simulated 1 Hz state with alarm and lock changes
+// for a number of days, enough to wrap the 512 KB image, and then:
+//  - reports the write amplification;
+//  - checks that the log reads back in GPS time order;
+//  - compares random range queries against a full scan and times them;
+//  - remounts the image and times the tail recovery.
+//
+//     cc -O2 -Isrc -o history_bench tools/history_bench.c src/history_log.c src/history_storage_file.c
+//     ./history_bench [days] [queries] [image]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "history_log.h"
+
+// The history partition of partitions.csv
+#define IMAGE_SIZE (512 * 1024)
+#define SECTOR_SIZE (4096)
+#define MAX_RECORDS (IMAGE_SIZE / HISTORY_RECORD_SIZE)
+#define START_TIME (1400000000)
+
+typedef struct
+{
+    uint32_t gps_time;
+    uint8_t type;
+} seen_t;
+
+typedef struct
+{
+    seen_t seen[MAX_RECORDS];
+    uint32_t count;
+} collect_t;
+
+static history_log_t history_log;
+static collect_t full, range;
+
+// Counts what the log reads through the file backend
+static history_storage_t file_storage;
+static uint64_t bytes_read;
+static uint32_t reads;
+
+static int counting_read(void *ctx, size_t offset, void *dst, size_t len)
+{
+    bytes_read += len;
+    reads++;
+    return file_storage.read(file_storage.ctx, offset, dst, len);
+}
+
+static int forward_write(void *ctx, size_t offset, const void *src, size_t len)
+{
+    return file_storage.write(file_storage.ctx, offset, src, len);
+}
+
+static int forward_erase(void *ctx, size_t offset, size_t len)
+{
+    return file_storage.erase(file_storage.ctx, offset, len);
+}
+
+static const history_storage_t storage = {
+    .size = IMAGE_SIZE,
+    .sector_size = SECTOR_SIZE,
+    .read = counting_read,
+    .write = forward_write,
+    .erase = forward_erase,
+};
+
+static int64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+static void collect(const history_record_t *record, void *arg)
+{
+    collect_t *into = arg;
+    if (into->count < MAX_RECORDS)
+    {
+        into->seen[into->count].gps_time = record->gps_time;
+        into->seen[into->count].type = record->type;
+    }
+    into->count++;
+}
+
+static void simulate(gpsdo_state_t *state, uint32_t seconds)
+{
+    static const char *gps_states[] = {"Locked", "Holdover", "Acquiring"};
+    static const char *alarms[] = {"0", "1", "10", "200"};
+
+    for (uint32_t i = 0; i < seconds; i++)
+    {
+        state->gps_time++;
+        state->phase += ((rand() % 2001) - 1000) * 1e-12f;
+        state->dac = 41.5f + ((rand() % 1000) * 1e-6f);
+        state->temperature = 45.0f + ((rand() % 100) * 1e-3f);
+        // A lock change every ten minutes and an alarm change every half
+        // hour on average, so transitions land inside most sample windows
+        if (rand() % 600 == 0)
+        {
+            strcpy(state->status_gps, gps_states[rand() % 3]);
+        }
+        if (rand() % 1800 == 0)
+        {
+            strcpy(state->alarm_hw, alarms[rand() % 4]);
+        }
+        // Flushed every second as history_task does
+        if ((history_log_update(&history_log, state) != 0) || (history_log_flush(&history_log) != 0))
+        {
+            printf("Append failed at %u\n", state->gps_time);
+            exit(1);
+        }
+    }
+}
+
+// Every record the log holds, which must come back in GPS time order
+static int check_order(const char *when)
+{
+    full.count = 0;
+    history_log_query(&history_log, 0, UINT32_MAX, collect, &full);
+    for (uint32_t i = 1; i < full.count; i++)
+    {
+        if (full.seen[i].gps_time < full.seen[i - 1].gps_time)
+        {
+            printf("%s: record %u at %u follows one at %u\n", when, i, full.seen[i].gps_time,
+                   full.seen[i - 1].gps_time);
+            return 1;
+        }
+    }
+    printf("%s: %u records from %u to %u, in order\n", when, full.count, full.seen[0].gps_time,
+           full.seen[full.count - 1].gps_time);
+    return 0;
+}
+
+// Random ranges inside the retained span must return exactly the records of
+// the full scan in that range
+static int check_queries(int queries)
+{
+    uint32_t first = full.seen[0].gps_time;
+    uint32_t span = full.seen[full.count - 1].gps_time - first;
+    int64_t total_ns = 0, worst_ns = 0;
+    uint64_t total_bytes = 0;
+    int failed = 0;
+
+    for (int q = 0; q < queries; q++)
+    {
+        uint32_t length = 60 + (rand() % (q % 2 ? 86400 : 3600));
+        uint32_t from = first + (rand() % span);
+        uint32_t to = from + length;
+
+        uint32_t start = 0;
+        while ((start < full.count) && (full.seen[start].gps_time < from))
+        {
+            start++;
+        }
+        uint32_t end = start;
+        while ((end < full.count) && (full.seen[end].gps_time <= to))
+        {
+            end++;
+        }
+
+        range.count = 0;
+        bytes_read = 0;
+        int64_t begin = now_ns();
+        history_log_query(&history_log, from, to, collect, &range);
+        int64_t elapsed = now_ns() - begin;
+        total_ns += elapsed;
+        worst_ns = (elapsed > worst_ns) ? elapsed : worst_ns;
+        total_bytes += bytes_read;
+
+        if ((range.count != end - start) ||
+            (memcmp(range.seen, &full.seen[start], range.count * sizeof(seen_t)) != 0))
+        {
+            if (failed++ < 5)
+            {
+                printf("Query %u..%u: %u records, the full scan has %u\n", from, to, range.count, end - start);
+            }
+        }
+    }
+    printf("%d queries: %lld us average, %lld us worst, %llu bytes read on average, %d wrong\n", queries,
+           (long long)(total_ns / queries / 1000), (long long)(worst_ns / 1000),
+           (unsigned long long)(total_bytes / queries), failed);
+    return failed != 0;
+}
+
+int main(int argc, char **argv)
+{
+    int days = (argc > 1) ? atoi(argv[1]) : 12;
+    int queries = (argc > 2) ? atoi(argv[2]) : 2000;
+    const char *image = (argc > 3) ? argv[3] : "history_bench.img";
+    gpsdo_state_t state;
+    int failed = 0;
+
+    remove(image);
+    if (history_storage_file_init(&file_storage, image, IMAGE_SIZE, SECTOR_SIZE) != 0)
+    {
+        printf("Cannot create %s\n", image);
+        return 1;
+    }
+    if (history_log_mount(&history_log, &storage) != 0)
+    {
+        printf("Mount failed\n");
+        return 1;
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.gps_time = START_TIME;
+    strcpy(state.status_gps, "Locked");
+    strcpy(state.alarm_hw, "0");
+    srand(1);
+    int64_t begin = now_ns();
+    simulate(&state, days * 86400);
+    int64_t elapsed = now_ns() - begin;
+
+    const history_log_stats_t *stats = &history_log.stats;
+    printf("%d days: %u records, %u bytes appended, %u programmed, %u sectors erased, %lld ns per update\n", days,
+           stats->records_appended, stats->bytes_appended, stats->bytes_programmed, stats->sectors_erased,
+           (long long)(elapsed / (days * 86400LL)));
+    printf("Write amplification: %.3f programmed, %.3f including erases\n",
+           (double)stats->bytes_programmed / stats->bytes_appended,
+           ((double)stats->bytes_programmed + ((double)stats->sectors_erased * SECTOR_SIZE)) / stats->bytes_appended);
+
+    failed |= check_order("Before remount");
+    failed |= check_queries(queries);
+
+    // Crash and recovery: what was flushed must mount again from the tail
+    history_log_flush(&history_log);
+    history_storage_file_close(&file_storage);
+    history_storage_file_init(&file_storage, image, IMAGE_SIZE, SECTOR_SIZE);
+    bytes_read = 0;
+    reads = 0;
+    begin = now_ns();
+    if (history_log_mount(&history_log, &storage) != 0)
+    {
+        printf("Remount failed\n");
+        return 1;
+    }
+    printf("Remount: %lld us, %u reads, %llu bytes read\n", (long long)((now_ns() - begin) / 1000), reads,
+           (unsigned long long)bytes_read);
+    uint32_t before = full.count;
+    failed |= check_order("After remount");
+    if (full.count != before)
+    {
+        printf("Remount lost %d records\n", (int)(before - full.count));
+        failed = 1;
+    }
+    simulate(&state, 86400);
+    failed |= check_order("One more day");
+
+    history_storage_file_close(&file_storage);
+    remove(image);
+    return failed;
+}
@@ -0,0 +1,154 @@
+# Build time report of the static RAM of the application, measured in the
+# linked image. The linker map gives the .data and .bss of every object of
+# the archive that holds main.c, by symbol since the IDF builds with
+# -fdata-sections. Each symbol is put in a subsystem of src/memory_budget.h:
+# those of main.c by the rules below, those of the other sources by their
+# file, dlog.c as log and so on. Next to each measured figure stands the
+# estimate memory_budget.c leaves in the image as the absolute symbol
+# memory_budget_<name>. The build fails when the measured total exceeds
+# MEMORY_BUDGET_LIMIT. Run after every build by the top level
+# CMakeLists.txt, or by hand:
+#
+#     cmake -DNM=xtensa-esp32-elf-nm -DELF=build/GPSDO_display_esp32.elf -DMAP=build/GPSDO_display_esp32.map -P tools/memory_budget.cmake
+
+cmake_minimum_required(VERSION 3.16)
+
+# Subsystem of the statics of main.c, first matching rule wins, the rest
+# stays as main
+set(main_rules
+    "_stack$|_tcb$=tasks"
+    "^(ring_cmd|cmd_data$|frame$)=cmd_pipeline"
+    "^(ring_tod|dtmp$|tod_buffer$)=tod_pipeline"
+    "^(u8g2$|display_|mirror_|clock_region$|current_screen$)=display"
+    "^(gpsdo_state$|clock_sync$|state_snapshot$)=state"
+    "^history_=history"
+    "^trend_=trends"
+    "^alarm_=alarms"
+    "^sample_=samples"
+    "^scpi_bridge=scpi_bridge"
+    "^metrics=metrics"
+    "^ntp_=ntp"
+    "^window_stats=window_stats"
+    "^(position_survey|survey_)=survey")
+# Subsystem of the other sources whose file is not named after it
+set(file_rules "dlog=log" "history_log=history" "state_snapshot=state" "metrics_http=metrics" "ntp_server=ntp"
+               "position_survey=survey")
+
+# Estimates and the limit
+execute_process(COMMAND ${NM} ${ELF} OUTPUT_VARIABLE symbols RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "memory budget: cannot read the symbols of ${ELF}")
+endif()
+string(REGEX MATCHALL "[0-9a-fA-F]+ A memory_budget_[a-z_]+" entries "${symbols}")
+if(NOT entries)
+    message(FATAL_ERROR "memory budget: no memory_budget_ symbols in ${ELF}")
+endif()
+set(subsystems "")
+foreach(entry ${entries})
+    string(REGEX REPLACE "^([0-9a-fA-F]+) A memory_budget_([a-z_]+)$" "\\1;\\2" fields "${entry}")
+    list(GET fields 0 value)
+    list(GET fields 1 name)
+    math(EXPR budget_${name} "0x${value}")
+    if(NOT name MATCHES "^(total|limit)$")
+        list(APPEND subsystems ${name})
+        set(measured_${name} 0)
+    endif()
+endforeach()
+
+# Input sections of the memory map, the discarded ones listed before it left out
+if(NOT EXISTS "${MAP}")
+    message(FATAL_ERROR "memory budget: no linker map ${MAP}")
+endif()
+file(READ "${MAP}" map)
+string(FIND "${map}" "Linker script and memory map" start)
+if(start LESS 0)
+    message(FATAL_ERROR "memory budget: ${MAP} has no memory map")
+endif()
+string(SUBSTRING "${map}" ${start} -1 map)
+set(section_pattern " (\\.bss|\\.sbss|\\.data|\\.sdata|\\.dram1|COMMON)[^ \n]*[ \n]+0x[0-9a-f]+ +0x[0-9a-f]+ +[^\n]*\\.a\\([^)\n]+\\)")
+string(REGEX MATCHALL "${section_pattern}" sections "${map}")
+
+set(app_archive "")
+foreach(section ${sections})
+    if(section MATCHES "[ /]([^ /]+\\.a)\\(main\\.c\\.obj\\)$")
+        set(app_archive ${CMAKE_MATCH_1})
+        break()
+    endif()
+endforeach()
+if(NOT app_archive)
+    message(FATAL_ERROR "memory budget: no statics of main.c in ${MAP}")
+endif()
+
+set(measured_total 0)
+foreach(section ${sections})
+    string(REGEX REPLACE "^ ([^ \n]+)[ \n]+0x[0-9a-f]+ +(0x[0-9a-f]+) +[^\n]*[ /]([^ /]+\\.a)\\(([^)]+)\\.c\\.obj\\)$"
+                         "\\1;\\2;\\3;\\4" fields "${section}")
+    list(LENGTH fields length)
+    if(NOT length EQUAL 4)
+        continue()
+    endif()
+    list(GET fields 2 archive)
+    if(NOT archive STREQUAL app_archive)
+        continue()
+    endif()
+    list(GET fields 0 section_name)
+    list(GET fields 1 size)
+    list(GET fields 3 file)
+    math(EXPR bytes "${size}")
+    if(bytes EQUAL 0)
+        continue()
+    endif()
+
+    # .bss.name, or .bss.name.N for a static within a function
+    string(REGEX REPLACE "^\\.[a-z0-9]+\\.?" "" symbol "${section_name}")
+    string(REGEX REPLACE "\\.[0-9]+$" "" symbol "${symbol}")
+    set(subsystem ${file})
+    if(file STREQUAL "main")
+        foreach(rule ${main_rules})
+            string(REGEX REPLACE "^(.*)=([a-z_]+)$" "\\1;\\2" rule "${rule}")
+            list(GET rule 0 pattern)
+            list(GET rule 1 name)
+            if(symbol MATCHES "${pattern}")
+                set(subsystem ${name})
+                break()
+            endif()
+        endforeach()
+    else()
+        foreach(rule ${file_rules})
+            if(rule MATCHES "^${file}=(.+)$")
+                set(subsystem ${CMAKE_MATCH_1})
+            endif()
+        endforeach()
+    endif()
+
+    if(NOT DEFINED measured_${subsystem})
+        set(measured_${subsystem} 0)
+        set(budget_${subsystem} 0)
+        list(APPEND subsystems ${subsystem})
+    endif()
+    math(EXPR measured_${subsystem} "${measured_${subsystem}} + ${bytes}")
+    math(EXPR measured_total "${measured_total} + ${bytes}")
+endforeach()
+
+message("memory budget: subsystem        measured estimated")
+foreach(name ${subsystems})
+    string(LENGTH "${name}" length)
+    math(EXPR padding "16 - ${length}")
+    string(REPEAT " " ${padding} spaces)
+    string(LENGTH "${measured_${name}}" length)
+    math(EXPR padding "9 - ${length}")
+    string(REPEAT " " ${padding} width)
+    string(LENGTH "${budget_${name}}" length)
+    math(EXPR padding "10 - ${length}")
+    string(REPEAT " " ${padding} estimate_width)
+    message("memory budget: ${name}${spaces} ${width}${measured_${name}}${estimate_width}${budget_${name}}")
+endforeach()
+
+math(EXPR percent "(${measured_total} * 100) / ${budget_limit}")
+math(EXPR spare "${budget_limit} - ${measured_total}")
+message("memory budget: total            ${measured_total} / ${budget_limit} bytes, ${percent}% used, ${spare} spare, "
+        "${budget_total} estimated")
+if(measured_total GREATER budget_limit)
+    message(FATAL_ERROR "memory budget: the statics of ${app_archive} take ${measured_total} bytes, "
+                        "over the MEMORY_BUDGET_LIMIT of ${budget_limit}")
+endif()
@@ -0,0 +1,152 @@
+// Localhost load test of the metrics responder. Serves src/metrics_http.c
+// from a thread while another one keeps changing the state, then scrapes it
+// back to back and reports requests per second and the latency spread.
+//
+//     cc -O2 -Isrc -o metrics_bench tools/metrics_bench.c src/metrics.c src/metrics_http.c -lpthread -lm
+//     ./metrics_bench [requests] [path] [update interval us]
+//     ./metrics_bench 20000 /metrics.json 1000
+//
+// The responder can also be left running for an external load generator,
+// e.g. wrk, with a request count of 0.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics_http.h"
+
+#define BENCH_PORT (19100)
+
+static metrics_t metrics;
+static gpsdo_state_t state;
+static alarm_engine_t alarms;
+static volatile int update_interval_us = 1000;
+
+static int64_t now_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+}
+
+static void *serve_thread(void *arg)
+{
+    if (metrics_http_serve(&metrics, BENCH_PORT) != 0)
+    {
+        perror("metrics_http_serve");
+        exit(1);
+    }
+    return NULL;
+}
+
+// A few values drift every update, the rest stays put as on the real unit
+static void *update_thread(void *arg)
+{
+    metrics_trend_t trends[METRICS_TREND_COUNT] = {{true, -1e-8f, 1e-8f}, {true, 10.0f, 12.0f}, {true, 40.0f, 42.0f}};
+
+    for (unsigned int n = 0;; n++)
+    {
+        state.temperature = 41.0f + (rand() % 1000) / 1000.0f;
+        state.phase = (rand() % 2000 - 1000) * 1e-11f;
+        state.dac = 11.0f + (rand() % 100) / 1000.0f;
+        state.tint = (rand() % 100) * 1e-10f;
+        state.gps_time = 1400000000 + n;
+        alarms.active = (n / 1000) & 1;
+        alarms.events = n / 1000;
+        metrics_update(&metrics, &state, trends, &alarms);
+        usleep(update_interval_us);
+    }
+    return NULL;
+}
+
+static int compare(const void *a, const void *b)
+{
+    return *(const int64_t *)a - *(const int64_t *)b;
+}
+
+// Returns the response length, -1 when it was not a 200
+static int scrape(const char *path)
+{
+    static char response[METRICS_HTTP_BUFFER_SIZE];
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(BENCH_PORT)};
+    char request[128];
+    int length = 0;
+    int received;
+
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if ((fd < 0) || (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0))
+    {
+        close(fd);
+        return -1;
+    }
+    int request_length = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+    send(fd, request, request_length, 0);
+    while ((length < sizeof(response)) && ((received = recv(fd, &response[length], sizeof(response) - length, 0)) > 0))
+    {
+        length += received;
+    }
+    close(fd);
+    return (strncmp(response, "HTTP/1.0 200", 12) == 0) ? length : -1;
+}
+
+int main(int argc, char **argv)
+{
+    int requests = (argc > 1) ? atoi(argv[1]) : 10000;
+    const char *path = (argc > 2) ? argv[2] : "/metrics";
+    pthread_t server, updater;
+
+    if (argc > 3)
+    {
+        update_interval_us = atoi(argv[3]);
+    }
+    if (metrics_init(&metrics) != 0)
+    {
+        fprintf(stderr, "Metrics do not fit their documents\n");
+        return 1;
+    }
+    pthread_create(&server, NULL, serve_thread, NULL);
+    pthread_create(&updater, NULL, update_thread, NULL);
+    usleep(100000);
+    if (requests == 0)
+    {
+        printf("Serving on http://127.0.0.1:%d%s\n", BENCH_PORT, path);
+        pthread_join(server, NULL);
+    }
+
+    int64_t *latency_us = malloc(requests * sizeof(int64_t));
+    int failed = 0;
+    long bytes = 0;
+    int64_t start_us = now_us();
+    for (int i = 0; i < requests; i++)
+    {
+        int64_t request_us = now_us();
+        int length = scrape(path);
+        latency_us[i] = now_us() - request_us;
+        if (length < 0)
+        {
+            failed++;
+        }
+        else
+        {
+            bytes += length;
+        }
+    }
+    double seconds = (now_us() - start_us) / 1e6;
+
+    qsort(latency_us, requests, sizeof(int64_t), compare);
+    printf("%d requests to %s in %.2f s, %d failed\n", requests, path, seconds, failed);
+    printf("%.0f requests/s, %ld bytes per response\n", requests / seconds, bytes / (requests - failed ? requests - failed : 1));
+    printf("latency us: p50 %lld, p99 %lld, max %lld\n", (long long)latency_us[requests / 2],
+           (long long)latency_us[requests * 99 / 100], (long long)latency_us[requests - 1]);
+    printf("%u updates, %u values re-rendered, server %u requests, %u errors\n", atomic_load(&metrics.stats.updates),
+           atomic_load(&metrics.stats.rendered), atomic_load(&metrics_http_stats.requests),
+           atomic_load(&metrics_http_stats.errors));
+    free(latency_us);
+    return 0;
+}
@@ -0,0 +1,183 @@
+// Localhost load test of the NTP server core. Feeds clock_sync with TOD
+// arrivals derived from the host clock, serves src/ntp_server.c from a
+// thread and sends it requests over UDP, a window of them in flight. Reports
+// requests per second, the round trip spread and the offset of the served
+// time against the host clock, which the synthetic TOD packets follow.
+//
+//     cc -O2 -Isrc -o ntp_bench tools/ntp_bench.c src/ntp_server.c src/clock_sync.c -lpthread -lm
+//     ./ntp_bench [requests] [window]
+//     ./ntp_bench 200000 8
+//
+// With a request count of 0 the server keeps running on port 12300 for an
+// external client, e.g. ntpdate -q -p 1 -u 127.0.0.1 after redirecting 123.
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ntp_server.h"
+
+#define BENCH_PORT (12300)
+#define BENCH_UTC_OFFSET (18)
+#define UNIX_GPS_EPOCH (315964800)
+
+static clock_sync_t clock_sync;
+static ntp_server_t ntp_server;
+static gpsdo_state_t state = {.tfom = 2, .utc_offset = BENCH_UTC_OFFSET, .tod_status = {0x60, 0x04, 0x45, 0x80}};
+
+static int64_t monotonic_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+}
+
+static int64_t realtime_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+}
+
+static void *serve_thread(void *arg)
+{
+    if (ntp_server_serve(&ntp_server, BENCH_PORT) != 0)
+    {
+        perror("ntp_server_serve");
+        exit(1);
+    }
+    return NULL;
+}
+
+// One TOD packet per host second, stamped on the monotonic time the second
+// began plus the latency clock_sync takes off again
+static void *tod_thread(void *arg)
+{
+    int32_t error_us;
+
+    for (;;)
+    {
+        int64_t real_us = realtime_us();
+        int64_t boundary_us = monotonic_us() - (real_us % 1000000);
+        uint32_t second = (real_us / 1000000) - UNIX_GPS_EPOCH + BENCH_UTC_OFFSET;
+        clock_sync_tod(&clock_sync, second, boundary_us + CLOCK_SYNC_TOD_LATENCY_US, &error_us);
+        ntp_server_update(&ntp_server, &state, second, 0);
+        usleep(1000000 - (realtime_us() % 1000000) + 1000);
+    }
+    return NULL;
+}
+
+static double ntp_to_unix(const uint8_t *p)
+{
+    uint32_t second = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    uint32_t fraction = (p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+    return (second - NTP_GPS_EPOCH + (double)UNIX_GPS_EPOCH) + (fraction / 4294967296.0);
+}
+
+static int compare(const void *a, const void *b)
+{
+    return *(const int64_t *)a - *(const int64_t *)b;
+}
+
+int main(int argc, char **argv)
+{
+    int requests = (argc > 1) ? atoi(argv[1]) : 100000;
+    int window = (argc > 2) ? atoi(argv[2]) : 1;
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(BENCH_PORT)};
+    pthread_t server, tod;
+    int32_t error_us;
+
+    clock_sync_init(&clock_sync);
+    ntp_server_init(&ntp_server, &clock_sync);
+    // A window of past seconds so the model locks at once
+    int64_t real_us = realtime_us();
+    int64_t boundary_us = monotonic_us() - (real_us % 1000000);
+    uint32_t second = (real_us / 1000000) - UNIX_GPS_EPOCH + BENCH_UTC_OFFSET;
+    for (int i = CLOCK_SYNC_WINDOW; i > 0; i--)
+    {
+        clock_sync_tod(&clock_sync, second - i, boundary_us - (i * 1000000LL) + CLOCK_SYNC_TOD_LATENCY_US, &error_us);
+    }
+    pthread_create(&tod, NULL, tod_thread, NULL);
+    pthread_create(&server, NULL, serve_thread, NULL);
+    usleep(100000);
+    if (requests == 0)
+    {
+        printf("Serving on udp 127.0.0.1:%d\n", BENCH_PORT);
+        pthread_join(server, NULL);
+    }
+
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    connect(fd, (struct sockaddr *)&address, sizeof(address));
+
+    // Requests carry their index in the transmit timestamp, which comes back as origin
+    int64_t *sent_us = calloc(requests, sizeof(int64_t));
+    int64_t *rtt_us = calloc(requests, sizeof(int64_t));
+    int sent = 0, received = 0, bad = 0, timeouts = 0;
+    double offset_sum = 0, offset_max = 0;
+    int64_t start_us = monotonic_us();
+    while (received + timeouts < requests)
+    {
+        while ((sent < requests) && (sent - received - timeouts < window))
+        {
+            uint8_t request[NTP_PACKET_SIZE] = {(4 << 3) | 3};
+            memcpy(&request[40], &sent, sizeof(sent));
+            sent_us[sent] = monotonic_us();
+            send(fd, request, sizeof(request), 0);
+            sent++;
+        }
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (poll(&pfd, 1, 100) <= 0)
+        {
+            // Lost in the socket buffers, let the window move on
+            timeouts += sent - received - timeouts;
+            continue;
+        }
+        uint8_t response[NTP_PACKET_SIZE];
+        int64_t arrival_real_us = realtime_us();
+        if (recv(fd, response, sizeof(response), 0) != NTP_PACKET_SIZE)
+        {
+            continue;
+        }
+        int index;
+        memcpy(&index, &response[24], sizeof(index));
+        if ((index < 0) || (index >= requests) || ((response[0] & 0x07) != 4) || (response[1] != 1))
+        {
+            bad++;
+            continue;
+        }
+        rtt_us[received++] = monotonic_us() - sent_us[index];
+        // Transmit time against the host clock at arrival, the round trip is microseconds
+        double offset = ntp_to_unix(&response[40]) - (arrival_real_us / 1e6);
+        offset_sum += offset;
+        offset_max = fmax(offset_max, fabs(offset));
+    }
+    double seconds = (monotonic_us() - start_us) / 1e6;
+
+    qsort(rtt_us, received, sizeof(int64_t), compare);
+    printf("%d requests in %.2f s with %d in flight, %d replies, %d bad, %d lost\n", requests, seconds, window,
+           received, bad, timeouts);
+    printf("%.0f requests/s\n", received / seconds);
+    if (received > 0)
+    {
+        printf("round trip us: p50 %lld, p99 %lld, max %lld\n", (long long)rtt_us[received / 2],
+               (long long)rtt_us[received * 99 / 100], (long long)rtt_us[received - 1]);
+        printf("served time against host clock: mean %+.1f us, max %.1f us\n", offset_sum / received * 1e6,
+               offset_max * 1e6);
+    }
+    printf("server: %u requests, %u dropped, turnaround %u us (max %u)\n", atomic_load(&ntp_server.stats.requests),
+           atomic_load(&ntp_server.stats.dropped),
+           atomic_load(&ntp_server.stats.turnaround_us_total) / (atomic_load(&ntp_server.stats.replies) | 1),
+           atomic_load(&ntp_server.stats.turnaround_us_max));
+    free(sent_us);
+    free(rtt_us);
+    return 0;
+}
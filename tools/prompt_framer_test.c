@@ -0,0 +1,237 @@
+// Host test of src/prompt_framer.c behind a simulated command UART. The
+// simulation queues the position of every space that ends a burst, as the
+// ESP32 pattern detector does for a space followed by line idle, and reads
+// up to each position the way uart_receive_cmd_task does. Covers prompts
+// split across reads, spaces and pauses inside a response, back to back
+// frames, batched responses, an oversized response, and random batches cut
+// into random bursts.
+//
+//     cc -O2 -Isrc -o prompt_framer_test tools/prompt_framer_test.c src/prompt_framer.c
+//     ./prompt_framer_test [random responses] [seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prompt_framer.h"
+
+#define UCCM_PROMPT "UCCM> "
+#define FRAME_SIZE (3072)
+#define STREAM_SIZE (1 << 23)
+#define MAX_RESPONSES (8192)
+#define MAX_PATTERNS (1 << 16)
+
+typedef struct
+{
+    char data[STREAM_SIZE];
+    int written;
+    int read;
+    int patterns[MAX_PATTERNS];
+    int pattern_head;
+    int pattern_count;
+} sim_uart_t;
+
+typedef struct
+{
+    char *expected[MAX_RESPONSES];
+    int expected_count;
+    int received;
+    int failed;
+} check_t;
+
+static sim_uart_t uart;
+static char frame[FRAME_SIZE];
+static prompt_framer_t framer;
+static check_t check;
+
+// A burst of bytes followed by line idle
+static void sim_burst(const char *bytes, int length)
+{
+    memcpy(&uart.data[uart.written], bytes, length);
+    uart.written += length;
+    if ((length > 0) && (bytes[length - 1] == ' '))
+    {
+        uart.patterns[(uart.pattern_head + uart.pattern_count++) % MAX_PATTERNS] = uart.written - 1;
+    }
+}
+
+static void on_response(char *response, int length, void *arg)
+{
+    check_t *c = arg;
+    if ((c->received >= c->expected_count) || ((int)strlen(response) != length) ||
+        (strcmp(response, c->expected[c->received]) != 0))
+    {
+        if (c->failed++ < 5)
+        {
+            printf("Response %d: got \"%.40s\" (%d), expected \"%.40s\"\n", c->received, response, length,
+                   (c->received < c->expected_count) ? c->expected[c->received] : "nothing");
+        }
+    }
+    c->received++;
+}
+
+// What uart_receive_cmd_task does on every UART_PATTERN_DET
+static void sim_task()
+{
+    while (uart.pattern_count > 0)
+    {
+        int pattern_pos = uart.patterns[uart.pattern_head] - uart.read;
+        uart.pattern_head = (uart.pattern_head + 1) % MAX_PATTERNS;
+        uart.pattern_count--;
+        for (int left = pattern_pos + 1; left > 0;)
+        {
+            int chunk = (left < prompt_framer_space(&framer)) ? left : prompt_framer_space(&framer);
+            if (chunk <= 0)
+            {
+                prompt_framer_overflow(&framer, left);
+                uart.read += left;
+                break;
+            }
+            memcpy(prompt_framer_tail(&framer), &uart.data[uart.read], chunk);
+            uart.read += chunk;
+            prompt_framer_commit(&framer, chunk, on_response, &check);
+            left -= chunk;
+        }
+    }
+}
+
+static void expect(const char *response)
+{
+    check.expected[check.expected_count++] = strdup(response);
+}
+
+static int finish(const char *name)
+{
+    int failed = check.failed || (check.received != check.expected_count);
+    printf("%-28s %3d of %3d responses, %u overflows: %s\n", name, check.received, check.expected_count,
+           framer.stats.overflows, failed ? "FAILED" : "ok");
+    for (int i = 0; i < check.expected_count; i++)
+    {
+        free(check.expected[i]);
+    }
+    memset(&check, 0, sizeof(check));
+    memset(&uart, 0, sizeof(uart));
+    prompt_framer_init(&framer, frame, sizeof(frame), UCCM_PROMPT);
+    return failed;
+}
+
+static const char *syst_stat = "SYST:STAT?\r\n-------------------------------- Operation ------------------------\r\n"
+                               "TFOM     3             FFOM     0\r\n"
+                               "\"Command Complete\"\r\n" UCCM_PROMPT;
+static const char *efc = "DIAG:ROSC:EFC:REL?\r\n41.53%\r\n\"Command Complete\"\r\n" UCCM_PROMPT;
+static const char *led = "LED:GPSL?\r\nLocked\r\n\"Command Complete\"\r\n" UCCM_PROMPT;
+
+// Printable text with spaces, never holding the prompt
+static void random_response(char *response, int length)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789:?.,+- \r\n";
+    int i = snprintf(response, length, "CMD%d?\r\n", rand() % 100);
+    for (; i < length - (int)sizeof(UCCM_PROMPT); i++)
+    {
+        response[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+    }
+    strcpy(&response[i], UCCM_PROMPT);
+}
+
+int main(int argc, char **argv)
+{
+    int count = (argc > 1) ? atoi(argv[1]) : 4000;
+    int failed = 0;
+
+    srand((argc > 2) ? atoi(argv[2]) : 1);
+    prompt_framer_init(&framer, frame, sizeof(frame), UCCM_PROMPT);
+
+    // One response, one burst
+    expect(syst_stat);
+    sim_burst(syst_stat, strlen(syst_stat));
+    sim_task();
+    failed |= finish("Single response");
+
+    // The prompt split across bursts, the first part ends in no space
+    expect(efc);
+    sim_burst(efc, strlen(efc) - 3);
+    sim_task();
+    sim_burst(efc + strlen(efc) - 3, 3);
+    sim_task();
+    failed |= finish("Prompt split across reads");
+
+    // A pause right after a space inside the response
+    expect(syst_stat);
+    const char *space = strstr(syst_stat, "3 ") + 2;
+    sim_burst(syst_stat, space - syst_stat);
+    sim_task();
+    sim_burst(space, strlen(space));
+    sim_task();
+    failed |= finish("Space and pause inside");
+
+    // Two frames queued before the task runs
+    expect(efc);
+    expect(led);
+    sim_burst(efc, strlen(efc));
+    sim_burst(led, strlen(led));
+    sim_task();
+    failed |= finish("Back to back frames");
+
+    // A batch answered in one burst, no pause after the inner prompts
+    char batch[1024];
+    snprintf(batch, sizeof(batch), "%s%s%s", led, efc, syst_stat);
+    expect(led);
+    expect(efc);
+    expect(syst_stat);
+    sim_burst(batch, strlen(batch));
+    sim_task();
+    failed |= finish("Batched responses");
+
+    // A burst with a prompt and then the second response up to a space
+    expect(led);
+    expect(syst_stat);
+    char first[512];
+    const char *cut = strstr(syst_stat, "TFOM ") + 5;
+    int first_length = snprintf(first, sizeof(first), "%s%.*s", led, (int)(cut - syst_stat), syst_stat);
+    sim_burst(first, first_length);
+    sim_task();
+    sim_burst(cut, strlen(cut));
+    sim_task();
+    failed |= finish("Prompt then partial reply");
+
+    // A response larger than the frame buffer is dropped, the next one is not
+    static char huge[FRAME_SIZE + 512];
+    random_response(huge, sizeof(huge));
+    sim_burst(huge, strlen(huge));
+    expect(led);
+    sim_burst(led, strlen(led));
+    sim_task();
+    int overflowed = (framer.stats.overflows == 0);
+    failed |= finish("Oversized response") | overflowed;
+
+    // Random batches of responses cut into random bursts. The UCCM idles
+    // after the last prompt of a batch while it waits for the next command,
+    // so that is always the end of a burst
+    for (int i = 0; i < count && i < MAX_RESPONSES;)
+    {
+        static char batch_text[4 * 1024];
+        int batch_length = 0;
+        for (int n = 1 + (rand() % 4); (n > 0) && (i < count) && (i < MAX_RESPONSES); n--, i++)
+        {
+            char response[1024];
+            random_response(response, 16 + (rand() % (sizeof(response) - 16)));
+            expect(response);
+            batch_length += sprintf(&batch_text[batch_length], "%s", response);
+        }
+        for (int at = 0; at < batch_length;)
+        {
+            int length = 1 + (rand() % 600);
+            length = (at + length > batch_length) ? batch_length - at : length;
+            sim_burst(&batch_text[at], length);
+            at += length;
+            if (rand() % 3 == 0)
+            {
+                sim_task();
+            }
+        }
+    }
+    sim_task();
+    failed |= finish("Random bursts");
+
+    return failed;
+}
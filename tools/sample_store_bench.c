@@ -0,0 +1,302 @@
+// Host benchmark and check of the compressed sample store in
+// src/sample_store.c, sized as memory_budget.h sizes it on the device: a
+// 1 Hz store for the window statistics and a week store of means. Feeds both
+// a recording or a simulated run at 1 Hz, then:
+//  - reports the bits per sample, the compression ratio and how long each
+//    pool holds, and fails when the 1 Hz store holds less than
+//    WINDOW_STATS_SECONDS or the week store less than 7 days;
+//  - decodes everything back and checks each value against what was
+//    appended, before any rounding, within half a unit of the last digit the
+//    UCCM prints it with;
+//  - times the appends and the streaming decode of the queries.
+//
+// A recording has one "gps_time phase dac temperature tint" line per second,
+// e.g. the values of the SYST:STAT?, DIAG:ROSC:EFC:REL? and TINT polls. The
+// simulated run prints each value with the digits the UCCM answers with and
+// reads it back: phase and TINT as a random walk in %.3E, the EFC as a slow
+// drift in %.4f and the temperature in 1/16 degree steps over a day in %.3f.
+//
+//     cc -O2 -Isrc -o sample_store_bench tools/sample_store_bench.c src/sample_store.c -lm
+//     ./sample_store_bench [days] [1 Hz blocks] [week blocks] [decimation]
+//     ./sample_store_bench -r recording.txt [1 Hz blocks] [week blocks] [decimation]
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sample_store.h"
+#include "window_stats.h"
+
+// The smallest pools of memory_budget.h, with the metrics and NTP server in
+#define FINE_BLOCKS (26)
+#define WEEK_BLOCKS (19)
+#define WEEK_DECIMATION (300)
+#define WEEK_SECONDS (7 * 24 * 3600)
+#define START_TIME (1400000000)
+
+typedef struct
+{
+    uint32_t gps_time;
+    float values[SAMPLE_SERIES_COUNT];
+} input_t;
+
+typedef struct
+{
+    const input_t *inputs;
+    uint32_t count;
+    // Next input to compare a 1 Hz sample with, or first of a week period
+    uint32_t next;
+    uint32_t decimation;
+    uint32_t decoded;
+    uint32_t mismatches;
+    double worst[SAMPLE_SERIES_COUNT];
+} verify_t;
+
+#define SERIES_NAME(id, field, bits) #field,
+static const char *const series_names[SAMPLE_SERIES_COUNT] = {SAMPLE_STORE_SERIES(SERIES_NAME)};
+
+static input_t *inputs;
+static uint32_t input_count;
+
+static int64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+// Through the text the UCCM answers with, as the parsers see it
+static float printed(const char *format, double value)
+{
+    char text[32];
+    snprintf(text, sizeof(text), format, value);
+    return (float)atof(text);
+}
+
+static void simulate(int days)
+{
+    double phase = 0.0, tint = 0.0, efc = 41.53;
+
+    input_count = days * 24 * 3600;
+    inputs = calloc(input_count, sizeof(input_t));
+    srand(1);
+    for (uint32_t i = 0; i < input_count; i++)
+    {
+        double noise = ((rand() % 2001) - 1000) / 1000.0;
+        phase = (0.98 * phase) + (2e-11 * noise);
+        tint = (0.95 * tint) + (5e-11 * (((rand() % 2001) - 1000) / 1000.0)) + 1e-9 * (i % 2);
+        efc += 1e-6 * (((rand() % 2001) - 1000) / 1000.0) + 2e-7;
+        double temperature = 37.0 + sin(i * 2 * M_PI / 86400) + (((rand() % 3) - 1) / 16.0);
+
+        input_t *input = &inputs[i];
+        input->gps_time = START_TIME + i;
+        input->values[SAMPLE_SERIES_PHASE] = printed("%.3E", phase);
+        input->values[SAMPLE_SERIES_DAC] = printed("%.4f", efc);
+        input->values[SAMPLE_SERIES_TEMPERATURE] = printed("%.3f", round(temperature * 16) / 16);
+        input->values[SAMPLE_SERIES_TINT] = printed("%.3E", tint);
+    }
+}
+
+static int load(const char *path)
+{
+    FILE *recording = fopen(path, "r");
+    uint32_t size = 0;
+    input_t input;
+
+    if (recording == NULL)
+    {
+        printf("Cannot open %s\n", path);
+        return -1;
+    }
+    while (fscanf(recording, "%u %f %f %f %f", &input.gps_time, &input.values[SAMPLE_SERIES_PHASE],
+                  &input.values[SAMPLE_SERIES_DAC], &input.values[SAMPLE_SERIES_TEMPERATURE],
+                  &input.values[SAMPLE_SERIES_TINT]) == 5)
+    {
+        if (input_count == size)
+        {
+            size = size ? size * 2 : 65536;
+            inputs = realloc(inputs, size * sizeof(input_t));
+        }
+        inputs[input_count++] = input;
+    }
+    fclose(recording);
+    return 0;
+}
+
+static void to_state(const input_t *input, gpsdo_state_t *state)
+{
+    state->gps_time = input->gps_time;
+    state->phase = input->values[SAMPLE_SERIES_PHASE];
+    state->dac = input->values[SAMPLE_SERIES_DAC];
+    state->temperature = input->values[SAMPLE_SERIES_TEMPERATURE];
+    state->tint = input->values[SAMPLE_SERIES_TINT];
+}
+
+// Half a unit of the last digit the UCCM prints a value with: 4 significant
+// digits of the phase and TINT, 4 decimals of the EFC and 3 of the temperature
+static double printed_half_digit(int series, double value)
+{
+    switch (series)
+    {
+    case SAMPLE_SERIES_PHASE:
+    case SAMPLE_SERIES_TINT:
+        return (value != 0.0) ? 0.5 * pow(10.0, floor(log10(fabs(value))) - 3) : 0.0;
+    case SAMPLE_SERIES_DAC:
+        return 0.5e-4;
+    default:
+        return 0.5e-3;
+    }
+}
+
+// What a decoded sample should hold, the input or the mean of the inputs of
+// its period, and how far off it may be: half a printed digit, plus the float
+// sums of a mean, which go by the size of what they add up
+static void expected(verify_t *verify, uint32_t gps_time, double *values, double *limits)
+{
+    double magnitudes[SAMPLE_SERIES_COUNT] = {0};
+    uint32_t count = 0;
+
+    memset(values, 0, SAMPLE_SERIES_COUNT * sizeof(double));
+    while ((verify->next < verify->count) && (verify->inputs[verify->next].gps_time < gps_time))
+    {
+        verify->next++;
+    }
+    while ((verify->next < verify->count) && (verify->inputs[verify->next].gps_time < gps_time + verify->decimation))
+    {
+        for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+        {
+            values[series] += verify->inputs[verify->next].values[series];
+            magnitudes[series] += fabs(verify->inputs[verify->next].values[series]);
+        }
+        verify->next++;
+        count++;
+    }
+    for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+    {
+        values[series] /= count ? count : 1;
+        limits[series] = printed_half_digit(series, values[series]) +
+                         ((count > 1) ? magnitudes[series] * FLT_EPSILON : 0.0);
+    }
+}
+
+static void verify_sample(const sample_store_sample_t *sample, void *arg)
+{
+    verify_t *verify = arg;
+    double values[SAMPLE_SERIES_COUNT], limits[SAMPLE_SERIES_COUNT];
+
+    expected(verify, sample->gps_time, values, limits);
+    verify->decoded++;
+    for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+    {
+        float value;
+        memcpy(&value, &sample->values[series], sizeof(value));
+        double error = fabs(value - values[series]);
+        if (error > 0.0)
+        {
+            verify->worst[series] = fmax(verify->worst[series], limits[series] ? error / limits[series] : INFINITY);
+        }
+        verify->mismatches += (error > limits[series]);
+    }
+}
+
+static void count_sample(const sample_store_sample_t *sample, void *arg)
+{
+    (*(uint32_t *)arg)++;
+}
+
+static int run(const char *name, uint32_t block_count, uint32_t decimation, uint32_t required)
+{
+    sample_block_t *blocks = calloc(block_count, sizeof(sample_block_t));
+    sample_store_t store;
+    gpsdo_state_t state;
+
+    memset(&state, 0, sizeof(state));
+    sample_store_init(&store, blocks, block_count, decimation);
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < input_count; i++)
+    {
+        to_state(&inputs[i], &state);
+        sample_store_append(&store, &state);
+    }
+    int64_t encode_ns = now_ns() - start;
+
+    verify_t verify = {.inputs = inputs, .count = input_count, .decimation = decimation};
+    int found = sample_store_query(&store, 0, UINT32_MAX, verify_sample, &verify);
+
+    uint32_t held = (found > 0) ? store.last_time - sample_store_first_time(&store) + decimation : 0;
+
+    // The whole pool, then the hours it holds as the window statistics query them
+    uint32_t decoded = 0;
+    start = now_ns();
+    sample_store_query(&store, 0, UINT32_MAX, count_sample, &decoded);
+    int64_t decode_ns = now_ns() - start;
+    uint32_t queries = 0, queried = 0;
+    start = now_ns();
+    for (uint32_t back = 0; back + WINDOW_STATS_SECONDS <= held; back += WINDOW_STATS_SECONDS)
+    {
+        uint32_t to = store.last_time - back;
+        sample_store_query(&store, to - WINDOW_STATS_SECONDS + 1, to, count_sample, &queried);
+        queries++;
+    }
+    int64_t query_ns = now_ns() - start;
+
+    const sample_store_stats_t *stats = &store.stats;
+    double bits = (stats->retained_bytes * 8.0) / stats->retained;
+
+    printf("%s store, %u blocks, a sample per %u s:\n", name, block_count, decimation);
+    printf("  %.1f bits per sample, %.2f:1 against %zu raw bytes, %.1f samples per block\n", bits,
+           (stats->retained * sizeof(sample_store_sample_t)) / (double)stats->retained_bytes,
+           sizeof(sample_store_sample_t), (8.0 * (SAMPLE_STORE_BLOCK_SIZE - 12)) / bits);
+    printf("  holds %.2f h (%.2f d), %u blocks recycled, needs %.2f h\n", held / 3600.0, held / 86400.0,
+           stats->blocks_recycled, required / 3600.0);
+    printf("  append %.1f ns per sample (worst %u ns), decode %.1f ns per sample\n", (double)encode_ns / input_count,
+           stats->cycles_max, (double)decode_ns / (decoded ? decoded : 1));
+    printf("  %u one hour queries of %.0f samples in %.1f us each\n", queries, queries ? (double)queried / queries : 0.0,
+           queries ? query_ns / 1000.0 / queries : 0.0);
+    printf("  %u samples decoded, %u off by more than half a printed digit, worst error in allowed errors", verify.decoded,
+           verify.mismatches);
+    for (int series = 0; series < SAMPLE_SERIES_COUNT; series++)
+    {
+        printf(" %s %.2f", series_names[series], verify.worst[series]);
+    }
+    printf("\n");
+    free(blocks);
+    return (held < required) || (verify.mismatches > 0) || (found != (int)stats->retained);
+}
+
+int main(int argc, char **argv)
+{
+    int arg = 1;
+
+    if ((argc > 2) && (strcmp(argv[1], "-r") == 0))
+    {
+        if (load(argv[2]) != 0)
+        {
+            return 1;
+        }
+        arg = 3;
+    }
+    else
+    {
+        simulate((argc > 1) ? atoi(argv[1]) : 8);
+        arg = 2;
+    }
+    uint32_t fine_blocks = (argc > arg) ? atoi(argv[arg]) : FINE_BLOCKS;
+    uint32_t week_blocks = (argc > arg + 1) ? atoi(argv[arg + 1]) : WEEK_BLOCKS;
+    uint32_t decimation = (argc > arg + 2) ? atoi(argv[arg + 2]) : WEEK_DECIMATION;
+
+    if (input_count == 0)
+    {
+        printf("No samples\n");
+        return 1;
+    }
+    uint32_t span = input_count ? inputs[input_count - 1].gps_time - inputs[0].gps_time + 1 : 0;
+    printf("%u samples over %.2f days\n", input_count, span / 86400.0);
+    int failed = run("1 Hz", fine_blocks, 1, MIN(span, WINDOW_STATS_SECONDS));
+    failed |= run("Week", week_blocks, decimation, MIN(span - (span % decimation), WEEK_SECONDS));
+    printf("%s\n", failed ? "FAILED" : "ok");
+    return failed;
+}
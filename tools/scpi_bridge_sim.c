@@ -0,0 +1,327 @@
+// Host run of the SCPI bridge against a fake UCCM. Threads stand in for the
+// firmware tasks and wire src/scpi_bridge.c up the same way:
+//  - the bridge task runs scpi_bridge_poll() on a pseudo terminal client
+//    from scpi_client_pty_init();
+//  - send_cmd_task interleaves the client commands with monitor polls and
+//    notes every write with scpi_bridge_sent();
+//  - the fake UCCM echoes each command line and answers it with a body,
+//    "Command Complete" and the prompt, in uneven pieces;
+//  - uart_receive_cmd_task frames the replies with prompt_framer and hands
+//    them to scpi_bridge_route(), the monitor counts the rest.
+//
+// By default the program types commands on the terminal side of the pty
+// itself, with some backspace editing, and checks that each one comes back
+// with its own response and prompt, that no monitor response leaks to the
+// terminal and that the monitor gets every poll answer. With -i it prints
+// the pty path and keeps running for a terminal program, e.g. picocom.
+//
+//     cc -O2 -pthread -Isrc -o scpi_bridge_sim tools/scpi_bridge_sim.c src/scpi_bridge.c src/scpi_bridge_pty.c src/spsc_ring.c src/prompt_framer.c
+//     ./scpi_bridge_sim [commands]
+//     ./scpi_bridge_sim -i
+
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "prompt_framer.h"
+#include "scpi_bridge.h"
+
+#define UCCM_PROMPT "UCCM> "
+#define COMMAND_COMPLETE "\"Command Complete\"\r\n"
+#define SLOT_MS (20)
+#define POLL_MS (10)
+#define REPLY_TIMEOUT_MS (2000)
+#define FRAME_SIZE (3072)
+
+static scpi_bridge_t bridge;
+static int to_uccm[2], from_uccm[2];
+static atomic_bool stopping;
+static atomic_uint polls_sent, polls_answered, monitor_unexpected;
+
+static int64_t now_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000LL) + (now.tv_nsec / 1000);
+}
+
+// The fake UCCM answers every query with its own name in the body, so a
+// response can be told apart from any other
+static int uccm_reply(const char *command, char *reply, size_t size)
+{
+    return snprintf(reply, size, "%s\r\nvalue of %s\r\n" COMMAND_COMPLETE UCCM_PROMPT, command, command);
+}
+
+static void *uccm_thread(void *arg)
+{
+    char line[256];
+    int length = 0;
+    char c;
+
+    while (read(to_uccm[0], &c, 1) == 1)
+    {
+        if (c != '\n')
+        {
+            length += (length < (int)sizeof(line) - 1);
+            line[length - 1] = c;
+            continue;
+        }
+        line[length] = '\0';
+        length = 0;
+
+        char reply[512];
+        int reply_length = uccm_reply(line, reply, sizeof(reply));
+        // In two or three pieces with a pause, a space may end the first
+        for (int at = 0; at < reply_length;)
+        {
+            int piece = 1 + (rand() % reply_length);
+            piece = (at + piece > reply_length) ? reply_length - at : piece;
+            write(from_uccm[1], &reply[at], piece);
+            at += piece;
+            usleep(rand() % 500);
+        }
+    }
+    return NULL;
+}
+
+// Writes the commands in one go after noting them, as send_commands() does
+static void send_commands(int owner, const char *const *commands, int count)
+{
+    char line[256];
+    int length = 0;
+    int64_t sent_us = now_us();
+
+    for (int i = 0; i < count; i++)
+    {
+        length += snprintf(&line[length], sizeof(line) - length, "%s\n", commands[i]);
+        scpi_bridge_sent(&bridge, owner, commands[i], i == count - 1, sent_us);
+    }
+    write(to_uccm[1], line, length);
+}
+
+static void *send_thread(void *arg)
+{
+    static const char *polls[] = {"LED:GPSL?", "DIAG:ROSC:EFC:REL?", "SYNC:TFOM?"};
+    char client_command[SCPI_BRIDGE_LINE_SIZE + 1];
+    unsigned int slot = 0;
+
+    while (!atomic_load(&stopping))
+    {
+        int owner = scpi_bridge_next_command(&bridge, client_command, sizeof(client_command));
+        // Every fourth slot is the monitor's, a batch of two polls
+        if ((owner == SCPI_OWNER_MONITOR) || (slot % 4 == 0))
+        {
+            const char *batch[2] = {polls[slot % 3], polls[(slot + 1) % 3]};
+            send_commands(SCPI_OWNER_MONITOR, batch, 2);
+            atomic_fetch_add(&polls_sent, 2);
+        }
+        if (owner != SCPI_OWNER_MONITOR)
+        {
+            const char *command = client_command;
+            send_commands(owner, &command, 1);
+        }
+        slot++;
+        usleep(SLOT_MS * 1000);
+    }
+    return NULL;
+}
+
+static void monitor_response(char *response, int length, void *arg)
+{
+    if (scpi_bridge_route(&bridge, response, length, now_us()))
+    {
+        return;
+    }
+    // Only the polls may come this way
+    if ((strstr(response, "value of LED:GPSL?") == NULL) && (strstr(response, "value of DIAG:ROSC:EFC:REL?") == NULL) &&
+        (strstr(response, "value of SYNC:TFOM?") == NULL))
+    {
+        atomic_fetch_add(&monitor_unexpected, 1);
+        return;
+    }
+    atomic_fetch_add(&polls_answered, 1);
+}
+
+static void *receive_thread(void *arg)
+{
+    static char frame[FRAME_SIZE];
+    prompt_framer_t framer;
+    int length;
+
+    prompt_framer_init(&framer, frame, sizeof(frame), UCCM_PROMPT);
+    while ((length = read(from_uccm[0], prompt_framer_tail(&framer), prompt_framer_space(&framer))) > 0)
+    {
+        prompt_framer_commit(&framer, length, monitor_response, NULL);
+        if (prompt_framer_space(&framer) == 0)
+        {
+            prompt_framer_overflow(&framer, 0);
+        }
+    }
+    return NULL;
+}
+
+static void *bridge_thread(void *arg)
+{
+    while (!atomic_load(&stopping))
+    {
+        scpi_bridge_poll(&bridge, POLL_MS);
+    }
+    return NULL;
+}
+
+// Reads the terminal until the output ends in the prompt
+static int read_reply(int terminal, char *output, size_t size)
+{
+    int length = 0;
+    int64_t deadline_us = now_us() + (REPLY_TIMEOUT_MS * 1000LL);
+
+    output[0] = '\0';
+    while (now_us() < deadline_us)
+    {
+        struct pollfd fd = {.fd = terminal, .events = POLLIN};
+        if (poll(&fd, 1, 10) <= 0)
+        {
+            continue;
+        }
+        int n = read(terminal, &output[length], size - length - 1);
+        if (n <= 0)
+        {
+            continue;
+        }
+        length += n;
+        output[length] = '\0';
+        if ((length >= (int)sizeof(UCCM_PROMPT) - 1) &&
+            (strcmp(&output[length - sizeof(UCCM_PROMPT) + 1], UCCM_PROMPT) == 0))
+        {
+            return length;
+        }
+    }
+    return -1;
+}
+
+// Types a command in random pieces with a typo fixed by backspace, and
+// checks the echo, the response and the prompt that come back
+static int type_command(int terminal, const char *command)
+{
+    char typed[SCPI_BRIDGE_LINE_SIZE + 8];
+    char output[1024], expected[512];
+    int length = 0;
+
+    int typo = rand() % strlen(command);
+    memcpy(typed, command, typo);
+    length = typo;
+    typed[length++] = 'X';
+    typed[length++] = 0x7f;
+    strcpy(&typed[length], &command[typo]);
+    length += strlen(&command[typo]);
+    typed[length++] = '\r';
+    for (int at = 0; at < length;)
+    {
+        int piece = 1 + (rand() % 4);
+        piece = (at + piece > length) ? length - at : piece;
+        write(terminal, &typed[at], piece);
+        at += piece;
+    }
+
+    if (read_reply(terminal, output, sizeof(output)) < 0)
+    {
+        printf("%s: no prompt, got \"%s\"\n", command, output);
+        return 1;
+    }
+    // Echo of the line as edited, then the UCCM body with its echo stripped
+    int n = snprintf(expected, sizeof(expected), "%.*sX\b \b%s\r\n", typo, command, &command[typo]);
+    uccm_reply(command, &expected[n], sizeof(expected) - n);
+    memmove(&expected[n], strchr(&expected[n], '\n') + 1, strlen(strchr(&expected[n], '\n') + 1) + 1);
+    if (strcmp(output, expected) != 0)
+    {
+        printf("%s: got \"%s\", expected \"%s\"\n", command, output, expected);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool interactive = (argc > 1) && (strcmp(argv[1], "-i") == 0);
+    int commands = (!interactive && (argc > 1)) ? atoi(argv[1]) : 200;
+    pthread_t threads[4];
+    scpi_client_t client;
+    char path[64];
+    int failed = 0;
+
+    srand(1);
+    if ((pipe(to_uccm) != 0) || (pipe(from_uccm) != 0))
+    {
+        perror("pipe");
+        return 1;
+    }
+    scpi_bridge_init(&bridge, UCCM_PROMPT);
+    if ((scpi_client_pty_init(&client, path, sizeof(path)) != 0) || (scpi_bridge_add_client(&bridge, &client) < 0))
+    {
+        printf("Cannot open a pseudo terminal\n");
+        return 1;
+    }
+
+    int terminal = -1;
+    if (!interactive)
+    {
+        // The terminal side in raw mode, as a terminal program sets it
+        struct termios raw;
+        terminal = open(path, O_RDWR | O_NOCTTY);
+        if ((terminal < 0) || (tcgetattr(terminal, &raw) != 0))
+        {
+            printf("Cannot open %s\n", path);
+            return 1;
+        }
+        cfmakeraw(&raw);
+        tcsetattr(terminal, TCSANOW, &raw);
+    }
+
+    pthread_create(&threads[0], NULL, uccm_thread, NULL);
+    pthread_create(&threads[1], NULL, receive_thread, NULL);
+    pthread_create(&threads[2], NULL, send_thread, NULL);
+    pthread_create(&threads[3], NULL, bridge_thread, NULL);
+
+    if (interactive)
+    {
+        printf("Bridge on %s, e.g. picocom %s\n", path, path);
+        fflush(stdout);
+        pthread_join(threads[3], NULL);
+        return 0;
+    }
+
+    int64_t start_us = now_us();
+    for (int i = 0; i < commands; i++)
+    {
+        char command[32];
+        snprintf(command, sizeof(command), "TEST:VALUE%d?", i);
+        failed += type_command(terminal, command);
+    }
+    int64_t elapsed_us = now_us() - start_us;
+
+    // Let the last polls come back before counting them
+    atomic_store(&stopping, true);
+    pthread_join(threads[2], NULL);
+    usleep(200000);
+
+    unsigned int sent = atomic_load(&polls_sent), answered = atomic_load(&polls_answered);
+    unsigned int unexpected = atomic_load(&monitor_unexpected), resyncs = atomic_load(&bridge.stats.resyncs);
+    unsigned int responses = atomic_load(&bridge.stats.responses);
+    printf("%d commands typed, %d wrong, %u answered, %lld ms per command\n", commands, failed, responses,
+           (long long)(elapsed_us / commands / 1000));
+    printf("Latency %u us average, %u us worst; %u round trips\n",
+           responses ? atomic_load(&bridge.stats.latency_us_total) / responses : 0,
+           atomic_load(&bridge.stats.latency_us_max), atomic_load(&bridge.stats.round_trips));
+    printf("Monitor: %u polls sent, %u answered, %u unexpected responses, %u resyncs\n", sent, answered, unexpected,
+           resyncs);
+    failed += (responses != (unsigned int)commands) || (answered != sent) || (unexpected != 0) || (resyncs != 0);
+    printf("%s\n", failed ? "FAILED" : "ok");
+    return failed != 0;
+}
@@ -0,0 +1,251 @@
+// Host benchmark of the sky plot frame, the part of skyPlotScreen() that
+// DLOGD times on the device: clear, horizon and elevation rings, axes and a
+// full table of satellites. u8g2 is not built on the host, so the frame goes
+// into a 128x64 buffer in the same tile layout with the same midpoint circle
+// and disc algorithms, the "N" label left out. Each frame is drawn with the
+// positions from src/sky_plot.c and again with float sinf/cosf on every
+// satellite, and the tables are checked against libm on every azimuth and
+// elevation.
+//
+//     cc -O2 -Isrc -o sky_plot_bench tools/sky_plot_bench.c src/sky_plot.c -lm
+//     ./sky_plot_bench [frames]
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sky_plot.h"
+
+#define WIDTH (128)
+#define HEIGHT (64)
+#define MAX_SATELLITES (24)
+#define CENTER_X (SKY_PLOT_RADIUS + 1)
+#define CENTER_Y (32)
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+typedef struct
+{
+    int az;
+    int el;
+    int cn;
+} satellite_t;
+
+typedef void (*position_fn)(int azimuth, int elevation, int *dx, int *dy);
+
+static uint8_t buffer[WIDTH * HEIGHT / 8];
+static satellite_t satellites[MAX_SATELLITES];
+
+static int64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+// Tile rows of 8 vertical pixels per byte, as the ST7920 buffer of u8g2
+static void pixel(int x, int y)
+{
+    if ((x >= 0) && (x < WIDTH) && (y >= 0) && (y < HEIGHT))
+    {
+        buffer[((y / 8) * WIDTH) + x] |= 1 << (y % 8);
+    }
+}
+
+static void hline(int x, int y, int w)
+{
+    for (int i = 0; i < w; i++)
+    {
+        pixel(x + i, y);
+    }
+}
+
+static void vline(int x, int y, int h)
+{
+    for (int i = 0; i < h; i++)
+    {
+        pixel(x, y + i);
+    }
+}
+
+// Midpoint circle, eight octants per step as u8g2_DrawCircle
+static void circle(int x0, int y0, int r)
+{
+    int f = 1 - r, ddf_x = 1, ddf_y = -2 * r, x = 0, y = r;
+
+    while (x <= y)
+    {
+        pixel(x0 + x, y0 + y);
+        pixel(x0 + y, y0 + x);
+        pixel(x0 - x, y0 + y);
+        pixel(x0 - y, y0 + x);
+        pixel(x0 + x, y0 - y);
+        pixel(x0 + y, y0 - x);
+        pixel(x0 - x, y0 - y);
+        pixel(x0 - y, y0 - x);
+        if (f >= 0)
+        {
+            y--;
+            ddf_y += 2;
+            f += ddf_y;
+        }
+        x++;
+        ddf_x += 2;
+        f += ddf_x;
+    }
+}
+
+// Same walk filled with vertical lines, as u8g2_DrawDisc
+static void disc(int x0, int y0, int r)
+{
+    int f = 1 - r, ddf_x = 1, ddf_y = -2 * r, x = 0, y = r;
+
+    while (x <= y)
+    {
+        vline(x0 + x, y0 - y, (2 * y) + 1);
+        vline(x0 - x, y0 - y, (2 * y) + 1);
+        vline(x0 + y, y0 - x, (2 * x) + 1);
+        vline(x0 - y, y0 - x, (2 * x) + 1);
+        if (f >= 0)
+        {
+            y--;
+            ddf_y += 2;
+            f += ddf_y;
+        }
+        x++;
+        ddf_x += 2;
+        f += ddf_x;
+    }
+}
+
+// What the tables replace: the same projection in float per satellite
+static void float_position(int azimuth, int elevation, int *dx, int *dy)
+{
+    const float deg = 3.14159265f / 180.0f;
+    float radius = SKY_PLOT_RADIUS * sinf((90 - elevation) * deg / 2) / sinf(45 * deg);
+
+    *dx = (int)(radius * sinf(azimuth * deg));
+    *dy = -(int)(radius * cosf(azimuth * deg));
+}
+
+static void draw_frame(position_fn position)
+{
+    int dx, dy;
+
+    memset(buffer, 0, sizeof(buffer));
+    circle(CENTER_X, CENTER_Y, sky_plot_radius(0));
+    circle(CENTER_X, CENTER_Y, sky_plot_radius(30));
+    circle(CENTER_X, CENTER_Y, sky_plot_radius(60));
+    hline(CENTER_X - SKY_PLOT_RADIUS, CENTER_Y, 2 * SKY_PLOT_RADIUS + 1);
+    vline(CENTER_X, CENTER_Y - SKY_PLOT_RADIUS, 2 * SKY_PLOT_RADIUS + 1);
+    for (int i = 0; i < MAX_SATELLITES; i++)
+    {
+        const satellite_t *sat = &satellites[i];
+        position(sat->az, sat->el, &dx, &dy);
+        if (sat->cn > 0)
+        {
+            int r = sat->cn > 30 ? (sat->cn - 30) / 8 : 0;
+            disc(CENTER_X + dx, CENTER_Y + dy, 1 + (r < 2 ? r : 2));
+        }
+        else
+        {
+            circle(CENTER_X + dx, CENTER_Y + dy, 1);
+        }
+    }
+}
+
+// Every azimuth and elevation against libm in double, in Q14 steps and in
+// plotted pixels
+static int check_tables()
+{
+    int worst_sin = 0, worst_radius = 0, off_pixels = 0;
+
+    for (int d = -360; d <= 720; d++)
+    {
+        int exact = (int)lround(sin(d * M_PI / 180) * (1 << SKY_PLOT_SIN_SHIFT));
+        worst_sin = MAX(worst_sin, abs(sky_plot_sin(d) - exact));
+        exact = (int)lround(cos(d * M_PI / 180) * (1 << SKY_PLOT_SIN_SHIFT));
+        worst_sin = MAX(worst_sin, abs(sky_plot_cos(d) - exact));
+    }
+    for (int el = 0; el <= 90; el++)
+    {
+        double radius = SKY_PLOT_RADIUS * sin((90 - el) * M_PI / 360) / sin(M_PI / 4);
+        worst_radius = MAX(worst_radius, abs(sky_plot_radius(el) - (int)lround(radius)));
+        for (int az = 0; az < 360; az++)
+        {
+            int dx, dy;
+            sky_plot_position(az, el, &dx, &dy);
+            // The shift floors, which may go either way within one Q14 step
+            // of a whole pixel
+            double x = sky_plot_radius(el) * sin(az * M_PI / 180);
+            double y = -sky_plot_radius(el) * cos(az * M_PI / 180);
+            double step = (double)sky_plot_radius(el) / (1 << SKY_PLOT_SIN_SHIFT);
+            off_pixels += (dx > x + step) || (dx + 1 < x - step) || (-dy > -y + step) || (-dy + 1 < -y - step);
+        }
+    }
+    printf("Tables against libm: sin/cos within %d Q14 steps, radius within %d px, %d of %d positions off\n",
+           worst_sin, worst_radius, off_pixels, 91 * 360);
+    return (worst_sin > 1) || (worst_radius > 0) || (off_pixels > 0);
+}
+
+static int64_t time_frames(position_fn position, int frames)
+{
+    // Warm up, then the best of a few rounds against scheduling noise
+    draw_frame(position);
+    int64_t best = INT64_MAX;
+    for (int round = 0; round < 5; round++)
+    {
+        int64_t start = now_ns();
+        for (int i = 0; i < frames; i++)
+        {
+            satellites[i % MAX_SATELLITES].az = (satellites[i % MAX_SATELLITES].az + 1) % 360;
+            draw_frame(position);
+        }
+        int64_t elapsed = now_ns() - start;
+        best = (elapsed < best) ? elapsed : best;
+    }
+    return best / frames;
+}
+
+static int64_t time_positions(position_fn position, int rounds)
+{
+    volatile int sink = 0;
+    int64_t start = now_ns();
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int i = 0; i < MAX_SATELLITES; i++)
+        {
+            int dx, dy;
+            position((satellites[i].az + round) % 360, satellites[i].el, &dx, &dy);
+            sink += dx + dy;
+        }
+    }
+    return (now_ns() - start) / rounds;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = (argc > 1) ? atoi(argv[1]) : 20000;
+    int failed = check_tables();
+
+    // A full sky: two thirds tracked at 25 to 50 dB-Hz, the rest only visible
+    srand(1);
+    for (int i = 0; i < MAX_SATELLITES; i++)
+    {
+        satellites[i].az = rand() % 360;
+        satellites[i].el = rand() % 91;
+        satellites[i].cn = (i % 3 != 2) ? 25 + (rand() % 26) : 0;
+    }
+
+    int64_t table_ns = time_frames(sky_plot_position, frames);
+    int64_t float_ns = time_frames(float_position, frames);
+    printf("Frame with %d satellites: %lld ns with the tables, %lld ns with sinf/cosf\n", MAX_SATELLITES,
+           (long long)table_ns, (long long)float_ns);
+    table_ns = time_positions(sky_plot_position, frames * 10);
+    float_ns = time_positions(float_position, frames * 10);
+    printf("Positions alone: %lld ns with the tables, %lld ns with sinf/cosf, per frame\n", (long long)table_ns,
+           (long long)float_ns);
+    return failed;
+}
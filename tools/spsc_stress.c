@@ -0,0 +1,222 @@
+// Host stress test of src/spsc_ring.c with one producer and one consumer
+// thread, under both policies. Every frame carries a sequence number and a
+// payload derived from it, of varying length so frames wrap the ring at every
+// offset. The consumer checks that:
+//  - every frame it pops is intact;
+//  - sequence numbers strictly increase;
+//  - with SPSC_DROP_NEWEST, the gaps are exactly the pushes that failed;
+//  - with SPSC_DROP_OLDEST, every push succeeds and popped plus dropped adds
+//    up to pushed.
+// The producer pushes in bursts and the consumer stalls now and then, so the
+// ring keeps going from empty to full.
+//
+//     cc -O2 -pthread -Isrc -o spsc_stress tools/spsc_stress.c src/spsc_ring.c
+//     ./spsc_stress [frames per policy] [ring capacity]
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc_ring.h"
+
+#define MAX_PAYLOAD (200)
+
+typedef struct
+{
+    uint32_t sequence;
+    uint8_t payload[MAX_PAYLOAD];
+} frame_t;
+
+typedef struct
+{
+    spsc_ring_t ring;
+    uint32_t frames;
+    // Set by the producer before it pushes the next frame, so the consumer
+    // sees the flags of every sequence below the one it popped
+    uint8_t *rejected;
+    atomic_bool done;
+    // Consumer results
+    uint32_t popped;
+    uint32_t corrupt;
+    uint32_t out_of_order;
+    uint32_t missing;
+    uint32_t oversized;
+    uint32_t last_sequence;
+} stress_t;
+
+static uint16_t frame_length(uint32_t sequence)
+{
+    return sizeof(uint32_t) + ((sequence * 2654435761u) >> 24) % MAX_PAYLOAD;
+}
+
+static uint8_t payload_byte(uint32_t sequence, int i)
+{
+    return (uint8_t)((sequence * 31) + (i * 7) + 1);
+}
+
+static void *producer(void *arg)
+{
+    stress_t *stress = arg;
+    frame_t frame;
+
+    for (uint32_t sequence = 1; sequence <= stress->frames; sequence++)
+    {
+        uint16_t length = frame_length(sequence);
+        frame.sequence = sequence;
+        for (int i = 0; i < length - (int)sizeof(uint32_t); i++)
+        {
+            frame.payload[i] = payload_byte(sequence, i);
+        }
+        if (!spsc_ring_push(&stress->ring, &frame, length))
+        {
+            stress->rejected[sequence] = 1;
+        }
+        // Bursts of up to 64 frames, then the consumer gets a turn, which
+        // matters most on a single core
+        if (((sequence * 40503u) >> 10) % 64 == 0)
+        {
+            sched_yield();
+        }
+    }
+    atomic_store(&stress->done, true);
+    return NULL;
+}
+
+static void check_frame(stress_t *stress, const frame_t *frame, int length)
+{
+    if ((length < (int)sizeof(uint32_t)) || (length != frame_length(frame->sequence)))
+    {
+        stress->corrupt++;
+        return;
+    }
+    for (int i = 0; i < length - (int)sizeof(uint32_t); i++)
+    {
+        if (frame->payload[i] != payload_byte(frame->sequence, i))
+        {
+            stress->corrupt++;
+            return;
+        }
+    }
+    if (frame->sequence <= stress->last_sequence)
+    {
+        stress->out_of_order++;
+        return;
+    }
+    // Only the newest policy knows which frames went missing, the oldest
+    // frames are dropped behind the consumer's back
+    if (stress->ring.policy == SPSC_DROP_NEWEST)
+    {
+        for (uint32_t skipped = stress->last_sequence + 1; skipped < frame->sequence; skipped++)
+        {
+            stress->missing += !stress->rejected[skipped];
+        }
+    }
+    stress->last_sequence = frame->sequence;
+}
+
+static void *consumer(void *arg)
+{
+    stress_t *stress = arg;
+    frame_t frame;
+    uint32_t pops = 0;
+
+    for (;;)
+    {
+        // Read before popping, an empty ring after the producer finished is
+        // really empty
+        bool done = atomic_load(&stress->done);
+        int length = spsc_ring_pop(&stress->ring, &frame, sizeof(frame));
+        if (length > 0)
+        {
+            stress->popped++;
+            check_frame(stress, &frame, length);
+        }
+        else if (length < 0)
+        {
+            stress->oversized++;
+        }
+        else if (done)
+        {
+            break;
+        }
+        else
+        {
+            sched_yield();
+        }
+        // Stall every so often so the producer catches up and fills the ring
+        if ((++pops % 4096) < 64)
+        {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static int run(spsc_policy_t policy, uint32_t frames, uint32_t capacity)
+{
+    static stress_t stress;
+    uint8_t *buffer = malloc(capacity);
+    pthread_t threads[2];
+
+    memset(&stress, 0, sizeof(stress));
+    stress.frames = frames;
+    stress.rejected = calloc(frames + 1, 1);
+    spsc_ring_init(&stress.ring, buffer, capacity, policy);
+    atomic_init(&stress.done, false);
+
+    pthread_create(&threads[1], NULL, consumer, &stress);
+    pthread_create(&threads[0], NULL, producer, &stress);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+
+    uint32_t rejected = 0;
+    for (uint32_t i = 1; i <= frames; i++)
+    {
+        rejected += stress.rejected[i];
+    }
+    uint32_t pushed = atomic_load(&stress.ring.stats.frames_pushed);
+    uint32_t popped = atomic_load(&stress.ring.stats.frames_popped);
+    uint32_t dropped = atomic_load(&stress.ring.stats.frames_dropped);
+
+    int failed = (stress.corrupt != 0) || (stress.out_of_order != 0) || (stress.missing != 0) ||
+                 (stress.oversized != 0) || (popped != stress.popped) || (pushed + rejected != frames);
+    if (policy == SPSC_DROP_NEWEST)
+    {
+        // Rejected pushes are the only drops, everything pushed comes out
+        failed |= (dropped != rejected) || (popped != pushed);
+    }
+    else
+    {
+        failed |= (rejected != 0) || (popped + dropped != pushed);
+    }
+
+    printf("%s: %u frames, %u pushed, %u rejected, %u popped, %u dropped, high water %u of %u bytes\n",
+           (policy == SPSC_DROP_NEWEST) ? "Drop newest" : "Drop oldest", frames, pushed, rejected, popped, dropped,
+           atomic_load(&stress.ring.stats.bytes_high_water), capacity);
+    printf("    %u corrupt, %u out of order, %u missing, %u oversized: %s\n", stress.corrupt, stress.out_of_order,
+           stress.missing, stress.oversized, failed ? "FAILED" : "ok");
+
+    free(stress.rejected);
+    free(buffer);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000000;
+    uint32_t capacity = (argc > 2) ? strtoul(argv[2], NULL, 0) : 2048;
+    int failed = 0;
+
+    if ((capacity & (capacity - 1)) || (capacity < SPSC_FRAME_HEADER + sizeof(frame_t)))
+    {
+        printf("The capacity must be a power of two of at least %u bytes\n",
+               (unsigned)(SPSC_FRAME_HEADER + sizeof(frame_t)));
+        return 1;
+    }
+    failed |= run(SPSC_DROP_NEWEST, frames, capacity);
+    failed |= run(SPSC_DROP_OLDEST, frames, capacity);
+    return failed;
+}
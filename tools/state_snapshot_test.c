@@ -0,0 +1,301 @@
+// Host test of the state snapshot format in src/state_snapshot.c and of the
+// schema evolution rules of state_snapshot.h. Blobs from other firmware
+// versions are built record by record, the way those versions encoded them:
+//  - a round trip restores every field;
+//  - records with unknown tags, older or newer, are skipped;
+//  - strings longer than their field are cut, shorter ones replace it;
+//  - numbers whose size changed are dropped, as the float altitude, latitude
+//    and longitude (tags 25 to 27) of the builds before they became double;
+//  - a bad CRC, a bad magic, a newer version or a truncated blob leave the
+//    state alone, a record running past the payload ends the decode.
+//
+//     cc -O2 -Isrc -o state_snapshot_test tools/state_snapshot_test.c src/state_snapshot.c
+//     ./state_snapshot_test
+
+#include <stdio.h>
+#include <string.h>
+
+#include "state_snapshot.h"
+
+#define HEADER_SIZE (12)
+#define ALL_FIELDS ((1u << STATE_FIELD_COUNT) - 1)
+#define BIT(field) (1u << STATE_FIELD_##field)
+
+typedef struct
+{
+    uint8_t data[STATE_SNAPSHOT_MAX_SIZE * 2];
+    size_t length;
+} blob_t;
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("%-56s %s\n", what, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+// CRC-32 as used by zlib, as the snapshot has it
+static uint32_t crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+
+    while (len--)
+    {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+static void blob_begin(blob_t *blob)
+{
+    memset(blob, 0, sizeof(*blob));
+    blob->length = HEADER_SIZE;
+}
+
+static void blob_record(blob_t *blob, uint8_t tag, const void *value, uint8_t length)
+{
+    blob->data[blob->length++] = tag;
+    blob->data[blob->length++] = length;
+    memcpy(&blob->data[blob->length], value, length);
+    blob->length += length;
+}
+
+// Header as snapshot_header_t lays it out, little endian and packed
+static void blob_finish(blob_t *blob, uint32_t magic, uint16_t version)
+{
+    uint16_t length = blob->length - HEADER_SIZE;
+    uint32_t crc = crc32(&blob->data[HEADER_SIZE], length);
+
+    memcpy(&blob->data[0], &magic, 4);
+    memcpy(&blob->data[4], &version, 2);
+    memcpy(&blob->data[6], &length, 2);
+    memcpy(&blob->data[8], &crc, 4);
+}
+
+static void fill_state(gpsdo_state_t *state)
+{
+    memset(state, 0, sizeof(*state));
+    strcpy(state->manufacturer, "Trimble");
+    strcpy(state->model, "UCCM-P");
+    strcpy(state->serial_number, "3410123456");
+    strcpy(state->version, "1.2.3");
+    state->temperature = 45.25f;
+    state->antenna_voltage = 5.1f;
+    state->antenna_current = 0.042f;
+    state->dac = 41.53f;
+    state->efc_data = 12345.0f;
+    state->phase = -1.5e-9f;
+    state->tint = 2.5e-9f;
+    state->freq_diff = 1.2e-12f;
+    state->tfom = 3;
+    state->ffom = 0;
+    strcpy(state->ffom_status, "Stable");
+    state->pullin_range = 30;
+    strcpy(state->status_output, "Normal");
+    strcpy(state->status_gps, "Locked");
+    strcpy(state->alarm_hw, "0");
+    strcpy(state->alarm_op, "0");
+    state->week = 2345;
+    state->utc_offset = 18;
+    strcpy(state->date, "2026-10-19");
+    strcpy(state->time, "12:34:56");
+    state->altitude = 123.456;
+    state->latitude = 52.3676123;
+    state->longitude = 4.9041456;
+    state->satellite_trk = 9;
+    state->satellite_vis = 12;
+}
+
+// Fields a decode may touch, the rest of gpsdo_state_t is not persisted
+static int same_fields(const gpsdo_state_t *a, const gpsdo_state_t *b)
+{
+    gpsdo_state_t x = *a, y = *b;
+    memset(x.satellites, 0, sizeof(x.satellites));
+    memset(y.satellites, 0, sizeof(y.satellites));
+    return memcmp(&x, &y, sizeof(x)) == 0;
+}
+
+static void test_round_trip()
+{
+    gpsdo_state_t state, restored_state;
+    uint8_t buffer[STATE_SNAPSHOT_MAX_SIZE];
+    uint32_t restored;
+
+    fill_state(&state);
+    int length = state_snapshot_encode(&state, buffer, sizeof(buffer));
+    memset(&restored_state, 0, sizeof(restored_state));
+    int result = state_snapshot_decode(&restored_state, buffer, length, &restored);
+    check((length > 0) && (result == 0) && (restored == ALL_FIELDS) && same_fields(&state, &restored_state),
+          "round trip restores every field");
+    check(state_snapshot_encode(&state, buffer, length - 1) < 0, "encode refuses a buffer too small");
+}
+
+static void test_unknown_tags()
+{
+    gpsdo_state_t state;
+    blob_t blob;
+    uint32_t restored;
+    int tfom = 2, trk = 7;
+    uint8_t future[40] = {1, 2, 3};
+
+    // A tag retired before this build and one added after it, around known ones
+    blob_begin(&blob);
+    blob_record(&blob, 0, "gone", 4);
+    blob_record(&blob, 13, &tfom, sizeof(tfom));
+    blob_record(&blob, 250, future, sizeof(future));
+    blob_record(&blob, 18, "Holdover", 8);
+    blob_record(&blob, 30, future, 3);
+    blob_record(&blob, 28, &trk, sizeof(trk));
+    blob_finish(&blob, STATE_SNAPSHOT_MAGIC, STATE_SNAPSHOT_VERSION);
+
+    fill_state(&state);
+    int result = state_snapshot_decode(&state, blob.data, blob.length, &restored);
+    check((result == 0) && (restored == (BIT(tfom) | BIT(status_gps) | BIT(satellite_trk))) && (state.tfom == 2) &&
+              (strcmp(state.status_gps, "Holdover") == 0) && (state.satellite_trk == 7),
+          "unknown tags are skipped, the known ones restored");
+    check(strcmp(state.manufacturer, "Trimble") == 0, "fields without a record keep their value");
+}
+
+static void test_strings()
+{
+    gpsdo_state_t state;
+    blob_t blob;
+    uint32_t restored;
+    const char *long_serial = "3410123456789012345678901234567890";
+
+    // An older build with a wider serial number field, and a short model
+    blob_begin(&blob);
+    blob_record(&blob, 3, long_serial, strlen(long_serial));
+    blob_record(&blob, 2, "U", 1);
+    blob_record(&blob, 4, "", 0);
+    blob_finish(&blob, STATE_SNAPSHOT_MAGIC, STATE_SNAPSHOT_VERSION);
+
+    fill_state(&state);
+    int result = state_snapshot_decode(&state, blob.data, blob.length, &restored);
+    check((result == 0) && (strlen(state.serial_number) == sizeof(state.serial_number) - 1) &&
+              (strncmp(state.serial_number, long_serial, sizeof(state.serial_number) - 1) == 0),
+          "a longer string is cut to the field and terminated");
+    check((strcmp(state.model, "U") == 0) && (state.version[0] == '\0') &&
+              (restored == (BIT(serial_number) | BIT(model) | BIT(version))),
+          "shorter and empty strings replace the field");
+}
+
+static void test_value_size()
+{
+    gpsdo_state_t state;
+    blob_t blob;
+    uint32_t restored;
+    float altitude = 99.5f, latitude = 10.25f, longitude = -3.5f;
+    double new_altitude = 200.125;
+    int16_t narrow_week = 2000;
+
+    // Tags 25 to 27 as the float builds wrote them, plus a number that was
+    // narrower then
+    blob_begin(&blob);
+    blob_record(&blob, 25, &altitude, sizeof(altitude));
+    blob_record(&blob, 26, &latitude, sizeof(latitude));
+    blob_record(&blob, 27, &longitude, sizeof(longitude));
+    blob_record(&blob, 21, &narrow_week, sizeof(narrow_week));
+    blob_record(&blob, 8, &(float){40.0f}, sizeof(float));
+    blob_finish(&blob, STATE_SNAPSHOT_MAGIC, STATE_SNAPSHOT_VERSION);
+
+    fill_state(&state);
+    int result = state_snapshot_decode(&state, blob.data, blob.length, &restored);
+    check((result == 0) && (state.altitude == 123.456) && (state.latitude == 52.3676123) &&
+              (state.longitude == 4.9041456) && !(restored & (BIT(altitude) | BIT(latitude) | BIT(longitude))),
+          "float position of an older build is dropped");
+    check((state.week == 2345) && !(restored & BIT(week)), "a number of another size is dropped");
+    check((state.dac == 40.0f) && (restored == BIT(dac)), "same size numbers around them are restored");
+
+    blob_begin(&blob);
+    blob_record(&blob, 25, &new_altitude, sizeof(new_altitude));
+    blob_finish(&blob, STATE_SNAPSHOT_MAGIC, STATE_SNAPSHOT_VERSION);
+    result = state_snapshot_decode(&state, blob.data, blob.length, &restored);
+    check((result == 0) && (state.altitude == 200.125) && (restored == BIT(altitude)),
+          "double position of this build is restored");
+}
+
+// A rejected blob must leave the state exactly as it was
+static void check_rejected(const blob_t *blob, size_t length, const char *what)
+{
+    gpsdo_state_t state, before;
+    uint32_t restored = ALL_FIELDS;
+
+    fill_state(&state);
+    before = state;
+    int result = state_snapshot_decode(&state, blob->data, length, &restored);
+    check((result < 0) && (restored == 0) && (memcmp(&state, &before, sizeof(state)) == 0), what);
+}
+
+static void test_rejected()
+{
+    gpsdo_state_t state;
+    uint8_t buffer[STATE_SNAPSHOT_MAX_SIZE];
+    blob_t blob;
+
+    fill_state(&state);
+    strcpy(state.status_gps, "Acquiring");
+    blob_begin(&blob);
+    blob.length = state_snapshot_encode(&state, blob.data, sizeof(blob.data));
+    memcpy(buffer, blob.data, blob.length);
+
+    blob.data[blob.length / 2] ^= 0x10;
+    check_rejected(&blob, blob.length, "a bad CRC is rejected");
+    memcpy(blob.data, buffer, blob.length);
+    blob.data[0] ^= 1;
+    check_rejected(&blob, blob.length, "a bad magic is rejected");
+    memcpy(blob.data, buffer, blob.length);
+    check_rejected(&blob, blob.length - 1, "a truncated blob is rejected");
+    check_rejected(&blob, HEADER_SIZE - 1, "a blob shorter than the header is rejected");
+
+    // A newer build, whatever it holds, is not read
+    blob_t newer;
+    blob_begin(&newer);
+    blob_record(&newer, 18, "Locked", 6);
+    blob_finish(&newer, STATE_SNAPSHOT_MAGIC, STATE_SNAPSHOT_VERSION + 1);
+    check_rejected(&newer, newer.length, "a newer version is rejected");
+
+    // An older version is read
+    uint32_t restored;
+    blob_finish(&newer, STATE_SNAPSHOT_MAGIC, STATE_SNAPSHOT_VERSION - 1);
+    int result = state_snapshot_decode(&state, newer.data, newer.length, &restored);
+    check((result == 0) && (restored == BIT(status_gps)) && (strcmp(state.status_gps, "Locked") == 0),
+          "an older version is read");
+}
+
+static void test_overrun()
+{
+    gpsdo_state_t state;
+    blob_t blob;
+    uint32_t restored;
+    int tfom = 1;
+
+    // The last record claims more bytes than the payload holds
+    blob_begin(&blob);
+    blob_record(&blob, 13, &tfom, sizeof(tfom));
+    blob_record(&blob, 18, "Locked", 6);
+    blob.data[blob.length - 7] = 60;
+    blob_finish(&blob, STATE_SNAPSHOT_MAGIC, STATE_SNAPSHOT_VERSION);
+
+    fill_state(&state);
+    strcpy(state.status_gps, "Holdover");
+    int result = state_snapshot_decode(&state, blob.data, blob.length, &restored);
+    check((result == 0) && (restored == BIT(tfom)) && (state.tfom == 1) && (strcmp(state.status_gps, "Holdover") == 0),
+          "a record past the payload ends the decode");
+}
+
+int main()
+{
+    test_round_trip();
+    test_unknown_tags();
+    test_strings();
+    test_value_size();
+    test_rejected();
+    test_overrun();
+    return failures != 0;
+}
@@ -0,0 +1,237 @@
+// Host test of the SYST:STAT? parsers in src/uccm_status.c and of the
+// profile selection in src/uccm_profile.c. The dump below is split into
+// lines the way parse_status() splits the response:
+//  - every key of the Trimble layout in uccm_profile.h is where the dump has
+//    it, and the layout parser reads every value and satellite from it;
+//  - the layout parser skips the lines that did not change since the previous
+//    dump, rereads those that did, and refills the slot of a satellite row
+//    that went away and came back;
+//  - the keyword parser reads the same state from the same dump;
+//  - a dump with a line more at the top is refused by the layout parser
+//    without touching the state, the keyword parser still reads it;
+//  - the UCCM and the UCCM-P get their Trimble profiles, which differ in the
+//    TOD decoding only, other models the generic one.
+// Lines 5, 8 to 18, 24 and 26 are the sample lines at the line numbers of
+// the position parser utils.c had before the profiles, the others only fill
+// their places.
+//
+//     cc -O2 -Isrc -o uccm_status_test tools/uccm_status_test.c src/uccm_status.c src/uccm_profile.c -lm
+//     ./uccm_status_test
+
+#define _DEFAULT_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "uccm_profile.h"
+#include "uccm_status.h"
+
+static const char capture[] =
+    "------------------------------------ STATUS ------------------------------------\r\n"
+    "10 MHz output : [ Normal ]       1 PPS output : [ Normal ]\r\n"
+    "Reference : [ GPS ]              Holdover duration : [ 0 s ]\r\n"
+    "Loop : [ Locked ]\r\n"
+    "--------------------------------------------------------------------------------\r\n"
+    "TFOM     2            FFOM      1\r\n"
+    "--------------------------------- SOURCE ---------------------------------------\r\n"
+    "Priority : [ GPS ]\r\n"
+    ">>GPS :     [phase : -4.714E-10]\r\n"
+    "ACQUISITION ................................................ [ GPS 1PPS Valid ]\r\n"
+    "Tracking:  7 ___   Not Tracking:  5 _______   Time ____________________________\r\n"
+    "PRN  El  AZ  CNO   PRN  El  Az                GPS      09:23:09     13 OCT 2021\r\n"
+    "  1  63 139  50      6   6 304                GPS      Synchronized to UTC\r\n"
+    "  3  41  62  47     12  10 201\r\n"
+    "  8  22 311  38     17   3  95\r\n"
+    " 11  75  20  51     24   1 150\r\n"
+    " 14  15 260  33     28   8 345\r\n"
+    " 19  36 104  44\r\n"
+    " 32  52 190  49\r\n"
+    "\r\n"
+    "--------------------------------------------------------------------------------\r\n"
+    "Position : [ N 52:22:3.404  E 4:54:14.924  12.51 m ]\r\n"
+    "Antenna delay : [ 0 ns ]\r\n"
+    "\r\n"
+    "ELEV MASK  5 deg                              ANT V=5.112V, I=24.400mA\r\n"
+    "--------------------------------------------------------------------------------\r\n"
+    "Temp = 37.000 / NONE";
+
+// PRN, elevation, azimuth and C/N0 of each slot, tracked ones first
+static const gps_satellite_t expected_satellites[] = {
+    {1, 63, 139, 50},  {3, 41, 62, 47},  {8, 22, 311, 38}, {11, 75, 20, 51}, {14, 15, 260, 33}, {19, 36, 104, 44},
+    {32, 52, 190, 49}, {0},              {0},              {0},              {0},               {0},
+    {6, 6, 304, 0},    {12, 10, 201, 0}, {17, 3, 95, 0},   {24, 1, 150, 0},  {28, 8, 345, 0},
+};
+
+typedef struct
+{
+    char text[sizeof(capture) + 128];
+    char *lines[UCCM_STATUS_MAX_LINES];
+    uint16_t lengths[UCCM_STATUS_MAX_LINES];
+    int count;
+} dump_t;
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+// As parse_status() does it
+static void dump_split(dump_t *dump, const char *prefix)
+{
+    char *found;
+    char *data_ptr = dump->text;
+
+    snprintf(dump->text, sizeof(dump->text), "%s%s", prefix, capture);
+    dump->count = 0;
+    while ((dump->count < UCCM_STATUS_MAX_LINES) && ((found = strsep(&data_ptr, "\n")) != NULL))
+    {
+        dump->lines[dump->count] = found;
+        dump->lengths[dump->count] = strlen(found);
+        dump->count++;
+    }
+}
+
+// Slots the dump does not fill hold a stale satellite, which must go
+static void stale_state(gpsdo_state_t *state)
+{
+    memset(state, 0, sizeof(*state));
+    for (int i = 0; i < GPSDO_MAX_SATELLITES; i++)
+    {
+        state->satellites[i] = (gps_satellite_t){.prn = 99, .e1 = 9, .az = 9, .cn = 9};
+    }
+}
+
+static int expected_values(const gpsdo_state_t *state)
+{
+    int ok = (state->tfom == 2) && (state->ffom == 1) && (fabsf(state->phase - -4.714e-10f) < 1e-15f) &&
+             (state->satellite_trk == 7) && (state->satellite_vis == 12) && (state->antenna_voltage == 5.112f) &&
+             (state->antenna_current == 24.4f) && (state->temperature == 37.0f);
+    for (int i = 0; i < GPSDO_MAX_SATELLITES; i++)
+    {
+        gps_satellite_t expected = {0};
+        if (i < (int)(sizeof(expected_satellites) / sizeof(expected_satellites[0])))
+        {
+            expected = expected_satellites[i];
+        }
+        const gps_satellite_t *sat = &state->satellites[i];
+        ok &= (sat->prn == expected.prn);
+        ok &= (expected.prn == 0) || ((sat->e1 == expected.e1) && (sat->az == expected.az) && (sat->cn == expected.cn));
+    }
+    return ok;
+}
+
+static int key_at(const dump_t *dump, int line, int column, const char *text)
+{
+    return (line < dump->count) && (dump->lengths[line] >= column + strlen(text)) &&
+           (memcmp(&dump->lines[line][column], text, strlen(text)) == 0);
+}
+
+static void test_layout()
+{
+    gpsdo_state_t state;
+    dump_t dump;
+    char what[80];
+
+    dump_split(&dump, "");
+#define CHECK_KEY(line, column, text)                                                   \
+    snprintf(what, sizeof(what), "\"%s\" on line %d at column %d", text, line, column); \
+    check(key_at(&dump, line, column, text), what);
+#define SKIP_VALUE(kind, line, column, field)
+    UCCM_TRIMBLE_STATUS(CHECK_KEY, SKIP_VALUE)
+
+    stale_state(&state);
+    uccm_status_invalidate();
+    check(uccm_status_trimble(&state, dump.lines, dump.lengths, dump.count), "the layout parser takes the dump");
+    check(expected_values(&state), "and reads every value and satellite of it");
+
+    // A field only changes when its line is parsed again
+    dump_split(&dump, "");
+    state.temperature = 0.0f;
+    uccm_status_trimble(&state, dump.lines, dump.lengths, dump.count);
+    check(state.temperature == 0.0f, "an unchanged dump is skipped");
+    dump.lines[26][8] = '8';
+    uccm_status_trimble(&state, dump.lines, dump.lengths, dump.count);
+    check(state.temperature == 38.0f, "a changed line is read again");
+
+    dump_split(&dump, "");
+    dump.lines[18][0] = '\0';
+    dump.lengths[18] = 0;
+    uccm_status_trimble(&state, dump.lines, dump.lengths, dump.count);
+    check(state.satellites[6].prn == 0, "a satellite row that went away is cleared");
+    dump_split(&dump, "");
+    uccm_status_trimble(&state, dump.lines, dump.lengths, dump.count);
+    check(expected_values(&state), "and read again when it comes back");
+}
+
+static void test_keywords()
+{
+    gpsdo_state_t state;
+    dump_t dump;
+
+    dump_split(&dump, "");
+    stale_state(&state);
+    uccm_status_invalidate();
+    check(uccm_status_keywords(&state, dump.lines, dump.count) == dump.count, "the keyword parser reads every line");
+    check(expected_values(&state), "and the same values and satellites");
+
+    dump_split(&dump, "");
+    check(uccm_status_keywords(&state, dump.lines, dump.count) == 0, "an unchanged dump is skipped");
+}
+
+static void test_moved()
+{
+    gpsdo_state_t state, before;
+    dump_t dump;
+
+    dump_split(&dump, "Firmware line the layout does not know\r\n");
+    stale_state(&state);
+    before = state;
+    check(!uccm_status_trimble(&state, dump.lines, dump.lengths, dump.count) &&
+              (memcmp(&state, &before, sizeof(state)) == 0),
+          "a dump with a line more is refused, the state untouched");
+    uccm_status_invalidate();
+    uccm_status_keywords(&state, dump.lines, dump.count);
+    check(expected_values(&state), "the keyword parser still reads it");
+}
+
+static const char *profile_of(const char *manufacturer, const char *model)
+{
+    gpsdo_state_t state;
+
+    memset(&state, 0, sizeof(state));
+    strcpy(state.manufacturer, manufacturer);
+    strcpy(state.model, model);
+    strcpy(state.version, "1.2.3");
+    uccm_profile_select(&state);
+    return uccm_profile_current()->name;
+}
+
+static void test_profiles()
+{
+    static const uint8_t power_up[4] = {0x43, 0x04, 0x41, 0x90};
+    uint8_t status[4];
+
+    check(strcmp(profile_of("Trimble", "UCCM"), "Trimble UCCM") == 0, "the UCCM gets its profile");
+    uccm_profile_current()->decode_tod(power_up, status);
+    check(status[2] == 0x4f, "which maps its power up status onto the UCCM-P one");
+    check(strcmp(profile_of(" Trimble", " UCCM-P "), "Trimble UCCM-P") == 0, "so does the UCCM-P");
+    uccm_profile_current()->decode_tod(power_up, status);
+    check((memcmp(status, power_up, sizeof(status)) == 0) &&
+              (uccm_profile_current()->parse_status == uccm_status_trimble),
+          "which keeps its TOD status bytes and shares the layout");
+    check((strcmp(profile_of("Trimble", "Thunderbolt"), "generic") == 0) &&
+              (uccm_profile_current()->parse_status == NULL),
+          "other models get the keyword parser");
+}
+
+int main()
+{
+    test_layout();
+    test_keywords();
+    test_moved();
+    test_profiles();
+    return failures != 0;
+}
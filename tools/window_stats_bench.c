@@ -0,0 +1,42 @@
+// Host benchmark of the window statistics kernels in src/window_stats.c.
+// Times the scalar and vector kernels through the chunked path the screen
+// uses and checks both against a double precision reference, for windows
+// from a minute to a day of 1 Hz samples.
+//
+//     cc -O2 -Isrc -o window_stats_bench tools/window_stats_bench.c src/window_stats.c -lm
+//     ./window_stats_bench [rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "window_stats.h"
+
+// Worst relative error either kernel may show, 10 ppm
+#define ERROR_LIMIT_PPB (10000)
+
+int main(int argc, char **argv)
+{
+    static const uint32_t windows[] = {60, 600, WINDOW_STATS_SECONDS, 6 * 3600, 24 * 3600};
+    int rounds = (argc > 1) ? atoi(argv[1]) : 200;
+    int failed = 0;
+
+    printf("%8s %10s %10s %8s %12s %12s\n", "samples", "scalar us", "vector us", "speedup", "scalar ppb",
+           "vector ppb");
+    for (int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+    {
+        window_stats_benchmark_t result;
+        if (window_stats_benchmark(windows[i], rounds, &result) != 0)
+        {
+            printf("Out of memory\n");
+            return 1;
+        }
+        printf("%8u %10.1f %10.1f %7.2fx %12u %12u\n", result.samples, result.scalar_ns / 1000.0,
+               result.vector_ns / 1000.0, (double)result.scalar_ns / (result.vector_ns ? result.vector_ns : 1),
+               result.scalar_error_ppb, result.vector_error_ppb);
+        if ((result.scalar_error_ppb > ERROR_LIMIT_PPB) || (result.vector_error_ppb > ERROR_LIMIT_PPB))
+        {
+            failed++;
+        }
+    }
+    return failed != 0;
+}